@@ -0,0 +1,787 @@
+/*
+ * bench.c
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: xenir
+ */
+
+// Runs each of the portable processing stages over the same synthetic
+// input and prints the cost per block and per sample. Cycles come from
+// cycle_count_get(), which is the TSC on x86 hosts, so the numbers are for
+// comparing stages and changes against each other, not for predicting the
+// ESP32 figures reported by the /command endpoints.
+//
+//   host/build/bench [--trace FILE] [FILTER]
+//
+// --trace takes the input from an I2S trace saved from /capture (see
+// main/i2s_trace.h) instead, looped if it is shorter than the run, so
+// stages whose cost depends on the signal are timed on real material and
+// a change can be compared on identical input. The quality reports after
+// the table keep their own signals, which their figures are worked out
+// against.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+
+#include "cycle_count.h"
+#include "voice_proc.h"
+#include "vad.h"
+#include "spectrum.h"
+#include "resampler.h"
+#include "stretch.h"
+#include "denoise.h"
+#include "notch.h"
+#include "iq.h"
+#include "narrowband.h"
+#include "goertzel.h"
+#include "drift.h"
+#include "wav_create.h"
+#include "mix.h"
+#include "i2s_trace.h"
+
+#define SAMPLE_RATE		16000
+#define BLOCK_FRAMES	1024			// streaming_http_audio block: 4096 bytes of stereo in
+#define BLOCKS			2000
+
+typedef struct {
+    const char*	name;
+    int			channels;
+    void*		(*setup)( void );
+    void		(*run)( void* ctx, int16_t* buf, int frames );
+} bench_t;
+
+static void* voice_proc_setup( void )
+{
+    static voice_proc_t vp;
+    voice_proc_params_t params = DEFAULT_VOICE_PROC_PARAMS();
+    voice_proc_init( &vp, SAMPLE_RATE, 2, &params );
+    return &vp;
+}
+
+static void voice_proc_run( void* ctx, int16_t* buf, int frames )
+{
+    voice_proc_process( (voice_proc_t*) ctx, buf, frames );
+}
+
+static void* vad_setup( void )
+{
+    static vad_t vad;
+    vad_params_t params = DEFAULT_VAD_PARAMS();
+    vad_init( &vad, SAMPLE_RATE, &params );
+    return &vad;
+}
+
+static void vad_run( void* ctx, int16_t* buf, int frames )
+{
+    vad_process( (vad_t*) ctx, buf, frames );
+}
+
+static void* spectrum_setup( void )
+{
+    static spectrum_t sp;
+    spectrum_init( &sp, SAMPLE_RATE );
+    return &sp;
+}
+
+static void spectrum_run( void* ctx, int16_t* buf, int frames )
+{
+    spectrum_frame_t frame;
+    spectrum_compute( (spectrum_t*) ctx, buf, frames, &frame );
+}
+
+// The spectrum at the tone detector's 10 ms time resolution: one transform
+// a frame instead of one a block
+
+static void spectrum_frames_run( void* ctx, int16_t* buf, int frames )
+{
+    spectrum_frame_t frame;
+    for ( int i = 0 ; i < frames ; i += SAMPLE_RATE / 100 )
+        spectrum_compute( (spectrum_t*) ctx, buf + i, frames - i < SAMPLE_RATE / 100 ? frames - i : SAMPLE_RATE / 100, &frame );
+}
+
+// A block shorter than the transform, as the streamer delivers once the
+// link is calm (16 ms, 256 samples), is zero padded in front. The block
+// is 1 kHz and what follows it in memory 3 kHz at the same level, so a
+// transform reaching past the block shows 3 kHz
+
+static void spectrum_report( void )
+{
+    static spectrum_t sp;
+    static int16_t x[SPECTRUM_FFT_SIZE];
+    spectrum_frame_t frame;
+    const int count = 256;
+
+    spectrum_init( &sp, SAMPLE_RATE );
+    for ( int i = 0 ; i < SPECTRUM_FFT_SIZE ; i++ )
+        x[i] = 16000 * sin( 2 * M_PI * ( i < count ? 1000 : 3000 ) * i / SAMPLE_RATE );
+    spectrum_compute( &sp, x, count, &frame );
+
+    int peak = 0, outside = 0;
+    for ( int b = 0 ; b < SPECTRUM_BINS ; b++ ) {
+        if ( frame.bins[b] > frame.bins[peak] )
+            peak = b;
+        int hz = sp.edges[b] * SAMPLE_RATE / SPECTRUM_FFT_SIZE;
+        if ( hz >= 2500 && hz <= 3500 && frame.bins[b] > frame.bins[outside] )
+            outside = b;
+    }
+
+    printf( "\nspectrum: %d sample block of 1000 Hz, peak bin from %d Hz at %.1f dB, "
+            "3000 Hz past the block %.1f dB below it\n", count,
+            sp.edges[peak] * SAMPLE_RATE / SPECTRUM_FFT_SIZE, SPECTRUM_FLOOR_DB + frame.bins[peak] / 2.0,
+            ( frame.bins[peak] - frame.bins[outside] ) / 2.0 );
+}
+
+// Tones spread over the voice band, the first being the default 600 Hz
+
+static void* goertzel_setup( int tones )
+{
+    static goertzel_t g[GOERTZEL_MAX_TONES + 1];
+    goertzel_params_t params = DEFAULT_GOERTZEL_PARAMS();
+    params.tones = tones;
+    for ( int t = 0 ; t < tones ; t++ )
+        params.hz[t] = 600 + 350 * t;
+    goertzel_init( &g[tones], SAMPLE_RATE, &params );
+    return &g[tones];
+}
+
+static void* goertzel1_setup( void ) { return goertzel_setup( 1 ); }
+static void* goertzel4_setup( void ) { return goertzel_setup( 4 ); }
+static void* goertzel8_setup( void ) { return goertzel_setup( 8 ); }
+
+static void goertzel_run( void* ctx, int16_t* buf, int frames )
+{
+    goertzel_event_t events[64];
+    goertzel_process( (goertzel_t*) ctx, buf, frames, events, 64 );
+}
+
+static void* resampler_setup( void )
+{
+    static resampler_t rs;
+    resampler_init( &rs );
+    resampler_set_ppm( &rs, -80 );
+    return &rs;
+}
+
+static void resampler_run( void* ctx, int16_t* buf, int frames )
+{
+    static int16_t out[BLOCK_FRAMES + BLOCK_FRAMES / 64];
+    resampler_process( (resampler_t*) ctx, buf, frames, out );
+}
+
+// Catch-up at 110% of real time, the backlog held so the rate stays put
+
+static void* stretch_setup( void )
+{
+    static stretch_t st;
+    stretch_params_t params = DEFAULT_STRETCH_PARAMS();
+    stretch_init( &st, SAMPLE_RATE, &params );
+    return &st;
+}
+
+static void stretch_run( void* ctx, int16_t* buf, int frames )
+{
+    static int16_t out[BLOCK_FRAMES + STRETCH_SEQUENCE_MS * SAMPLE_RATE / 1000];
+    stretch_t* st = (stretch_t*) ctx;
+    stretch_update( st, st->params.stop_ms + st->params.catchup_ms / 10 );
+    stretch_process( st, buf, frames, out );
+}
+
+static void* denoise_setup( void )
+{
+    static denoise_t dn;
+    denoise_params_t params = DEFAULT_DENOISE_PARAMS();
+    params.enable = true;
+    denoise_init( &dn, SAMPLE_RATE, 2, &params );
+    return &dn;
+}
+
+static void denoise_run( void* ctx, int16_t* buf, int frames )
+{
+    denoise_process( (denoise_t*) ctx, buf, frames );
+}
+
+// The delay through the noise reduction, found from where an impulse comes
+// out with the gains held at unity, and what it takes off steady noise:
+// seconds of white noise at about -30 dBFS, the last one measured
+
+static void denoise_report( void )
+{
+    static denoise_t dn;
+    static int16_t x[4 * SAMPLE_RATE];
+    denoise_params_t params = DEFAULT_DENOISE_PARAMS();
+    params.enable = true;
+    params.attenuation_db = 0;
+    denoise_init( &dn, SAMPLE_RATE, 1, &params );
+
+    memset( x, 0, sizeof(x) );
+    x[100] = 16000;
+    denoise_process( &dn, x, SAMPLE_RATE );
+    int delay = 0;
+    for ( int i = 0 ; i < SAMPLE_RATE ; i++ )
+        if ( abs( x[i] ) > abs( x[delay] ) )
+            delay = i;
+    delay -= 100;
+
+    denoise_params_t defaults = DEFAULT_DENOISE_PARAMS();
+    params.attenuation_db = defaults.attenuation_db;
+    denoise_init( &dn, SAMPLE_RATE, 1, &params );
+    srand( 1 );
+    double in = 0, out = 0;
+    for ( int i = 0 ; i < 4 * SAMPLE_RATE ; i++ ) {
+        x[i] = rand() % 2000 - 1000;
+        if ( i >= 3 * SAMPLE_RATE )
+            in += (double) x[i] * x[i];
+    }
+    for ( int i = 0 ; i < 4 * SAMPLE_RATE ; i += BLOCK_FRAMES )
+        denoise_process( &dn, x + i, i + BLOCK_FRAMES > 4 * SAMPLE_RATE ? 4 * SAMPLE_RATE - i : BLOCK_FRAMES );
+    for ( int i = 3 * SAMPLE_RATE ; i < 4 * SAMPLE_RATE ; i++ )
+        out += (double) x[i] * x[i];
+
+    printf( "\ndenoise: %d point frames, hop %d, delay %d samples (%.1f ms at %d Hz), "
+            "steady noise %.1f dB with attenuation %d dB\n",
+            DENOISE_FFT_SIZE, DENOISE_HOP, delay, delay * 1000.0 / SAMPLE_RATE, SAMPLE_RATE,
+            10 * log10( out / in ), params.attenuation_db );
+}
+
+// The bench input's bursts hold two steady tones, so the sections lock and
+// the locked path is what is measured
+
+static void* notch_setup( void )
+{
+    static notch_t nt;
+    notch_params_t params = DEFAULT_NOTCH_PARAMS();
+    notch_init( &nt, SAMPLE_RATE, &params );
+    return &nt;
+}
+
+static void notch_run( void* ctx, int16_t* buf, int frames )
+{
+    notch_process( (notch_t*) ctx, buf, frames );
+}
+
+// Tracking on the create_wav_data test signal, a fundamental and its odd
+// harmonics at 1/n: four sections on a 500 Hz wave, then the wave jumps to
+// 600 Hz. Reports when all four are locked after each start, where they
+// are, and how far the wave comes down
+
+static int notch_track( notch_t* nt, int16_t* wave, int16_t* mono, double hz, double* reduction )
+{
+    int locked_ms = -1;
+    double in = 0, out = 0;
+
+    create_wav_data( wave, 2, hz, 2, 16, SAMPLE_RATE );
+    for ( int i = 0 ; i < 2 * SAMPLE_RATE ; i++ )
+        mono[i] = wave[2*i] / 2;
+
+    for ( int i = 0 ; i < 2 * SAMPLE_RATE ; i += 256 ) {
+        int locked = 0;
+        for ( int j = i ; j < i + 256 && i >= SAMPLE_RATE ; j++ )
+            in += (double) mono[j] * mono[j];
+        notch_process( nt, mono + i, 256 );
+        for ( int k = 0 ; k < nt->tones ; k++ )
+            locked += nt->sec[k].locked;
+        if ( locked == nt->tones && locked_ms < 0 )
+            locked_ms = ( i + 256 ) * 1000 / SAMPLE_RATE;
+        for ( int j = i ; j < i + 256 && i >= SAMPLE_RATE ; j++ )
+            out += (double) mono[j] * mono[j];
+    }
+
+    *reduction = 10 * log10( out / in );
+    return locked_ms;
+}
+
+static void notch_report( void )
+{
+    static notch_t nt;
+    static int16_t wave[2 * 2 * SAMPLE_RATE], mono[2 * SAMPLE_RATE];
+    notch_params_t params = DEFAULT_NOTCH_PARAMS();
+    params.tones = 4;
+    notch_init( &nt, SAMPLE_RATE, &params );
+
+    for ( double hz = 500 ; hz <= 600 ; hz += 100 ) {
+        double reduction;
+        int ms = notch_track( &nt, wave, mono, hz, &reduction );
+        printf( "notch: %.0f Hz wave, 4 sections locked after %d ms at", hz, ms );
+        for ( int k = 0 ; k < nt.tones ; k++ )
+            printf( " %d", notch_frequency( &nt, k ) );
+        printf( " Hz, second second %.1f dB\n", reduction );
+    }
+}
+
+// The drift loop against a listener whose clock runs 80 ppm slow, fed a
+// played position every two seconds as index3.html does, for three days of
+// stream time. The player starts with half a second buffered. The depth
+// band is taken after the first hour, by which the loop has settled
+
+static void drift_report( void )
+{
+    static drift_t d;
+    drift_params_t params = DEFAULT_DRIFT_PARAMS();
+    drift_init( &d, SAMPLE_RATE, &params );
+    drift_reset( &d, 0 );
+
+    const double slow_ppm = 80, preroll = 0.5 * SAMPLE_RATE;
+    const int64_t step_us = 2000000, end_us = 3 * 24 * 3600 * 1000000LL;
+    double sent = preroll, played = 0;
+    int32_t ppm = 0, lo = INT32_MAX, hi = INT32_MIN;
+
+    for ( int64_t t = step_us ; t <= end_us ; t += step_us ) {
+        sent += SAMPLE_RATE * 2.0 * ( 1 + ppm / 1e6 );
+        played += SAMPLE_RATE * 2.0 * ( 1 - slow_ppm / 1e6 );
+        ppm = drift_update( &d, t, (int32_t) ( (int64_t) sent - (int64_t) played ) );
+        if ( t >= 3600 * 1000000LL ) {
+            lo = d.depth_ms < lo ? d.depth_ms : lo;
+            hi = d.depth_ms > hi ? d.depth_ms : hi;
+        }
+    }
+
+    printf( "drift: listener %.0f ppm slow for 3 days, drift_ppm %.1f, correction %d ppm, depth %d to %d ms (target %d)\n",
+            slow_ppm, -d.integral_ppm, ppm, lo, hi, d.target_ms );
+}
+
+// The bench input is the same on both channels, which as I/Q is a lopsided
+// signal the balance correction holds back on, but costs the same. The
+// offset keeps the shift's oscillator in the path
+
+static void* iq_setup( int mode )
+{
+    static iq_t iq[IQ_MODES];
+    iq_params_t params = DEFAULT_IQ_PARAMS();
+    params.mode = mode;
+    params.offset_hz = 1000;
+    iq_init( &iq[mode], SAMPLE_RATE, &params );
+    return &iq[mode];
+}
+
+static void* iq_usb_setup( void ) { return iq_setup( IQ_MODE_USB ); }
+static void* iq_lsb_setup( void ) { return iq_setup( IQ_MODE_LSB ); }
+static void* iq_am_setup( void ) { return iq_setup( IQ_MODE_AM ); }
+
+static void iq_run( void* ctx, int16_t* buf, int frames )
+{
+    iq_process( (iq_t*) ctx, buf, 16, frames );
+}
+
+// A complex tone at -12 dBFS, I = cos and Q = g sin( wt + phi ) plus a DC
+// offset, through "mode" for two seconds; returns the level of the second
+// relative to the tone's
+
+static double iq_level( int mode, double hz, double gain_db, double phase_deg, int dc, bool balance, iq_t* iq )
+{
+    iq_params_t params = DEFAULT_IQ_PARAMS();
+    params.mode = mode;
+    params.balance = balance;
+    iq_init( iq, SAMPLE_RATE, &params );
+
+    int16_t buf[2 * 256];
+    double g = pow( 10, gain_db / 20 ), phi = phase_deg * M_PI / 180, a = 8192, out = 0;
+    for ( int i = 0 ; i < 2 * SAMPLE_RATE ; i += 256 ) {
+        for ( int j = 0 ; j < 256 ; j++ ) {
+            double w = 2 * M_PI * hz * ( i + j ) / SAMPLE_RATE;
+            buf[2*j] = lrint( a * cos( w ) + dc );
+            buf[2*j+1] = lrint( a * g * sin( w + phi ) - dc );
+        }
+        iq_process( iq, buf, 16, 256 );
+        for ( int j = 0 ; j < 256 && i >= SAMPLE_RATE ; j++ )
+            out += (double) buf[2*j] * buf[2*j];
+    }
+    return 10 * log10( out / SAMPLE_RATE / ( a * a / 2 ) );
+}
+
+// Opposite sideband rejection across the band, what a front end 1 dB and 5
+// degrees out of balance with a DC offset does to it with and without the
+// correction, and AM: a 2 kHz carrier 50% modulated at 400 Hz, tuned with
+// the offset, should come out at 6 dB under the carrier
+
+static void iq_report( void )
+{
+    static iq_t iq;
+    static const double hz[] = { 200, 300, 1000, 3000, 7000, 7800 };
+
+    printf( "\niq: opposite sideband" );
+    for ( int k = 0 ; k < sizeof(hz) / sizeof(hz[0]) ; k++ )
+        printf( " %.0f Hz %.1f dB%s", hz[k], iq_level( IQ_MODE_LSB, hz[k], 0, 0, 0, true, &iq ), k + 1 < sizeof(hz) / sizeof(hz[0]) ? "," : "" );
+
+    float gain_db, phase_deg;
+    double off = iq_level( IQ_MODE_LSB, 1000, 1, 5, 500, false, &iq );
+    double on = iq_level( IQ_MODE_LSB, 1000, 1, 5, 500, true, &iq );
+    iq_imbalance( &iq, &gain_db, &phase_deg );
+    printf( "\niq: 1 dB 5 deg imbalance and 500 DC, opposite sideband %.1f dB uncorrected, %.1f dB corrected "
+            "(estimated %.2f dB %.2f deg, DC %.0f %.0f)\n",
+            off, on, gain_db, phase_deg, iq.dc_i, iq.dc_q );
+
+    iq_params_t params = DEFAULT_IQ_PARAMS();
+    params.mode = IQ_MODE_AM;
+    params.offset_hz = 2000;
+    iq_init( &iq, SAMPLE_RATE, &params );
+
+    int16_t buf[2 * 256];
+    double out = 0, a = 8192;
+    for ( int i = 0 ; i < 2 * SAMPLE_RATE ; i += 256 ) {
+        for ( int j = 0 ; j < 256 ; j++ ) {
+            double t = (double) ( i + j ) / SAMPLE_RATE;
+            double env = a * ( 1 + 0.5 * cos( 2 * M_PI * 400 * t ) );
+            buf[2*j] = lrint( env * cos( 2 * M_PI * 2000 * t ) );
+            buf[2*j+1] = lrint( env * sin( 2 * M_PI * 2000 * t ) );
+        }
+        iq_process( &iq, buf, 16, 256 );
+        for ( int j = 0 ; j < 256 && i >= SAMPLE_RATE ; j++ )
+            out += (double) buf[2*j] * buf[2*j];
+    }
+    printf( "iq: am 2 kHz carrier 50%% modulated at 400 Hz, audio %.1f dB against the carrier\n",
+            10 * log10( out / SAMPLE_RATE / ( a * a / 2 ) ) );
+}
+
+static void* narrowband_setup( int preset )
+{
+    static narrowband_t nb[NARROWBAND_PRESETS];
+    narrowband_init( &nb[preset], SAMPLE_RATE, preset );
+    return &nb[preset];
+}
+
+static void* narrowband_voice_setup( void ) { return narrowband_setup( NARROWBAND_VOICE ); }
+static void* narrowband_narrow_setup( void ) { return narrowband_setup( NARROWBAND_NARROW ); }
+static void* narrowband_cw_setup( void ) { return narrowband_setup( NARROWBAND_CW ); }
+
+static void narrowband_run( void* ctx, int16_t* buf, int frames )
+{
+    narrowband_process( (narrowband_t*) ctx, buf, frames );
+}
+
+// Each preset's response: a second of a -12 dBFS tone at each frequency,
+// the level of the last half against the input's, and the delay
+
+static void narrowband_report( void )
+{
+    static narrowband_t nb;
+    static int16_t x[SAMPLE_RATE];
+    static const int hz[] = { 100, 500, 1500, 3000, 3500, 4500, 6000 };
+
+    for ( int p = NARROWBAND_VOICE ; p < NARROWBAND_PRESETS ; p++ ) {
+
+        int rate = narrowband_init( &nb, SAMPLE_RATE, p );
+        printf( "%snarrowband: %s at %d Hz, %.1f ms delay,", p == NARROWBAND_VOICE ? "\n" : "",
+                narrowband_name( p ), rate, nb.delay_us / 1000.0 );
+
+        for ( int k = 0 ; k < sizeof(hz) / sizeof(hz[0]) ; k++ ) {
+            narrowband_init( &nb, SAMPLE_RATE, p );
+            for ( int i = 0 ; i < SAMPLE_RATE ; i++ )
+                x[i] = lrint( 8192 * sin( 2 * M_PI * hz[k] * i / SAMPLE_RATE ) );
+            int n = 0;
+            for ( int i = 0 ; i < SAMPLE_RATE ; i += SAMPLE_RATE / 50 ) {
+                int m = narrowband_process( &nb, x + i, SAMPLE_RATE / 50 );
+                memmove( x + n, x + i, m * sizeof(int16_t) );
+                n += m;
+            }
+            double out = 0;
+            for ( int i = n / 2 ; i < n ; i++ )
+                out += (double) x[i] * x[i];
+            printf( " %d Hz %.1f dB%s", hz[k], 10 * log10( out / ( n - n / 2 ) / ( 8192.0 * 8192 / 2 ) + 1e-12 ),
+                    k + 1 < sizeof(hz) / sizeof(hz[0]) ? "," : "\n" );
+        }
+    }
+}
+
+// Each extra input is a tone at -20 dB added to the stereo block, the live
+// block at -1 dB so the main gain multiply is included. The difference
+// between the rows is the cost of one more input
+
+static int16_t mix_sources[4][BLOCK_FRAMES];
+
+static void* mix_setup( int inputs )
+{
+    static int counts[5];
+    for ( int n = 0 ; n < 4 ; n++ )
+        for ( int i = 0 ; i < BLOCK_FRAMES ; i++ )
+            mix_sources[n][i] = 15000 * sin( 2 * M_PI * ( 300 + 200 * n ) * i / SAMPLE_RATE );
+    counts[inputs] = inputs;
+    return &counts[inputs];
+}
+
+static void* mix1_setup( void ) { return mix_setup( 1 ); }
+static void* mix2_setup( void ) { return mix_setup( 2 ); }
+static void* mix4_setup( void ) { return mix_setup( 4 ); }
+
+static void mix_run( void* ctx, int16_t* buf, int frames )
+{
+    int inputs = *(int*) ctx;
+    mix_scale_q15( buf, frames * 2, mix_gain_q15( -1 ) );
+    for ( int n = 0 ; n < inputs ; n++ )
+        mix_add_q15( buf, mix_sources[n], frames, 2, mix_gain_q15( -20 ) );
+}
+
+// Keyed 600 Hz CW at 20 WPM, elements and gaps of one or three 60 ms dits
+// give or take 2.5 ms as a hand would send them, with 5 ms raised cosine
+// edges timed from their middle, over white noise at a range of signal to noise ratios across the
+// whole band. A bank at 200 Hz spacing, 400 to 1000 Hz, is run over it: the
+// 600 Hz detector's edges are matched to the keying, the others should
+// stay off
+
+#define CW_DIT			( SAMPLE_RATE * 60 / 1000 )
+#define CW_SECONDS		10
+#define CW_RAMP			( SAMPLE_RATE * 5 / 1000 )
+
+static double gauss( void )
+{
+    double u = ( rand() + 1.0 ) / ( RAND_MAX + 2.0 ), v = ( rand() + 1.0 ) / ( RAND_MAX + 2.0 );
+    return sqrt( -2 * log( u ) ) * cos( 2 * M_PI * v );
+}
+
+static void goertzel_report( void )
+{
+    static goertzel_t g;
+    static int16_t x[CW_SECONDS * SAMPLE_RATE];
+    static long edges[CW_SECONDS * SAMPLE_RATE / CW_DIT];
+    static const int snr[] = { 20, 10, 0, -5, -10 };
+    const int frames = CW_SECONDS * SAMPLE_RATE;
+    const double amplitude = 4000;
+
+    goertzel_params_t params = DEFAULT_GOERTZEL_PARAMS();
+    params.tones = 4;
+    for ( int t = 0 ; t < 4 ; t++ )
+        params.hz[t] = 400 + 200 * t;
+
+    printf( "\ngoertzel: %d ms frames, on %d dB off %d dB of the frame, keyed 600 Hz at 20 wpm, %d s\n",
+            params.frame_ms, params.on_db, params.off_db, CW_SECONDS );
+
+    for ( int k = 0 ; k < sizeof(snr) / sizeof(snr[0]) ; k++ ) {
+
+        srand( 1 );
+        int n_edges = 0;
+        long next = CW_DIT;
+        bool key = false;
+        double envelope = 0, sigma = amplitude / sqrt( 2 ) / pow( 10, snr[k] / 20.0 );
+
+        for ( long i = 0 ; i < frames ; i++ ) {
+            if ( i == next ) {
+                key = !key;
+                edges[n_edges++] = i + CW_RAMP / 2;
+                next += CW_DIT * ( rand() % 2 ? 3 : 1 ) + rand() % 81 - 40;
+            }
+            long since = i - ( n_edges ? edges[n_edges - 1] - CW_RAMP / 2 : 0 );
+            if ( n_edges && since < CW_RAMP ) {
+                double ramp = 0.5 - 0.5 * cos( M_PI * since / CW_RAMP );
+                envelope = key ? ramp : 1 - ramp;
+            }
+            double s = sigma * gauss() + envelope * amplitude * sin( 2 * M_PI * 600 * i / SAMPLE_RATE );
+            x[i] = s > 32767 ? 32767 : ( s < -32768 ? -32768 : lrint( s ) );
+        }
+        if ( key )
+            edges[n_edges++] = frames;
+
+        goertzel_init( &g, SAMPLE_RATE, &params );
+        goertzel_event_t events[64];
+        int ons[4] = { 0 }, matched = 0;
+        double error = 0, worst = 0;
+
+        for ( int i = 0 ; i < frames ; i += BLOCK_FRAMES ) {
+            int n = goertzel_process( &g, x + i, i + BLOCK_FRAMES > frames ? frames - i : BLOCK_FRAMES, events, 64 );
+            for ( int e = 0 ; e < n ; e++ ) {
+                ons[events[e].tone] += events[e].on;
+                if ( events[e].tone != 1 )
+                    continue;
+
+                // Nearest keying edge the same way
+                long best = frames;
+                for ( int j = events[e].on ? 0 : 1 ; j < n_edges ; j += 2 )
+                    if ( labs( edges[j] - (long) events[e].sample ) < labs( best ) )
+                        best = edges[j] - (long) events[e].sample;
+                double ms = labs( best ) * 1000.0 / SAMPLE_RATE;
+                if ( ms <= params.frame_ms ) {
+                    matched++;
+                    error += ms;
+                    worst = ms > worst ? ms : worst;
+                }
+            }
+        }
+
+        printf( "  snr %3d dB: %d elements, %d on, %d of %d edges within a frame, error %.1f ms mean %.1f ms max,"
+                " on at 400/800/1000 Hz %d/%d/%d\n", snr[k], n_edges / 2, ons[1], matched, n_edges,
+                matched ? error / matched : 0, worst, ons[0], ons[2], ons[3] );
+    }
+}
+
+static const bench_t benches[] = {
+    { "voice_proc (hpf+agc+gate, stereo)",	2, voice_proc_setup,	voice_proc_run },
+    { "vad",								1, vad_setup,			vad_run },
+    { "spectrum (512 point real fft)",		1, spectrum_setup,		spectrum_run },
+    { "spectrum every 10 ms",				1, spectrum_setup,		spectrum_frames_run },
+    { "goertzel 1 tone (10 ms frames)",		1, goertzel1_setup,		goertzel_run },
+    { "goertzel 4 tones (10 ms frames)",	1, goertzel4_setup,		goertzel_run },
+    { "goertzel 8 tones (10 ms frames)",	1, goertzel8_setup,		goertzel_run },
+    { "denoise (256 point stft, stereo)",	2, denoise_setup,		denoise_run },
+    { "notch (2 adaptive sections)",		1, notch_setup,			notch_run },
+    { "iq usb (dc+balance+shift+hilbert)",	2, iq_usb_setup,		iq_run },
+    { "iq lsb (dc+balance+shift+hilbert)",	2, iq_lsb_setup,		iq_run },
+    { "iq am (dc+balance+shift+envelope)",	2, iq_am_setup,			iq_run },
+    { "narrowband voice (3 kHz, 16k->8k)",	1, narrowband_voice_setup,	narrowband_run },
+    { "narrowband narrow (1.5 kHz, ->4k)",	1, narrowband_narrow_setup,	narrowband_run },
+    { "narrowband cw (500 Hz, ->2k)",		1, narrowband_cw_setup,	narrowband_run },
+    { "resampler (-80 ppm)",				1, resampler_setup,		resampler_run },
+    { "stretch (wsola catch-up at 110%)",	1, stretch_setup,		stretch_run },
+    { "mix 1 input (stereo)",				2, mix1_setup,			mix_run },
+    { "mix 2 inputs (stereo)",				2, mix2_setup,			mix_run },
+    { "mix 4 inputs (stereo)",				2, mix4_setup,			mix_run },
+};
+
+// A trace's audio as 16 bit stereo frames, the top half of 32 bit samples
+// as the I2S reader's 32 bit slots hold the microphone's bits there
+
+static int16_t* trace_audio;
+static long trace_frames;
+
+static int load_trace( const char* path )
+{
+    i2s_trace_reader_t reader;
+    if ( i2s_trace_open( &reader, path ) != 0 ) {
+        fprintf( stderr, "%s is not a readable trace\n", path );
+        return -1;
+    }
+
+    const i2s_trace_header_t* h = &reader.header;
+    if ( h->sample_rate != SAMPLE_RATE ) {
+        fprintf( stderr, "%s is %u Hz, the stages are set up for %d\n", path, h->sample_rate, SAMPLE_RATE );
+        i2s_trace_close( &reader );
+        return -1;
+    }
+
+    int sample_bytes = h->bits / 8, frame_bytes = sample_bytes * h->channels;
+    long size = 0;
+    char block[UINT16_MAX];
+    i2s_trace_record_t rec;
+    int r;
+
+    while ( ( r = i2s_trace_next( &reader, &rec ) ) == 1 ) {
+        int n = i2s_trace_read( &reader, block, rec.len ) / frame_bytes;
+        if ( trace_frames + n > size ) {
+            size = ( trace_frames + n ) * 2;
+            trace_audio = realloc( trace_audio, size * 2 * sizeof(int16_t) );
+        }
+        for ( int i = 0 ; i < n ; i++, trace_frames++ ) {
+            for ( int c = 0 ; c < 2 ; c++ ) {
+                const char* p = block + i * frame_bytes + ( c % h->channels ) * sample_bytes;
+                int16_t v;
+                if ( h->bits == 32 ) {
+                    int32_t w;
+                    memcpy( &w, p, 4 );
+                    v = w >> 16;
+                } else {
+                    memcpy( &v, p, 2 );
+                }
+                trace_audio[trace_frames * 2 + c] = v;
+            }
+        }
+    }
+    i2s_trace_close( &reader );
+
+    if ( r < 0 || trace_frames == 0 ) {
+        fprintf( stderr, "%s is %s\n", path, r < 0 ? "corrupt" : "empty" );
+        return -1;
+    }
+
+    printf( "input from %s: %.1f s of %u bit %u channel%s\n", path, (double) trace_frames / SAMPLE_RATE,
+            h->bits, h->channels, trace_frames < (long) BLOCKS * BLOCK_FRAMES ? ", looped" : "" );
+    return 0;
+}
+
+// Bursts of a few harmonics over noise and a DC offset, roughly what the
+// microphone delivers: one second on, one second off. Or the trace, its
+// left channel for the mono stages
+
+static void fill( int16_t* buf, int frames, int channels, long* t )
+{
+    if ( trace_frames ) {
+        for ( int i = 0 ; i < frames ; i++, (*t)++ )
+            for ( int c = 0 ; c < channels ; c++ )
+                buf[i * channels + c] = trace_audio[( *t % trace_frames ) * 2 + c];
+        return;
+    }
+
+    for ( int i = 0 ; i < frames ; i++, (*t)++ ) {
+        double s = 400 + ( rand() % 200 - 100 );
+        if ( ( *t / SAMPLE_RATE ) % 2 == 0 )
+            s += 6000 * sin( 2 * M_PI * 220 * *t / SAMPLE_RATE ) + 2000 * sin( 2 * M_PI * 660 * *t / SAMPLE_RATE );
+        for ( int c = 0 ; c < channels ; c++ )
+            buf[i * channels + c] = s;
+    }
+}
+
+static double now( void )
+{
+    struct timespec ts;
+    clock_gettime( CLOCK_MONOTONIC, &ts );
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+int main( int argc, char** argv )
+{
+    const char* only = NULL;
+
+    for ( int i = 1 ; i < argc ; i++ ) {
+        if ( strcmp( argv[i], "--trace" ) == 0 && i + 1 < argc ) {
+            if ( load_trace( argv[++i] ) != 0 )
+                return 1;
+        } else if ( !only && argv[i][0] != '-' ) {
+            only = argv[i];
+        } else {
+            fprintf( stderr, "usage: %s [--trace FILE] [FILTER]\n", argv[0] );
+            return 1;
+        }
+    }
+
+    int16_t* input = malloc( BLOCKS * BLOCK_FRAMES * 2 * sizeof(int16_t) );
+    int16_t buf[BLOCK_FRAMES * 2];
+
+    printf( "%-40s %14s %12s %12s\n", "stage", "cycles/block", "cycles/smp", "ns/smp" );
+
+    for ( int b = 0 ; b < sizeof(benches) / sizeof(benches[0]) ; b++ ) {
+
+        const bench_t* bench = &benches[b];
+        if ( only && !strstr( bench->name, only ) )
+            continue;
+
+        long t = 0;
+        srand( 1 );
+        for ( int i = 0 ; i < BLOCKS ; i++ )
+            fill( input + i * BLOCK_FRAMES * bench->channels, BLOCK_FRAMES, bench->channels, &t );
+
+        void* ctx = bench->setup();
+        uint64_t cycles = 0;
+        double start = now();
+
+        for ( int i = 0 ; i < BLOCKS ; i++ ) {
+            memcpy( buf, input + i * BLOCK_FRAMES * bench->channels, BLOCK_FRAMES * bench->channels * sizeof(int16_t) );
+            uint32_t c = cycle_count_get();
+            bench->run( ctx, buf, BLOCK_FRAMES );
+            cycles += cycle_count_get() - c;
+        }
+
+        double elapsed = now() - start;
+        double samples = (double) BLOCKS * BLOCK_FRAMES;
+
+        printf( "%-40s %14.0f %12.1f %12.2f\n", bench->name,
+                (double) cycles / BLOCKS, cycles / samples, elapsed * 1e9 / samples );
+    }
+
+    if ( !only || strstr( "denoise", only ) )
+        denoise_report();
+    if ( !only || strstr( "spectrum", only ) )
+        spectrum_report();
+    if ( !only || strstr( "notch", only ) )
+        notch_report();
+    if ( !only || strstr( "drift", only ) )
+        drift_report();
+    if ( !only || strstr( "iq", only ) )
+        iq_report();
+    if ( !only || strstr( "narrowband", only ) )
+        narrowband_report();
+    if ( !only || strstr( "goertzel", only ) )
+        goertzel_report();
+
+    free( input );
+    free( trace_audio );
+    return 0;
+}
@@ -0,0 +1,447 @@
+/*
+ * loadgen.cpp
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: xenir
+ */
+
+// Opens a number of concurrent /stream connections against the board or
+// host/build/sim and checks what each one gets: time to first byte, the WAV
+// header, the rate sustained against the header's byterate, and gaps
+// between arrivals. Some clients can be made slow readers or made to drop
+// the connection abruptly (RST) part way through, to see how the server
+// copes with the others still connected.
+//
+//   host/build/loadgen --host 192.168.1.50 --clients 4 --stagger 2000 --seconds 30
+//
+// The exit status is 1 if any normal client failed to connect, got no WAV
+// header, or ran below --min-ratio of the advertised byterate, so the tool
+// can gate a regression run against the simulator.
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <csignal>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <netdb.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+
+using Clock = std::chrono::steady_clock;
+
+namespace {
+
+enum class Kind { normal, slow, drop };
+
+struct Options {
+    std::string     host = "127.0.0.1";
+    std::string     port = "8080";
+    std::string     path = "/stream";
+    int             clients = 1;
+    int             stagger_ms = 0;         // Between successive joins
+    int             seconds = 10;           // Each client's listening time
+    int             slow = 0;               // How many of the clients read slowly
+    double          slow_factor = 0.5;      // Fraction of the byterate a slow client reads at
+    int             drop = 0;               // How many disconnect abruptly
+    int             stall_ms = 250;         // A gap longer than this counts as a stall
+    int             timeout_ms = 5000;      // Connect and first byte
+    double          min_ratio = 0.95;
+};
+
+struct Result {
+    Kind            kind = Kind::normal;
+    int             join_ms = 0;
+    int             status = 0;             // HTTP status, 0 if none was received
+    double          ttfb_ms = -1;
+    bool            wav = false;
+    uint32_t        byterate = 0;
+    uint32_t        sample_rate = 0;
+    uint16_t        channels = 0;
+    uint16_t        bits = 0;
+    uint64_t        bytes = 0;              // Audio bytes after the WAV header
+    double          seconds = 0;            // From the WAV header to the end
+    double          max_gap_ms = 0;
+    int             stalls = 0;
+    std::string     end = "running";
+
+    double ratio() const {
+        return byterate && seconds > 0 ? bytes / seconds / byterate : 0;
+    }
+};
+
+const char* kind_name(Kind kind)
+{
+    switch (kind) {
+    case Kind::slow:    return "slow";
+    case Kind::drop:    return "drop";
+    default:            return "normal";
+    }
+}
+
+std::atomic<bool> quit(false);
+
+void on_signal(int)
+{
+    quit = true;
+}
+
+double ms_since(Clock::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+uint32_t le32(const uint8_t* p) { return p[0] | p[1] << 8 | p[2] << 16 | (uint32_t) p[3] << 24; }
+uint16_t le16(const uint8_t* p) { return p[0] | p[1] << 8; }
+
+int connect_to(const Options& opt)
+{
+    addrinfo hints = {}, *res = nullptr;
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+
+    if (getaddrinfo(opt.host.c_str(), opt.port.c_str(), &hints, &res) != 0)
+        return -1;
+
+    int fd = -1;
+    for (addrinfo* ai = res; ai && fd < 0; ai = ai->ai_next) {
+        fd = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+        if (fd >= 0 && connect(fd, ai->ai_addr, ai->ai_addrlen) != 0) {
+            close(fd);
+            fd = -1;
+        }
+    }
+
+    freeaddrinfo(res);
+    return fd;
+}
+
+// Undoes chunked transfer encoding, which older firmware used for /stream.
+// Bytes go in as they arrive, the payload comes out
+
+class Dechunker {
+public:
+    bool done() const { return state_ == State::done; }
+    bool failed() const { return state_ == State::error; }
+
+    void feed(const char* data, size_t len, std::string& out)
+    {
+        for (size_t i = 0; i < len && state_ != State::done && state_ != State::error; ) {
+
+            char c = data[i];
+
+            switch (state_) {
+            case State::size:
+                i++;
+                if (c == '\n') {
+                    char* end;
+                    remaining_ = strtoul(line_.c_str(), &end, 16);
+                    if (end == line_.c_str())
+                        state_ = State::error;
+                    else
+                        state_ = remaining_ ? State::data : State::trailer;
+                    line_.clear();
+                } else if (c != '\r') {
+                    line_ += c;
+                }
+                break;
+
+            case State::data: {
+                size_t n = std::min(remaining_, len - i);
+                out.append(data + i, n);
+                i += n;
+                remaining_ -= n;
+                if (!remaining_)
+                    state_ = State::data_end;
+                break;
+            }
+
+            case State::data_end:
+                i++;
+                if (c == '\n')
+                    state_ = State::size;
+                break;
+
+            case State::trailer:
+                i++;
+                if (c == '\n')
+                    state_ = State::done;
+                break;
+
+            default:
+                return;
+            }
+        }
+    }
+
+private:
+    enum class State { size, data, data_end, trailer, done, error };
+
+    State           state_ = State::size;
+    std::string     line_;
+    size_t          remaining_ = 0;
+};
+
+void run_client(const Options& opt, Result& r)
+{
+    auto start = Clock::now();
+
+    int fd = connect_to(opt);
+    if (fd < 0) {
+        r.end = "connect failed";
+        return;
+    }
+
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+    // A slow reader also needs a small receive window, or the kernel
+    // buffers hide it from the server
+    if (r.kind == Kind::slow) {
+        int rcvbuf = 4096;
+        setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+    }
+
+    std::string req = "GET " + opt.path + " HTTP/1.1\r\nHost: " + opt.host + "\r\nConnection: close\r\n\r\n";
+    if (send(fd, req.data(), req.size(), MSG_NOSIGNAL) != (ssize_t) req.size()) {
+        close(fd);
+        r.end = "send failed";
+        return;
+    }
+
+    // Drop clients leave somewhere in the middle of their listening time
+    double drop_at_ms = r.kind == Kind::drop ? opt.seconds * 1000.0 * (0.25 + 0.5 * rand() / RAND_MAX) : -1;
+
+    std::string head, body;
+    bool in_body = false, chunked = false;
+    Dechunker dechunk;
+    Clock::time_point header_time, last_data;
+    char buf[8192];
+
+    for (;;) {
+
+        if (quit) {
+            r.end = "interrupted";
+            break;
+        }
+
+        double elapsed = in_body ? ms_since(header_time) : ms_since(start);
+
+        if (!in_body && r.ttfb_ms < 0 && elapsed > opt.timeout_ms) {
+            r.end = "no response";
+            break;
+        }
+        if (r.wav && elapsed >= opt.seconds * 1000.0) {
+            r.end = "completed";
+            break;
+        }
+        if (r.wav && drop_at_ms >= 0 && elapsed >= drop_at_ms) {
+            linger lg = { 1, 0 };
+            setsockopt(fd, SOL_SOCKET, SO_LINGER, &lg, sizeof(lg));
+            r.end = "dropped";
+            break;
+        }
+
+        pollfd pfd = { fd, POLLIN, 0 };
+        if (poll(&pfd, 1, 50) <= 0)
+            continue;
+
+        // A slow reader takes at most what its share of the byterate allows
+        size_t want = sizeof(buf);
+        if (r.kind == Kind::slow && r.wav) {
+            double allowed = r.byterate * opt.slow_factor * ms_since(header_time) / 1000.0 - r.bytes;
+            if (allowed < 1) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(10));
+                continue;
+            }
+            want = std::min(want, (size_t) allowed);
+        }
+
+        ssize_t n = recv(fd, buf, want, 0);
+        if (n <= 0) {
+            r.end = n == 0 ? "closed by server" : "reset";
+            break;
+        }
+
+        auto now = Clock::now();
+        if (r.ttfb_ms < 0)
+            r.ttfb_ms = ms_since(start);
+
+        const char* data = buf;
+        size_t len = n;
+
+        if (!in_body) {
+            head.append(buf, n);
+            size_t end = head.find("\r\n\r\n");
+            if (end == std::string::npos)
+                continue;
+
+            r.status = atoi(head.c_str() + head.find(' ') + 1);
+            std::string lower = head.substr(0, end);
+            std::transform(lower.begin(), lower.end(), lower.begin(), ::tolower);
+            chunked = lower.find("transfer-encoding: chunked") != std::string::npos;
+
+            std::string rest = head.substr(end + 4);
+            in_body = true;
+            head.clear();
+
+            if (r.status != 200) {
+                r.end = "http error";
+                break;
+            }
+
+            header_time = last_data = now;
+            if (rest.empty())
+                continue;
+            std::copy(rest.begin(), rest.end(), buf);
+            len = rest.size();
+        }
+
+        size_t before = body.size();
+        if (chunked)
+            dechunk.feed(data, len, body);
+        else
+            body.append(data, len);
+
+        if (body.size() > before) {
+            double gap = std::chrono::duration<double, std::milli>(now - last_data).count();
+            if (r.wav) {
+                r.max_gap_ms = std::max(r.max_gap_ms, gap);
+                if (gap > opt.stall_ms)
+                    r.stalls++;
+            }
+            last_data = now;
+        }
+
+        if (!r.wav && body.size() >= 44) {
+            auto* h = reinterpret_cast<const uint8_t*>(body.data());
+            if (memcmp(h, "RIFF", 4) != 0 || memcmp(h + 8, "WAVE", 4) != 0 || memcmp(h + 12, "fmt ", 4) != 0) {
+                r.end = "bad wav header";
+                break;
+            }
+            r.wav = true;
+            r.channels = le16(h + 22);
+            r.sample_rate = le32(h + 24);
+            r.byterate = le32(h + 28);
+            r.bits = le16(h + 34);
+            header_time = now;
+            body.erase(0, 44);
+        }
+
+        if (r.wav) {
+            r.bytes += body.size();
+            body.clear();
+        }
+
+        if (dechunk.failed()) {
+            r.end = "bad chunking";
+            break;
+        }
+        if (dechunk.done()) {
+            r.end = "ended by server";
+            break;
+        }
+    }
+
+    if (r.wav)
+        r.seconds = ms_since(header_time) / 1000.0;
+
+    close(fd);
+}
+
+void usage(const char* name)
+{
+    fprintf(stderr,
+        "usage: %s [--host H] [--port P] [--path /stream] [--clients N] [--stagger MS]\n"
+        "          [--seconds S] [--slow N] [--slow-factor F] [--drop N] [--stall-ms MS]\n"
+        "          [--timeout-ms MS] [--min-ratio R]\n", name);
+    exit(2);
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    Options opt;
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        const char* val = i + 1 < argc ? argv[i + 1] : nullptr;
+        if (!val)
+            usage(argv[0]);
+        i++;
+
+        if (arg == "--host")                opt.host = val;
+        else if (arg == "--port")           opt.port = val;
+        else if (arg == "--path")           opt.path = val;
+        else if (arg == "--clients")        opt.clients = atoi(val);
+        else if (arg == "--stagger")        opt.stagger_ms = atoi(val);
+        else if (arg == "--seconds")        opt.seconds = atoi(val);
+        else if (arg == "--slow")           opt.slow = atoi(val);
+        else if (arg == "--slow-factor")    opt.slow_factor = atof(val);
+        else if (arg == "--drop")           opt.drop = atoi(val);
+        else if (arg == "--stall-ms")       opt.stall_ms = atoi(val);
+        else if (arg == "--timeout-ms")     opt.timeout_ms = atoi(val);
+        else if (arg == "--min-ratio")      opt.min_ratio = atof(val);
+        else                                usage(argv[0]);
+    }
+
+    if (opt.clients < 1 || opt.slow + opt.drop > opt.clients || opt.seconds < 1)
+        usage(argv[0]);
+
+    // The special clients join last, so the first ones measure the server
+    // before anything misbehaves
+    std::vector<Result> results(opt.clients);
+    for (int i = 0; i < opt.clients; i++) {
+        int from_end = opt.clients - 1 - i;
+        results[i].kind = from_end < opt.drop ? Kind::drop : from_end < opt.drop + opt.slow ? Kind::slow : Kind::normal;
+        results[i].join_ms = i * opt.stagger_ms;
+    }
+
+    signal(SIGINT, on_signal);
+    signal(SIGTERM, on_signal);
+
+    std::vector<std::thread> threads;
+    auto start = Clock::now();
+
+    for (int i = 0; i < opt.clients && !quit; i++) {
+        std::this_thread::sleep_until(start + std::chrono::milliseconds(results[i].join_ms));
+        threads.emplace_back(run_client, std::cref(opt), std::ref(results[i]));
+    }
+
+    for (auto& t : threads)
+        t.join();
+
+    printf("  #  kind    join ms  status  ttfb ms  format        byterate  rate  max gap ms  stalls  end\n");
+
+    int failed = 0, served = 0;
+    for (int i = 0; i < opt.clients; i++) {
+        const Result& r = results[i];
+        char format[32] = "-";
+        if (r.wav)
+            snprintf(format, sizeof(format), "%u/%u/%u", r.sample_rate, r.bits, r.channels);
+
+        printf("%3d  %-6s  %7d  %6d  %7.0f  %-12s  %8u  %4.2f  %10.0f  %6d  %s\n",
+               i, kind_name(r.kind), r.join_ms, r.status, r.ttfb_ms, format, r.byterate,
+               r.ratio(), r.max_gap_ms, r.stalls, r.end.c_str());
+
+        if (r.wav)
+            served++;
+        if (r.kind == Kind::normal && (!r.wav || r.ratio() < opt.min_ratio))
+            failed++;
+    }
+
+    printf("%d of %d clients got audio, %d normal clients below %.2f of the byterate or not served\n",
+           served, opt.clients, failed, opt.min_ratio);
+
+    return failed ? 1 : 0;
+}
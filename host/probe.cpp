@@ -0,0 +1,469 @@
+/*
+ * probe.cpp
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: xenir
+ */
+
+// Measures the capture to listener latency of /stream with the probe
+// markers from main/probe.c. While it listens to the stream it asks the
+// board (or host/build/sim) for a marker every --interval ms with
+// /command?cmd=probe&fire=1, finds each marker in the received audio by
+// normalised cross-correlation with the same chirp, and takes the latency
+// as the time the chunk holding the marker's first sample arrived less the
+// middle of the command's round trip. Half the round trip is the
+// uncertainty and is reported with the results.
+//
+//   host/build/probe --host 192.168.1.50 --port 80 --seconds 60
+//
+// With --listen no markers are asked for; the board's own periodic markers
+// (cmd=probe&period=<ms>) are found instead and only their spacing and the
+// drift are reported.
+//
+// Markers are added by the mixer, so the I2S DMA buffers and the voice DSP
+// before it are not in the figure, nor is the player's own buffering after
+// the socket. Drift is reported two ways: the latency trend over the run,
+// and the rate of the stream's sample clock against this host's clock from
+// where the markers sit in the stream.
+//
+// The exit status is 1 if no marker was found.
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <csignal>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <netdb.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+
+#include "probe.h"
+
+using Clock = std::chrono::steady_clock;
+
+namespace {
+
+struct Options {
+    std::string     host = "127.0.0.1";
+    std::string     port = "8080";
+    std::string     path = "/stream";
+    int             seconds = 30;
+    int             interval_ms = 2000;     // Between markers asked for
+    int             timeout_ms = 3000;      // A marker not found by then is missed
+    double          threshold = 0.5;        // Normalised correlation that counts as a marker
+    bool            listen = false;
+};
+
+struct Trigger {
+    double          sent_ms;                // Since the start of the run
+    double          reply_ms;
+    bool            matched = false;
+};
+
+struct Marker {
+    double          arrival_ms;             // When the chunk holding its first sample arrived
+    uint64_t        position;               // First sample in the stream
+    double          corr;
+    bool            matched = false;        // To a marker asked for, never with --listen
+    double          latency_ms = 0;
+    double          rtt_ms = 0;
+};
+
+std::atomic<bool> quit(false);
+
+void on_signal(int)
+{
+    quit = true;
+}
+
+double ms_between(Clock::time_point from, Clock::time_point to)
+{
+    return std::chrono::duration<double, std::milli>(to - from).count();
+}
+
+uint32_t le32(const uint8_t* p) { return p[0] | p[1] << 8 | p[2] << 16 | (uint32_t) p[3] << 24; }
+uint16_t le16(const uint8_t* p) { return p[0] | p[1] << 8; }
+
+int connect_to(const Options& opt)
+{
+    addrinfo hints = {}, *res = nullptr;
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+
+    if (getaddrinfo(opt.host.c_str(), opt.port.c_str(), &hints, &res) != 0)
+        return -1;
+
+    int fd = -1;
+    for (addrinfo* ai = res; ai && fd < 0; ai = ai->ai_next) {
+        fd = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+        if (fd >= 0 && connect(fd, ai->ai_addr, ai->ai_addrlen) != 0) {
+            close(fd);
+            fd = -1;
+        }
+    }
+
+    freeaddrinfo(res);
+    return fd;
+}
+
+// One GET on a connection of its own, true if the reply was a 200
+
+bool fire(const Options& opt)
+{
+    int fd = connect_to(opt);
+    if (fd < 0)
+        return false;
+
+    std::string req = "GET /command?cmd=probe&fire=1 HTTP/1.1\r\nHost: " + opt.host + "\r\nConnection: close\r\n\r\n";
+    std::string reply;
+    char buf[512];
+
+    if (send(fd, req.data(), req.size(), MSG_NOSIGNAL) == (ssize_t) req.size()) {
+        ssize_t n;
+        while ((n = recv(fd, buf, sizeof(buf), 0)) > 0)
+            reply.append(buf, n);
+    }
+
+    close(fd);
+    return reply.compare(0, 12, "HTTP/1.1 200") == 0;
+}
+
+// Streaming normalised cross-correlation against the chirp. A marker is
+// the highest peak above the threshold, reported once a chirp length has
+// passed without a higher one
+
+class Detector {
+public:
+    Detector(int sample_rate, double threshold)
+        : threshold_(threshold)
+    {
+        chirp_.resize(probe_samples(sample_rate));
+        probe_chirp(sample_rate, chirp_.data());
+        for (float c : chirp_)
+            chirp_energy_ += c * c;
+    }
+
+    // Returns true with the marker's first sample and correlation when one
+    // is complete
+    bool feed(float x, uint64_t& position, double& corr)
+    {
+        size_t len = chirp_.size();
+
+        window_.push_back(x);
+        energy_ += x * x;
+        if (window_.size() > len) {
+            energy_ -= window_.front() * window_.front();
+            window_.pop_front();
+        }
+        n_++;
+
+        bool found = false;
+        if (best_ > 0 && n_ - best_end_ > len) {
+            position = best_end_ - len;
+            corr = best_;
+            best_ = 0;
+            found = true;
+        }
+
+        if (window_.size() == len && energy_ > 1e-9) {
+            double dot = 0;
+            for (size_t k = 0; k < len; k++)
+                dot += window_[k] * chirp_[k];
+            double ncc = dot / std::sqrt(energy_ * chirp_energy_);
+            if (ncc > threshold_ && ncc > best_) {
+                best_ = ncc;
+                best_end_ = n_;
+            }
+        }
+
+        return found;
+    }
+
+private:
+    std::vector<float>  chirp_;
+    double              chirp_energy_ = 0;
+    double              threshold_;
+    std::deque<float>   window_;
+    double              energy_ = 0;
+    uint64_t            n_ = 0;             // Samples fed
+    double              best_ = 0;
+    uint64_t            best_end_ = 0;      // Samples fed when the best peak was seen
+};
+
+double percentile(std::vector<double> v, double p)
+{
+    if (v.empty())
+        return 0;
+    std::sort(v.begin(), v.end());
+    return v[std::min(v.size() - 1, (size_t) (p * (v.size() - 1) + 0.5))];
+}
+
+// Least squares slope of y against x
+
+double slope(const std::vector<double>& x, const std::vector<double>& y)
+{
+    size_t n = x.size();
+    if (n < 2)
+        return 0;
+
+    double mx = 0, my = 0;
+    for (size_t i = 0; i < n; i++) {
+        mx += x[i];
+        my += y[i];
+    }
+    mx /= n;
+    my /= n;
+
+    double sxy = 0, sxx = 0;
+    for (size_t i = 0; i < n; i++) {
+        sxy += (x[i] - mx) * (y[i] - my);
+        sxx += (x[i] - mx) * (x[i] - mx);
+    }
+    return sxx > 0 ? sxy / sxx : 0;
+}
+
+void usage(const char* name)
+{
+    fprintf(stderr,
+        "usage: %s [--host H] [--port P] [--path /stream] [--seconds S] [--interval MS]\n"
+        "          [--timeout-ms MS] [--threshold T] [--listen]\n", name);
+    exit(2);
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    Options opt;
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--listen") {
+            opt.listen = true;
+            continue;
+        }
+
+        const char* val = i + 1 < argc ? argv[i + 1] : nullptr;
+        if (!val)
+            usage(argv[0]);
+        i++;
+
+        if (arg == "--host")                opt.host = val;
+        else if (arg == "--port")           opt.port = val;
+        else if (arg == "--path")           opt.path = val;
+        else if (arg == "--seconds")        opt.seconds = atoi(val);
+        else if (arg == "--interval")       opt.interval_ms = atoi(val);
+        else if (arg == "--timeout-ms")     opt.timeout_ms = atoi(val);
+        else if (arg == "--threshold")      opt.threshold = atof(val);
+        else                                usage(argv[0]);
+    }
+
+    if (opt.seconds < 1 || opt.interval_ms < PROBE_MS * 4 || opt.threshold <= 0 || opt.threshold >= 1)
+        usage(argv[0]);
+
+    signal(SIGINT, on_signal);
+    signal(SIGTERM, on_signal);
+
+    int fd = connect_to(opt);
+    if (fd < 0) {
+        fprintf(stderr, "Cannot connect to %s:%s\n", opt.host.c_str(), opt.port.c_str());
+        return 1;
+    }
+
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+    std::string req = "GET " + opt.path + " HTTP/1.1\r\nHost: " + opt.host + "\r\nConnection: close\r\n\r\n";
+    send(fd, req.data(), req.size(), MSG_NOSIGNAL);
+
+    auto start = Clock::now();
+    std::string head;
+    std::vector<uint8_t> body;
+    bool in_body = false, wav = false;
+    uint32_t sample_rate = 0;
+    uint16_t channels = 0, bits = 0;
+    uint64_t samples = 0;
+    std::unique_ptr<Detector> detector;
+
+    std::mutex lock;
+    std::vector<Trigger> triggers;
+    std::vector<Marker> markers;
+    std::thread firer;
+    const char* end = "completed";
+    char buf[8192];
+
+    while (!quit && ms_between(start, Clock::now()) < opt.seconds * 1000.0) {
+
+        pollfd pfd = { fd, POLLIN, 0 };
+        if (poll(&pfd, 1, 50) <= 0)
+            continue;
+
+        ssize_t n = recv(fd, buf, sizeof(buf), 0);
+        if (n <= 0) {
+            end = n == 0 ? "closed by server" : "reset";
+            break;
+        }
+        double now_ms = ms_between(start, Clock::now());
+
+        const char* data = buf;
+        size_t len = n;
+
+        if (!in_body) {
+            head.append(buf, n);
+            size_t hend = head.find("\r\n\r\n");
+            if (hend == std::string::npos)
+                continue;
+
+            std::string lower = head.substr(0, hend);
+            std::transform(lower.begin(), lower.end(), lower.begin(), ::tolower);
+            if (atoi(head.c_str() + head.find(' ') + 1) != 200 ||
+                lower.find("transfer-encoding: chunked") != std::string::npos) {
+                end = "not a plain 200 response";
+                break;
+            }
+
+            in_body = true;
+            body.assign(head.begin() + hend + 4, head.end());
+            len = 0;
+        }
+
+        body.insert(body.end(), data, data + len);
+
+        if (!wav) {
+            if (body.size() < 44)
+                continue;
+            const uint8_t* h = body.data();
+            if (memcmp(h, "RIFF", 4) != 0 || memcmp(h + 8, "WAVE", 4) != 0 || le16(h + 34) != 16) {
+                end = "not 16 bit WAV";
+                break;
+            }
+            wav = true;
+            channels = le16(h + 22);
+            sample_rate = le32(h + 24);
+            bits = le16(h + 34);
+            body.erase(body.begin(), body.begin() + 44);
+            detector.reset(new Detector(sample_rate, opt.threshold));
+
+            printf("Stream %u Hz, %u bit, %u channel%s, chirp %d-%d Hz over %d ms\n",
+                   sample_rate, bits, channels, channels > 1 ? "s" : "", PROBE_F0_HZ, PROBE_F1_HZ, PROBE_MS);
+            printf("  #    at s  latency ms  +/- ms   corr  stream s\n");
+
+            // Markers are asked for from a thread of their own so a slow
+            // command never holds up reading the stream
+            if (!opt.listen) {
+                firer = std::thread([&]() {
+                    while (!quit && ms_between(start, Clock::now()) < opt.seconds * 1000.0 - opt.timeout_ms) {
+                        Trigger t;
+                        t.sent_ms = ms_between(start, Clock::now());
+                        bool ok = fire(opt);
+                        t.reply_ms = ms_between(start, Clock::now());
+                        if (ok) {
+                            std::lock_guard<std::mutex> guard(lock);
+                            triggers.push_back(t);
+                        }
+                        std::this_thread::sleep_for(std::chrono::milliseconds(opt.interval_ms));
+                    }
+                });
+            }
+        }
+
+        // First channel only, every sample of this chunk arrived now
+
+        size_t frame = 2 * channels;
+        size_t whole = body.size() - body.size() % frame;
+
+        for (size_t i = 0; i < whole; i += frame, samples++) {
+            float x = (int16_t) le16(&body[i]) / 32768.0f;
+            uint64_t position;
+            double corr;
+            if (!detector->feed(x, position, corr))
+                continue;
+
+            // The marker started (samples - position) samples ago in stream
+            // time; its first sample came in with an earlier chunk if the
+            // chirp spanned chunks, which the arrival time of this chunk
+            // would overstate by at most one chunk
+            Marker m;
+            m.arrival_ms = now_ms;
+            m.position = position;
+            m.corr = corr;
+
+            std::lock_guard<std::mutex> guard(lock);
+            for (Trigger& t : triggers) {
+                if (!t.matched && t.sent_ms < now_ms && now_ms - t.sent_ms < opt.timeout_ms) {
+                    t.matched = true;
+                    m.matched = true;
+                    m.latency_ms = now_ms - (samples - position) * 1000.0 / sample_rate - (t.sent_ms + t.reply_ms) / 2;
+                    m.rtt_ms = t.reply_ms - t.sent_ms;
+                    break;
+                }
+            }
+
+            if (opt.listen || m.matched) {
+                markers.push_back(m);
+                printf("%3zu  %6.1f  %10.1f  %6.1f  %5.2f  %8.2f\n", markers.size(), now_ms / 1000,
+                       m.latency_ms, m.rtt_ms / 2, corr, position / (double) sample_rate);
+                fflush(stdout);
+            }
+        }
+        body.erase(body.begin(), body.begin() + whole);
+    }
+
+    quit = true;
+    if (firer.joinable())
+        firer.join();
+    close(fd);
+
+    // Latencies, their trend, and the stream clock against ours: if the
+    // two clocks agree the arrival time less the stream position is flat
+
+    std::vector<double> at, latency, lag;
+    for (const Marker& m : markers) {
+        at.push_back(m.arrival_ms);
+        if (m.matched)
+            latency.push_back(m.latency_ms);
+        lag.push_back(m.arrival_ms - m.position * 1000.0 / (sample_rate ? sample_rate : 1));
+    }
+
+    int asked = (int) triggers.size(), missed = 0;
+    for (const Trigger& t : triggers)
+        missed += !t.matched;
+
+    printf("%s, %zu markers", end, markers.size());
+    if (!opt.listen)
+        printf(" of %d asked for, %d missed", asked, missed);
+    printf("\n");
+
+    if (!latency.empty()) {
+        std::vector<double> half_rtt;
+        for (const Marker& m : markers)
+            half_rtt.push_back(m.rtt_ms / 2);
+        printf("latency ms: min %.1f median %.1f p95 %.1f max %.1f (+/- %.1f median), trend %+.2f ms/min\n",
+               percentile(latency, 0), percentile(latency, 0.5), percentile(latency, 0.95), percentile(latency, 1),
+               percentile(half_rtt, 0.5), slope(at, latency) * 60000);
+    }
+
+    if (markers.size() >= 2) {
+        std::vector<double> spacing;
+        for (size_t i = 1; i < markers.size(); i++)
+            spacing.push_back(markers[i].arrival_ms - markers[i - 1].arrival_ms);
+        printf("marker spacing ms: median %.1f min %.1f max %.1f, stream clock %+.0f ppm against this host\n",
+               percentile(spacing, 0.5), percentile(spacing, 0), percentile(spacing, 1), -slope(at, lag) * 1e6);
+    }
+
+    return markers.empty() ? 1 : 0;
+}
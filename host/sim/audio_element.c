@@ -0,0 +1,207 @@
+/*
+ * audio_element.c
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: xenir
+ */
+
+#include <stdlib.h>
+#include <pthread.h>
+
+#include "esp_log.h"
+#include "audio_element.h"
+
+static const char *TAG = "sim_element";
+
+struct audio_element {
+    audio_element_cfg_t     cfg;
+    void*                   data;
+    ringbuf_handle_t        in;
+    ringbuf_handle_t        out;
+    char*                   buf;
+    pthread_t               thread;
+    bool                    started;        // Task to join, whatever state it left
+    volatile audio_element_state_t state;
+    int64_t                 byte_pos;
+    int64_t                 total_bytes;
+};
+
+audio_element_handle_t audio_element_init(audio_element_cfg_t *config)
+{
+    struct audio_element* el = calloc( 1, sizeof(struct audio_element) );
+    if ( !el )
+        return NULL;
+
+    el->cfg = *config;
+    el->data = config->data;
+    el->buf = malloc( config->buffer_len );
+    if ( !el->buf ) {
+        free( el );
+        return NULL;
+    }
+
+    el->state = AEL_STATE_INIT;
+    return el;
+}
+
+esp_err_t audio_element_deinit(audio_element_handle_t el)
+{
+    audio_element_stop( el );
+    if ( el->cfg.destroy )
+        el->cfg.destroy( el );
+    free( el->buf );
+    free( el );
+    return ESP_OK;
+}
+
+esp_err_t audio_element_setdata(audio_element_handle_t el, void *data)
+{
+    el->data = data;
+    return ESP_OK;
+}
+
+void *audio_element_getdata(audio_element_handle_t el)
+{
+    return el->data;
+}
+
+esp_err_t audio_element_set_input_ringbuf(audio_element_handle_t el, ringbuf_handle_t rb)
+{
+    el->in = rb;
+    return ESP_OK;
+}
+
+ringbuf_handle_t audio_element_get_input_ringbuf(audio_element_handle_t el)
+{
+    return el->in;
+}
+
+esp_err_t audio_element_set_output_ringbuf(audio_element_handle_t el, ringbuf_handle_t rb)
+{
+    el->out = rb;
+    return ESP_OK;
+}
+
+ringbuf_handle_t audio_element_get_output_ringbuf(audio_element_handle_t el)
+{
+    return el->out;
+}
+
+static void* _element_task( void* arg )
+{
+    struct audio_element* el = (struct audio_element*) arg;
+
+    if ( el->cfg.open && el->cfg.open( el ) != ESP_OK ) {
+        ESP_LOGE(TAG, "[%s] open failed", el->cfg.tag);
+        el->state = AEL_STATE_ERROR;
+        return NULL;
+    }
+
+    while ( el->state == AEL_STATE_RUNNING ) {
+        int ret = el->cfg.process( el, el->buf, el->cfg.buffer_len );
+        if ( ret == AEL_IO_DONE ) {
+            el->state = AEL_STATE_FINISHED;
+        } else if ( ret == AEL_IO_ABORT ) {
+            // A neighbour stopping aborts the ringbuffer between them; as
+            // on ADF this stops the element rather than failing it
+            el->state = AEL_STATE_STOPPED;
+        } else if ( ret < 0 && el->state == AEL_STATE_RUNNING ) {
+            ESP_LOGE(TAG, "[%s] process returned %d", el->cfg.tag, ret);
+            el->state = AEL_STATE_ERROR;
+        }
+    }
+
+    if ( el->cfg.close )
+        el->cfg.close( el );
+    return NULL;
+}
+
+esp_err_t audio_element_run(audio_element_handle_t el)
+{
+    if ( el->state == AEL_STATE_RUNNING )
+        return ESP_OK;
+
+    if ( !( el->in || el->cfg.read ) || !( el->out || el->cfg.write ) || !el->cfg.process ) {
+        ESP_LOGE(TAG, "[%s] needs an input ringbuffer or read callback, an output ringbuffer or write callback, and a process callback", el->cfg.tag);
+        return ESP_FAIL;
+    }
+
+    el->state = AEL_STATE_RUNNING;
+    if ( pthread_create( &el->thread, NULL, _element_task, el ) != 0 ) {
+        el->state = AEL_STATE_ERROR;
+        return ESP_FAIL;
+    }
+    el->started = true;
+    return ESP_OK;
+}
+
+esp_err_t audio_element_stop(audio_element_handle_t el)
+{
+    if ( !el->started )
+        return ESP_OK;
+
+    el->state = AEL_STATE_STOPPED;
+    if ( el->in )
+        rb_abort( el->in );
+    if ( el->out )
+        rb_abort( el->out );
+    pthread_join( el->thread, NULL );
+    el->started = false;
+    return ESP_OK;
+}
+
+audio_element_state_t audio_element_get_state(audio_element_handle_t el)
+{
+    return el->state;
+}
+
+audio_element_err_t audio_element_input(audio_element_handle_t el, char *buffer, int wanted_size)
+{
+    if ( !el->in )
+        return el->cfg.read( el, buffer, wanted_size, portMAX_DELAY, el->data );
+
+    int ret = rb_read( el->in, buffer, wanted_size, portMAX_DELAY );
+    if ( ret == RB_ABORT )
+        return AEL_IO_ABORT;
+    if ( ret == RB_DONE )
+        return AEL_IO_DONE;
+    return ret;
+}
+
+audio_element_err_t audio_element_output(audio_element_handle_t el, char *buffer, int write_size)
+{
+    if ( el->out ) {
+        int ret = rb_write( el->out, buffer, write_size, portMAX_DELAY );
+        if ( ret == RB_ABORT )
+            return AEL_IO_ABORT;
+        if ( ret == RB_DONE )
+            return AEL_IO_DONE;
+        return ret;
+    }
+    if ( !el->cfg.write )
+        return AEL_IO_FAIL;
+    return el->cfg.write( el, buffer, write_size, portMAX_DELAY, NULL );
+}
+
+esp_err_t audio_element_update_byte_pos(audio_element_handle_t el, int pos)
+{
+    el->byte_pos += pos;
+    return ESP_OK;
+}
+
+esp_err_t audio_element_set_byte_pos(audio_element_handle_t el, int64_t pos)
+{
+    el->byte_pos = pos;
+    return ESP_OK;
+}
+
+int64_t audio_element_get_byte_pos(audio_element_handle_t el)
+{
+    return el->byte_pos;
+}
+
+esp_err_t audio_element_set_total_bytes(audio_element_handle_t el, int64_t total_bytes)
+{
+    el->total_bytes = total_bytes;
+    return ESP_OK;
+}
@@ -0,0 +1,79 @@
+/*
+ * esp_sys.c
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: xenir
+ */
+
+// Host simulator versions of the ESP-IDF log, timer and system calls
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <time.h>
+
+#include "esp_err.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_system.h"
+
+static esp_log_level_t log_level = ESP_LOG_INFO;
+
+static int64_t _now_us( void )
+{
+    struct timespec ts;
+    clock_gettime( CLOCK_MONOTONIC, &ts );
+    return (int64_t) ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+int64_t esp_timer_get_time(void)
+{
+    static int64_t start;
+    if ( !start )
+        start = _now_us();
+    return _now_us() - start;
+}
+
+void esp_log_level_set(const char *tag, esp_log_level_t level)
+{
+    // Per tag levels are not kept, "*" or any tag sets the global level
+    log_level = level;
+}
+
+void esp_log_write(esp_log_level_t level, const char *tag, const char *format, ...)
+{
+    static const char letters[] = "-EWIDV";
+
+    if ( level > log_level )
+        return;
+
+    char line[512];
+    va_list args;
+    va_start( args, format );
+    vsnprintf( line, sizeof(line), format, args );
+    va_end( args );
+
+    fprintf( stderr, "%c (%lld) %s: %s\n", letters[level], (long long) ( esp_timer_get_time() / 1000 ), tag, line );
+}
+
+const char *esp_err_to_name(esp_err_t code)
+{
+    switch ( code ) {
+    case ESP_OK:                    return "ESP_OK";
+    case ESP_FAIL:                  return "ESP_FAIL";
+    case ESP_ERR_NO_MEM:            return "ESP_ERR_NO_MEM";
+    case ESP_ERR_INVALID_ARG:       return "ESP_ERR_INVALID_ARG";
+    case ESP_ERR_INVALID_STATE:     return "ESP_ERR_INVALID_STATE";
+    case ESP_ERR_INVALID_SIZE:      return "ESP_ERR_INVALID_SIZE";
+    case ESP_ERR_NOT_FOUND:         return "ESP_ERR_NOT_FOUND";
+    case ESP_ERR_NOT_SUPPORTED:     return "ESP_ERR_NOT_SUPPORTED";
+    case ESP_ERR_TIMEOUT:           return "ESP_ERR_TIMEOUT";
+    default:                        return "UNKNOWN ERROR";
+    }
+}
+
+uint32_t esp_random(void)
+{
+    return ( (uint32_t) random() << 16 ) ^ (uint32_t) random();
+}
@@ -0,0 +1,245 @@
+/*
+ * freertos.c
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: xenir
+ */
+
+// Host simulator versions of the FreeRTOS calls the streaming code makes.
+// Tasks are detached pthreads, mutexes are pthread mutexes, queues a ring
+// of copies under a mutex and the tick count is derived from the monotonic
+// clock.
+
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <pthread.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "freertos/queue.h"
+#include "esp_timer.h"
+
+struct sim_task {
+    pthread_t       thread;
+    TaskFunction_t  fn;
+    void*           arg;
+};
+
+struct sim_mutex {
+    pthread_mutex_t mutex;
+};
+
+struct sim_queue {
+    pthread_mutex_t mutex;
+    pthread_cond_t  not_empty;
+    pthread_cond_t  not_full;
+    UBaseType_t     length;
+    UBaseType_t     item_size;
+    UBaseType_t     head;
+    UBaseType_t     count;
+    char            items[];
+};
+
+static __thread struct sim_task* current;
+
+static void* _task_entry( void* arg )
+{
+    struct sim_task* task = (struct sim_task*) arg;
+    current = task;
+    task->fn( task->arg );
+    return NULL;
+}
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t fn, const char *name, uint32_t stack, void *arg, UBaseType_t prio, TaskHandle_t *handle, BaseType_t core)
+{
+    struct sim_task* task = calloc( 1, sizeof(struct sim_task) );
+    if ( !task )
+        return pdFAIL;
+
+    task->fn = fn;
+    task->arg = arg;
+
+    if ( pthread_create( &task->thread, NULL, _task_entry, task ) != 0 ) {
+        free( task );
+        return pdFAIL;
+    }
+    pthread_detach( task->thread );
+
+    if ( handle )
+        *handle = task;
+    return pdPASS;
+}
+
+BaseType_t xTaskCreate(TaskFunction_t fn, const char *name, uint32_t stack, void *arg, UBaseType_t prio, TaskHandle_t *handle)
+{
+    return xTaskCreatePinnedToCore( fn, name, stack, arg, prio, handle, tskNO_AFFINITY );
+}
+
+void vTaskDelete(TaskHandle_t task)
+{
+    // Only self deletion is supported, which is all the firmware does
+    if ( task == NULL )
+        pthread_exit( NULL );
+}
+
+// NULL on threads the simulator started itself
+
+TaskHandle_t xTaskGetCurrentTaskHandle(void)
+{
+    return current;
+}
+
+TickType_t xTaskGetTickCount(void)
+{
+    return esp_timer_get_time() / ( 1000 * portTICK_PERIOD_MS );
+}
+
+static void _sleep_us( int64_t us )
+{
+    struct timespec ts = { us / 1000000, ( us % 1000000 ) * 1000 };
+    while ( nanosleep( &ts, &ts ) != 0 && errno == EINTR )
+        ;
+}
+
+void vTaskDelay(TickType_t ticks)
+{
+    _sleep_us( (int64_t) ticks * portTICK_PERIOD_MS * 1000 );
+}
+
+void vTaskDelayUntil(TickType_t *wake, TickType_t period)
+{
+    *wake += period;
+    int64_t wait = (int64_t) *wake * portTICK_PERIOD_MS * 1000 - esp_timer_get_time();
+    if ( wait > 0 )
+        _sleep_us( wait );
+}
+
+static void _deadline( struct timespec* ts, TickType_t ticks )
+{
+    clock_gettime( CLOCK_REALTIME, ts );
+    int64_t ns = ts->tv_nsec + (int64_t) ticks * portTICK_PERIOD_MS * 1000000;
+    ts->tv_sec += ns / 1000000000;
+    ts->tv_nsec = ns % 1000000000;
+}
+
+SemaphoreHandle_t xSemaphoreCreateMutex(void)
+{
+    struct sim_mutex* sem = calloc( 1, sizeof(struct sim_mutex) );
+    if ( sem )
+        pthread_mutex_init( &sem->mutex, NULL );
+    return sem;
+}
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t sem, TickType_t ticks)
+{
+    if ( ticks == portMAX_DELAY )
+        return pthread_mutex_lock( &sem->mutex ) == 0 ? pdTRUE : pdFALSE;
+
+    struct timespec ts;
+    _deadline( &ts, ticks );
+
+    return pthread_mutex_timedlock( &sem->mutex, &ts ) == 0 ? pdTRUE : pdFALSE;
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t sem)
+{
+    return pthread_mutex_unlock( &sem->mutex ) == 0 ? pdTRUE : pdFALSE;
+}
+
+void vSemaphoreDelete(SemaphoreHandle_t sem)
+{
+    if ( !sem )
+        return;
+    pthread_mutex_destroy( &sem->mutex );
+    free( sem );
+}
+
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t item_size)
+{
+    struct sim_queue* q = calloc( 1, sizeof(struct sim_queue) + length * item_size );
+    if ( !q )
+        return NULL;
+
+    pthread_mutex_init( &q->mutex, NULL );
+    pthread_cond_init( &q->not_empty, NULL );
+    pthread_cond_init( &q->not_full, NULL );
+    q->length = length;
+    q->item_size = item_size;
+    return q;
+}
+
+// Waits on "cond" until "ready" holds or the ticks run out, with the queue
+// mutex held
+
+static bool _queue_wait( struct sim_queue* q, pthread_cond_t* cond, bool (*ready)( struct sim_queue* ), TickType_t ticks )
+{
+    struct timespec ts;
+    if ( ticks != portMAX_DELAY )
+        _deadline( &ts, ticks );
+
+    while ( !ready( q ) ) {
+        if ( ticks == 0 )
+            return false;
+        if ( ticks == portMAX_DELAY )
+            pthread_cond_wait( cond, &q->mutex );
+        else if ( pthread_cond_timedwait( cond, &q->mutex, &ts ) == ETIMEDOUT )
+            return ready( q );
+    }
+    return true;
+}
+
+static bool _has_room( struct sim_queue* q )
+{
+    return q->count < q->length;
+}
+
+static bool _has_item( struct sim_queue* q )
+{
+    return q->count > 0;
+}
+
+BaseType_t xQueueSend(QueueHandle_t q, const void *item, TickType_t ticks)
+{
+    pthread_mutex_lock( &q->mutex );
+
+    bool ok = _queue_wait( q, &q->not_full, _has_room, ticks );
+    if ( ok ) {
+        UBaseType_t tail = ( q->head + q->count ) % q->length;
+        memcpy( q->items + tail * q->item_size, item, q->item_size );
+        q->count++;
+        pthread_cond_signal( &q->not_empty );
+    }
+
+    pthread_mutex_unlock( &q->mutex );
+    return ok ? pdTRUE : pdFALSE;
+}
+
+BaseType_t xQueueReceive(QueueHandle_t q, void *item, TickType_t ticks)
+{
+    pthread_mutex_lock( &q->mutex );
+
+    bool ok = _queue_wait( q, &q->not_empty, _has_item, ticks );
+    if ( ok ) {
+        memcpy( item, q->items + q->head * q->item_size, q->item_size );
+        q->head = ( q->head + 1 ) % q->length;
+        q->count--;
+        pthread_cond_signal( &q->not_full );
+    }
+
+    pthread_mutex_unlock( &q->mutex );
+    return ok ? pdTRUE : pdFALSE;
+}
+
+void vQueueDelete(QueueHandle_t q)
+{
+    if ( !q )
+        return;
+    pthread_mutex_destroy( &q->mutex );
+    pthread_cond_destroy( &q->not_empty );
+    pthread_cond_destroy( &q->not_full );
+    free( q );
+}
@@ -0,0 +1,509 @@
+/*
+ * httpd.c
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: xenir
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+
+#include "esp_log.h"
+#include "esp_http_server.h"
+
+static const char *TAG = "sim_httpd";
+
+int sim_httpd_port_80 = 8080;
+
+#define REQ_BUF_SIZE		( HTTPD_MAX_URI_LEN + HTTPD_MAX_REQ_HDR_LEN + 64 )
+
+struct sim_httpd {
+    httpd_config_t	config;
+    int				listen_fd;
+    pthread_t		thread;
+    int				num_handlers;
+    httpd_uri_t*	handlers;
+    pthread_mutex_t	lock;			// Held for each request, so work runs between them
+};
+
+// Per request state, what the real server keeps in httpd_req_aux
+
+struct sim_req {
+    int				fd;
+    char			raw[REQ_BUF_SIZE + 1];
+    const char*		headers;		// First header line in raw
+    const char*		status;
+    const char*		content_type;
+    int				num_hdrs;
+    const char*		hdr_field[8];
+    const char*		hdr_value[8];
+    bool			headers_sent;
+};
+
+static const struct {
+    const char*		status;
+    const char*		msg;
+} errors[HTTPD_ERR_CODE_MAX] = {
+    [HTTPD_500_INTERNAL_SERVER_ERROR]	= { "500 Internal Server Error", "Server has encountered an unexpected error" },
+    [HTTPD_501_METHOD_NOT_IMPLEMENTED]	= { "501 Method Not Implemented", "Request method is not supported by server" },
+    [HTTPD_505_VERSION_NOT_SUPPORTED]	= { "505 Version Not Supported", "HTTP version not supported by server" },
+    [HTTPD_400_BAD_REQUEST]				= { "400 Bad Request", "Bad request syntax" },
+    [HTTPD_401_UNAUTHORIZED]			= { "401 Unauthorized", "No permission -- see authorization schemes" },
+    [HTTPD_403_FORBIDDEN]				= { "403 Forbidden", "Request forbidden -- authorization will not help" },
+    [HTTPD_404_NOT_FOUND]				= { "404 Not Found", "Nothing matches the given URI" },
+    [HTTPD_405_METHOD_NOT_ALLOWED]		= { "405 Method Not Allowed", "Specified method is invalid for this resource" },
+    [HTTPD_408_REQ_TIMEOUT]				= { "408 Request Timeout", "Server closed this connection" },
+    [HTTPD_411_LENGTH_REQUIRED]			= { "411 Length Required", "Chunked encoding not supported by server" },
+    [HTTPD_414_URI_TOO_LONG]			= { "414 URI Too Long", "URI is too long" },
+    [HTTPD_431_REQ_HDR_FIELDS_TOO_LARGE] = { "431 Request Header Fields Too Large", "Header fields are too long" },
+};
+
+static const char* const methods[] = {
+    [HTTP_DELETE] = "DELETE", [HTTP_GET] = "GET", [HTTP_HEAD] = "HEAD", [HTTP_POST] = "POST", [HTTP_PUT] = "PUT"
+};
+
+static int _send_all( int fd, const char* buf, size_t len )
+{
+    while ( len > 0 ) {
+        ssize_t n = send( fd, buf, len, MSG_NOSIGNAL );
+        if ( n <= 0 )
+            return -1;
+        buf += n;
+        len -= n;
+    }
+    return 0;
+}
+
+static int _send_headers( struct sim_req* sr, const char* length_hdr )
+{
+    char hdr[HTTPD_MAX_REQ_HDR_LEN];
+    int len = snprintf( hdr, sizeof(hdr), "HTTP/1.1 %s\r\nContent-Type: %s\r\n%s\r\nConnection: close\r\n",
+            sr->status, sr->content_type, length_hdr );
+
+    for ( int i = 0 ; i < sr->num_hdrs && len < (int) sizeof(hdr) ; i++ )
+        len += snprintf( hdr + len, sizeof(hdr) - len, "%s: %s\r\n", sr->hdr_field[i], sr->hdr_value[i] );
+
+    if ( len + 2 >= (int) sizeof(hdr) )
+        return -1;
+
+    memcpy( hdr + len, "\r\n", 2 );
+    sr->headers_sent = true;
+    return _send_all( sr->fd, hdr, len + 2 );
+}
+
+esp_err_t httpd_resp_set_status(httpd_req_t *r, const char *status)
+{
+    ((struct sim_req*) r->aux)->status = status;
+    return ESP_OK;
+}
+
+esp_err_t httpd_resp_set_type(httpd_req_t *r, const char *type)
+{
+    ((struct sim_req*) r->aux)->content_type = type;
+    return ESP_OK;
+}
+
+esp_err_t httpd_resp_set_hdr(httpd_req_t *r, const char *field, const char *value)
+{
+    struct sim_req* sr = r->aux;
+    if ( sr->num_hdrs == 8 )
+        return ESP_ERR_HTTPD_RESP_HDR;
+    sr->hdr_field[sr->num_hdrs] = field;
+    sr->hdr_value[sr->num_hdrs++] = value;
+    return ESP_OK;
+}
+
+esp_err_t httpd_resp_send(httpd_req_t *r, const char *buf, ssize_t buf_len)
+{
+    struct sim_req* sr = r->aux;
+    char length[48];
+
+    if ( buf_len == HTTPD_RESP_USE_STRLEN )
+        buf_len = buf ? strlen( buf ) : 0;
+
+    snprintf( length, sizeof(length), "Content-Length: %d", (int) buf_len );
+    if ( _send_headers( sr, length ) != 0 || _send_all( sr->fd, buf, buf_len ) != 0 )
+        return ESP_ERR_HTTPD_RESP_SEND;
+    return ESP_OK;
+}
+
+esp_err_t httpd_resp_send_chunk(httpd_req_t *r, const char *buf, ssize_t buf_len)
+{
+    struct sim_req* sr = r->aux;
+
+    if ( buf_len == HTTPD_RESP_USE_STRLEN )
+        buf_len = buf ? strlen( buf ) : 0;
+
+    if ( !sr->headers_sent && _send_headers( sr, "Transfer-Encoding: chunked" ) != 0 )
+        return ESP_ERR_HTTPD_RESP_HDR;
+
+    char size[16];
+    int len = snprintf( size, sizeof(size), "%x\r\n", (unsigned) buf_len );
+
+    if ( _send_all( sr->fd, size, len ) != 0 ||
+         ( buf_len > 0 && _send_all( sr->fd, buf, buf_len ) != 0 ) ||
+         _send_all( sr->fd, "\r\n", 2 ) != 0 )
+        return ESP_ERR_HTTPD_RESP_SEND;
+
+    return ESP_OK;
+}
+
+esp_err_t httpd_resp_send_err(httpd_req_t *req, httpd_err_code_t error, const char *msg)
+{
+    if ( error >= HTTPD_ERR_CODE_MAX )
+        return ESP_ERR_INVALID_ARG;
+
+    httpd_resp_set_status( req, errors[error].status );
+    httpd_resp_set_type( req, "text/html" );
+    return httpd_resp_send( req, msg ? msg : errors[error].msg, HTTPD_RESP_USE_STRLEN );
+}
+
+int httpd_req_to_sockfd(httpd_req_t *r)
+{
+    return ((struct sim_req*) r->aux)->fd;
+}
+
+size_t httpd_req_get_url_query_len(httpd_req_t *r)
+{
+    const char* q = strchr( r->uri, '?' );
+    return q ? strlen( q + 1 ) : 0;
+}
+
+esp_err_t httpd_req_get_url_query_str(httpd_req_t *r, char *buf, size_t buf_len)
+{
+    const char* q = strchr( r->uri, '?' );
+    if ( !q )
+        return ESP_ERR_NOT_FOUND;
+
+    snprintf( buf, buf_len, "%s", q + 1 );
+    return strlen( q + 1 ) >= buf_len ? ESP_ERR_HTTPD_RESULT_TRUNC : ESP_OK;
+}
+
+esp_err_t httpd_query_key_value(const char *qry, const char *key, char *val, size_t val_size)
+{
+    size_t key_len = strlen( key );
+
+    for ( const char* p = qry ; p && *p ; ) {
+
+        const char* end = strchr( p, '&' );
+        size_t len = end ? (size_t)( end - p ) : strlen( p );
+
+        if ( len > key_len && strncmp( p, key, key_len ) == 0 && p[key_len] == '=' ) {
+            size_t n = len - key_len - 1;
+            size_t copy = n < val_size - 1 ? n : val_size - 1;
+            memcpy( val, p + key_len + 1, copy );
+            val[copy] = 0;
+            return copy < n ? ESP_ERR_HTTPD_RESULT_TRUNC : ESP_OK;
+        }
+
+        p = end ? end + 1 : NULL;
+    }
+
+    return ESP_ERR_NOT_FOUND;
+}
+
+static const char* _find_hdr( httpd_req_t *r, const char *field, size_t *len )
+{
+    size_t field_len = strlen( field );
+
+    for ( const char* p = ((struct sim_req*) r->aux)->headers ; p && *p && *p != '\r' ; ) {
+
+        const char* eol = strstr( p, "\r\n" );
+        if ( !eol )
+            break;
+
+        if ( strncasecmp( p, field, field_len ) == 0 && p[field_len] == ':' ) {
+            const char* v = p + field_len + 1;
+            while ( *v == ' ' )
+                v++;
+            *len = eol - v;
+            return v;
+        }
+
+        p = eol + 2;
+    }
+
+    return NULL;
+}
+
+size_t httpd_req_get_hdr_value_len(httpd_req_t *r, const char *field)
+{
+    size_t len = 0;
+    return _find_hdr( r, field, &len ) ? len : 0;
+}
+
+esp_err_t httpd_req_get_hdr_value_str(httpd_req_t *r, const char *field, char *val, size_t val_size)
+{
+    size_t len;
+    const char* v = _find_hdr( r, field, &len );
+    if ( !v )
+        return ESP_ERR_NOT_FOUND;
+
+    size_t copy = len < val_size - 1 ? len : val_size - 1;
+    memcpy( val, v, copy );
+    val[copy] = 0;
+    return copy < len ? ESP_ERR_HTTPD_RESULT_TRUNC : ESP_OK;
+}
+
+// Same rules as the ESP-IDF matcher: a trailing '*' matches any rest, a '?'
+// (before the '*' if both are there) makes the character before it optional
+
+bool httpd_uri_match_wildcard(const char *uri_template, const char *uri_to_match, size_t match_upto)
+{
+    size_t tpl_len = strlen( uri_template );
+
+    bool asterisk = tpl_len > 0 && uri_template[tpl_len - 1] == '*';
+    if ( asterisk )
+        tpl_len--;
+    bool quest = tpl_len > 1 && uri_template[tpl_len - 1] == '?';
+    if ( quest )
+        tpl_len--;
+
+    size_t required = quest ? tpl_len - 1 : tpl_len;
+    if ( match_upto < required || strncmp( uri_template, uri_to_match, required ) != 0 )
+        return false;
+
+    size_t pos = required;
+    if ( quest && pos < match_upto && uri_to_match[pos] == uri_template[required] )
+        pos++;
+
+    return asterisk || pos == match_upto;
+}
+
+esp_err_t httpd_register_uri_handler(httpd_handle_t handle, const httpd_uri_t *uri_handler)
+{
+    for ( int i = 0 ; i < handle->num_handlers ; i++ ) {
+        if ( handle->handlers[i].method == uri_handler->method && strcmp( handle->handlers[i].uri, uri_handler->uri ) == 0 )
+            return ESP_ERR_HTTPD_HANDLER_EXISTS;
+    }
+
+    if ( handle->num_handlers == handle->config.max_uri_handlers ) {
+        ESP_LOGE(TAG, "No slots left for registering handler");
+        return ESP_ERR_HTTPD_HANDLERS_FULL;
+    }
+
+    httpd_uri_t* h = &handle->handlers[handle->num_handlers];
+    *h = *uri_handler;
+    h->uri = strdup( uri_handler->uri );
+    if ( !h->uri )
+        return ESP_ERR_NO_MEM;
+
+    handle->num_handlers++;
+    return ESP_OK;
+}
+
+esp_err_t httpd_unregister_uri_handler(httpd_handle_t handle, const char *uri, httpd_method_t method)
+{
+    for ( int i = 0 ; i < handle->num_handlers ; i++ ) {
+        if ( handle->handlers[i].method == method && strcmp( handle->handlers[i].uri, uri ) == 0 ) {
+            free( (char*) handle->handlers[i].uri );
+            memmove( &handle->handlers[i], &handle->handlers[i + 1], ( handle->num_handlers - i - 1 ) * sizeof(httpd_uri_t) );
+            handle->num_handlers--;
+            return ESP_OK;
+        }
+    }
+    return ESP_ERR_NOT_FOUND;
+}
+
+// Every connection is closed once its one request is done, so a close
+// requested from another task only has to stop the peer sending
+
+esp_err_t httpd_sess_trigger_close(httpd_handle_t handle, int sockfd)
+{
+    return shutdown( sockfd, SHUT_RDWR ) == 0 ? ESP_OK : ESP_FAIL;
+}
+
+// Work runs in the caller's thread rather than the server's, but not while
+// a request is being handled, which is what its callers count on
+
+esp_err_t httpd_queue_work(httpd_handle_t handle, httpd_work_fn_t work, void *arg)
+{
+    pthread_mutex_lock( &handle->lock );
+    work( arg );
+    pthread_mutex_unlock( &handle->lock );
+    return ESP_OK;
+}
+
+static int _read_request( struct sim_req* sr )
+{
+    int len = 0;
+
+    while ( len < REQ_BUF_SIZE ) {
+        ssize_t n = recv( sr->fd, sr->raw + len, REQ_BUF_SIZE - len, 0 );
+        if ( n <= 0 )
+            return -1;
+        len += n;
+        sr->raw[len] = 0;
+        if ( strstr( sr->raw, "\r\n\r\n" ) )
+            return 0;
+    }
+
+    return -1;
+}
+
+static void _handle_connection( struct sim_httpd* hd, int fd )
+{
+    struct sim_req* sr = calloc( 1, sizeof(struct sim_req) );
+    httpd_req_t* req = calloc( 1, sizeof(httpd_req_t) );
+
+    if ( !sr || !req )
+        goto done;
+
+    sr->fd = fd;
+    sr->status = HTTPD_200;
+    sr->content_type = "text/html";
+    req->handle = hd;
+    req->aux = sr;
+
+    if ( _read_request( sr ) != 0 )
+        goto done;
+
+    // Request line: METHOD URI VERSION
+
+    char* method = sr->raw;
+    char* uri = strchr( method, ' ' );
+    char* version = uri ? strchr( uri + 1, ' ' ) : NULL;
+    char* eol = strstr( sr->raw, "\r\n" );
+
+    if ( !version || version > eol ) {
+        httpd_resp_send_err( req, HTTPD_400_BAD_REQUEST, NULL );
+        goto done;
+    }
+
+    *uri++ = 0;
+    *version = 0;
+    sr->headers = eol + 2;
+
+    if ( strlen( uri ) > HTTPD_MAX_URI_LEN ) {
+        httpd_resp_send_err( req, HTTPD_414_URI_TOO_LONG, NULL );
+        goto done;
+    }
+    strcpy( (char*) req->uri, uri );
+
+    req->method = -1;
+    for ( int m = 0 ; m < (int)( sizeof(methods) / sizeof(methods[0]) ) ; m++ ) {
+        if ( strcmp( method, methods[m] ) == 0 )
+            req->method = m;
+    }
+
+    size_t match_len = strcspn( uri, "?" );
+    httpd_uri_t* found = NULL;
+    bool uri_known = false;
+
+    for ( int i = 0 ; i < hd->num_handlers && !found ; i++ ) {
+
+        httpd_uri_t* h = &hd->handlers[i];
+        bool match = hd->config.uri_match_fn ?
+                hd->config.uri_match_fn( h->uri, uri, match_len ) :
+                strlen( h->uri ) == match_len && strncmp( h->uri, uri, match_len ) == 0;
+
+        if ( match ) {
+            uri_known = true;
+            if ( (int) h->method == req->method )
+                found = h;
+        }
+    }
+
+    if ( !found ) {
+        httpd_resp_send_err( req, uri_known ? HTTPD_405_METHOD_NOT_ALLOWED : HTTPD_404_NOT_FOUND, NULL );
+        goto done;
+    }
+
+    req->user_ctx = found->user_ctx;
+    if ( found->handler( req ) != ESP_OK )
+        ESP_LOGW(TAG, "Handler for %s failed, closing %d", req->uri, fd);
+
+done:
+    free( req );
+    free( sr );
+
+    if ( hd->config.close_fn )
+        hd->config.close_fn( hd, fd );
+    else
+        close( fd );
+}
+
+static void* _server_task( void* arg )
+{
+    struct sim_httpd* hd = (struct sim_httpd*) arg;
+
+    for ( ;; ) {
+
+        int fd = accept( hd->listen_fd, NULL, NULL );
+        if ( fd < 0 )
+            break;
+
+        struct timeval rcv = { hd->config.recv_wait_timeout, 0 };
+        struct timeval snd = { hd->config.send_wait_timeout, 0 };
+        int one = 1;
+        setsockopt( fd, SOL_SOCKET, SO_RCVTIMEO, &rcv, sizeof(rcv) );
+        setsockopt( fd, SOL_SOCKET, SO_SNDTIMEO, &snd, sizeof(snd) );
+        setsockopt( fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one) );
+
+        pthread_mutex_lock( &hd->lock );
+        _handle_connection( hd, fd );
+        pthread_mutex_unlock( &hd->lock );
+    }
+
+    return NULL;
+}
+
+esp_err_t httpd_start(httpd_handle_t *handle, const httpd_config_t *config)
+{
+    struct sim_httpd* hd = calloc( 1, sizeof(struct sim_httpd) );
+    if ( !hd )
+        return ESP_ERR_NO_MEM;
+
+    int port = config->server_port == 80 ? sim_httpd_port_80 : config->server_port;
+
+    hd->config = *config;
+    pthread_mutex_init( &hd->lock, NULL );
+    hd->handlers = calloc( config->max_uri_handlers, sizeof(httpd_uri_t) );
+    hd->listen_fd = socket( AF_INET, SOCK_STREAM, 0 );
+
+    int one = 1;
+    struct sockaddr_in addr = {
+        .sin_family = AF_INET,
+        .sin_port = htons( port ),
+        .sin_addr.s_addr = htonl( INADDR_ANY ),
+    };
+
+    if ( !hd->handlers || hd->listen_fd < 0 ||
+         setsockopt( hd->listen_fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one) ) != 0 ||
+         bind( hd->listen_fd, (struct sockaddr*) &addr, sizeof(addr) ) != 0 ||
+         listen( hd->listen_fd, config->backlog_conn ) != 0 ) {
+        ESP_LOGE(TAG, "Cannot listen on port %d", port);
+        goto fail;
+    }
+
+    if ( pthread_create( &hd->thread, NULL, _server_task, hd ) != 0 )
+        goto fail;
+
+    *handle = hd;
+    return ESP_OK;
+
+fail:
+    if ( hd->listen_fd >= 0 )
+        close( hd->listen_fd );
+    free( hd->handlers );
+    free( hd );
+    return ESP_ERR_HTTPD_TASK;
+}
+
+esp_err_t httpd_stop(httpd_handle_t handle)
+{
+    // Wakes the accept, a handler still running finishes on its own
+    shutdown( handle->listen_fd, SHUT_RDWR );
+    close( handle->listen_fd );
+    pthread_detach( handle->thread );
+    return ESP_OK;
+}
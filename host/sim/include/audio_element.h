@@ -0,0 +1,113 @@
+/*
+ * audio_element.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: xenir
+ */
+
+// Host simulator stand-in for the ESP-ADF audio element. Only what a sink
+// or a source element needs: the task runs the process callback, input
+// comes from the input ringbuffer or, without one, the read callback, and
+// output goes to the output ringbuffer or, without one, the write callback.
+// There is no event interface and no pipeline, the simulator drives the
+// element directly.
+
+#ifndef SIM_AUDIO_ELEMENT_H_
+#define SIM_AUDIO_ELEMENT_H_
+
+#include "esp_err.h"
+#include "freertos/FreeRTOS.h"
+#include "ringbuf.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef enum {
+    AEL_IO_OK           = ESP_OK,
+    AEL_IO_FAIL         = ESP_FAIL,
+    AEL_IO_DONE         = -2,
+    AEL_IO_ABORT        = -3,
+    AEL_IO_TIMEOUT      = -4,
+} audio_element_err_t;
+
+typedef enum {
+    AEL_STATE_NONE          = 0,
+    AEL_STATE_INIT,
+    AEL_STATE_RUNNING,
+    AEL_STATE_PAUSED,
+    AEL_STATE_STOPPED,
+    AEL_STATE_FINISHED,
+    AEL_STATE_ERROR
+} audio_element_state_t;
+
+typedef struct audio_element *audio_element_handle_t;
+
+typedef esp_err_t (*el_io_func)(audio_element_handle_t self);
+typedef int (*process_func)(audio_element_handle_t self, char *el_buffer, int el_buf_len);
+typedef int (*stream_func)(audio_element_handle_t self, char *buffer, int len, TickType_t ticks_to_wait, void *context);
+
+typedef struct {
+    el_io_func          open;
+    el_io_func          seek;
+    process_func        process;
+    el_io_func          close;
+    el_io_func          destroy;
+    stream_func         read;
+    stream_func         write;
+    int                 buffer_len;
+    int                 task_stack;
+    int                 task_prio;
+    int                 task_core;
+    int                 out_rb_size;
+    void                *data;
+    const char          *tag;
+    bool                stack_in_ext;
+    int                 multi_in_rb_num;
+    int                 multi_out_rb_num;
+} audio_element_cfg_t;
+
+#define DEFAULT_ELEMENT_RINGBUF_SIZE    (8*1024)
+#define DEFAULT_ELEMENT_BUFFER_LENGTH   (1024)
+#define DEFAULT_ELEMENT_STACK_SIZE      (2*1024)
+#define DEFAULT_ELEMENT_TASK_PRIO       (5)
+#define DEFAULT_ELEMENT_TASK_CORE       (0)
+
+#define DEFAULT_AUDIO_ELEMENT_CONFIG() {\
+    .buffer_len         = DEFAULT_ELEMENT_BUFFER_LENGTH,\
+    .task_stack         = DEFAULT_ELEMENT_STACK_SIZE,\
+    .task_prio          = DEFAULT_ELEMENT_TASK_PRIO,\
+    .task_core          = DEFAULT_ELEMENT_TASK_CORE,\
+    .out_rb_size        = DEFAULT_ELEMENT_RINGBUF_SIZE,\
+}
+
+audio_element_handle_t audio_element_init(audio_element_cfg_t *config);
+esp_err_t audio_element_deinit(audio_element_handle_t el);
+
+esp_err_t audio_element_setdata(audio_element_handle_t el, void *data);
+void *audio_element_getdata(audio_element_handle_t el);
+
+esp_err_t audio_element_set_input_ringbuf(audio_element_handle_t el, ringbuf_handle_t rb);
+ringbuf_handle_t audio_element_get_input_ringbuf(audio_element_handle_t el);
+esp_err_t audio_element_set_output_ringbuf(audio_element_handle_t el, ringbuf_handle_t rb);
+ringbuf_handle_t audio_element_get_output_ringbuf(audio_element_handle_t el);
+
+// Start the element task, and stop it by aborting its ringbuffers and joining it
+esp_err_t audio_element_run(audio_element_handle_t el);
+esp_err_t audio_element_stop(audio_element_handle_t el);
+
+audio_element_state_t audio_element_get_state(audio_element_handle_t el);
+
+audio_element_err_t audio_element_input(audio_element_handle_t el, char *buffer, int wanted_size);
+audio_element_err_t audio_element_output(audio_element_handle_t el, char *buffer, int write_size);
+
+esp_err_t audio_element_update_byte_pos(audio_element_handle_t el, int pos);
+esp_err_t audio_element_set_byte_pos(audio_element_handle_t el, int64_t pos);
+int64_t audio_element_get_byte_pos(audio_element_handle_t el);
+esp_err_t audio_element_set_total_bytes(audio_element_handle_t el, int64_t total_bytes);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SIM_AUDIO_ELEMENT_H_ */
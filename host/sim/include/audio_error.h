@@ -0,0 +1,25 @@
+/*
+ * audio_error.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: xenir
+ */
+
+// Host simulator stand-in for the ESP-ADF error helpers
+
+#ifndef SIM_AUDIO_ERROR_H_
+#define SIM_AUDIO_ERROR_H_
+
+#include "esp_log.h"
+
+#define AUDIO_MEM_CHECK(TAG, a, action) if (!(a)) {                 \
+        ESP_LOGE(TAG, "%s:%d (%s): %s", __FILE__, __LINE__, __FUNCTION__, "Memory exhausted"); \
+        action;                                                     \
+        }
+
+#define AUDIO_NULL_CHECK(TAG, a, action) if (!(a)) {                \
+        ESP_LOGE(TAG, "%s:%d (%s): %s", __FILE__, __LINE__, __FUNCTION__, "Got NULL Pointer"); \
+        action;                                                     \
+        }
+
+#endif /* SIM_AUDIO_ERROR_H_ */
@@ -0,0 +1,20 @@
+/*
+ * audio_mem.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: xenir
+ */
+
+// Host simulator stand-in for the ESP-ADF allocator
+
+#ifndef SIM_AUDIO_MEM_H_
+#define SIM_AUDIO_MEM_H_
+
+#include <stdlib.h>
+
+#define audio_malloc(size)          malloc(size)
+#define audio_calloc(n, size)       calloc(n, size)
+#define audio_realloc(ptr, size)    realloc(ptr, size)
+#define audio_free(ptr)             free(ptr)
+
+#endif /* SIM_AUDIO_MEM_H_ */
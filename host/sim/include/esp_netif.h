@@ -0,0 +1,13 @@
+/*
+ * esp_netif.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: xenir
+ */
+
+// Host simulator stand-in: included by the server headers, nothing used
+
+#ifndef SIM_ESP_NETIF_H_
+#define SIM_ESP_NETIF_H_
+
+#endif /* SIM_ESP_NETIF_H_ */
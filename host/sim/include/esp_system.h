@@ -0,0 +1,18 @@
+/*
+ * esp_system.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: xenir
+ */
+
+// Host simulator stand-in
+
+#ifndef SIM_ESP_SYSTEM_H_
+#define SIM_ESP_SYSTEM_H_
+
+#include <stdint.h>
+#include "esp_err.h"
+
+uint32_t esp_random(void);
+
+#endif /* SIM_ESP_SYSTEM_H_ */
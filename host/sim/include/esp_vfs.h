@@ -0,0 +1,33 @@
+/*
+ * esp_vfs.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: xenir
+ */
+
+// Host simulator stand-in: the path limits the file server sizes its
+// buffers with. Files are looked up on the host under the same base path.
+
+#ifndef SIM_ESP_VFS_H_
+#define SIM_ESP_VFS_H_
+
+#include <string.h>
+
+#define ESP_VFS_PATH_MAX                15
+#define CONFIG_SPIFFS_OBJ_NAME_LEN      32
+
+// newlib has strlcpy, glibc only from 2.38
+#if defined(__GLIBC__) && !( __GLIBC__ > 2 || ( __GLIBC__ == 2 && __GLIBC_MINOR__ >= 38 ) )
+static inline size_t strlcpy( char *dst, const char *src, size_t size )
+{
+    size_t len = strlen( src );
+    if ( size ) {
+        size_t n = len < size - 1 ? len : size - 1;
+        memcpy( dst, src, n );
+        dst[n] = 0;
+    }
+    return len;
+}
+#endif
+
+#endif /* SIM_ESP_VFS_H_ */
@@ -0,0 +1,40 @@
+/*
+ * FreeRTOS.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: xenir
+ */
+
+// Host simulator stand-in: FreeRTOS types on top of pthreads
+
+#ifndef SIM_FREERTOS_H_
+#define SIM_FREERTOS_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <pthread.h>
+
+typedef uint32_t TickType_t;
+typedef int BaseType_t;
+typedef unsigned UBaseType_t;
+
+#define configTICK_RATE_HZ      100
+#define portTICK_PERIOD_MS      ( 1000 / configTICK_RATE_HZ )
+#define portMAX_DELAY           ( (TickType_t) 0xffffffffUL )
+#define pdMS_TO_TICKS(ms)       ( (TickType_t) ( (uint64_t) (ms) * configTICK_RATE_HZ / 1000 ) )
+#define portNUM_PROCESSORS      2
+
+// Host threads are not tied to a core, everything is reported on core 0
+static inline BaseType_t xPortGetCoreID(void) { return 0; }
+
+#define pdFALSE                 0
+#define pdTRUE                  1
+#define pdFAIL                  pdFALSE
+#define pdPASS                  pdTRUE
+
+// Spinlocks become mutexes, which is all a critical section needs here
+typedef pthread_mutex_t portMUX_TYPE;
+#define portMUX_INITIALIZER_UNLOCKED    PTHREAD_MUTEX_INITIALIZER
+
+#endif /* SIM_FREERTOS_H_ */
@@ -0,0 +1,17 @@
+/*
+ * event_groups.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: xenir
+ */
+
+// Host simulator stand-in: nothing in the simulated code uses event groups
+
+#ifndef SIM_FREERTOS_EVENT_GROUPS_H_
+#define SIM_FREERTOS_EVENT_GROUPS_H_
+
+#include "FreeRTOS.h"
+
+typedef uint32_t EventBits_t;
+
+#endif /* SIM_FREERTOS_EVENT_GROUPS_H_ */
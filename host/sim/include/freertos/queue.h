@@ -0,0 +1,22 @@
+/*
+ * queue.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: xenir
+ */
+
+// Host simulator stand-in: copying queues on a mutex and two conditions
+
+#ifndef SIM_FREERTOS_QUEUE_H_
+#define SIM_FREERTOS_QUEUE_H_
+
+#include "FreeRTOS.h"
+
+typedef struct sim_queue *QueueHandle_t;
+
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t item_size);
+BaseType_t xQueueSend(QueueHandle_t queue, const void *item, TickType_t ticks);
+BaseType_t xQueueReceive(QueueHandle_t queue, void *item, TickType_t ticks);
+void vQueueDelete(QueueHandle_t queue);
+
+#endif /* SIM_FREERTOS_QUEUE_H_ */
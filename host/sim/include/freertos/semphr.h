@@ -0,0 +1,22 @@
+/*
+ * semphr.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: xenir
+ */
+
+// Host simulator stand-in: mutexes only
+
+#ifndef SIM_FREERTOS_SEMPHR_H_
+#define SIM_FREERTOS_SEMPHR_H_
+
+#include "FreeRTOS.h"
+
+typedef struct sim_mutex *SemaphoreHandle_t;
+
+SemaphoreHandle_t xSemaphoreCreateMutex(void);
+BaseType_t xSemaphoreTake(SemaphoreHandle_t sem, TickType_t ticks);
+BaseType_t xSemaphoreGive(SemaphoreHandle_t sem);
+void vSemaphoreDelete(SemaphoreHandle_t sem);
+
+#endif /* SIM_FREERTOS_SEMPHR_H_ */
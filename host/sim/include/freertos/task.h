@@ -0,0 +1,32 @@
+/*
+ * task.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: xenir
+ */
+
+// Host simulator stand-in: tasks are detached pthreads, priorities and core
+// affinity are ignored
+
+#ifndef SIM_FREERTOS_TASK_H_
+#define SIM_FREERTOS_TASK_H_
+
+#include "FreeRTOS.h"
+
+typedef void (*TaskFunction_t)(void *);
+typedef struct sim_task *TaskHandle_t;
+
+#define tskNO_AFFINITY          0x7FFFFFFF
+
+BaseType_t xTaskCreate(TaskFunction_t fn, const char *name, uint32_t stack, void *arg, UBaseType_t prio, TaskHandle_t *handle);
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t fn, const char *name, uint32_t stack, void *arg, UBaseType_t prio, TaskHandle_t *handle, BaseType_t core);
+void vTaskDelete(TaskHandle_t task);
+void vTaskDelay(TickType_t ticks);
+void vTaskDelayUntil(TickType_t *wake, TickType_t period);
+TickType_t xTaskGetTickCount(void);
+TaskHandle_t xTaskGetCurrentTaskHandle(void);
+
+#define taskENTER_CRITICAL(mux)     pthread_mutex_lock( mux )
+#define taskEXIT_CRITICAL(mux)      pthread_mutex_unlock( mux )
+
+#endif /* SIM_FREERTOS_TASK_H_ */
@@ -0,0 +1,29 @@
+/*
+ * http_parser.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: xenir
+ */
+
+// Host simulator stand-in: only the URL result type, which the server code
+// mirrors in its copy of the private request structure
+
+#ifndef SIM_HTTP_PARSER_H_
+#define SIM_HTTP_PARSER_H_
+
+#include <stdint.h>
+
+enum http_parser_url_fields {
+    UF_SCHEMA, UF_HOST, UF_PORT, UF_PATH, UF_QUERY, UF_FRAGMENT, UF_USERINFO, UF_MAX
+};
+
+struct http_parser_url {
+    uint16_t field_set;
+    uint16_t port;
+    struct {
+        uint16_t off;
+        uint16_t len;
+    } field_data[UF_MAX];
+};
+
+#endif /* SIM_HTTP_PARSER_H_ */
@@ -0,0 +1,13 @@
+/*
+ * nvs_flash.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: xenir
+ */
+
+// Host simulator stand-in: included by the server headers, nothing used
+
+#ifndef SIM_NVS_FLASH_H_
+#define SIM_NVS_FLASH_H_
+
+#endif /* SIM_NVS_FLASH_H_ */
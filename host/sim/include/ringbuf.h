@@ -0,0 +1,40 @@
+/*
+ * ringbuf.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: xenir
+ */
+
+// Host simulator stand-in for the ESP-ADF ringbuffer: a byte FIFO with
+// blocking reads and writes
+
+#ifndef SIM_RINGBUF_H_
+#define SIM_RINGBUF_H_
+
+#include "freertos/FreeRTOS.h"
+
+#define RB_OK           (0)
+#define RB_FAIL         (-1)
+#define RB_DONE         (-2)
+#define RB_ABORT        (-3)
+#define RB_TIMEOUT      (-4)
+
+typedef struct ringbuf *ringbuf_handle_t;
+
+ringbuf_handle_t rb_create(int block_size, int n_blocks);
+void rb_destroy(ringbuf_handle_t rb);
+
+// Both block until all of "len" is transferred, the ticks run out (returning
+// what was transferred, or RB_TIMEOUT if nothing was) or the buffer is
+// aborted. A read of a done buffer returns what is left, then RB_DONE
+int rb_write(ringbuf_handle_t rb, char *buf, int len, TickType_t ticks_to_wait);
+int rb_read(ringbuf_handle_t rb, char *buf, int len, TickType_t ticks_to_wait);
+
+int rb_bytes_filled(ringbuf_handle_t rb);
+int rb_bytes_available(ringbuf_handle_t rb);
+int rb_get_size(ringbuf_handle_t rb);
+void rb_reset(ringbuf_handle_t rb);
+void rb_done_write(ringbuf_handle_t rb);
+void rb_abort(ringbuf_handle_t rb);
+
+#endif /* SIM_RINGBUF_H_ */
@@ -0,0 +1,17 @@
+/*
+ * sdkconfig.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: xenir
+ */
+
+// Host simulator stand-in: the menuconfig options the simulated code reads.
+// Tracing is on so /trace can be tried without a board.
+
+#ifndef SIM_SDKCONFIG_H_
+#define SIM_SDKCONFIG_H_
+
+#define CONFIG_STREAMING_TRACE              1
+#define CONFIG_STREAMING_TRACE_EVENTS       1024
+
+#endif /* SIM_SDKCONFIG_H_ */
@@ -0,0 +1,15 @@
+/*
+ * unistd.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: xenir
+ */
+
+// newlib has sys/unistd.h, glibc only unistd.h
+
+#ifndef SIM_SYS_UNISTD_H_
+#define SIM_SYS_UNISTD_H_
+
+#include <unistd.h>
+
+#endif /* SIM_SYS_UNISTD_H_ */
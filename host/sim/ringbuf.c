@@ -0,0 +1,197 @@
+/*
+ * ringbuf.c
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: xenir
+ */
+
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+
+#include "ringbuf.h"
+
+struct ringbuf {
+    pthread_mutex_t lock;
+    pthread_cond_t  can_read;
+    pthread_cond_t  can_write;
+    char*           buf;
+    int             size;
+    int             head;           // Next byte written
+    int             fill;
+    bool            done;
+    bool            aborted;
+};
+
+ringbuf_handle_t rb_create(int block_size, int n_blocks)
+{
+    struct ringbuf* rb = calloc( 1, sizeof(struct ringbuf) );
+    if ( !rb )
+        return NULL;
+
+    rb->size = block_size * n_blocks;
+    rb->buf = malloc( rb->size );
+    if ( !rb->buf ) {
+        free( rb );
+        return NULL;
+    }
+
+    pthread_mutex_init( &rb->lock, NULL );
+    pthread_cond_init( &rb->can_read, NULL );
+    pthread_cond_init( &rb->can_write, NULL );
+    return rb;
+}
+
+void rb_destroy(ringbuf_handle_t rb)
+{
+    pthread_mutex_destroy( &rb->lock );
+    pthread_cond_destroy( &rb->can_read );
+    pthread_cond_destroy( &rb->can_write );
+    free( rb->buf );
+    free( rb );
+}
+
+static void _deadline( struct timespec* ts, TickType_t ticks )
+{
+    clock_gettime( CLOCK_REALTIME, ts );
+    int64_t ns = ts->tv_nsec + (int64_t) ticks * portTICK_PERIOD_MS * 1000000;
+    ts->tv_sec += ns / 1000000000;
+    ts->tv_nsec = ns % 1000000000;
+}
+
+// Waits on "cond" with the lock held. Returns false once the deadline passes
+static bool _wait( ringbuf_handle_t rb, pthread_cond_t* cond, TickType_t ticks, const struct timespec* deadline )
+{
+    if ( ticks == portMAX_DELAY )
+        return pthread_cond_wait( cond, &rb->lock ) == 0;
+    if ( ticks == 0 )
+        return false;
+    return pthread_cond_timedwait( cond, &rb->lock, deadline ) == 0;
+}
+
+int rb_write(ringbuf_handle_t rb, char *buf, int len, TickType_t ticks_to_wait)
+{
+    struct timespec deadline;
+    _deadline( &deadline, ticks_to_wait );
+
+    int written = 0;
+    pthread_mutex_lock( &rb->lock );
+
+    while ( written < len ) {
+
+        if ( rb->aborted ) {
+            written = RB_ABORT;
+            break;
+        }
+
+        int n = rb->size - rb->fill;
+        if ( n == 0 ) {
+            if ( !_wait( rb, &rb->can_write, ticks_to_wait, &deadline ) && rb->fill == rb->size )
+                break;
+            continue;
+        }
+
+        if ( n > len - written )
+            n = len - written;
+        if ( n > rb->size - rb->head )
+            n = rb->size - rb->head;
+
+        memcpy( rb->buf + rb->head, buf + written, n );
+        rb->head = ( rb->head + n ) % rb->size;
+        rb->fill += n;
+        written += n;
+        pthread_cond_signal( &rb->can_read );
+    }
+
+    pthread_mutex_unlock( &rb->lock );
+    return written == 0 && len > 0 ? RB_TIMEOUT : written;
+}
+
+int rb_read(ringbuf_handle_t rb, char *buf, int len, TickType_t ticks_to_wait)
+{
+    struct timespec deadline;
+    _deadline( &deadline, ticks_to_wait );
+
+    int read = 0;
+    pthread_mutex_lock( &rb->lock );
+
+    while ( read < len ) {
+
+        if ( rb->aborted ) {
+            read = RB_ABORT;
+            break;
+        }
+
+        if ( rb->fill == 0 ) {
+            if ( rb->done ) {
+                if ( read == 0 )
+                    read = RB_DONE;
+                break;
+            }
+            if ( !_wait( rb, &rb->can_read, ticks_to_wait, &deadline ) && rb->fill == 0 )
+                break;
+            continue;
+        }
+
+        int tail = ( rb->head - rb->fill + rb->size ) % rb->size;
+        int n = rb->fill;
+        if ( n > len - read )
+            n = len - read;
+        if ( n > rb->size - tail )
+            n = rb->size - tail;
+
+        memcpy( buf + read, rb->buf + tail, n );
+        rb->fill -= n;
+        read += n;
+        pthread_cond_signal( &rb->can_write );
+    }
+
+    pthread_mutex_unlock( &rb->lock );
+    return read == 0 && len > 0 ? RB_TIMEOUT : read;
+}
+
+int rb_bytes_filled(ringbuf_handle_t rb)
+{
+    pthread_mutex_lock( &rb->lock );
+    int fill = rb->fill;
+    pthread_mutex_unlock( &rb->lock );
+    return fill;
+}
+
+int rb_bytes_available(ringbuf_handle_t rb)
+{
+    return rb->size - rb_bytes_filled( rb );
+}
+
+int rb_get_size(ringbuf_handle_t rb)
+{
+    return rb->size;
+}
+
+void rb_reset(ringbuf_handle_t rb)
+{
+    pthread_mutex_lock( &rb->lock );
+    rb->head = rb->fill = 0;
+    rb->done = rb->aborted = false;
+    pthread_cond_broadcast( &rb->can_write );
+    pthread_mutex_unlock( &rb->lock );
+}
+
+void rb_done_write(ringbuf_handle_t rb)
+{
+    pthread_mutex_lock( &rb->lock );
+    rb->done = true;
+    pthread_cond_broadcast( &rb->can_read );
+    pthread_mutex_unlock( &rb->lock );
+}
+
+void rb_abort(ringbuf_handle_t rb)
+{
+    pthread_mutex_lock( &rb->lock );
+    rb->aborted = true;
+    pthread_cond_broadcast( &rb->can_read );
+    pthread_cond_broadcast( &rb->can_write );
+    pthread_mutex_unlock( &rb->lock );
+}
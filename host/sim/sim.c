@@ -0,0 +1,372 @@
+/*
+ * sim.c
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: xenir
+ */
+
+// Runs the HTTP streaming sink on a host against the stand-ins in this
+// directory. A synthetic I2S source writes stereo 16 bit audio into the
+// sink's input ringbuffer in real time, the sink serves it on /stream just
+// as it does on the board, and once a second the source rate, the bytes
+// sent, the ringbuffer fill (the capture to send latency) and the source
+// overruns are printed. With --fast the source is not paced, so the line
+// shows how far the sink can run ahead of real time.
+//
+//   host/build/sim --seconds 30 &
+//   curl -s localhost:8080/stream -o out.wav
+//
+// /command?cmd=probe adds latency probe markers to the source the same way
+// the board's mixer does, so host/probe can be tried against the sim.
+//
+// /capture records the synthetic source as an I2S trace, as on the board,
+// and --replay FILE feeds one to the sink through the replay element in place
+// of the synthetic source, once through, at its captured pacing or, with
+// --fast, as fast as the sink takes it:
+//
+//   curl -s 'localhost:8080/capture?seconds=30' -o input.i2st
+//   host/build/sim --replay input.i2st --fast --seconds 10
+//
+// --server runs the standalone tone server (streaming_server.c) instead.
+// Either way the stream is served by the file server in webserver.c, which
+// asks for port 80 and gets --port; --alias adds the port redirect.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <math.h>
+#include <unistd.h>
+
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "ringbuf.h"
+#include "streaming_http_audio.h"
+#include "streaming_server.h"
+#include "webserver.h"
+#include "trace.h"
+#include "probe.h"
+#include "i2s_capture.h"
+#include "i2s_replay.h"
+
+static const char *TAG = "sim";
+
+#define SOURCE_FRAMES		256				// One I2S DMA buffer
+#define TONE_HZ				440
+#define TONE_LEVEL			0.25f			// -12 dBFS
+#define NOISE_LEVEL			0.001f			// -60 dBFS
+#define BURST_MS			1000			// Tone on, then off, for this long
+
+typedef struct {
+    int				port;
+    int				alias;
+    int				sample_rate;
+    int				seconds;				// 0 runs until interrupted
+    bool			fast;
+    bool			dtx;
+    bool			drift;
+    bool			server;
+    const char*		replay;
+} sim_args_t;
+
+typedef struct {
+    ringbuf_handle_t	rb;
+    int					sample_rate;
+    bool				fast;
+    i2s_capture_handle_t	capture;
+    volatile bool		run;
+    volatile uint64_t	bytes;
+    volatile uint64_t	overrun_bytes;
+    volatile uint32_t	overruns;
+} source_t;
+
+static volatile bool stop;
+static probe_t probe;
+
+static void _on_signal( int sig )
+{
+    stop = true;
+}
+
+// Only cmd=probe, with fire and period as on the board
+
+static void _command( const char* command, char* response )
+{
+    char cmd[16], val[16];
+
+    if ( httpd_query_key_value( command, "cmd", cmd, sizeof(cmd) ) != ESP_OK || strcmp( cmd, "probe" ) != 0 ) {
+        snprintf( response, WEBSERVER_COMMAND_RESPONSE_SIZE, "Only cmd=probe in the simulator" );
+        return;
+    }
+
+    int64_t now = esp_timer_get_time();
+
+    if ( httpd_query_key_value( command, "period", val, sizeof(val) ) == ESP_OK )
+        probe_set_period( &probe, atoi( val ) );
+    if ( httpd_query_key_value( command, "fire", val, sizeof(val) ) == ESP_OK && atoi( val ) )
+        probe_fire( &probe );
+
+    snprintf( response, WEBSERVER_COMMAND_RESPONSE_SIZE,
+            "attached=1 period=%d requested=%u markers=%u rate=%d chirp=%d-%dHz/%dms time_us=%lld",
+            probe.period_ms, probe.requested, probe.markers, probe.sample_rate,
+            PROBE_F0_HZ, PROBE_F1_HZ, PROBE_MS, (long long) now );
+}
+
+static int _start_webserver( const sim_args_t* args )
+{
+    sim_httpd_port_80 = args->port;
+
+    if ( start_webserver( "/spiffs", _command ) != ESP_OK )
+        return -1;
+    if ( args->alias && webserver_start_alias( args->alias ) != ESP_OK )
+        return -1;
+    return trace_register() == ESP_OK ? 0 : -1;
+}
+
+// Writes like the I2S reader: one DMA buffer at a time, and a buffer that
+// does not fit is lost, as the DMA would overwrite it
+
+static void _source_task( void* arg )
+{
+    source_t* src = (source_t*) arg;
+    int16_t buf[SOURCE_FRAMES * 2];
+    int16_t marker[SOURCE_FRAMES];
+    double phase = 0, step = 2 * M_PI * TONE_HZ / src->sample_rate;
+    int64_t frames = 0, start = esp_timer_get_time();
+
+    while ( src->run ) {
+
+        probe_read( &probe, marker, SOURCE_FRAMES );
+
+        for ( int i = 0 ; i < SOURCE_FRAMES ; i++, frames++ ) {
+            bool on = ( frames * 1000 / src->sample_rate / BURST_MS ) % 2 == 0;
+            float noise = NOISE_LEVEL * ( 2.0f * rand() / RAND_MAX - 1.0f );
+            float s = ( on ? TONE_LEVEL * sinf( phase ) : 0 ) + noise + marker[i] / 32767.0f;
+            buf[2*i] = buf[2*i+1] = s * 32767;
+            phase += step;
+        }
+        phase = fmod( phase, 2 * M_PI );
+
+        int len = sizeof(buf);
+        i2s_capture_write( (char*) buf, len, src->capture );
+
+        int n = rb_write( src->rb, (char*) buf, len, src->fast ? portMAX_DELAY : 0 );
+        if ( n == RB_ABORT )
+            break;
+        if ( n < 0 )
+            n = 0;
+        if ( n < len ) {
+            src->overruns++;
+            src->overrun_bytes += len - n;
+        }
+        src->bytes += len;
+
+        if ( !src->fast ) {
+            int64_t due = start + frames * 1000000 / src->sample_rate;
+            int64_t wait = due - esp_timer_get_time();
+            if ( wait > 0 )
+                usleep( wait );
+        }
+    }
+}
+
+// The sink takes what the sim source writes, so only a trace in that
+// format can stand in for it
+
+static audio_element_handle_t _replay_init( const sim_args_t* args, int* sample_rate )
+{
+    i2s_replay_cfg_t cfg = DEFAULT_I2S_REPLAY_CONFIG();
+    cfg.path = args->replay;
+    cfg.fast = args->fast;
+    cfg.loop = false;
+
+    audio_element_handle_t replay = i2s_replay_init( &cfg );
+    if ( !replay )
+        return NULL;
+
+    int bits, channels;
+    i2s_replay_get_format( replay, sample_rate, &bits, &channels );
+    if ( bits != 16 || channels != 2 ) {
+        ESP_LOGE(TAG, "%s is %d bit %d channel, the sink takes 16 bit stereo", args->replay, bits, channels);
+        audio_element_deinit( replay );
+        return NULL;
+    }
+    return replay;
+}
+
+static uint64_t _source_bytes( const source_t* src, audio_element_handle_t replay )
+{
+    i2s_replay_stats_t stats;
+
+    if ( !replay )
+        return src->bytes;
+    i2s_replay_get_stats( replay, &stats );
+    return stats.bytes;
+}
+
+static int _run_pipeline( const sim_args_t* args )
+{
+    streaming_http_audio_cfg_t sha_cfg = DEFAULT_STREAMING_HTTP_AUDIO_CONFIG();
+    audio_element_handle_t replay = NULL;
+    int sample_rate = args->sample_rate;
+
+    if ( args->replay && !( replay = _replay_init( args, &sample_rate ) ) )
+        return 1;
+
+    sha_cfg.pool = block_pool_create("audio", STREAMING_HTTP_AUDIO_POOL_BLOCK, 3);
+    sha_cfg.sample_rate = sample_rate;
+    sha_cfg.dtx.enable = args->dtx;
+    sha_cfg.drift.enable = args->drift;
+
+    audio_element_handle_t sink = streaming_http_audio_init(&sha_cfg);
+    if ( !sink || _start_webserver( args ) != 0 || streaming_http_audio_register( sink ) != ESP_OK )
+        return 1;
+
+    source_t src = {
+        .rb = rb_create(sha_cfg.out_rb_size, 1),
+        .sample_rate = sample_rate,
+        .fast = args->fast,
+        .capture = i2s_capture_init( sample_rate, 16, 2 ),
+        .run = true,
+    };
+    int frame_bytes = 2 * sizeof(int16_t);
+
+    if ( !src.capture || i2s_capture_register( src.capture ) != ESP_OK )
+        return 1;
+
+    probe_init( &probe, sample_rate );
+    audio_element_set_input_ringbuf(sink, src.rb);
+    if ( audio_element_run(sink) != ESP_OK )
+        return 1;
+
+    if ( replay ) {
+        audio_element_set_output_ringbuf( replay, src.rb );
+        if ( audio_element_run( replay ) != ESP_OK )
+            return 1;
+    } else if ( xTaskCreate(_source_task, "source", 4096, &src, 5, NULL) != pdPASS ) {
+        return 1;
+    }
+
+    ESP_LOGI(TAG, "Streaming %d Hz%s%s on http://localhost:%d/stream%s", sample_rate,
+            replay ? " from " : "", replay ? args->replay : "", args->port, args->fast ? ", unpaced" : "");
+    printf("    t  in kB/s  x realtime  sent kB/s  blocks  speech  fill ms  overruns  block ms  rate %%\n");
+
+    streaming_http_audio_stats_t prev = {0}, stats;
+    latency_t latency;
+    streaming_http_audio_stretch_t stretch;
+    uint64_t prev_in = 0;
+    int64_t prev_us = esp_timer_get_time();
+    int max_fill = 0;
+
+    for ( int t = 1 ; !stop && ( args->seconds == 0 || t <= args->seconds ) ; t++ ) {
+
+        if ( replay && audio_element_get_state( replay ) != AEL_STATE_RUNNING && rb_bytes_filled( src.rb ) == 0 )
+            break;
+
+        sleep( 1 );
+
+        int64_t now = esp_timer_get_time();
+        float secs = ( now - prev_us ) / 1e6f;
+        uint64_t in = _source_bytes( &src, replay );
+        int fill = rb_bytes_filled( src.rb );
+        streaming_http_audio_get_stats( sink, &stats );
+        streaming_http_audio_get_latency( sink, &latency );
+        streaming_http_audio_get_stretch( sink, &stretch );
+
+        if ( fill > max_fill )
+            max_fill = fill;
+
+        printf( "%5d  %8.1f  %10.2f  %9.1f  %6u  %6u  %7d  %8u  %8d  %6d\n", t,
+                ( in - prev_in ) / 1024.0f / secs,
+                ( in - prev_in ) / (float) frame_bytes / sample_rate / secs,
+                ( stats.bytes_sent - prev.bytes_sent ) / 1024.0f / secs,
+                stats.blocks - prev.blocks,
+                stats.speech_blocks - prev.speech_blocks,
+                fill * 1000 / ( frame_bytes * sample_rate ),
+                src.overruns, latency.block_ms, stretch.pct );
+        fflush( stdout );
+
+        prev = stats;
+        prev_in = in;
+        prev_us = now;
+    }
+
+    src.run = false;
+    if ( replay ) {
+        i2s_replay_stats_t rs;
+        i2s_replay_get_stats( replay, &rs );
+        printf( "replayed %u blocks, %u loops, %u gaps, %u late (max %u us)\n",
+                rs.blocks, rs.loops, rs.gaps, rs.late, rs.max_late_us );
+        audio_element_deinit( replay );
+    }
+    audio_element_deinit( sink );
+
+    printf( "in %llu bytes, sent %llu, suppressed %llu, dropped %llu, caught up %llu ms in %u catch-ups, overruns %u (%llu bytes), max fill %d ms\n",
+            (unsigned long long) _source_bytes( &src, replay ), (unsigned long long) stats.bytes_sent, (unsigned long long) stats.bytes_suppressed,
+            (unsigned long long) stats.bytes_dropped,
+            (unsigned long long) ( stretch.in_samples > stretch.out_samples ? ( stretch.in_samples - stretch.out_samples ) * 1000 / sample_rate : 0 ),
+            stretch.catchups,
+            src.overruns, (unsigned long long) src.overrun_bytes, max_fill * 1000 / ( frame_bytes * sample_rate ) );
+
+    return src.overruns && !args->fast ? 2 : 0;
+}
+
+static int _run_server( const sim_args_t* args )
+{
+    if ( _start_webserver( args ) != 0 || start_streaming_server() != ESP_OK )
+        return 1;
+
+    ESP_LOGI(TAG, "Tone server on http://localhost:%d/stream", args->port);
+    for ( int t = 0 ; !stop && ( args->seconds == 0 || t < args->seconds ) ; t++ )
+        sleep( 1 );
+    return 0;
+}
+
+static void _usage( const char* name )
+{
+    fprintf( stderr, "usage: %s [--port N] [--alias N] [--rate HZ] [--seconds S] [--fast] [--dtx] [--drift] [--server] [--replay FILE] [--debug]\n", name );
+    exit( 1 );
+}
+
+int main( int argc, char** argv )
+{
+    sim_args_t args = {
+        .port = 8080,
+        .sample_rate = 16000,
+    };
+
+    for ( int i = 1 ; i < argc ; i++ ) {
+        if ( strcmp( argv[i], "--port" ) == 0 && i + 1 < argc )
+            args.port = atoi( argv[++i] );
+        else if ( strcmp( argv[i], "--alias" ) == 0 && i + 1 < argc )
+            args.alias = atoi( argv[++i] );
+        else if ( strcmp( argv[i], "--rate" ) == 0 && i + 1 < argc )
+            args.sample_rate = atoi( argv[++i] );
+        else if ( strcmp( argv[i], "--seconds" ) == 0 && i + 1 < argc )
+            args.seconds = atoi( argv[++i] );
+        else if ( strcmp( argv[i], "--fast" ) == 0 )
+            args.fast = true;
+        else if ( strcmp( argv[i], "--dtx" ) == 0 )
+            args.dtx = true;
+        else if ( strcmp( argv[i], "--drift" ) == 0 )
+            args.drift = true;
+        else if ( strcmp( argv[i], "--server" ) == 0 )
+            args.server = true;
+        else if ( strcmp( argv[i], "--replay" ) == 0 && i + 1 < argc )
+            args.replay = argv[++i];
+        else if ( strcmp( argv[i], "--debug" ) == 0 )
+            esp_log_level_set( "*", ESP_LOG_DEBUG );
+        else
+            _usage( argv[0] );
+    }
+
+    if ( args.sample_rate < 8000 || args.sample_rate > 48000 || args.port <= 0 )
+        _usage( argv[0] );
+
+    signal( SIGINT, _on_signal );
+    signal( SIGTERM, _on_signal );
+
+    return args.server ? _run_server( &args ) : _run_pipeline( &args );
+}
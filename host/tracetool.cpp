@@ -0,0 +1,291 @@
+/*
+ * tracetool.cpp
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: xenir
+ */
+
+// Inspects and converts the I2S traces of main/i2s_trace.h, as saved from
+// /capture on the board or the sim.
+//
+//   host/build/tracetool info input.i2st
+//   host/build/tracetool wav input.i2st input.wav
+//   host/build/tracetool from-wav speech.wav speech.i2st [--block BYTES]
+//
+// info prints the format, the blocks and the time they cover, and the
+// spread of the intervals between them, which is the I2S DMA pacing as the
+// capture saw it; gaps are where the capture lost blocks. wav writes the
+// audio alone for listening or for other tools. from-wav makes a trace of
+// a recording, in blocks of --block bytes (1024 by default, one DMA buffer
+// of 16 bit stereo) spaced at exactly their duration, for replaying
+// reference material.
+//
+// The exit status is 1 if a file cannot be read or written or is corrupt.
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "i2s_trace.h"
+#include "wav_header.h"
+
+namespace {
+
+int info(const char* path)
+{
+    i2s_trace_reader_t reader;
+    if (i2s_trace_open(&reader, path) != 0) {
+        fprintf(stderr, "%s is not a readable trace\n", path);
+        return 1;
+    }
+
+    const i2s_trace_header_t& h = reader.header;
+    int frame_bytes = h.bits / 8 * h.channels;
+
+    uint64_t bytes = 0, wall_us = 0;
+    uint32_t gaps = 0, min_us = UINT32_MAX, max_us = 0, min_len = UINT16_MAX, max_len = 0;
+    double sum = 0, sum2 = 0;
+    i2s_trace_record_t rec;
+    int r;
+
+    while ((r = i2s_trace_next(&reader, &rec)) == 1) {
+        bytes += rec.len;
+        min_len = std::min<uint32_t>(min_len, rec.len);
+        max_len = std::max<uint32_t>(max_len, rec.len);
+        if (rec.flags & I2S_TRACE_GAP)
+            gaps++;
+        if (reader.records == 1)
+            continue;
+        wall_us += rec.delta_us;
+        min_us = std::min(min_us, rec.delta_us);
+        max_us = std::max(max_us, rec.delta_us);
+        sum += rec.delta_us;
+        sum2 += (double) rec.delta_us * rec.delta_us;
+    }
+
+    uint32_t records = reader.records;
+    i2s_trace_close(&reader);
+
+    printf("format    %u Hz, %u bit, %u channel\n", h.sample_rate, h.bits, h.channels);
+    printf("blocks    %u, %u to %u bytes\n", records, records ? min_len : 0, max_len);
+    printf("audio     %.3f s (%llu bytes)\n", (double) bytes / frame_bytes / h.sample_rate, (unsigned long long) bytes);
+    printf("captured  %.3f s\n", wall_us / 1e6);
+
+    if (records > 1) {
+        double n = records - 1, mean = sum / n;
+        double sd = std::sqrt(std::max(0.0, sum2 / n - mean * mean));
+        printf("interval  mean %.0f us, sd %.0f us, min %u us, max %u us\n", mean, sd, min_us, max_us);
+    }
+    printf("gaps      %u\n", gaps);
+
+    if (r < 0) {
+        fprintf(stderr, "%s is corrupt after record %u\n", path, records);
+        return 1;
+    }
+    return 0;
+}
+
+void wav_header(wav_header_t* wav, uint32_t data_bytes, int sample_rate, int bits, int channels)
+{
+    memset(wav, 0, sizeof(*wav));
+    memcpy(&wav->riff.chunk_id, "RIFF", 4);
+    wav->riff.chunk_size = sizeof(wav_header_t) - 8 + data_bytes;
+    memcpy(&wav->riff.format, "WAVE", 4);
+    memcpy(&wav->fmt.chunk_id, "fmt ", 4);
+    wav->fmt.chunk_size = sizeof(chunk_fmt_t) - 8;
+    wav->fmt.audio_format = 1;
+    wav->fmt.num_of_channels = channels;
+    wav->fmt.samplerate = sample_rate;
+    wav->fmt.byterate = sample_rate * channels * bits / 8;
+    wav->fmt.block_align = channels * bits / 8;
+    wav->fmt.bits_per_sample = bits;
+    memcpy(&wav->data.chunk_id, "data", 4);
+    wav->data.chunk_size = data_bytes;
+}
+
+int to_wav(const char* path, const char* out_path)
+{
+    i2s_trace_reader_t reader;
+    if (i2s_trace_open(&reader, path) != 0) {
+        fprintf(stderr, "%s is not a readable trace\n", path);
+        return 1;
+    }
+
+    FILE* out = fopen(out_path, "wb");
+    if (!out) {
+        fprintf(stderr, "Cannot write %s\n", out_path);
+        i2s_trace_close(&reader);
+        return 1;
+    }
+
+    // Header rewritten with the length at the end
+    const i2s_trace_header_t& h = reader.header;
+    wav_header_t wav;
+    wav_header(&wav, 0, h.sample_rate, h.bits, h.channels);
+    fwrite(&wav, sizeof(wav), 1, out);
+
+    std::vector<char> buf(UINT16_MAX);
+    uint32_t bytes = 0;
+    i2s_trace_record_t rec;
+    int r;
+
+    while ((r = i2s_trace_next(&reader, &rec)) == 1) {
+        int n = i2s_trace_read(&reader, buf.data(), rec.len);
+        fwrite(buf.data(), 1, n, out);
+        bytes += n;
+    }
+
+    wav_header(&wav, bytes, h.sample_rate, h.bits, h.channels);
+    fseek(out, 0, SEEK_SET);
+    fwrite(&wav, sizeof(wav), 1, out);
+
+    bool ok = fclose(out) == 0 && r == 0;
+    i2s_trace_close(&reader);
+
+    if (r < 0)
+        fprintf(stderr, "%s is corrupt after record %u, wrote what came before\n", path, reader.records);
+    printf("%s: %u bytes of %u Hz %u bit %u channel\n", out_path, bytes, h.sample_rate, h.bits, h.channels);
+    return ok ? 0 : 1;
+}
+
+// Walks the chunks to "fmt " and "data", skipping any others (LIST and the
+// like) in between. Leaves the file at the start of the data
+
+bool read_wav(FILE* in, chunk_fmt_t* fmt, uint32_t* data_bytes)
+{
+    chunk_riff_t riff;
+    if (fread(&riff, sizeof(riff), 1, in) != 1 || memcmp(&riff.chunk_id, "RIFF", 4) || memcmp(&riff.format, "WAVE", 4))
+        return false;
+
+    bool have_fmt = false;
+    for (;;) {
+        chunk_data_t chunk;
+        if (fread(&chunk, sizeof(chunk), 1, in) != 1)
+            return false;
+
+        if (!memcmp(&chunk.chunk_id, "data", 4)) {
+            *data_bytes = chunk.chunk_size;
+            return have_fmt;
+        }
+
+        long skip = chunk.chunk_size + (chunk.chunk_size & 1);
+        if (!memcmp(&chunk.chunk_id, "fmt ", 4) && chunk.chunk_size >= sizeof(chunk_fmt_t) - 8) {
+            fmt->chunk_id = chunk.chunk_id;
+            fmt->chunk_size = chunk.chunk_size;
+            if (fread(&fmt->audio_format, sizeof(chunk_fmt_t) - 8, 1, in) != 1)
+                return false;
+            skip -= sizeof(chunk_fmt_t) - 8;
+            have_fmt = true;
+        }
+        if (fseek(in, skip, SEEK_CUR) != 0)
+            return false;
+    }
+}
+
+int from_wav(const char* path, const char* out_path, int block)
+{
+    FILE* in = fopen(path, "rb");
+    if (!in) {
+        fprintf(stderr, "Cannot read %s\n", path);
+        return 1;
+    }
+
+    chunk_fmt_t fmt;
+    uint32_t data_bytes = 0;
+    i2s_trace_header_t h;
+
+    if (!read_wav(in, &fmt, &data_bytes) || fmt.audio_format != 1) {
+        fprintf(stderr, "%s is not a PCM WAV file\n", path);
+        fclose(in);
+        return 1;
+    }
+
+    i2s_trace_header_init(&h, fmt.samplerate, fmt.bits_per_sample, fmt.num_of_channels);
+    int frame_bytes = fmt.bits_per_sample / 8 * fmt.num_of_channels;
+    if (!i2s_trace_header_valid(&h) || block % frame_bytes) {
+        fprintf(stderr, "%s: %u Hz %u bit %u channel cannot be traced in %d byte blocks\n",
+                path, fmt.samplerate, fmt.bits_per_sample, fmt.num_of_channels, block);
+        fclose(in);
+        return 1;
+    }
+
+    FILE* out = fopen(out_path, "wb");
+    if (!out) {
+        fprintf(stderr, "Cannot write %s\n", out_path);
+        fclose(in);
+        return 1;
+    }
+    fwrite(&h, sizeof(h), 1, out);
+
+    // Deltas from the running frame count so the rounding does not add up
+    std::vector<char> buf(block);
+    uint64_t frames = 0, prev_us = 0;
+    uint32_t blocks = 0;
+    int n;
+
+    while (data_bytes && (n = fread(buf.data(), 1, std::min<uint32_t>(block, data_bytes), in)) > 0) {
+        n -= n % frame_bytes;
+        if (n == 0)
+            break;
+        uint64_t us = frames * 1000000 / h.sample_rate;
+        i2s_trace_record_t rec = { (uint32_t) (blocks ? us - prev_us : 0), (uint16_t) n, 0 };
+        fwrite(&rec, sizeof(rec), 1, out);
+        fwrite(buf.data(), 1, n, out);
+        prev_us = us;
+        frames += n / frame_bytes;
+        data_bytes -= n;
+        blocks++;
+    }
+
+    fclose(in);
+    if (fclose(out) != 0) {
+        fprintf(stderr, "Cannot write %s\n", out_path);
+        return 1;
+    }
+    printf("%s: %u blocks, %.3f s of %u Hz %u bit %u channel\n", out_path, blocks,
+           (double) frames / h.sample_rate, h.sample_rate, h.bits, h.channels);
+    return 0;
+}
+
+void usage(const char* name)
+{
+    fprintf(stderr,
+        "usage: %s info TRACE\n"
+        "       %s wav TRACE OUT.wav\n"
+        "       %s from-wav IN.wav TRACE [--block BYTES]\n", name, name, name);
+    exit(2);
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    if (argc < 3)
+        usage(argv[0]);
+
+    std::string cmd = argv[1];
+
+    if (cmd == "info" && argc == 3)
+        return info(argv[2]);
+    if (cmd == "wav" && argc == 4)
+        return to_wav(argv[2], argv[3]);
+
+    if (cmd == "from-wav" && (argc == 4 || argc == 6)) {
+        int block = 1024;
+        if (argc == 6) {
+            if (strcmp(argv[4], "--block"))
+                usage(argv[0]);
+            block = atoi(argv[5]);
+        }
+        if (block <= 0 || block > UINT16_MAX)
+            usage(argv[0]);
+        return from_wav(argv[2], argv[3], block);
+    }
+
+    usage(argv[0]);
+}
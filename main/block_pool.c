@@ -0,0 +1,132 @@
+/*
+ * block_pool.c
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: xenir
+ */
+
+#include <string.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "esp_log.h"
+#include "audio_mem.h"
+#include "audio_error.h"
+
+#include "block_pool.h"
+
+static const char *TAG = "block_pool";
+
+// Free blocks are kept on a stack of indices, so get and put are a few
+// instructions under the lock and the most recently freed (cache warm)
+// block is reused first.
+
+struct block_pool {
+
+    const char*			name;
+    int					block_size;
+    int					count;
+    char*				mem;
+
+    SemaphoreHandle_t	lock;
+    uint16_t*			free;
+    int					num_free;
+    int					peak;
+    uint32_t			fails;
+};
+
+static block_pool_handle_t pools[BLOCK_POOL_MAX_POOLS];
+static int num_pools = 0;
+
+block_pool_handle_t block_pool_create(const char *name, int block_size, int count)
+{
+    if ( num_pools >= BLOCK_POOL_MAX_POOLS || count <= 0 || count > UINT16_MAX ) {
+        ESP_LOGE(TAG, "Cannot create pool %s", name);
+        return NULL;
+    }
+
+    struct block_pool* pool = audio_calloc( 1, sizeof(struct block_pool) );
+    AUDIO_MEM_CHECK(TAG, pool, {return NULL;});
+
+    pool->name = name;
+    pool->block_size = ( block_size + 3 ) & ~3;
+    pool->count = count;
+    pool->mem = audio_malloc( pool->block_size * count );
+    pool->free = audio_malloc( count * sizeof(uint16_t) );
+    pool->lock = xSemaphoreCreateMutex();
+    AUDIO_MEM_CHECK(TAG, pool->mem && pool->free && pool->lock, {
+        if (pool->lock) vSemaphoreDelete(pool->lock);
+        audio_free(pool->free); audio_free(pool->mem); audio_free(pool); return NULL;});
+
+    for ( int i = 0 ; i < count ; i++ )
+        pool->free[i] = count - 1 - i;
+    pool->num_free = count;
+
+    pools[num_pools++] = pool;
+
+    ESP_LOGI(TAG, "Pool %s: %d blocks of %d bytes", name, count, pool->block_size);
+    return pool;
+}
+
+void *block_pool_get(block_pool_handle_t pool)
+{
+    void* block = NULL;
+
+    xSemaphoreTake( pool->lock, portMAX_DELAY );
+
+    if ( pool->num_free > 0 ) {
+        block = pool->mem + pool->free[--pool->num_free] * pool->block_size;
+        int in_use = pool->count - pool->num_free;
+        if ( in_use > pool->peak )
+            pool->peak = in_use;
+    } else {
+        pool->fails++;
+    }
+
+    xSemaphoreGive( pool->lock );
+
+    if ( !block )
+        ESP_LOGW(TAG, "Pool %s exhausted", pool->name);
+
+    return block;
+}
+
+void block_pool_put(block_pool_handle_t pool, void *block)
+{
+    if ( !block )
+        return;
+
+    int index = ( (char*) block - pool->mem ) / pool->block_size;
+    if ( index < 0 || index >= pool->count ) {
+        ESP_LOGE(TAG, "Block %p does not belong to pool %s", block, pool->name);
+        return;
+    }
+
+    xSemaphoreTake( pool->lock, portMAX_DELAY );
+    pool->free[pool->num_free++] = index;
+    xSemaphoreGive( pool->lock );
+}
+
+int block_pool_block_size(block_pool_handle_t pool)
+{
+    return pool->block_size;
+}
+
+void block_pool_get_stats(block_pool_handle_t pool, block_pool_stats_t *stats)
+{
+    xSemaphoreTake( pool->lock, portMAX_DELAY );
+    stats->name = pool->name;
+    stats->block_size = pool->block_size;
+    stats->count = pool->count;
+    stats->in_use = pool->count - pool->num_free;
+    stats->peak = pool->peak;
+    stats->fails = pool->fails;
+    xSemaphoreGive( pool->lock );
+}
+
+int block_pool_list(block_pool_handle_t *list, int max)
+{
+    int n = num_pools < max ? num_pools : max;
+    memcpy( list, pools, n * sizeof(block_pool_handle_t) );
+    return n;
+}
@@ -0,0 +1,69 @@
+/*
+ * block_pool.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: xenir
+ */
+
+#ifndef MAIN_BLOCK_POOL_H_
+#define MAIN_BLOCK_POOL_H_
+
+#include <stdint.h>
+
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Fixed size blocks carved out of one allocation made at init, so buffers
+// that are taken and given back while streaming never touch the heap. A get
+// on an empty pool fails rather than falling back to malloc; the failure is
+// counted so undersized pools show up in /stats.
+
+#define BLOCK_POOL_MAX_POOLS	8
+
+typedef struct block_pool *block_pool_handle_t;
+
+typedef struct {
+    const char*				name;
+    int						block_size;
+    int						count;
+    int						in_use;
+    int						peak;			/*!< Most blocks ever in use at once */
+    uint32_t				fails;			/*!< Gets refused because the pool was empty */
+} block_pool_stats_t;
+
+/**
+ * @brief      Allocate "count" blocks of "block_size" bytes. Blocks are word
+ *             aligned. "name" must stay valid for the life of the pool
+ *
+ * @return     The pool handle or NULL
+ */
+block_pool_handle_t block_pool_create(const char *name, int block_size, int count);
+
+/**
+ * @brief      Take a block. Callable from any task
+ *
+ * @return     The block or NULL when the pool is empty
+ */
+void *block_pool_get(block_pool_handle_t pool);
+
+void block_pool_put(block_pool_handle_t pool, void *block);
+
+int block_pool_block_size(block_pool_handle_t pool);
+
+void block_pool_get_stats(block_pool_handle_t pool, block_pool_stats_t *stats);
+
+/**
+ * @brief      Every pool created so far, for reporting
+ *
+ * @return     The number of handles written to "pools"
+ */
+int block_pool_list(block_pool_handle_t *pools, int max);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* MAIN_BLOCK_POOL_H_ */
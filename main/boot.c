@@ -0,0 +1,245 @@
+/*
+ * boot.c
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: xenir
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/event_groups.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_http_server.h"
+
+#include "webserver.h"
+#include "boot.h"
+
+static const char *TAG = "boot";
+
+typedef enum {
+    BOOT_WAITING,
+    BOOT_RUNNING,
+    BOOT_OK,
+    BOOT_FAILED,
+    BOOT_SKIPPED
+} boot_status_t;
+
+typedef struct {
+    const boot_step_t*	step;
+    uint32_t			after;				// Bits of the steps waited for
+    volatile boot_status_t status;
+    int32_t				start_ms;
+    int32_t				end_ms;
+} boot_state_t;
+
+// Nothing here is freed: the report is served for the life of the program
+
+static struct {
+    boot_state_t		steps[BOOT_MAX_STEPS];
+    int					count;
+    EventGroupHandle_t	done;
+    uint32_t			failed;				// Bits of steps that failed or were skipped
+    int32_t				done_ms;
+
+    const char*			mark_name[BOOT_MAX_MARKS];
+    int32_t				mark_ms[BOOT_MAX_MARKS];
+    volatile int		marks;
+    portMUX_TYPE		mark_lock;
+} boot = { .mark_lock = portMUX_INITIALIZER_UNLOCKED };
+
+static const char* const status_names[] = { "waiting", "running", "ok", "failed", "skipped" };
+
+static int32_t _now_ms( void )
+{
+    return esp_timer_get_time() / 1000;
+}
+
+static void _step_task( void* arg )
+{
+    boot_state_t* st = (boot_state_t*) arg;
+    uint32_t bit = 1 << ( st - boot.steps );
+
+    if ( st->after )
+        xEventGroupWaitBits( boot.done, st->after, pdFALSE, pdTRUE, portMAX_DELAY );
+
+    st->start_ms = _now_ms();
+
+    if ( boot.failed & st->after ) {
+        st->status = BOOT_SKIPPED;
+    } else {
+        st->status = BOOT_RUNNING;
+        ESP_LOGI(TAG, "%s starting at %d ms", st->step->name, st->start_ms);
+        st->status = st->step->fn() == ESP_OK ? BOOT_OK : BOOT_FAILED;
+    }
+
+    st->end_ms = _now_ms();
+
+    if ( st->status != BOOT_OK ) {
+        ESP_LOGE(TAG, "%s %s", st->step->name, status_names[st->status]);
+        taskENTER_CRITICAL( &boot.mark_lock );
+        boot.failed |= bit;
+        taskEXIT_CRITICAL( &boot.mark_lock );
+    }
+
+    xEventGroupSetBits( boot.done, bit );
+    vTaskDelete( NULL );
+}
+
+static int _find( const boot_step_t* steps, int count, const char* name )
+{
+    for ( int i = 0 ; i < count ; i++ )
+        if ( strcmp( steps[i].name, name ) == 0 )
+            return i;
+    return -1;
+}
+
+static void _log_report( void )
+{
+    ESP_LOGI(TAG, "%-12s %8s %8s %8s  %s", "step", "start", "end", "ms", "status");
+    for ( int i = 0 ; i < boot.count ; i++ ) {
+        boot_state_t* st = &boot.steps[i];
+        ESP_LOGI(TAG, "%-12s %8d %8d %8d  %s", st->step->name, st->start_ms, st->end_ms,
+                st->end_ms - st->start_ms, status_names[st->status]);
+    }
+    for ( int i = 0 ; i < boot.marks ; i++ )
+        ESP_LOGI(TAG, "%-12s %8d", boot.mark_name[i], boot.mark_ms[i]);
+}
+
+esp_err_t boot_run(const boot_step_t *steps, int count)
+{
+    if ( count > BOOT_MAX_STEPS || boot.count )
+        return ESP_ERR_INVALID_ARG;
+
+    for ( int i = 0 ; i < count ; i++ ) {
+        boot.steps[i].step = &steps[i];
+        for ( int a = 0 ; a < BOOT_MAX_AFTER && steps[i].after[a] ; a++ ) {
+            int dep = _find( steps, count, steps[i].after[a] );
+            if ( dep < 0 || dep == i ) {
+                ESP_LOGE(TAG, "%s: bad dependency %s", steps[i].name, steps[i].after[a]);
+                return ESP_ERR_INVALID_ARG;
+            }
+            boot.steps[i].after |= 1 << dep;
+        }
+    }
+
+    // Any cycle would leave its steps waiting forever, so check the graph
+    // can be ordered before starting anything
+
+    uint32_t ordered = 0;
+    for ( bool progress = true ; progress ; ) {
+        progress = false;
+        for ( int i = 0 ; i < count ; i++ ) {
+            if ( !( ordered & ( 1 << i ) ) && ( boot.steps[i].after & ~ordered ) == 0 ) {
+                ordered |= 1 << i;
+                progress = true;
+            }
+        }
+    }
+    if ( ordered != ( 1u << count ) - 1 ) {
+        ESP_LOGE(TAG, "Dependency cycle among steps 0x%x", ( ( 1u << count ) - 1 ) & ~ordered);
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    boot.done = xEventGroupCreate();
+    if ( !boot.done )
+        return ESP_ERR_NO_MEM;
+    boot.count = count;
+
+    for ( int i = 0 ; i < count ; i++ ) {
+        int stack = steps[i].task_stack ? steps[i].task_stack : BOOT_TASK_STACK;
+        if ( xTaskCreate( _step_task, steps[i].name, stack, &boot.steps[i], BOOT_TASK_PRIO, NULL ) != pdPASS ) {
+            // Stand in for the missing task so its dependents do not hang
+            ESP_LOGE(TAG, "No task for %s", steps[i].name);
+            boot.steps[i].status = BOOT_FAILED;
+            taskENTER_CRITICAL( &boot.mark_lock );
+            boot.failed |= 1 << i;
+            taskEXIT_CRITICAL( &boot.mark_lock );
+            xEventGroupSetBits( boot.done, 1 << i );
+        }
+    }
+
+    xEventGroupWaitBits( boot.done, ( 1u << count ) - 1, pdFALSE, pdTRUE, portMAX_DELAY );
+    boot.done_ms = _now_ms();
+
+    _log_report();
+    return boot.failed ? ESP_FAIL : ESP_OK;
+}
+
+void boot_mark(const char *name)
+{
+    // Marks are only ever added, so the unlocked scan can only miss the
+    // newest ones, and those are checked again under the lock
+
+    int seen = boot.marks;
+    for ( int i = 0 ; i < seen ; i++ )
+        if ( strcmp( boot.mark_name[i], name ) == 0 )
+            return;
+
+    int32_t now = _now_ms();
+    bool added = false;
+
+    taskENTER_CRITICAL( &boot.mark_lock );
+    bool found = false;
+    for ( int i = seen ; i < boot.marks ; i++ )
+        found |= strcmp( boot.mark_name[i], name ) == 0;
+    if ( !found && boot.marks < BOOT_MAX_MARKS ) {
+        boot.mark_name[boot.marks] = name;
+        boot.mark_ms[boot.marks] = now;
+        boot.marks++;
+        added = true;
+    }
+    taskEXIT_CRITICAL( &boot.mark_lock );
+
+    if ( added )
+        ESP_LOGI(TAG, "%s at %d ms", name, now);
+}
+
+static esp_err_t _boot_handler( httpd_req_t *req )
+{
+    char buf[160];
+
+    httpd_resp_set_type(req, "application/json");
+    httpd_resp_set_hdr(req, "Cache-Control", "no-cache");
+
+    snprintf( buf, sizeof(buf), "{\"uptime_ms\":%d,\"done_ms\":%d,\"steps\":[", _now_ms(), boot.done_ms );
+    httpd_resp_sendstr_chunk(req, buf);
+
+    for ( int i = 0 ; i < boot.count ; i++ ) {
+
+        boot_state_t* st = &boot.steps[i];
+        char after[BOOT_MAX_AFTER * 16] = "";
+        int pos = 0;
+        for ( int a = 0 ; a < BOOT_MAX_AFTER && st->step->after[a] && pos < sizeof(after) ; a++ )
+            pos += snprintf( after + pos, sizeof(after) - pos, "%s%s", a ? " " : "", st->step->after[a] );
+
+        snprintf( buf, sizeof(buf), "%s{\"name\":\"%s\",\"after\":\"%s\",\"start\":%d,\"end\":%d,\"status\":\"%s\"}",
+                i ? "," : "", st->step->name, after, st->start_ms, st->end_ms, status_names[st->status] );
+        httpd_resp_sendstr_chunk(req, buf);
+    }
+
+    httpd_resp_sendstr_chunk(req, "],\"marks\":[");
+
+    for ( int i = 0 ; i < boot.marks ; i++ ) {
+        snprintf( buf, sizeof(buf), "%s{\"name\":\"%s\",\"at\":%d}", i ? "," : "", boot.mark_name[i], boot.mark_ms[i] );
+        httpd_resp_sendstr_chunk(req, buf);
+    }
+
+    httpd_resp_sendstr_chunk(req, "]}");
+    return httpd_resp_sendstr_chunk(req, NULL);
+}
+
+esp_err_t boot_register(void)
+{
+    httpd_uri_t report = {
+        .uri       = "/boot",
+        .method    = HTTP_GET,
+        .handler   = _boot_handler,
+        .user_ctx  = NULL
+    };
+
+    return webserver_register_uri_handler( &report );
+}
@@ -0,0 +1,71 @@
+/*
+ * boot.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: xenir
+ */
+
+#ifndef MAIN_BOOT_H_
+#define MAIN_BOOT_H_
+
+#include <stdint.h>
+
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Runs the init steps of app_main as a dependency graph. Every step gets
+// its own task which waits for the steps named in its "after" list, so
+// independent steps (mounting SPIFFS, associating with the AP, starting
+// the audio pipeline) overlap instead of queueing behind each other. A step
+// whose dependency failed is skipped rather than run.
+//
+// Start and end of every step and any milestones marked along the way (the
+// first audio block, say) are kept in ms since boot, logged once the graph
+// is done and served from /boot on the port 80 server:
+//
+//   {"uptime_ms":..,"done_ms":..,
+//    "steps":[{"name":"wifi","after":"nvs net","start":12,"end":2310,"status":"ok"},...],
+//    "marks":[{"name":"first_audio","at":402},...]}
+
+#define BOOT_MAX_STEPS			16
+#define BOOT_MAX_AFTER			4
+#define BOOT_MAX_MARKS			8
+#define BOOT_TASK_STACK			(4 * 1024)
+#define BOOT_TASK_PRIO			(5)
+
+typedef struct {
+    const char*			name;
+    esp_err_t			(*fn)(void);
+    const char*			after[BOOT_MAX_AFTER];		/*!< Steps that must finish first, unused entries NULL */
+    int					task_stack;					/*!< BOOT_TASK_STACK if 0 */
+} boot_step_t;
+
+/**
+ * @brief      Run the steps and wait for all of them. "steps" must stay
+ *             valid until this returns
+ *
+ * @return     ESP_OK if every step succeeded, ESP_ERR_INVALID_ARG for an
+ *             unknown dependency or a cycle (nothing is run), ESP_FAIL if
+ *             any step failed or was skipped
+ */
+esp_err_t boot_run(const boot_step_t *steps, int count);
+
+/**
+ * @brief      Record a milestone the first time it is reached. "name" must
+ *             stay valid. Callable from any task, cheap after the first call
+ */
+void boot_mark(const char *name);
+
+/**
+ * @brief      Register /boot. The web server must be running
+ */
+esp_err_t boot_register(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* MAIN_BOOT_H_ */
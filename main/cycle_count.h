@@ -0,0 +1,49 @@
+/*
+ * cycle_count.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: xenir
+ */
+
+#ifndef MAIN_CYCLE_COUNT_H_
+#define MAIN_CYCLE_COUNT_H_
+
+#include <stdint.h>
+
+// CPU cycle counter used to benchmark the audio processing stages. On the
+// ESP32 this is the CCOUNT register of the calling core. Host builds use
+// the TSC where there is one, otherwise nanoseconds, so host numbers are
+// only comparable with other host numbers.
+
+#ifdef ESP_PLATFORM
+
+#include "hal/cpu_hal.h"
+
+static inline uint32_t cycle_count_get(void)
+{
+    return cpu_hal_get_cycle_count();
+}
+
+#elif defined(__x86_64__) || defined(__i386__)
+
+#include <x86intrin.h>
+
+static inline uint32_t cycle_count_get(void)
+{
+    return (uint32_t) __rdtsc();
+}
+
+#else
+
+#include <time.h>
+
+static inline uint32_t cycle_count_get(void)
+{
+    struct timespec ts;
+    clock_gettime( CLOCK_MONOTONIC, &ts );
+    return (uint32_t) ( ts.tv_sec * 1000000000ULL + ts.tv_nsec );
+}
+
+#endif
+
+#endif /* MAIN_CYCLE_COUNT_H_ */
@@ -0,0 +1,302 @@
+/*
+ * denoise.c
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: xenir
+ */
+
+#include <string.h>
+#include <math.h>
+
+#include "denoise.h"
+
+#ifdef ESP_PLATFORM
+#include "esp_dsp.h"
+#endif
+
+#define N				DENOISE_FFT_SIZE
+#define SMOOTH			0.7f		// Power smoothing ahead of the minimum tracking
+#define NOISE_BIAS		1.5f		// Mean over minimum of the smoothed power of noise
+#define HEADROOM		0x3FFF		// Peak a block is normalised to before a transform
+
+#ifdef ESP_PLATFORM
+
+static int _fft_init( denoise_t* dn )
+{
+    // As in spectrum.c, the table is global and may already be there
+
+    esp_err_t ret = dsps_fft2r_init_sc16( NULL, CONFIG_DSP_MAX_FFT_SIZE );
+    return ( ret == ESP_OK || ret == ESP_ERR_DSP_REINITIALIZED ) ? 0 : -1;
+}
+
+// Forward transform in place, scaled by 1 / N: every stage halves
+
+static void _fft( denoise_t* dn, int16_t* d )
+{
+    dsps_fft2r_sc16( d, N );
+    dsps_bit_rev_sc16_ansi( d, N );
+}
+
+#else
+
+static int _fft_init( denoise_t* dn )
+{
+    for ( int k = 0 ; k < N / 2 ; k++ ) {
+        dn->twiddle[2*k] = (int16_t) lrintf( 32767 * cosf( 2 * M_PI * k / N ) );
+        dn->twiddle[2*k+1] = (int16_t) lrintf( -32767 * sinf( 2 * M_PI * k / N ) );
+    }
+    return 0;
+}
+
+// Iterative radix-2 decimation in time with the same halving per stage as
+// esp-dsp's, so both scale by 1 / N
+
+static void _fft( denoise_t* dn, int16_t* d )
+{
+    for ( int i = 1, j = 0 ; i < N ; i++ ) {
+        int bit = N >> 1;
+        for ( ; j & bit ; bit >>= 1 )
+            j ^= bit;
+        j ^= bit;
+        if ( i < j ) {
+            int16_t t;
+            t = d[2*i]; d[2*i] = d[2*j]; d[2*j] = t;
+            t = d[2*i+1]; d[2*i+1] = d[2*j+1]; d[2*j+1] = t;
+        }
+    }
+
+    for ( int len = 2 ; len <= N ; len <<= 1 ) {
+        int step = N / len;
+        for ( int i = 0 ; i < N ; i += len ) {
+            for ( int k = 0 ; k < len / 2 ; k++ ) {
+                int32_t wr = dn->twiddle[2*k*step], wi = dn->twiddle[2*k*step+1];
+                int16_t* a = &d[2*(i+k)];
+                int16_t* b = &d[2*(i+k+len/2)];
+                int32_t tr = ( b[0] * wr - b[1] * wi + 0x4000 ) >> 15;
+                int32_t ti = ( b[0] * wi + b[1] * wr + 0x4000 ) >> 15;
+                b[0] = ( a[0] - tr + 1 ) >> 1; b[1] = ( a[1] - ti + 1 ) >> 1;
+                a[0] = ( a[0] + tr + 1 ) >> 1; a[1] = ( a[1] + ti + 1 ) >> 1;
+            }
+        }
+    }
+}
+
+#endif
+
+// Left shift that brings "peak" closest to HEADROOM without passing it
+
+static int _norm( int32_t peak )
+{
+    int s = 0;
+    while ( s < 14 && ( peak << ( s + 1 ) ) <= HEADROOM )
+        s++;
+    return s;
+}
+
+static int16_t _sat16( int32_t v )
+{
+    return v > 32767 ? 32767 : ( v < -32768 ? -32768 : v );
+}
+
+static void _derive( denoise_t* dn )
+{
+    const denoise_params_t* p = &dn->params;
+    int atten = p->attenuation_db < 0 ? 0 : p->attenuation_db;
+    int alpha = p->smoothing_pct < 0 ? 0 : ( p->smoothing_pct > 99 ? 99 : p->smoothing_pct );
+
+    dn->floor = powf( 10, -atten / 20.0f );
+    dn->rise = powf( 10, p->noise_rise_db * (float) DENOISE_HOP / dn->sample_rate / 10 );
+    dn->alpha = alpha / 100.0f;
+}
+
+static void _clear( denoise_t* dn )
+{
+    memset( dn->in, 0, sizeof(dn->in) );
+    memset( dn->out, 0, sizeof(dn->out) );
+    memset( dn->ola, 0, sizeof(dn->ola) );
+    dn->pos = 0;
+}
+
+int denoise_init( denoise_t* dn, int sample_rate, int channels, const denoise_params_t* params )
+{
+    memset( dn, 0, sizeof(denoise_t) );
+    if ( channels < 1 || channels > DENOISE_MAX_CHANNELS || sample_rate <= 0 )
+        return -1;
+
+    dn->params = *params;
+    dn->sample_rate = sample_rate;
+
+    // Periodic square root Hann, sin( pi n / N ), whose squares sum to one
+    // at 50% overlap
+
+    for ( int n = 0 ; n < N ; n++ )
+        dn->window[n] = (int16_t) lrintf( 32767 * sinf( M_PI * n / N ) );
+    for ( int k = 0 ; k < DENOISE_BINS ; k++ )
+        dn->gain[k] = 32767;
+    dn->mean_gain = 1;
+
+    _derive( dn );
+    if ( _fft_init( dn ) != 0 )
+        return -1;
+
+    dn->channels = channels;
+    return 0;
+}
+
+void denoise_set_params( denoise_t* dn, const denoise_params_t* params )
+{
+    if ( params->enable && !dn->params.enable )
+        _clear( dn );
+    dn->params = *params;
+    _derive( dn );
+}
+
+// Per bin gains from the power of this frame
+
+static void _gains( denoise_t* dn )
+{
+    float sum = 0;
+
+    for ( int k = 0 ; k < DENOISE_BINS ; k++ ) {
+
+        float p = dn->power[k];
+
+        // Minimum tracking on the smoothed power, rising slowly so a floor
+        // that went up is found again
+
+        if ( dn->frames == 0 ) {
+            dn->smooth[k] = p;
+            dn->noise[k] = p;
+        } else {
+            dn->smooth[k] = SMOOTH * dn->smooth[k] + ( 1 - SMOOTH ) * p;
+            dn->noise[k] = dn->smooth[k] < dn->noise[k] ? dn->smooth[k] : dn->noise[k] * dn->rise;
+        }
+
+        // Wiener gain on the decision directed a priori SNR
+
+        float noise = NOISE_BIAS * dn->noise[k] + 1e-12f;
+        float post = p / noise - 1;
+        float xi = dn->alpha * dn->clean[k] / noise + ( 1 - dn->alpha ) * ( post > 0 ? post : 0 );
+        float g = xi / ( 1 + xi );
+        if ( g < dn->floor )
+            g = dn->floor;
+
+        dn->clean[k] = g * g * p;
+        dn->gain[k] = (int16_t) ( g * 32767 );
+        sum += g;
+    }
+
+    dn->mean_gain = sum / DENOISE_BINS;
+    dn->frames++;
+}
+
+// One hop: analysis of the last N input samples, gains, synthesis into the
+// overlap-add buffers, and the next hop of output. Both channels go through
+// one complex transform, the first as the real part and the second as the
+// imaginary part: the gains are real and the same for bins k and N - k, so
+// applying them to the packed spectrum filters each channel on its own
+
+static void _frame( denoise_t* dn )
+{
+    int16_t* d = dn->spec;
+    const int16_t* l = dn->in[0];
+    const int16_t* r = dn->in[dn->channels - 1];
+    bool stereo = dn->channels > 1;
+    int32_t peak = 0;
+
+    for ( int c = 0 ; c < dn->channels ; c++ ) {
+        for ( int n = 0 ; n < N ; n++ ) {
+            int32_t a = dn->in[c][n] < 0 ? -dn->in[c][n] : dn->in[c][n];
+            peak = a > peak ? a : peak;
+        }
+    }
+
+    int s = _norm( peak );
+    for ( int n = 0 ; n < N ; n++ ) {
+        d[2*n] = ( ( (int32_t) l[n] << s ) * dn->window[n] + 0x4000 ) >> 15;
+        d[2*n+1] = stereo ? ( ( (int32_t) r[n] << s ) * dn->window[n] + 0x4000 ) >> 15 : 0;
+    }
+
+    _fft( dn, d );
+
+    // Summed power of the channels, |L|^2 + |R|^2 = ( |Z(k)|^2 + |Z(N-k)|^2 ) / 2,
+    // in the units of the input whatever the block exponent
+
+    float scale = 0.5f / ( 1 << ( 2 * s ) );
+    for ( int k = 0 ; k < DENOISE_BINS ; k++ ) {
+        int m = ( N - k ) & ( N - 1 );
+        float re = d[2*k], im = d[2*k+1], mre = d[2*m], mim = d[2*m+1];
+        dn->power[k] = ( re * re + im * im + mre * mre + mim * mim ) * scale;
+    }
+
+    _gains( dn );
+
+    // Gains on both halves of the spectrum, then the inverse as the forward
+    // transform of the conjugate
+
+    peak = 0;
+    for ( int k = 0 ; k < N ; k++ ) {
+        int32_t g = dn->gain[k < DENOISE_BINS ? k : N - k];
+        int32_t re = ( d[2*k] * g + 0x4000 ) >> 15;
+        int32_t im = ( d[2*k+1] * g + 0x4000 ) >> 15;
+        d[2*k] = re;
+        d[2*k+1] = im;
+        re = re < 0 ? -re : re;
+        im = im < 0 ? -im : im;
+        peak = re > peak ? re : peak;
+        peak = im > peak ? im : peak;
+    }
+
+    int s2 = _norm( peak );
+    for ( int k = 0 ; k < N ; k++ ) {
+        d[2*k] = d[2*k] << s2;
+        d[2*k+1] = -( d[2*k+1] << s2 );
+    }
+
+    _fft( dn, d );
+
+    // Undo both block exponents and the 1 / N of the two transforms
+    // combined, window again and add in. The second channel comes back
+    // conjugated in the imaginary part
+
+    int sh = DENOISE_LOG2_SIZE - s - s2;
+    for ( int c = 0 ; c < dn->channels ; c++ ) {
+
+        int32_t* ola = dn->ola[c];
+        for ( int n = 0 ; n < N ; n++ ) {
+            int32_t y = ( ( c ? -d[2*n+1] : d[2*n] ) * (int32_t) dn->window[n] + 0x4000 ) >> 15;
+            ola[n] += sh >= 0 ? y << sh : ( y + ( 1 << ( -sh - 1 ) ) ) >> -sh;
+        }
+
+        for ( int n = 0 ; n < DENOISE_HOP ; n++ )
+            dn->out[c][n] = _sat16( ola[n] );
+        memmove( ola, ola + DENOISE_HOP, ( N - DENOISE_HOP ) * sizeof(int32_t) );
+        memset( ola + N - DENOISE_HOP, 0, DENOISE_HOP * sizeof(int32_t) );
+
+        memmove( dn->in[c], dn->in[c] + DENOISE_HOP, ( N - DENOISE_HOP ) * sizeof(int16_t) );
+    }
+}
+
+void denoise_process( denoise_t* dn, int16_t* buf, int frames )
+{
+    // No channels if the init failed, and it stays a pass through
+
+    if ( !dn->params.enable || dn->channels == 0 )
+        return;
+
+    int ch = dn->channels;
+
+    // Sample by sample through a hop long delay line, so blocks of any
+    // length go through in place with the same constant delay
+
+    for ( int i = 0 ; i < frames ; i++ ) {
+        for ( int c = 0 ; c < ch ; c++ ) {
+            dn->in[c][N - DENOISE_HOP + dn->pos] = buf[i*ch+c];
+            buf[i*ch+c] = dn->out[c][dn->pos];
+        }
+        if ( ++dn->pos == DENOISE_HOP ) {
+            _frame( dn );
+            dn->pos = 0;
+        }
+    }
+}
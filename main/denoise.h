@@ -0,0 +1,107 @@
+/*
+ * denoise.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: xenir
+ */
+
+#ifndef MAIN_DENOISE_H_
+#define MAIN_DENOISE_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Spectral noise reduction for 16 bit interleaved PCM. Overlap-add STFT
+// with DENOISE_FFT_SIZE frames at 50% overlap and square root Hann windows
+// on both sides, so with unity gains the output is the input delayed by
+// DENOISE_FFT_SIZE samples (16 ms at 16 kHz).
+//
+// The noise floor of each bin is tracked continuously as the minimum of its
+// smoothed power, allowed to rise by noise_rise_db per second so it follows
+// a receiver whose hiss changes. Gains are Wiener gains on a decision
+// directed a priori SNR, which keeps the residual noise smooth rather than
+// "musical", and never go below -attenuation_db. Channels share one set of
+// gains worked out from their summed power, which lets a stereo pair share
+// one complex transform each way.
+//
+// The sample path is fixed point: Q15 windows and gains, and a 16 bit
+// complex FFT (esp-dsp's dsps_fft2r_sc16 on the ESP32, a portable radix-2
+// with the same per stage halving elsewhere) run block floating point, each
+// frame and each spectrum shifted up to use the full 16 bits before its
+// transform. The per bin noise and gain estimates, 129 per frame, are
+// single precision float.
+//
+// Off by default: it costs 16 ms of latency, which only a noisy feed is
+// worth.
+
+#define DENOISE_FFT_SIZE		256
+#define DENOISE_LOG2_SIZE		8
+#define DENOISE_HOP				( DENOISE_FFT_SIZE / 2 )
+#define DENOISE_BINS			( DENOISE_FFT_SIZE / 2 + 1 )
+#define DENOISE_MAX_CHANNELS	2
+
+typedef struct {
+    bool	enable;
+    int		attenuation_db;			// Most any bin is turned down by
+    int		noise_rise_db;			// Per second the noise floor estimate may rise
+    int		smoothing_pct;			// Weight of the previous frame in the a priori SNR
+} denoise_params_t;
+
+#define DEFAULT_DENOISE_PARAMS() {\
+    .enable             = false,\
+    .attenuation_db     = 12,\
+    .noise_rise_db      = 6,\
+    .smoothing_pct      = 96,\
+}
+
+typedef struct {
+
+    denoise_params_t	params;
+    int					sample_rate;
+    int					channels;
+    int					pos;						// Samples of the current hop so far
+
+    int16_t				window[DENOISE_FFT_SIZE];	// Square root Hann, Q15
+    int16_t				in[DENOISE_MAX_CHANNELS][DENOISE_FFT_SIZE];
+    int16_t				out[DENOISE_MAX_CHANNELS][DENOISE_HOP];
+    int32_t				ola[DENOISE_MAX_CHANNELS][DENOISE_FFT_SIZE];
+    int16_t				spec[2 * DENOISE_FFT_SIZE];		// Channels packed as real and imaginary
+#ifndef ESP_PLATFORM
+    int16_t				twiddle[DENOISE_FFT_SIZE];	// Fallback FFT twiddles, N/2 complex Q15
+#endif
+
+    float				power[DENOISE_BINS];		// This frame
+    float				smooth[DENOISE_BINS];		// Smoothed, for the minimum tracking
+    float				noise[DENOISE_BINS];
+    float				clean[DENOISE_BINS];		// Last frame's gain squared times power
+    int16_t				gain[DENOISE_BINS];			// Q15
+    float				rise;						// Per frame noise floor rise factor
+    float				floor;						// Gain limit
+    float				alpha;
+
+    uint32_t			frames;
+    float				mean_gain;					// Average gain of the last frame, for reporting
+
+} denoise_t;
+
+// Returns -1 for a format it cannot take or without an FFT table, and then
+// passes the audio through unchanged whatever the parameters
+int denoise_init( denoise_t* dn, int sample_rate, int channels, const denoise_params_t* params );
+
+// Changes parameters keeping the noise estimate. Enabling starts from
+// silence, as the delay line is empty
+void denoise_set_params( denoise_t* dn, const denoise_params_t* params );
+
+// Processes "frames" interleaved frames in place. Does nothing when not
+// enabled, so there is then no delay either
+void denoise_process( denoise_t* dn, int16_t* buf, int frames );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* MAIN_DENOISE_H_ */
@@ -0,0 +1,67 @@
+/*
+ * drift.c
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: xenir
+ */
+
+#include <string.h>
+
+#include "drift.h"
+
+void drift_init( drift_t* d, int sample_rate, const drift_params_t* params )
+{
+    memset( d, 0, sizeof(drift_t) );
+    d->params = *params;
+    d->sample_rate = sample_rate;
+}
+
+void drift_reset( drift_t* d, int64_t now_us )
+{
+    d->start_us = now_us;
+    d->last_us = 0;
+    d->target_ms = d->params.target_ms;
+    d->integral_ppm = 0;
+    d->ppm = 0;
+    d->depth_ms = 0;
+    d->reports = 0;
+}
+
+static float _clamp( float v, float limit )
+{
+    return v > limit ? limit : ( v < -limit ? -limit : v );
+}
+
+int32_t drift_update( drift_t* d, int64_t now_us, int32_t depth_samples )
+{
+    d->reports++;
+    d->depth_ms = (int64_t) depth_samples * 1000 / d->sample_rate;
+
+    if ( !d->params.enable || now_us - d->start_us < (int64_t) d->params.settle_ms * 1000 )
+        return d->ppm;
+
+    if ( d->target_ms <= 0 )
+        d->target_ms = d->depth_ms;
+
+    float dt = d->last_us ? ( now_us - d->last_us ) / 1e6f : 0;
+    d->last_us = now_us;
+
+    // A depth error of e ms is worked off over T seconds by a correction of
+    // e / 1000 / T * 1e6 ppm. The integral runs four times slower so the loop
+    // stays well damped
+
+    int error = d->depth_ms - d->target_ms;
+    float t = d->params.time_constant_s;
+    if ( error > d->params.band_ms || error < -d->params.band_ms )
+        t /= 4;
+
+    float kp = 1000.0f / t;
+
+    d->integral_ppm = _clamp( d->integral_ppm + error * kp * dt / ( 4 * t ), d->params.max_ppm );
+
+    // A growing depth means the listener plays slower than we send, so the
+    // correction is negative
+
+    d->ppm = _clamp( -( error * kp + d->integral_ppm ), d->params.max_ppm );
+    return d->ppm;
+}
@@ -0,0 +1,71 @@
+/*
+ * drift.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: xenir
+ */
+
+#ifndef MAIN_DRIFT_H_
+#define MAIN_DRIFT_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Keeps a listener's buffer at a steady depth when its sound card clock and
+// the I2S clock disagree. The buffer depth is what has been sent less what
+// the listener reports having played. A PI loop turns the depth error into
+// a resampling correction in ppm; the integral term settles at the clock
+// difference, which is reported as the drift estimate.
+
+typedef struct {
+    bool	enable;
+    int		target_ms;			// Depth to hold, 0 to hold the depth the listener settled at
+    int		band_ms;			// Outside target +/- band the loop pulls back four times faster
+    int		max_ppm;			// Correction limit
+    int		time_constant_s;	// Time taken to work off a depth error
+    int		settle_ms;			// Reports ignored after the stream starts while the player prerolls
+} drift_params_t;
+
+#define DEFAULT_DRIFT_PARAMS() {\
+    .enable             = true,\
+    .target_ms          = 0,\
+    .band_ms            = 250,\
+    .max_ppm            = 500,\
+    .time_constant_s    = 300,\
+    .settle_ms          = 10000,\
+}
+
+typedef struct {
+
+    drift_params_t	params;
+    int				sample_rate;
+
+    int64_t			start_us;
+    int64_t			last_us;
+    int				target_ms;
+    float			integral_ppm;
+
+    int32_t			ppm;			// Correction in force
+    int32_t			depth_ms;		// Last measured depth
+    uint32_t		reports;
+
+} drift_t;
+
+void drift_init( drift_t* d, int sample_rate, const drift_params_t* params );
+
+// Starts over for a new listener
+void drift_reset( drift_t* d, int64_t now_us );
+
+// Feeds one depth measurement and returns the correction to apply in ppm:
+// positive sends more samples, negative fewer
+int32_t drift_update( drift_t* d, int64_t now_us, int32_t depth_samples );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* MAIN_DRIFT_H_ */
@@ -0,0 +1,200 @@
+/*
+ * event_stream.c
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: xenir
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "esp_log.h"
+#include "esp_http_server.h"
+#include "audio_mem.h"
+#include "audio_error.h"
+
+#include "webserver.h"
+#include "event_stream.h"
+
+static const char *TAG = "event_stream";
+
+// Subscriber sockets are only touched from the server task (handler, close
+// callback and queued send), so they need no lock. The publisher only reads
+// the count and owns the event buffer while "busy" is clear.
+
+struct event_stream {
+
+    httpd_handle_t	server;
+    const char*		uri;
+    const char*		hello;
+
+    int				fds[EVENT_STREAM_MAX_SUBSCRIBERS];
+    volatile int	count;
+
+    volatile bool	busy;
+    char			buf[EVENT_STREAM_MAX_EVENT + 32];	// Chunk framing + "data: " + event + "\n\n"
+    int				len;
+    uint32_t		dropped;
+};
+
+static void _remove( struct event_stream* es, int fd )
+{
+    for ( int i = 0 ; i < es->count ; i++ ) {
+        if ( es->fds[i] == fd ) {
+            es->fds[i] = es->fds[es->count - 1];
+            es->count--;
+            ESP_LOGI(TAG, "Subscriber %d gone, %d left", fd, es->count);
+            return;
+        }
+    }
+}
+
+static void _close_callback( int fd, void* ctx )
+{
+    _remove( (struct event_stream*) ctx, fd );
+}
+
+static void _send_work( void* arg )
+{
+    struct event_stream* es = (struct event_stream*) arg;
+
+    for ( int i = es->count - 1 ; i >= 0 ; i-- ) {
+
+        int fd = es->fds[i];
+        int sent = 0;
+
+        while ( sent < es->len ) {
+            int n = httpd_socket_send( es->server, fd, es->buf + sent, es->len - sent, 0 );
+            if ( n <= 0 )
+                break;
+            sent += n;
+        }
+
+        if ( sent < es->len ) {
+            _remove( es, fd );
+            httpd_sess_trigger_close( es->server, fd );
+        }
+    }
+
+    es->busy = false;
+}
+
+static esp_err_t _subscribe_handler(httpd_req_t *req)
+{
+    struct event_stream* es = (struct event_stream*) req->user_ctx;
+
+    if ( es->count >= EVENT_STREAM_MAX_SUBSCRIBERS ) {
+        httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Too many subscribers");
+        return ESP_OK;
+    }
+
+    httpd_resp_set_type(req, "text/event-stream");
+    httpd_resp_set_hdr(req, "Cache-Control", "no-cache");
+
+    // The response is left open: later events are written straight to the
+    // socket with the same chunked framing
+
+    esp_err_t ret = httpd_resp_send_chunk(req, ": subscribed\n\n", HTTPD_RESP_USE_STRLEN);
+    if ( ret == ESP_OK && es->hello ) {
+        httpd_resp_send_chunk(req, "data: ", HTTPD_RESP_USE_STRLEN);
+        httpd_resp_send_chunk(req, es->hello, HTTPD_RESP_USE_STRLEN);
+        ret = httpd_resp_send_chunk(req, "\n\n", HTTPD_RESP_USE_STRLEN);
+    }
+
+    if ( ret != ESP_OK )
+        return ESP_FAIL;
+
+    es->fds[es->count++] = httpd_req_to_sockfd(req);
+    ESP_LOGI(TAG, "Subscriber %d added to %s, %d total", httpd_req_to_sockfd(req), req->uri, es->count);
+
+    return ESP_OK;
+}
+
+int event_stream_subscribers(event_stream_handle_t es)
+{
+    return es->count;
+}
+
+uint32_t event_stream_dropped(event_stream_handle_t es)
+{
+    return es->dropped;
+}
+
+bool event_stream_publish(event_stream_handle_t es, const char *data, int len)
+{
+    if ( es->count == 0 )
+        return false;
+
+    if ( es->busy || len > EVENT_STREAM_MAX_EVENT ) {
+        es->dropped++;
+        return false;
+    }
+
+    int hdr = snprintf( es->buf, sizeof(es->buf), "%x\r\ndata: ", len + 8 );
+    memcpy( es->buf + hdr, data, len );
+    memcpy( es->buf + hdr + len, "\n\n\r\n", 4 );
+    es->len = hdr + len + 4;
+
+    es->busy = true;
+    if ( httpd_queue_work( es->server, _send_work, es ) != ESP_OK ) {
+        es->busy = false;
+        es->dropped++;
+        return false;
+    }
+
+    return true;
+}
+
+// Runs in the server task after any queued send, so nothing else there
+// still uses the stream
+
+static void _destroy_work( void* arg )
+{
+    struct event_stream* es = (struct event_stream*) arg;
+
+    webserver_remove_close_callback( _close_callback, es );
+    for ( int i = 0 ; i < es->count ; i++ )
+        httpd_sess_trigger_close( es->server, es->fds[i] );
+    es->count = 0;
+}
+
+void event_stream_destroy(event_stream_handle_t es)
+{
+    if ( !es )
+        return;
+
+    webserver_unregister_uri_handler( es->uri, HTTP_GET );
+    webserver_call( _destroy_work, es );
+    audio_free( es );
+}
+
+event_stream_handle_t event_stream_create(const char *uri, const char *hello)
+{
+    httpd_handle_t server = webserver_get_handle();
+    if ( !server ) {
+        ESP_LOGE(TAG, "Web server not started");
+        return NULL;
+    }
+
+    struct event_stream* es = audio_calloc( 1, sizeof(struct event_stream) );
+    AUDIO_MEM_CHECK(TAG, es, {return NULL;});
+
+    es->server = server;
+    es->uri = uri;
+    es->hello = hello;
+
+    httpd_uri_t subscribe = {
+        .uri       = uri,
+        .method    = HTTP_GET,
+        .handler   = _subscribe_handler,
+        .user_ctx  = es
+    };
+
+    if ( webserver_register_uri_handler( &subscribe ) != ESP_OK ||
+         webserver_add_close_callback( _close_callback, es ) != ESP_OK ) {
+        audio_free( es );
+        return NULL;
+    }
+
+    return es;
+}
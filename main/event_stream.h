@@ -0,0 +1,61 @@
+/*
+ * event_stream.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: xenir
+ */
+
+#ifndef MAIN_EVENT_STREAM_H_
+#define MAIN_EVENT_STREAM_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Server-sent events on the port 80 server. A GET on the stream URI leaves
+// the chunked response open and the socket is remembered; published events
+// are written to every subscriber from the server task. Only one event is
+// in flight at a time: publishing while the previous event is still being
+// sent drops the new one, so a slow viewer lowers the frame rate rather
+// than queueing memory.
+
+#define EVENT_STREAM_MAX_SUBSCRIBERS	4
+#define EVENT_STREAM_MAX_EVENT			1024
+
+typedef struct event_stream *event_stream_handle_t;
+
+/**
+ * @brief      Register an event stream at "uri". "uri" and "hello" (may be
+ *             NULL), which is sent as the first event to every new
+ *             subscriber, must stay valid for the life of the stream
+ */
+event_stream_handle_t event_stream_create(const char *uri, const char *hello);
+
+/**
+ * @brief      Unregister the stream and close its subscribers. Nothing may
+ *             publish to it any more. Not from the server task
+ */
+void event_stream_destroy(event_stream_handle_t es);
+
+int event_stream_subscribers(event_stream_handle_t es);
+
+/**
+ * @brief      Queue "data" as one event for every subscriber. Callable from
+ *             any task
+ *
+ * @return     true if queued, false if dropped or there are no subscribers
+ */
+bool event_stream_publish(event_stream_handle_t es, const char *data, int len);
+
+uint32_t event_stream_dropped(event_stream_handle_t es);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* MAIN_EVENT_STREAM_H_ */
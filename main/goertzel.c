@@ -0,0 +1,182 @@
+/*
+ * goertzel.c
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: xenir
+ */
+
+#include <string.h>
+#include <math.h>
+
+#include "goertzel.h"
+
+#define FULL_SCALE		32768.0f
+
+void goertzel_init( goertzel_t* g, int sample_rate, const goertzel_params_t* params )
+{
+    memset( g, 0, sizeof(goertzel_t) );
+    g->params = *params;
+    g->sample_rate = sample_rate;
+
+    goertzel_params_t* p = &g->params;
+    p->tones = p->tones < 0 ? 0 : ( p->tones > GOERTZEL_MAX_TONES ? GOERTZEL_MAX_TONES : p->tones );
+    p->frame_ms = p->frame_ms < GOERTZEL_MIN_FRAME_MS ? GOERTZEL_MIN_FRAME_MS :
+            ( p->frame_ms > GOERTZEL_MAX_FRAME_MS ? GOERTZEL_MAX_FRAME_MS : p->frame_ms );
+    p->on_db = p->on_db > 0 ? 0 : p->on_db;
+    p->off_db = p->off_db > p->on_db ? p->on_db : p->off_db;
+
+    g->frame = sample_rate * p->frame_ms / 1000;
+
+    for ( int t = 0 ; t < p->tones ; t++ ) {
+        g->coeff[t] = 2 * cosf( 2 * M_PI * p->hz[t] / sample_rate );
+        g->share_db[t] = g->level_dbfs[t] = -120;
+    }
+}
+
+// Ends a frame: works out each tone's power from the last two filter
+// states, decides on or off and starts the next frame
+
+static int _decide( goertzel_t* g, goertzel_event_t* events, int max_events )
+{
+    int n = 0;
+    uint64_t start = g->samples - g->frame;
+    float energy = g->energy + 1e-3f;
+
+    for ( int t = 0 ; t < g->params.tones ; t++ ) {
+
+        float s1 = g->s1[t], s2 = g->s2[t];
+        float power = s1 * s1 + s2 * s2 - g->coeff[t] * s1 * s2;
+        g->s1[t] = g->s2[t] = 0;
+
+        // A sine of amplitude A at the tone gives power ( A N / 2 )^2 and
+        // the frame energy A^2 N / 2, a share of 1
+        float share = 2 * power / ( g->frame * energy );
+        float level = 4 * power / ( (float) g->frame * g->frame * FULL_SCALE * FULL_SCALE );
+        g->share_db[t] = 10 * log10f( share + 1e-12f );
+        g->level_dbfs[t] = 10 * log10f( level + 1e-12f );
+
+        int hz = g->params.hz[t];
+        bool valid = hz > 0 && 2 * hz < g->sample_rate;
+        bool loud = g->level_dbfs[t] >= g->params.min_dbfs;
+        bool on;
+
+        if ( !g->on[t] ) {
+
+            // A frame holding only the end of a neighbouring tone spreads
+            // it wide, so one frame alone is not believed; the edge is put
+            // in the first of the two
+            if ( valid && loud && g->share_db[t] >= g->params.on_db ) {
+                if ( g->onset[t]++ == 0 ) {
+                    g->onset_sample[t] = g->samples;
+                    g->onset_dbfs[t] = g->ref_dbfs[t] = g->level_dbfs[t];
+                    g->before_dbfs[t] = g->prev_dbfs[t];
+                }
+            }
+            else
+                g->onset[t] = 0;
+            g->prev_dbfs[t] = g->level_dbfs[t];
+
+            on = g->onset[t] >= GOERTZEL_ON_FRAMES;
+            if ( !on )
+                continue;
+            g->ref_dbfs[t] = fmaxf( g->ref_dbfs[t], g->level_dbfs[t] );
+        }
+        else {
+
+            // The share alone lets a tone well clear of the noise hang on
+            // into the frame after it stops, the fall in level does not
+            on = loud && g->share_db[t] >= g->params.off_db && g->level_dbfs[t] >= g->ref_dbfs[t] - GOERTZEL_FALL_DB;
+            if ( on ) {
+                g->ref_dbfs[t] += 0.25f * ( g->level_dbfs[t] - g->ref_dbfs[t] );
+                continue;
+            }
+            g->onset[t] = 0;
+        }
+
+        g->on[t] = on;
+
+        // A tone in part of a frame has its amplitude in proportion, so
+        // the level of the edge frame against the level while on says how
+        // much of it the tone took up: the end for an on, the start for an
+        // off
+        float edge_dbfs = on ? g->onset_dbfs[t] : g->level_dbfs[t];
+        float part = powf( 10, ( edge_dbfs - g->ref_dbfs[t] ) / 20 );
+        part = part > 1 ? 1 : part;
+        if ( on )
+            part += powf( 10, ( g->before_dbfs[t] - g->ref_dbfs[t] ) / 20 );
+        uint64_t into = lrintf( part * g->frame );
+        into = on && into > g->onset_sample[t] ? g->onset_sample[t] : into;
+
+        if ( n < max_events ) {
+            events[n].tone = t;
+            events[n].on = on;
+            events[n].dbfs = g->ref_dbfs[t] < -127 ? -127 : lrintf( g->ref_dbfs[t] );
+            events[n].sample = on ? g->onset_sample[t] - into : start + into;
+            n++;
+        }
+        else
+            g->lost++;
+    }
+
+    g->energy = 0;
+    g->fill = 0;
+    g->frames++;
+    return n;
+}
+
+// Tones are run in pairs, so each sample has two independent recursions
+// in flight rather than waiting on one, and the older state is taken off
+// first so only the multiply and one add wait on the newest
+
+static void _run( goertzel_t* g, const int16_t* samples, int count )
+{
+    float energy = 0;
+    for ( int i = 0 ; i < count ; i++ )
+        energy += (float) samples[i] * samples[i];
+    g->energy += energy;
+
+    int t = 0;
+    for ( ; t + 1 < g->params.tones ; t += 2 ) {
+        float c0 = g->coeff[t], a1 = g->s1[t], a2 = g->s2[t];
+        float c1 = g->coeff[t + 1], b1 = g->s1[t + 1], b2 = g->s2[t + 1];
+        for ( int i = 0 ; i < count ; i++ ) {
+            float x = samples[i];
+            float a0 = ( x - a2 ) + c0 * a1;
+            float b0 = ( x - b2 ) + c1 * b1;
+            a2 = a1; a1 = a0;
+            b2 = b1; b1 = b0;
+        }
+        g->s1[t] = a1; g->s2[t] = a2;
+        g->s1[t + 1] = b1; g->s2[t + 1] = b2;
+    }
+    if ( t < g->params.tones ) {
+        float c0 = g->coeff[t], a1 = g->s1[t], a2 = g->s2[t];
+        for ( int i = 0 ; i < count ; i++ ) {
+            float a0 = ( samples[i] - a2 ) + c0 * a1;
+            a2 = a1; a1 = a0;
+        }
+        g->s1[t] = a1; g->s2[t] = a2;
+    }
+}
+
+int goertzel_process( goertzel_t* g, const int16_t* samples, int count, goertzel_event_t* events, int max_events )
+{
+    int n = 0;
+
+    while ( count > 0 ) {
+
+        int run = g->frame - g->fill;
+        run = run > count ? count : run;
+
+        _run( g, samples, run );
+        g->fill += run;
+        g->samples += run;
+        samples += run;
+        count -= run;
+
+        if ( g->fill == g->frame )
+            n += _decide( g, events + n, max_events - n );
+    }
+
+    return n;
+}
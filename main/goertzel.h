@@ -0,0 +1,111 @@
+/*
+ * goertzel.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: xenir
+ */
+
+#ifndef MAIN_GOERTZEL_H_
+#define MAIN_GOERTZEL_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Tone detection at a handful of fixed frequencies, a Goertzel filter for
+// each over frames of frame_ms. Where the spectrum's FFT works out every
+// bin to look at a few, each tone here costs one multiply and two adds a
+// sample. The spectrum takes one FFT a block, too seldom to time an on or
+// off; one every 10 ms costs over three times a full bank of
+// GOERTZEL_MAX_TONES (see the host bench).
+// The frequency need not fall on a bin; each detector is the DFT at exactly
+// its tone, about 2000 / frame_ms Hz wide between the first nulls, 200 Hz
+// for the default 10 ms, which also sets how close together tones can be.
+//
+// A tone is judged by its share of the frame's power, 0 dB when the frame
+// holds nothing else, so the decision does not depend on the input level:
+// it turns on at on_db for GOERTZEL_ON_FRAMES frames running, and off
+// below off_db or once its level has fallen GOERTZEL_FALL_DB under what it
+// was while on, and is never on quieter than min_dbfs. On and off are
+// reported against the sample clock, placed within the frame the change
+// was seen in by how much of that frame's level the tone made up, to a
+// few ms with 10 ms frames; an on is only known the frame after.
+//
+// Single precision float like the notch.
+
+#define GOERTZEL_MAX_TONES		8
+#define GOERTZEL_MIN_FRAME_MS	2
+#define GOERTZEL_MAX_FRAME_MS	100
+#define GOERTZEL_ON_FRAMES		2
+#define GOERTZEL_FALL_DB		6
+
+typedef struct {
+    int		tones;						// Used entries of hz
+    int		hz[GOERTZEL_MAX_TONES];		// Under half the sample rate; others never turn on
+    int		frame_ms;
+    int		on_db;						// Share of the frame's power to turn on
+    int		off_db;						// ... and to stay on, at or below on_db
+    int		min_dbfs;					// Level, a full scale sine being 0
+} goertzel_params_t;
+
+// The tone the stream server plays, CW's usual sidetone
+
+#define DEFAULT_GOERTZEL_PARAMS() {\
+    .tones              = 1,\
+    .hz                 = { 600 },\
+    .frame_ms           = 10,\
+    .on_db              = -10,\
+    .off_db             = -14,\
+    .min_dbfs           = -50,\
+}
+
+typedef struct {
+    uint8_t		tone;							// Index into hz
+    bool		on;
+    int8_t		dbfs;							// The tone's level while on
+    uint64_t	sample;							// Since goertzel_init
+} goertzel_event_t;
+
+typedef struct {
+
+    goertzel_params_t	params;
+    int					sample_rate;
+    int					frame;					// Samples per frame
+    float				coeff[GOERTZEL_MAX_TONES];	// 2 cos( w )
+    float				s1[GOERTZEL_MAX_TONES];
+    float				s2[GOERTZEL_MAX_TONES];
+    float				energy;
+    int					fill;					// Samples into the frame
+    uint64_t			samples;
+
+    bool				on[GOERTZEL_MAX_TONES];
+    int					onset[GOERTZEL_MAX_TONES];		// Frames running above on_db
+    uint64_t			onset_sample[GOERTZEL_MAX_TONES];	// End of the first frame above on_db
+    float				onset_dbfs[GOERTZEL_MAX_TONES];		// ... and its level
+    float				before_dbfs[GOERTZEL_MAX_TONES];	// The frame before's
+    float				prev_dbfs[GOERTZEL_MAX_TONES];
+    float				ref_dbfs[GOERTZEL_MAX_TONES];	// Level while on
+    float				share_db[GOERTZEL_MAX_TONES];	// For the last frame
+    float				level_dbfs[GOERTZEL_MAX_TONES];
+    uint32_t			frames;
+    uint32_t			lost;					// Events beyond max_events
+
+} goertzel_t;
+
+// Starts the sample clock at 0 with every tone off. Out of range frame
+// lengths and levels are clamped
+void goertzel_init( goertzel_t* g, int sample_rate, const goertzel_params_t* params );
+
+// Runs "count" mono samples through the bank and writes up to max_events
+// on and off changes to "events", returning how many. A frame part way
+// through carries to the next call
+int goertzel_process( goertzel_t* g, const int16_t* samples, int count, goertzel_event_t* events, int max_events );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* MAIN_GOERTZEL_H_ */
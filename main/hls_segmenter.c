@@ -0,0 +1,339 @@
+/*
+ * hls_segmenter.c
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: xenir
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <sys/param.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "esp_log.h"
+#include "esp_system.h"
+#include "esp_http_server.h"
+#include "audio_mem.h"
+#include "audio_error.h"
+
+#include "wav_header.h"
+#include "wav_create.h"
+#include "webserver.h"
+#include "hls_segmenter.h"
+
+static const char *TAG = "hls_segmenter";
+
+// Each segment is a complete WAV file: the header is filled in once the
+// segment is full, after which the segment never changes until its slot is
+// reused. Segment names carry a per boot id as well as the sequence number
+// so a cached segment from a previous boot can never be served by mistake.
+//
+// The slot after the one being written is the next to be overwritten, so it
+// is left out of the playlist. That gives a client at least one segment
+// duration to finish a download it started from a stale playlist.
+//
+// A format change closes the segment being written early and starts the
+// next one with a discontinuity. Segments keep their own format, so their
+// length in bytes stays fixed and their duration follows the byte rate.
+
+typedef struct {
+    int				seq;			// -1 while the slot is unused
+    int				len;			// PCM bytes written
+    bool			complete;
+    int				byterate;
+    int				disc;			// Discontinuities before and including this segment
+    char*			buf;			// wav_header_t followed by PCM
+} hls_segment_t;
+
+struct hls_segmenter {
+
+    hls_segmenter_cfg_t	cfg;
+    int					capacity;		// PCM bytes per segment
+    uint32_t			boot_id;
+
+    SemaphoreHandle_t	lock;
+    hls_segment_t*		segments;
+    int					cur;
+    int					next_seq;
+    int					disc;
+};
+
+static hls_segment_t* _find_segment( struct hls_segmenter* hls, int seq )
+{
+    int next = ( hls->cur + 1 ) % hls->cfg.window;
+
+    for ( int i = 0 ; i < hls->cfg.window ; i++ ) {
+        hls_segment_t* seg = &hls->segments[i];
+        if ( i != next && seg->complete && seg->seq == seq )
+            return seg;
+    }
+
+    return NULL;
+}
+
+static int _byterate( const hls_segmenter_cfg_t* cfg )
+{
+    return cfg->sample_rate * cfg->channels * cfg->bits / 8;
+}
+
+// Publishes the segment being written and claims the next slot. Both happen
+// together so the playlist never sees the slot that is about to be
+// overwritten. Called with the lock held.
+
+static void _next_segment( struct hls_segmenter* hls )
+{
+    hls_segment_t* seg = &hls->segments[hls->cur];
+
+    create_wav_header( (int16_t*) seg->buf, seg->len, hls->cfg.channels, hls->cfg.bits, hls->cfg.sample_rate );
+    seg->byterate = _byterate( &hls->cfg );
+    seg->complete = true;
+
+    hls->cur = ( hls->cur + 1 ) % hls->cfg.window;
+    hls_segment_t* next = &hls->segments[hls->cur];
+    next->seq = hls->next_seq++;
+    next->len = 0;
+    next->complete = false;
+    next->disc = hls->disc;
+}
+
+void hls_segmenter_write(const char *buf, int len, void *ctx)
+{
+    struct hls_segmenter* hls = (struct hls_segmenter*) ctx;
+
+    while ( len > 0 ) {
+
+        hls_segment_t* seg = &hls->segments[hls->cur];
+        int n = MIN( len, hls->capacity - seg->len );
+
+        memcpy( seg->buf + sizeof(wav_header_t) + seg->len, buf, n );
+        seg->len += n;
+        buf += n;
+        len -= n;
+
+        if ( seg->len < hls->capacity )
+            break;
+
+        xSemaphoreTake( hls->lock, portMAX_DELAY );
+        _next_segment( hls );
+        xSemaphoreGive( hls->lock );
+    }
+}
+
+void hls_segmenter_set_format(hls_segmenter_handle_t hls, int sample_rate, int bits, int channels)
+{
+    xSemaphoreTake( hls->lock, portMAX_DELAY );
+
+    if ( hls->segments[hls->cur].len > 0 )
+        _next_segment( hls );
+
+    hls->cfg.sample_rate = sample_rate;
+    hls->cfg.bits = bits;
+    hls->cfg.channels = channels;
+    hls->segments[hls->cur].disc = ++hls->disc;
+
+    xSemaphoreGive( hls->lock );
+
+    ESP_LOGI(TAG, "Format now %d Hz %d bit %d channel, %d ms per segment",
+            sample_rate, bits, channels, (int) ( (int64_t) hls->capacity * 1000 / _byterate( &hls->cfg ) ));
+}
+
+static esp_err_t _playlist_handler(httpd_req_t *req)
+{
+    struct hls_segmenter* hls = (struct hls_segmenter*) req->user_ctx;
+
+    char playlist[160 + HLS_SEGMENTER_MAX_WINDOW * 72];
+    int duration_ms[HLS_SEGMENTER_MAX_WINDOW];
+    int disc[HLS_SEGMENTER_MAX_WINDOW];
+    int seq[HLS_SEGMENTER_MAX_WINDOW];
+    int count = 0;
+
+    xSemaphoreTake( hls->lock, portMAX_DELAY );
+
+    // Oldest advertised segment sits two slots after the one being written
+
+    for ( int i = 2 ; i < hls->cfg.window ; i++ ) {
+        hls_segment_t* seg = &hls->segments[( hls->cur + i ) % hls->cfg.window];
+        if ( seg->complete ) {
+            seq[count] = seg->seq;
+            duration_ms[count] = (int64_t) seg->len * 1000 / seg->byterate;
+            disc[count] = seg->disc;
+            count++;
+        }
+    }
+
+    xSemaphoreGive( hls->lock );
+
+    int target = 1;
+    for ( int i = 0 ; i < count ; i++ )
+        target = MAX( target, ( duration_ms[i] + 999 ) / 1000 );
+
+    int pos = snprintf( playlist, sizeof(playlist),
+            "#EXTM3U\n#EXT-X-VERSION:3\n#EXT-X-TARGETDURATION:%d\n#EXT-X-MEDIA-SEQUENCE:%d\n"
+            "#EXT-X-DISCONTINUITY-SEQUENCE:%d\n",
+            target, count ? seq[0] : 0, count ? disc[0] : 0 );
+
+    for ( int i = 0 ; i < count && pos < (int) sizeof(playlist) ; i++ ) {
+        if ( i > 0 && disc[i] != disc[i-1] )
+            pos += snprintf( playlist + pos, sizeof(playlist) - pos, "#EXT-X-DISCONTINUITY\n" );
+        if ( pos < (int) sizeof(playlist) )
+            pos += snprintf( playlist + pos, sizeof(playlist) - pos, "#EXTINF:%d.%03d,\nhls/%08x-%d.wav\n",
+                    duration_ms[i] / 1000, duration_ms[i] % 1000, (unsigned) hls->boot_id, seq[i] );
+    }
+
+    httpd_resp_set_type(req, "application/vnd.apple.mpegurl");
+    httpd_resp_set_hdr(req, "Cache-Control", "no-cache");
+    return httpd_resp_send(req, playlist, MIN( pos, (int) sizeof(playlist) - 1 ));
+}
+
+// Segments are immutable once published, so they are sent straight out of
+// the ring the way download_get_handler sends a file, without copying.
+// A slow client can let the writer wrap around onto the segment being sent,
+// and the writer claims a slot, changing its sequence number, before it
+// writes to it. So a chunk is known to have gone out intact only if the
+// number still holds once the chunk has been sent. If it does not, or a
+// send fails, the response is abandoned without its terminating chunk, so
+// the client and any cache in between see it cut short rather than a
+// complete, cacheable segment.
+
+static bool _segment_valid( struct hls_segmenter* hls, hls_segment_t* seg, int seq )
+{
+    xSemaphoreTake( hls->lock, portMAX_DELAY );
+    bool valid = seg->seq == seq;
+    xSemaphoreGive( hls->lock );
+    return valid;
+}
+
+static esp_err_t _segment_handler(httpd_req_t *req)
+{
+    struct hls_segmenter* hls = (struct hls_segmenter*) req->user_ctx;
+
+    unsigned boot_id;
+    int seq;
+
+    const char* name = strrchr( req->uri, '/' );
+    if ( !name || sscanf( name, "/%x-%d.wav", &boot_id, &seq ) != 2 || boot_id != hls->boot_id ) {
+        httpd_resp_send_err(req, HTTPD_404_NOT_FOUND, "Segment does not exist");
+        return ESP_OK;
+    }
+
+    xSemaphoreTake( hls->lock, portMAX_DELAY );
+    hls_segment_t* seg = _find_segment( hls, seq );
+    xSemaphoreGive( hls->lock );
+
+    if ( !seg ) {
+        httpd_resp_send_err(req, HTTPD_404_NOT_FOUND, "Segment has expired");
+        return ESP_OK;
+    }
+
+    httpd_resp_set_type(req, "audio/x-wav");
+    httpd_resp_set_hdr(req, "Cache-Control", "public, max-age=86400, immutable");
+
+    const char* buf = seg->buf;
+    int total = sizeof(wav_header_t) + seg->len;
+
+    while ( total > 0 ) {
+
+        int chunksize = MIN( total, HLS_SEGMENTER_SEND_CHUNK );
+        if (httpd_resp_send_chunk(req, buf, chunksize) != ESP_OK) {
+            ESP_LOGE(TAG, "Segment sending failed");
+            return ESP_FAIL;
+        }
+
+        if ( !_segment_valid( hls, seg, seq ) ) {
+            ESP_LOGW(TAG, "Segment %d overwritten while sending", seq);
+            return ESP_FAIL;
+        }
+
+        buf += chunksize;
+        total -= chunksize;
+    }
+
+    httpd_resp_send_chunk(req, NULL, 0);
+    return ESP_OK;
+}
+
+esp_err_t hls_segmenter_register(hls_segmenter_handle_t hls)
+{
+    httpd_uri_t playlist = {
+        .uri       = "/live.m3u8",
+        .method    = HTTP_GET,
+        .handler   = _playlist_handler,
+        .user_ctx  = hls
+    };
+
+    httpd_uri_t segment = {
+        .uri       = "/hls/*",
+        .method    = HTTP_GET,
+        .handler   = _segment_handler,
+        .user_ctx  = hls
+    };
+
+    esp_err_t ret = webserver_register_uri_handler( &playlist );
+    if ( ret == ESP_OK )
+        ret = webserver_register_uri_handler( &segment );
+
+    return ret;
+}
+
+esp_err_t hls_segmenter_unregister(hls_segmenter_handle_t hls)
+{
+    esp_err_t ret = webserver_unregister_uri_handler( "/live.m3u8", HTTP_GET );
+    if ( webserver_unregister_uri_handler( "/hls/*", HTTP_GET ) != ESP_OK )
+        ret = ESP_FAIL;
+
+    return ret;
+}
+
+void hls_segmenter_destroy(hls_segmenter_handle_t hls)
+{
+    if ( !hls )
+        return;
+
+    if ( hls->segments ) {
+        for ( int i = 0 ; i < hls->cfg.window ; i++ )
+            audio_free( hls->segments[i].buf );
+        audio_free( hls->segments );
+    }
+
+    if ( hls->lock )
+        vSemaphoreDelete( hls->lock );
+
+    audio_free( hls );
+}
+
+hls_segmenter_handle_t hls_segmenter_init(hls_segmenter_cfg_t *config)
+{
+    if ( config->window < 3 || config->window > HLS_SEGMENTER_MAX_WINDOW ) {
+        ESP_LOGE(TAG, "Window must be between 3 and %d segments", HLS_SEGMENTER_MAX_WINDOW);
+        return NULL;
+    }
+
+    struct hls_segmenter *hls = audio_calloc(1, sizeof(struct hls_segmenter));
+    AUDIO_MEM_CHECK(TAG, hls, {return NULL;});
+
+    hls->cfg = *config;
+    hls->boot_id = esp_random();
+
+    int block_align = config->channels * config->bits / 8;
+    hls->capacity = (int64_t) config->sample_rate * config->segment_ms / 1000 * block_align;
+
+    hls->lock = xSemaphoreCreateMutex();
+    hls->segments = audio_calloc( config->window, sizeof(hls_segment_t) );
+    AUDIO_MEM_CHECK(TAG, hls->segments, {hls_segmenter_destroy(hls); return NULL;});
+
+    for ( int i = 0 ; i < config->window ; i++ ) {
+        hls->segments[i].seq = -1;
+        hls->segments[i].buf = audio_malloc( sizeof(wav_header_t) + hls->capacity );
+        AUDIO_MEM_CHECK(TAG, hls->segments[i].buf, {hls_segmenter_destroy(hls); return NULL;});
+    }
+
+    hls->cur = 0;
+    hls->segments[0].seq = 0;
+    hls->next_seq = 1;
+
+    ESP_LOGI(TAG, "HLS Config: Segment: %d ms (%d bytes) Window: %d Sample Rate: %d",
+            config->segment_ms, hls->capacity, config->window, config->sample_rate);
+
+    return hls;
+}
@@ -0,0 +1,86 @@
+/*
+ * hls_segmenter.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: xenir
+ */
+
+#ifndef MAIN_HLS_SEGMENTER_H_
+#define MAIN_HLS_SEGMENTER_H_
+
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief      HLS segmenter configurations
+ */
+typedef struct {
+    int                     segment_ms;     /*!< Duration of each segment */
+    int                     window;         /*!< Number of segments held in RAM */
+    int                     sample_rate;
+    int                     bits;
+    int                     channels;
+} hls_segmenter_cfg_t;
+
+#define HLS_SEGMENTER_SEGMENT_MS        (1000)
+#define HLS_SEGMENTER_WINDOW            (5)
+#define HLS_SEGMENTER_MAX_WINDOW        (8)
+#define HLS_SEGMENTER_SEND_CHUNK        (4096)
+
+#define DEFAULT_HLS_SEGMENTER_CONFIG() {\
+    .segment_ms         = HLS_SEGMENTER_SEGMENT_MS,\
+    .window             = HLS_SEGMENTER_WINDOW,\
+    .sample_rate        = 8000,\
+    .bits               = 16,\
+    .channels           = 1,\
+}
+
+typedef struct hls_segmenter *hls_segmenter_handle_t;
+
+/**
+ * @brief      Allocate the segment ring. The window must be at least 3: one
+ *             segment being written, one about to be overwritten and at
+ *             least one advertised in the playlist
+ *
+ * @param      config  The configuration
+ *
+ * @return     The segmenter handle or NULL
+ */
+hls_segmenter_handle_t hls_segmenter_init(hls_segmenter_cfg_t *config);
+
+/**
+ * @brief      Append PCM in the configured format. Matches the
+ *             streaming_http_audio tap signature so it can be attached
+ *             directly with streaming_http_audio_add_tap
+ */
+void hls_segmenter_write(const char *buf, int len, void *ctx);
+
+/**
+ * @brief      Switch to a new PCM format. The segment being written is closed
+ *             early and the next one is marked as a discontinuity. Must not
+ *             run at the same time as hls_segmenter_write, so call it while
+ *             the element feeding the segmenter is paused
+ */
+void hls_segmenter_set_format(hls_segmenter_handle_t hls, int sample_rate, int bits, int channels);
+
+/**
+ * @brief      Register the playlist and segment handlers on the port 80 web server
+ */
+esp_err_t hls_segmenter_register(hls_segmenter_handle_t hls);
+
+/**
+ * @brief      Take the handlers off again. Returns once no request is using
+ *             the segmenter, so it can be destroyed
+ */
+esp_err_t hls_segmenter_unregister(hls_segmenter_handle_t hls);
+
+void hls_segmenter_destroy(hls_segmenter_handle_t hls);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* MAIN_HLS_SEGMENTER_H_ */
@@ -0,0 +1,247 @@
+/*
+ * i2s_capture.c
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: xenir
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_http_server.h"
+#include "audio_mem.h"
+#include "audio_error.h"
+#include "ringbuf.h"
+
+#include "webserver.h"
+#include "i2s_trace.h"
+#include "i2s_capture.h"
+
+static const char *TAG = "i2s_capture";
+
+#define CHUNK_SIZE		1024
+#define END_GRACE_US	1000000			// Capture stopped feeding the tap
+
+// The tap is the only writer and ends a capture itself, marking the
+// ringbuffer done after a whole record, so the sending task reads to the
+// end of a clean trace. "busy" covers the sending task's life, "active"
+// the tap's part of it.
+
+struct i2s_capture {
+
+    ringbuf_handle_t		rb;
+    int						sample_rate;
+    int						bits;
+    int						channels;
+
+    volatile bool			busy;
+    volatile bool			active;
+    int						fd;
+    int64_t					end_us;
+    int64_t					last_us;		// When the last record was taken
+    bool					first;
+    bool					gap;
+
+    char					chunk[CHUNK_SIZE];
+    i2s_capture_stats_t		stats;
+};
+
+void i2s_capture_write(const char *buf, int len, void *ctx)
+{
+    struct i2s_capture* cap = (struct i2s_capture*) ctx;
+
+    if ( !cap->active )
+        return;
+
+    int64_t now = esp_timer_get_time();
+    if ( now >= cap->end_us ) {
+        cap->active = false;
+        rb_done_write( cap->rb );
+        return;
+    }
+
+    i2s_trace_record_t record = {
+        .delta_us = cap->first ? 0 : now - cap->last_us,
+        .len = len,
+        .flags = cap->gap ? I2S_TRACE_GAP : 0,
+    };
+
+    if ( len > UINT16_MAX || rb_bytes_available( cap->rb ) < (int) sizeof(record) + len ) {
+        cap->gap = true;
+        cap->stats.dropped++;
+        return;
+    }
+
+    rb_write( cap->rb, (char*) &record, sizeof(record), 0 );
+    rb_write( cap->rb, (char*) buf, len, 0 );
+
+    cap->last_us = now;
+    cap->first = false;
+    cap->gap = false;
+    cap->stats.blocks++;
+    cap->stats.bytes += len;
+}
+
+static void _capture_task(void *arg)
+{
+    struct i2s_capture* cap = (struct i2s_capture*) arg;
+
+    for ( ;; ) {
+
+        int n = rb_read( cap->rb, cap->chunk, CHUNK_SIZE, pdMS_TO_TICKS( 100 ) );
+        if ( n == RB_DONE || n == RB_ABORT )
+            break;
+
+        if ( n > 0 && webserver_send_all( cap->fd, cap->chunk, n ) != ESP_OK ) {
+            ESP_LOGI(TAG, "Capture on socket %d ended by the client", cap->fd);
+            break;
+        }
+
+        // Nothing coming means nothing is feeding the tap to end it
+        if ( n <= 0 && esp_timer_get_time() > cap->end_us + END_GRACE_US )
+            break;
+    }
+
+    cap->active = false;
+    ESP_LOGI(TAG, "Capture on socket %d done, %u blocks dropped so far", cap->fd, cap->stats.dropped);
+
+    if ( webserver_release_socket( cap->fd ) )
+        close( cap->fd );
+    cap->busy = false;
+    vTaskDelete( NULL );
+}
+
+/* Writes the response head and trace header, then leaves the socket to the
+ * sending task */
+static esp_err_t _capture_handler(httpd_req_t *req)
+{
+    static const char head[] = "HTTP/1.1 200 OK\r\nContent-Type: application/octet-stream\r\n"
+                               "Content-Disposition: attachment; filename=\"capture" I2S_TRACE_EXT "\"\r\n"
+                               "Cache-Control: no-cache\r\nConnection: close\r\n\r\n";
+
+    struct i2s_capture* cap = (struct i2s_capture*) req->user_ctx;
+
+    char query[32], value[8];
+    int seconds = I2S_CAPTURE_DEFAULT_SECONDS;
+    if ( httpd_req_get_url_query_str( req, query, sizeof(query) ) == ESP_OK &&
+            httpd_query_key_value( query, "seconds", value, sizeof(value) ) == ESP_OK )
+        seconds = atoi( value );
+
+    if ( seconds < 1 || seconds > I2S_CAPTURE_MAX_SECONDS ) {
+        httpd_resp_send_err( req, HTTPD_400_BAD_REQUEST, "seconds out of range" );
+        return ESP_OK;
+    }
+
+    if ( cap->busy || webserver_detach_socket( req ) != ESP_OK ) {
+        httpd_resp_set_status( req, "503 Service Unavailable" );
+        httpd_resp_send( req, cap->busy ? "Capture already running" : "Busy", HTTPD_RESP_USE_STRLEN );
+        return ESP_OK;
+    }
+
+    cap->fd = httpd_req_to_sockfd( req );
+
+    i2s_trace_header_t header;
+    i2s_trace_header_init( &header, cap->sample_rate, cap->bits, cap->channels );
+
+    if ( webserver_send_all( cap->fd, head, sizeof(head) - 1 ) != ESP_OK ||
+         webserver_send_all( cap->fd, (const char*) &header, sizeof(header) ) != ESP_OK ) {
+        webserver_release_socket( cap->fd );
+        return ESP_FAIL;
+    }
+
+    rb_reset( cap->rb );
+    cap->first = true;
+    cap->gap = false;
+    cap->end_us = esp_timer_get_time() + (int64_t) seconds * 1000000;
+    cap->busy = true;
+    cap->active = true;
+
+    if ( xTaskCreate( _capture_task, "capture", I2S_CAPTURE_TASK_STACK, cap, I2S_CAPTURE_TASK_PRIO, NULL ) != pdPASS ) {
+        cap->active = false;
+        webserver_release_socket( cap->fd );
+        cap->busy = false;
+        return ESP_FAIL;
+    }
+
+    ESP_LOGI(TAG, "Capturing %d s of %d Hz %d bit %d channel on socket %d",
+            seconds, cap->sample_rate, cap->bits, cap->channels, cap->fd);
+    cap->stats.captures++;
+
+    // Failing the request is what detaches the socket from the server
+    return ESP_FAIL;
+}
+
+void i2s_capture_set_format(i2s_capture_handle_t cap, int sample_rate, int bits, int channels)
+{
+    if ( cap->active ) {
+        cap->active = false;
+        rb_done_write( cap->rb );
+    }
+
+    cap->sample_rate = sample_rate;
+    cap->bits = bits;
+    cap->channels = channels;
+}
+
+void i2s_capture_get_stats(i2s_capture_handle_t cap, i2s_capture_stats_t *stats)
+{
+    *stats = cap->stats;
+    stats->active = cap->busy;
+}
+
+i2s_capture_handle_t i2s_capture_init(int sample_rate, int bits, int channels)
+{
+    struct i2s_capture* cap = audio_calloc( 1, sizeof(struct i2s_capture) );
+    AUDIO_MEM_CHECK(TAG, cap, {return NULL;});
+
+    cap->rb = rb_create( I2S_CAPTURE_BUFFER_SIZE, 1 );
+    AUDIO_MEM_CHECK(TAG, cap->rb, {audio_free(cap); return NULL;});
+
+    cap->sample_rate = sample_rate;
+    cap->bits = bits;
+    cap->channels = channels;
+
+    ESP_LOGI(TAG, "Capture Config: Buffer: %d Sample Rate: %d Bits: %d Channels: %d",
+            I2S_CAPTURE_BUFFER_SIZE, sample_rate, bits, channels);
+    return cap;
+}
+
+esp_err_t i2s_capture_register(i2s_capture_handle_t cap)
+{
+    httpd_uri_t capture = {
+        .uri       = "/capture",
+        .method    = HTTP_GET,
+        .handler   = _capture_handler,
+        .user_ctx  = cap
+    };
+
+    return webserver_register_uri_handler( &capture );
+}
+
+esp_err_t i2s_capture_unregister(i2s_capture_handle_t cap)
+{
+    return webserver_unregister_uri_handler( "/capture", HTTP_GET );
+}
+
+// A capture still sending is cut short: the ringbuffer is aborted under
+// the sending task, which closes the socket and goes
+
+void i2s_capture_destroy(i2s_capture_handle_t cap)
+{
+    if ( !cap )
+        return;
+
+    cap->active = false;
+    rb_abort( cap->rb );
+    while ( cap->busy )
+        vTaskDelay( pdMS_TO_TICKS( 10 ) );
+
+    rb_destroy( cap->rb );
+    audio_free( cap );
+}
@@ -0,0 +1,88 @@
+/*
+ * i2s_capture.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: xenir
+ */
+
+#ifndef MAIN_I2S_CAPTURE_H_
+#define MAIN_I2S_CAPTURE_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Records the raw capture as an I2S trace (see i2s_trace.h) and streams it
+// to an HTTP client as it is taken: GET /capture?seconds=N answers with
+// the trace header and then a record for every block for N seconds, so
+//   curl -o input.i2st 'http://<board>/capture?seconds=30'
+// saves one. Blocks are handed from the capture task to the sending task
+// through a ringbuffer; one that finds it full is lost and the next record
+// flagged I2S_TRACE_GAP, so a slow client never holds up the capture. One
+// capture at a time.
+
+#define I2S_CAPTURE_BUFFER_SIZE			(32 * 1024)
+#define I2S_CAPTURE_DEFAULT_SECONDS		10
+#define I2S_CAPTURE_MAX_SECONDS			600
+#define I2S_CAPTURE_TASK_STACK			(3 * 1024)
+#define I2S_CAPTURE_TASK_PRIO			(4)
+
+typedef struct i2s_capture *i2s_capture_handle_t;
+
+typedef struct {
+    uint32_t                captures;       /*!< Downloads started */
+    uint32_t                blocks;         /*!< Recorded across all of them */
+    uint64_t                bytes;
+    uint32_t                dropped;        /*!< Blocks lost behind a slow client */
+    bool                    active;
+} i2s_capture_stats_t;
+
+/**
+ * @brief      Create the capture in the format the blocks will arrive in.
+ *             Feed it with i2s_capture_write; nothing is recorded until a
+ *             client asks
+ */
+i2s_capture_handle_t i2s_capture_init(int sample_rate, int bits, int channels);
+
+/**
+ * @brief      Register /capture on the port 80 server, which must be running
+ */
+esp_err_t i2s_capture_register(i2s_capture_handle_t cap);
+
+/**
+ * @brief      Tap for the raw capture, the same signature as the element
+ *             taps. Does nothing while no capture is running
+ */
+void i2s_capture_write(const char *buf, int len, void *ctx);
+
+/**
+ * @brief      Follow a format change. Call while the element feeding the tap
+ *             is paused; a capture running is ended there, as its header no
+ *             longer holds
+ */
+void i2s_capture_set_format(i2s_capture_handle_t cap, int sample_rate, int bits, int channels);
+
+void i2s_capture_get_stats(i2s_capture_handle_t cap, i2s_capture_stats_t *stats);
+
+/**
+ * @brief      Take /capture off the port 80 server. Call before
+ *             i2s_capture_destroy
+ */
+esp_err_t i2s_capture_unregister(i2s_capture_handle_t cap);
+
+/**
+ * @brief      End a capture in progress and free the tap. Whatever feeds it
+ *             must have stopped
+ */
+void i2s_capture_destroy(i2s_capture_handle_t cap);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* MAIN_I2S_CAPTURE_H_ */
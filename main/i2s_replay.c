@@ -0,0 +1,206 @@
+/*
+ * i2s_replay.c
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: xenir
+ */
+
+#include <string.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "audio_mem.h"
+#include "audio_element.h"
+#include "audio_error.h"
+
+#include "i2s_trace.h"
+#include "i2s_replay.h"
+
+static const char *TAG = "i2s_replay";
+
+#define TICK_US			( portTICK_PERIOD_MS * 1000 )
+#define RESYNC_US		1000000			// Further behind than this starts the pacing afresh
+
+typedef struct i2s_replay {
+
+    i2s_trace_reader_t	reader;
+    bool				loop;
+    volatile bool		fast;
+
+    // Each block is due its captured delta after the one before; a delay
+    // rounded down to whole ticks leaves the rest to the next block, so the
+    // rate comes out right with a tick of jitter
+    bool				started;
+    int64_t				due_us;
+
+    i2s_replay_stats_t	stats;
+
+} i2s_replay_t;
+
+static void _pace(i2s_replay_t *rp, uint32_t delta_us)
+{
+    int64_t now = esp_timer_get_time();
+
+    if (rp->fast || !rp->started) {
+        rp->due_us = now;
+        rp->started = true;
+        return;
+    }
+
+    rp->due_us += delta_us;
+    int64_t wait = rp->due_us - now;
+
+    if (wait >= TICK_US) {
+        vTaskDelay(wait / TICK_US);
+    } else if (wait < -TICK_US) {
+        rp->stats.late++;
+        if (-wait > rp->stats.max_late_us)
+            rp->stats.max_late_us = -wait;
+        if (-wait > RESYNC_US)
+            rp->due_us = now;
+    }
+}
+
+static esp_err_t _i2s_replay_destroy(audio_element_handle_t self)
+{
+    i2s_replay_t *rp = (i2s_replay_t *)audio_element_getdata(self);
+    i2s_trace_close(&rp->reader);
+    audio_free(rp);
+    return ESP_OK;
+}
+
+static esp_err_t _i2s_replay_open(audio_element_handle_t self)
+{
+    i2s_replay_t *rp = (i2s_replay_t *)audio_element_getdata(self);
+    ESP_LOGD(TAG, "_i2s_replay_open");
+
+    rp->started = false;
+    return i2s_trace_rewind(&rp->reader) == 0 ? ESP_OK : ESP_FAIL;
+}
+
+static esp_err_t _i2s_replay_close(audio_element_handle_t self)
+{
+    ESP_LOGD(TAG, "_i2s_replay_close");
+    if (AEL_STATE_PAUSED != audio_element_get_state(self)) {
+        audio_element_set_byte_pos(self, 0);
+        audio_element_set_total_bytes(self, 0);
+    }
+    return ESP_OK;
+}
+
+// A block longer than the element buffer is read out over several calls,
+// paced once at its start
+
+static int _i2s_replay_read(audio_element_handle_t self, char *buffer, int len, TickType_t ticks_to_wait, void *context)
+{
+    i2s_replay_t *rp = (i2s_replay_t *)audio_element_getdata(self);
+
+    if (rp->reader.remaining == 0) {
+
+        i2s_trace_record_t record;
+        int r = i2s_trace_next(&rp->reader, &record);
+        if (r == 0 && rp->loop) {
+            i2s_trace_rewind(&rp->reader);
+            rp->stats.loops++;
+            r = i2s_trace_next(&rp->reader, &record);
+        }
+        if (r < 0) {
+            ESP_LOGE(TAG, "Trace corrupt at record %u", rp->reader.records);
+            return AEL_IO_FAIL;
+        }
+        if (r == 0) {
+            ESP_LOGI(TAG, "Trace finished after %u blocks", rp->stats.blocks);
+            return AEL_IO_DONE;
+        }
+
+        if (record.flags & I2S_TRACE_GAP)
+            rp->stats.gaps++;
+        _pace(rp, record.delta_us);
+        rp->stats.blocks++;
+    }
+
+    int n = i2s_trace_read(&rp->reader, buffer, len);
+    if (n <= 0)
+        return AEL_IO_FAIL;
+
+    rp->stats.bytes += n;
+    return n;
+}
+
+static int _i2s_replay_process(audio_element_handle_t self, char *in_buffer, int in_len)
+{
+    int r_size = audio_element_input(self, in_buffer, in_len);
+    if (r_size <= 0)
+        return r_size;
+
+    int out_len = audio_element_output(self, in_buffer, r_size);
+    if (out_len > 0) {
+        audio_element_update_byte_pos(self, out_len);
+    }
+
+    return out_len;
+}
+
+esp_err_t i2s_replay_get_format(audio_element_handle_t self, int *sample_rate, int *bits, int *channels)
+{
+    i2s_replay_t *rp = (i2s_replay_t *)audio_element_getdata(self);
+    *sample_rate = rp->reader.header.sample_rate;
+    *bits = rp->reader.header.bits;
+    *channels = rp->reader.header.channels;
+    return ESP_OK;
+}
+
+esp_err_t i2s_replay_set_fast(audio_element_handle_t self, bool fast)
+{
+    i2s_replay_t *rp = (i2s_replay_t *)audio_element_getdata(self);
+    rp->fast = fast;
+    return ESP_OK;
+}
+
+esp_err_t i2s_replay_get_stats(audio_element_handle_t self, i2s_replay_stats_t *stats)
+{
+    i2s_replay_t *rp = (i2s_replay_t *)audio_element_getdata(self);
+    *stats = rp->stats;
+    return ESP_OK;
+}
+
+audio_element_handle_t i2s_replay_init(i2s_replay_cfg_t *config)
+{
+    i2s_replay_t *rp = audio_calloc(1, sizeof(i2s_replay_t));
+    AUDIO_MEM_CHECK(TAG, rp, {return NULL;});
+
+    if (!config->path || i2s_trace_open(&rp->reader, config->path) != 0) {
+        ESP_LOGE(TAG, "Cannot read a trace from %s", config->path ? config->path : "(no path)");
+        audio_free(rp);
+        return NULL;
+    }
+
+    rp->loop = config->loop;
+    rp->fast = config->fast;
+
+    audio_element_cfg_t cfg = DEFAULT_AUDIO_ELEMENT_CONFIG();
+    cfg.destroy = _i2s_replay_destroy;
+    cfg.process = _i2s_replay_process;
+    cfg.open = _i2s_replay_open;
+    cfg.close = _i2s_replay_close;
+    cfg.read = _i2s_replay_read;
+    cfg.buffer_len = I2S_REPLAY_BUFFER_LEN;
+    cfg.task_stack = config->task_stack ? config->task_stack : I2S_REPLAY_TASK_STACK;
+    cfg.stack_in_ext = config->stack_in_ext;
+    cfg.task_prio = config->task_prio;
+    cfg.task_core = config->task_core;
+    cfg.out_rb_size = config->out_rb_size;
+    cfg.tag = "replay";
+
+    const i2s_trace_header_t *h = &rp->reader.header;
+    ESP_LOGI(TAG, "Replay Config: %s Sample Rate: %u Bits: %u Channels: %u Pacing: %s Loop: %d",
+            config->path, h->sample_rate, h->bits, h->channels, config->fast ? "fast" : "captured", config->loop);
+
+    audio_element_handle_t el = audio_element_init(&cfg);
+    AUDIO_MEM_CHECK(TAG, el, {i2s_trace_close(&rp->reader); audio_free(rp); return NULL;});
+    audio_element_setdata(el, rp);
+
+    return el;
+}
@@ -0,0 +1,96 @@
+/*
+ * i2s_replay.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: xenir
+ */
+
+#ifndef MAIN_I2S_REPLAY_H_
+#define MAIN_I2S_REPLAY_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "esp_err.h"
+#include "audio_element.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief      I2S trace replay configurations
+ */
+typedef struct {
+    int                     out_rb_size;    /*!< Size of output ringbuffer */
+    int                     task_stack;     /*!< Task stack size */
+    int                     task_core;      /*!< Task running in core (0 or 1) */
+    int                     task_prio;      /*!< Task priority (based on freeRTOS priority) */
+    bool                    stack_in_ext;   /*!< Try to allocate stack in external memory */
+
+    const char             *path;           /*!< Trace file, see i2s_trace.h */
+    bool                    fast;           /*!< As fast as the pipeline takes the blocks, not at the pace they were captured */
+    bool                    loop;           /*!< Start over at the end rather than finish */
+} i2s_replay_cfg_t;
+
+/**
+ * @brief      Progress through the trace and how well the pacing was kept
+ */
+typedef struct {
+    uint32_t                blocks;
+    uint64_t                bytes;
+    uint32_t                loops;          /*!< Times the trace was started over */
+    uint32_t                gaps;           /*!< Records the capture lost blocks before */
+    uint32_t                late;           /*!< Blocks read out after they were due */
+    uint32_t                max_late_us;
+} i2s_replay_stats_t;
+
+#define I2S_REPLAY_TASK_STACK          (3 * 1024)
+#define I2S_REPLAY_TASK_CORE           (0)
+#define I2S_REPLAY_TASK_PRIO           (23)
+#define I2S_REPLAY_RINGBUFFER_SIZE     (8 * 1024)
+#define I2S_REPLAY_BUFFER_LEN          (1024)
+
+#define DEFAULT_I2S_REPLAY_CONFIG() {\
+    .out_rb_size        = I2S_REPLAY_RINGBUFFER_SIZE,\
+    .task_stack         = I2S_REPLAY_TASK_STACK,\
+    .task_core          = I2S_REPLAY_TASK_CORE,\
+    .task_prio          = I2S_REPLAY_TASK_PRIO,\
+    .stack_in_ext       = true,\
+    .path               = NULL,\
+    .fast               = false,\
+    .loop               = true,\
+}
+
+/**
+ * @brief      Create an Audio Element that plays a recorded I2S trace into
+ *             the pipeline in place of the I2S reader: the same blocks in
+ *             the same format, each held back until as long after the one
+ *             before as it was captured, or with fast as soon as there is
+ *             room for it. The trace is opened here so its format is known
+ *             before the rest of the pipeline is set up
+ *
+ * @param      config  The configuration
+ *
+ * @return     The audio element handle, NULL if the trace cannot be read
+ */
+audio_element_handle_t i2s_replay_init(i2s_replay_cfg_t *config);
+
+/**
+ * @brief      The trace's capture format
+ */
+esp_err_t i2s_replay_get_format(audio_element_handle_t self, int *sample_rate, int *bits, int *channels);
+
+/**
+ * @brief      Switch between the captured pacing and as fast as possible,
+ *             from the next block. Safe to call from any task
+ */
+esp_err_t i2s_replay_set_fast(audio_element_handle_t self, bool fast);
+
+esp_err_t i2s_replay_get_stats(audio_element_handle_t self, i2s_replay_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* MAIN_I2S_REPLAY_H_ */
@@ -0,0 +1,90 @@
+/*
+ * i2s_trace.c
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: xenir
+ */
+
+#include <string.h>
+
+#include "i2s_trace.h"
+
+_Static_assert( sizeof(i2s_trace_header_t) == 16, "Trace header is 16 bytes on disk" );
+_Static_assert( sizeof(i2s_trace_record_t) == 8, "Record header is 8 bytes on disk" );
+
+void i2s_trace_header_init( i2s_trace_header_t* header, int sample_rate, int bits, int channels )
+{
+    memset( header, 0, sizeof(i2s_trace_header_t) );
+    memcpy( header->magic, I2S_TRACE_MAGIC, 4 );
+    header->version = I2S_TRACE_VERSION;
+    header->header_size = sizeof(i2s_trace_header_t);
+    header->sample_rate = sample_rate;
+    header->bits = bits;
+    header->channels = channels;
+}
+
+bool i2s_trace_header_valid( const i2s_trace_header_t* header )
+{
+    return memcmp( header->magic, I2S_TRACE_MAGIC, 4 ) == 0 && header->version == I2S_TRACE_VERSION &&
+            header->header_size >= sizeof(i2s_trace_header_t) &&
+            header->sample_rate >= 8000 && header->sample_rate <= 48000 &&
+            ( header->bits == 16 || header->bits == 32 ) && header->channels >= 1 && header->channels <= 2;
+}
+
+int i2s_trace_open( i2s_trace_reader_t* reader, const char* path )
+{
+    memset( reader, 0, sizeof(i2s_trace_reader_t) );
+
+    reader->file = fopen( path, "rb" );
+    if ( !reader->file )
+        return -1;
+
+    if ( fread( &reader->header, sizeof(i2s_trace_header_t), 1, reader->file ) != 1 ||
+            !i2s_trace_header_valid( &reader->header ) ) {
+        i2s_trace_close( reader );
+        return -1;
+    }
+
+    return i2s_trace_rewind( reader );
+}
+
+int i2s_trace_next( i2s_trace_reader_t* reader, i2s_trace_record_t* record )
+{
+    if ( reader->remaining && fseek( reader->file, reader->remaining, SEEK_CUR ) != 0 )
+        return -1;
+    reader->remaining = 0;
+
+    size_t n = fread( &reader->record, 1, sizeof(i2s_trace_record_t), reader->file );
+    if ( n == 0 )
+        return 0;
+
+    if ( n != sizeof(i2s_trace_record_t) || reader->record.len == 0 )
+        return -1;
+
+    reader->remaining = reader->record.len;
+    reader->records++;
+    *record = reader->record;
+    return 1;
+}
+
+int i2s_trace_read( i2s_trace_reader_t* reader, void* buf, int len )
+{
+    len = len > reader->remaining ? reader->remaining : len;
+    int n = fread( buf, 1, len, reader->file );
+    reader->remaining -= n;
+    return n;
+}
+
+int i2s_trace_rewind( i2s_trace_reader_t* reader )
+{
+    reader->remaining = 0;
+    reader->records = 0;
+    return fseek( reader->file, reader->header.header_size, SEEK_SET ) == 0 ? 0 : -1;
+}
+
+void i2s_trace_close( i2s_trace_reader_t* reader )
+{
+    if ( reader->file )
+        fclose( reader->file );
+    reader->file = NULL;
+}
@@ -0,0 +1,82 @@
+/*
+ * i2s_trace.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: xenir
+ */
+
+#ifndef MAIN_I2S_TRACE_H_
+#define MAIN_I2S_TRACE_H_
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Recorded I2S input: the raw blocks the capture delivered, in its format,
+// each with the time since the block before it, so the same input can be
+// replayed into the pipeline on the board or the host at the pace it came
+// in and benchmarks compared on identical audio. A file is a header and
+// then records, a record header followed by its block; both little endian,
+// as the ESP32 and the usual hosts write them. It has no length and can be
+// cut anywhere between records, so a capture can be streamed as it is
+// written.
+
+#define I2S_TRACE_MAGIC			"I2ST"
+#define I2S_TRACE_VERSION		1
+#define I2S_TRACE_EXT			".i2st"
+
+#define I2S_TRACE_GAP			0x0001		// Blocks were lost before this one
+
+typedef struct {
+    char		magic[4];
+    uint16_t	version;
+    uint16_t	header_size;			// Records start this far in
+    uint32_t	sample_rate;
+    uint16_t	bits;
+    uint16_t	channels;
+} i2s_trace_header_t;
+
+typedef struct {
+    uint32_t	delta_us;				// Since the block before, 0 for the first
+    uint16_t	len;					// Bytes of block that follow
+    uint16_t	flags;
+} i2s_trace_record_t;
+
+typedef struct {
+    FILE*				file;
+    i2s_trace_header_t	header;
+    i2s_trace_record_t	record;			// The one being read
+    int					remaining;		// Bytes of its block not yet read
+    uint32_t			records;		// Since the start
+} i2s_trace_reader_t;
+
+void i2s_trace_header_init( i2s_trace_header_t* header, int sample_rate, int bits, int channels );
+
+bool i2s_trace_header_valid( const i2s_trace_header_t* header );
+
+// Opens a trace and reads its header. Returns 0, or -1 if it cannot be
+// opened or is not a trace
+int i2s_trace_open( i2s_trace_reader_t* reader, const char* path );
+
+// Moves to the next record, skipping whatever of the current block was not
+// read. Returns 1 with its header in "record", 0 at the end, -1 on a
+// truncated or corrupt record
+int i2s_trace_next( i2s_trace_reader_t* reader, i2s_trace_record_t* record );
+
+// Reads up to "len" bytes of the current block, returning how many
+int i2s_trace_read( i2s_trace_reader_t* reader, void* buf, int len );
+
+// Back to the first record
+int i2s_trace_rewind( i2s_trace_reader_t* reader );
+
+void i2s_trace_close( i2s_trace_reader_t* reader );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* MAIN_I2S_TRACE_H_ */
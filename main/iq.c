@@ -0,0 +1,205 @@
+/*
+ * iq.c
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: xenir
+ */
+
+#include <string.h>
+#include <strings.h>
+#include <math.h>
+
+#include "iq.h"
+
+#define DC_HZ				5			// Corner of the DC removal
+#define AM_CARRIER_HZ		10			// Corner of the carrier removal after the envelope
+#define BALANCE_MS			1000		// About how long the imbalance estimate averages over
+#define MAX_PHASE			0.5f		// Sine of the most phase error corrected, 30 degrees
+#define MAX_GAIN			2.0f		// Most amplitude ratio corrected, 6 dB
+
+static const char* mode_names[IQ_MODES] = { "off", "usb", "lsb", "am" };
+
+static float _corner( int sample_rate, int hz )
+{
+    return 1 - expf( -2 * M_PI * hz / sample_rate );
+}
+
+static void _derive( iq_t* iq )
+{
+    float w = -2 * M_PI * iq->params.offset_hz / iq->sample_rate;
+
+    iq->rot_re = cosf( w );
+    iq->rot_im = sinf( w );
+    iq->dc_k = iq->params.dc ? _corner( iq->sample_rate, DC_HZ ) : 0;
+    if ( !iq->params.dc ) {
+        iq->dc_i = 0;
+        iq->dc_q = 0;
+    }
+}
+
+void iq_init( iq_t* iq, int sample_rate, const iq_params_t* params )
+{
+    memset( iq, 0, sizeof(iq_t) );
+    iq->sample_rate = sample_rate > 0 ? sample_rate : 16000;
+    iq->params = *params;
+    iq->scale = 1;
+    iq->nco_re = 1;
+    iq->am_k = _corner( iq->sample_rate, AM_CARRIER_HZ );
+
+    // Ideal Hilbert transformer 2 / ( pi n ) on odd n, Hamming windowed
+    for ( int j = 0 ; j < ( IQ_HILBERT_HALF + 1 ) / 2 ; j++ ) {
+        int m = 2 * j + 1;
+        iq->hilbert[j] = 2 / ( M_PI * m ) * ( 0.54f + 0.46f * cosf( M_PI * m / IQ_HILBERT_HALF ) );
+    }
+
+    _derive( iq );
+}
+
+void iq_set_params( iq_t* iq, const iq_params_t* params )
+{
+    iq->params = *params;
+    _derive( iq );
+}
+
+const char* iq_mode_name( int mode )
+{
+    return mode >= 0 && mode < IQ_MODES ? mode_names[mode] : "?";
+}
+
+int iq_mode_parse( const char* name )
+{
+    for ( int m = 0 ; m < IQ_MODES ; m++ )
+        if ( strcasecmp( name, mode_names[m] ) == 0 )
+            return m;
+    return -1;
+}
+
+void iq_imbalance( const iq_t* iq, float* gain_db, float* phase_deg )
+{
+    float p = iq->ii * iq->qq;
+    *gain_db = iq->ii > 0 && iq->qq > 0 ? 10 * log10f( iq->qq / iq->ii ) : 0;
+    *phase_deg = p > 0 ? asinf( fmaxf( -1, fminf( 1, iq->iq / sqrtf( p ) ) ) ) * 180 / M_PI : 0;
+}
+
+// The correction for the next block from the moments of this one. With
+// Q = g sin( wt + phi ) against I = cos( wt ), taking out the part of Q
+// that correlates with I and scaling what is left to I's power gives back
+// sin( wt ). A signal that really is lopsided, the same audio on both
+// channels say, would ask for more than any front end gets wrong, so the
+// correction is held to MAX_PHASE and MAX_GAIN
+
+static void _balance( iq_t* iq, int frames, float sii, float sqq, float siq )
+{
+    float k = (float) frames * 1000 / ( (float) iq->sample_rate * BALANCE_MS );
+    k = k > 1 ? 1 : k;
+
+    iq->ii += k * ( sii / frames - iq->ii );
+    iq->qq += k * ( sqq / frames - iq->qq );
+    iq->iq += k * ( siq / frames - iq->iq );
+
+    if ( !iq->params.balance || iq->ii < 1 || iq->qq < 1 ) {
+        iq->cross = 0;
+        iq->scale = 1;
+        return;
+    }
+
+    float ri = sqrtf( iq->ii ), rq = sqrtf( iq->qq );
+    float rho = iq->iq / ( ri * rq );
+    float g = rq / ri;
+
+    rho = rho > MAX_PHASE ? MAX_PHASE : ( rho < -MAX_PHASE ? -MAX_PHASE : rho );
+    g = g > MAX_GAIN ? MAX_GAIN : ( g < 1 / MAX_GAIN ? 1 / MAX_GAIN : g );
+
+    iq->cross = -rho * g;
+    iq->scale = 1 / ( g * sqrtf( 1 - rho * rho ) );
+}
+
+// One frame, I and Q in, audio out
+
+static inline float _frame( iq_t* iq, float i, float q, float* sii, float* sqq, float* siq )
+{
+    iq->dc_i += iq->dc_k * ( i - iq->dc_i );
+    iq->dc_q += iq->dc_k * ( q - iq->dc_q );
+    i -= iq->dc_i;
+    q -= iq->dc_q;
+
+    *sii += i * i;
+    *sqq += q * q;
+    *siq += i * q;
+
+    q = iq->scale * ( q + iq->cross * i );
+
+    // Shift down by offset_hz: times e^( -j w n )
+
+    float c = iq->nco_re, s = iq->nco_im;
+    float re = i * c - q * s;
+    float im = i * s + q * c;
+    iq->nco_re = c * iq->rot_re - s * iq->rot_im;
+    iq->nco_im = c * iq->rot_im + s * iq->rot_re;
+
+    if ( iq->params.mode == IQ_MODE_AM ) {
+        float env = sqrtf( re * re + im * im );
+        iq->am_dc += iq->am_k * ( env - iq->am_dc );
+        return env - iq->am_dc;
+    }
+
+    // Phasing method: for I + jQ holding only positive frequencies, Q is
+    // the Hilbert transform of I and H{ Q } = -I, so I - H{ Q } is twice
+    // the upper sideband and the lower cancels. The centre tap of the delay
+    // line is I delayed to line up with the transformer's output
+
+    int p = iq->pos;
+    iq->hist_i[p] = iq->hist_i[p + IQ_HILBERT_TAPS] = re;
+    iq->hist_q[p] = iq->hist_q[p + IQ_HILBERT_TAPS] = im;
+    iq->pos = p + 1 == IQ_HILBERT_TAPS ? 0 : p + 1;
+
+    // Two sums, so each add need not wait for the one before
+    const float* x = &iq->hist_q[iq->pos + IQ_HILBERT_HALF];
+    float h0 = 0, h1 = 0;
+    for ( int j = 0 ; j < ( IQ_HILBERT_HALF + 1 ) / 2 ; j += 2 ) {
+        h0 += iq->hilbert[j] * ( x[-2 * j - 1] - x[2 * j + 1] );
+        h1 += iq->hilbert[j + 1] * ( x[-2 * j - 3] - x[2 * j + 3] );
+    }
+    float h = h0 + h1;
+
+    float d = iq->hist_i[iq->pos + IQ_HILBERT_HALF];
+    return 0.5f * ( iq->params.mode == IQ_MODE_USB ? d - h : d + h );
+}
+
+void iq_process( iq_t* iq, void* buf, int bits, int frames )
+{
+    if ( iq->params.mode == IQ_MODE_OFF || frames <= 0 )
+        return;
+
+    float sii = 0, sqq = 0, siq = 0;
+    int first = iq->params.swap ? 1 : 0;
+
+    if ( bits == 32 ) {
+
+        // The sample left justified in the slot, worked on in 16 bit units
+        // keeping the bits below
+
+        int32_t* s = (int32_t*) buf;
+        for ( int n = 0 ; n < frames ; n++ ) {
+            float y = 65536.0f * _frame( iq, s[2*n+first] / 65536.0f, s[2*n+1-first] / 65536.0f, &sii, &sqq, &siq );
+            int32_t v = y > 2147483520.0f ? INT32_MAX : ( y < -2147483648.0f ? INT32_MIN : (int32_t) lrintf( y ) );
+            s[2*n] = s[2*n+1] = v;
+        }
+
+    } else {
+
+        int16_t* s = (int16_t*) buf;
+        for ( int n = 0 ; n < frames ; n++ ) {
+            float y = _frame( iq, s[2*n+first], s[2*n+1-first], &sii, &sqq, &siq );
+            s[2*n] = s[2*n+1] = y > 32767 ? 32767 : ( y < -32768 ? -32768 : lrintf( y ) );
+        }
+    }
+
+    // The oscillator's magnitude drifts from rounding, put back once a block
+    float m = 1 / sqrtf( iq->nco_re * iq->nco_re + iq->nco_im * iq->nco_im );
+    iq->nco_re *= m;
+    iq->nco_im *= m;
+
+    _balance( iq, frames, sii, sqq, siq );
+    iq->blocks++;
+}
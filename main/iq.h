@@ -0,0 +1,114 @@
+/*
+ * iq.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: xenir
+ */
+
+#ifndef MAIN_IQ_H_
+#define MAIN_IQ_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Demodulation of quadrature (I/Q) input: a stereo pair from an SDR front
+// end, I on the left and Q on the right, taken as the complex baseband
+// I + jQ in which positive frequencies are the upper sideband. In order:
+//
+//   - DC removal on I and Q, a one pole high-pass taking out the local
+//     oscillator leakage and converter offsets at 0 Hz
+//   - gain and phase imbalance correction, Q made orthogonal to I and of
+//     the same power from their running second moments, which for any
+//     signal that is not itself lopsided is what a balanced front end gives
+//   - a shift by offset_hz, so the carrier of the wanted signal sits at 0 Hz
+//   - USB or LSB by the phasing method, I delayed against Q through a
+//     Hilbert transformer and the two added or subtracted, or AM as the
+//     envelope sqrt( I^2 + Q^2 ) less its mean, the carrier
+//
+// The result is real audio; a tone comes out at the level it had in I. The
+// DC removal would take an AM carrier sitting at 0 Hz with it, so AM wants
+// an offset, or dc turned off for a zero IF feed.
+//
+// Single precision float throughout, which the ESP32's FPU does as fast as
+// the fixed point equivalent. The Hilbert transformer is a Hamming windowed
+// type III FIR of IQ_HILBERT_TAPS taps, every other one zero and the rest
+// antisymmetric, so IQ_HILBERT_TAPS / 4 multiplies a sample; at 16 kHz it
+// holds the opposite sideband over 40 dB down from 200 Hz to 7.8 kHz and
+// delays SSB by IQ_HILBERT_TAPS / 2 samples (4 ms).
+
+#define IQ_HILBERT_TAPS		127
+#define IQ_HILBERT_HALF		( IQ_HILBERT_TAPS / 2 )
+
+typedef enum {
+    IQ_MODE_OFF = 0,						// Input passes through untouched
+    IQ_MODE_USB,
+    IQ_MODE_LSB,
+    IQ_MODE_AM,
+    IQ_MODES
+} iq_mode_t;
+
+typedef struct {
+    int		mode;					// iq_mode_t
+    int		offset_hz;				// Baseband frequency moved to 0 Hz, within +-rate / 2
+    bool	dc;						// Remove DC from I and Q
+    bool	balance;				// Correct gain and phase imbalance
+    bool	swap;					// Front end with Q on the left
+} iq_params_t;
+
+#define DEFAULT_IQ_PARAMS() {\
+    .mode               = IQ_MODE_OFF,\
+    .offset_hz          = 0,\
+    .dc                 = true,\
+    .balance            = true,\
+    .swap               = false,\
+}
+
+typedef struct {
+
+    iq_params_t		params;
+    int				sample_rate;
+
+    float			dc_i, dc_q;				// DC estimates
+    float			dc_k;
+    float			ii, qq, iq;				// Smoothed second moments after the DC removal
+    float			cross, scale;			// Q' = scale * ( Q + cross * I )
+    float			nco_re, nco_im;			// Oscillator for the shift
+    float			rot_re, rot_im;			// Its step per sample
+    float			am_dc, am_k;			// AM carrier level
+
+    float			hist_i[2 * IQ_HILBERT_TAPS];	// Delay lines, written twice so a
+    float			hist_q[2 * IQ_HILBERT_TAPS];	// window of taps never wraps
+    int				pos;
+    float			hilbert[( IQ_HILBERT_HALF + 1 ) / 2];	// Taps 1, 3, 5 ... from the centre
+
+    uint32_t		blocks;
+
+} iq_t;
+
+void iq_init( iq_t* iq, int sample_rate, const iq_params_t* params );
+
+// Changes parameters keeping the DC and imbalance estimates
+void iq_set_params( iq_t* iq, const iq_params_t* params );
+
+// Demodulates "frames" stereo frames of 16 or 32 bit samples in place,
+// writing the audio to both channels. Does nothing in IQ_MODE_OFF
+void iq_process( iq_t* iq, void* buf, int bits, int frames );
+
+// Imbalance the correction takes out: Q's gain against I in dB, and how
+// far from 90 degrees apart they are
+void iq_imbalance( const iq_t* iq, float* gain_db, float* phase_deg );
+
+const char* iq_mode_name( int mode );
+
+// Mode from its name, -1 for none
+int iq_mode_parse( const char* name );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* MAIN_IQ_H_ */
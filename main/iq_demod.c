@@ -0,0 +1,216 @@
+/*
+ * iq_demod.c
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: xenir
+ */
+
+#include <string.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "esp_log.h"
+#include "audio_mem.h"
+#include "audio_element.h"
+#include "audio_error.h"
+
+#include "cycle_count.h"
+#include "iq_demod.h"
+
+static const char *TAG = "iq_demod";
+
+typedef struct iq_demod {
+
+    iq_t				iq;
+    int					bits;
+    int					channels;
+
+    // Staged like voice_dsp's, applied by the element task between blocks
+    SemaphoreHandle_t	lock;
+    iq_params_t			pending;
+    volatile bool		dirty;
+    int					pending_rate;
+    int					pending_bits;
+    int					pending_channels;
+    volatile bool		format_dirty;
+
+    iq_demod_stats_t	stats;
+
+    iq_demod_tap_t		input_tap;
+    void*				input_tap_ctx;
+
+} iq_demod_t;
+
+static esp_err_t _iq_demod_destroy(audio_element_handle_t self)
+{
+    iq_demod_t *dm = (iq_demod_t *)audio_element_getdata(self);
+    vSemaphoreDelete(dm->lock);
+    audio_free(dm);
+    return ESP_OK;
+}
+
+static esp_err_t _iq_demod_open(audio_element_handle_t self)
+{
+    ESP_LOGD(TAG, "_iq_demod_open");
+    return ESP_OK;
+}
+
+static esp_err_t _iq_demod_close(audio_element_handle_t self)
+{
+    ESP_LOGD(TAG, "_iq_demod_close");
+    if (AEL_STATE_PAUSED != audio_element_get_state(self)) {
+        audio_element_set_byte_pos(self, 0);
+        audio_element_set_total_bytes(self, 0);
+    }
+    return ESP_OK;
+}
+
+static int _iq_demod_process(audio_element_handle_t self, char *in_buffer, int in_len)
+{
+    iq_demod_t *dm = (iq_demod_t *)audio_element_getdata(self);
+
+    int r_size = audio_element_input(self, in_buffer, in_len);
+    if (r_size <= 0)
+        return r_size;
+
+    if (dm->input_tap)
+        dm->input_tap(in_buffer, r_size, dm->input_tap_ctx);
+
+    if (dm->dirty) {
+        xSemaphoreTake(dm->lock, portMAX_DELAY);
+        iq_set_params(&dm->iq, &dm->pending);
+        dm->dirty = false;
+        xSemaphoreGive(dm->lock);
+    }
+
+    if (dm->format_dirty) {
+        xSemaphoreTake(dm->lock, portMAX_DELAY);
+        iq_init(&dm->iq, dm->pending_rate, &dm->pending);
+        dm->bits = dm->pending_bits;
+        dm->channels = dm->pending_channels;
+        dm->format_dirty = false;
+        xSemaphoreGive(dm->lock);
+        ESP_LOGI(TAG, "Format now %d Hz %d bit %d channel", dm->iq.sample_rate, dm->bits, dm->channels);
+    }
+
+    // Mono has no Q, so there is nothing to demodulate
+
+    int mode = dm->channels == 2 ? dm->iq.params.mode : IQ_MODE_OFF;
+    if (mode != IQ_MODE_OFF) {
+
+        int frames = r_size / (dm->bits / 8 * 2);
+
+        uint32_t start = cycle_count_get();
+        iq_process(&dm->iq, in_buffer, dm->bits, frames);
+        uint32_t cycles = cycle_count_get() - start;
+
+        dm->stats.blocks[mode]++;
+        dm->stats.frames[mode] += frames;
+        dm->stats.cycles[mode] += cycles;
+    }
+
+    int out_len = audio_element_output(self, in_buffer, r_size);
+    if (out_len > 0) {
+        audio_element_update_byte_pos(self, out_len);
+    }
+
+    return out_len;
+}
+
+esp_err_t iq_demod_set_params(audio_element_handle_t self, const iq_params_t *params)
+{
+    iq_demod_t *dm = (iq_demod_t *)audio_element_getdata(self);
+
+    if (params->mode < IQ_MODE_OFF || params->mode >= IQ_MODES)
+        return ESP_ERR_INVALID_ARG;
+
+    xSemaphoreTake(dm->lock, portMAX_DELAY);
+    dm->pending = *params;
+    dm->dirty = true;
+    xSemaphoreGive(dm->lock);
+
+    return ESP_OK;
+}
+
+esp_err_t iq_demod_get_params(audio_element_handle_t self, iq_params_t *params)
+{
+    iq_demod_t *dm = (iq_demod_t *)audio_element_getdata(self);
+
+    xSemaphoreTake(dm->lock, portMAX_DELAY);
+    *params = dm->pending;
+    xSemaphoreGive(dm->lock);
+
+    return ESP_OK;
+}
+
+esp_err_t iq_demod_set_format(audio_element_handle_t self, int sample_rate, int bits, int channels)
+{
+    iq_demod_t *dm = (iq_demod_t *)audio_element_getdata(self);
+
+    if ((bits != 16 && bits != 32) || channels < 1 || channels > 2)
+        return ESP_ERR_INVALID_ARG;
+
+    xSemaphoreTake(dm->lock, portMAX_DELAY);
+    dm->pending_rate = sample_rate;
+    dm->pending_bits = bits;
+    dm->pending_channels = channels;
+    dm->format_dirty = true;
+    xSemaphoreGive(dm->lock);
+
+    return ESP_OK;
+}
+
+esp_err_t iq_demod_get_stats(audio_element_handle_t self, iq_demod_stats_t *stats)
+{
+    iq_demod_t *dm = (iq_demod_t *)audio_element_getdata(self);
+    *stats = dm->stats;
+    stats->dc_i = dm->iq.dc_i;
+    stats->dc_q = dm->iq.dc_q;
+    iq_imbalance(&dm->iq, &stats->gain_db, &stats->phase_deg);
+    return ESP_OK;
+}
+
+esp_err_t iq_demod_set_input_tap(audio_element_handle_t self, iq_demod_tap_t tap, void *ctx)
+{
+    iq_demod_t *dm = (iq_demod_t *)audio_element_getdata(self);
+    dm->input_tap = tap;
+    dm->input_tap_ctx = ctx;
+    return ESP_OK;
+}
+
+audio_element_handle_t iq_demod_init(iq_demod_cfg_t *config)
+{
+    iq_demod_t *dm = audio_calloc(1, sizeof(iq_demod_t));
+    AUDIO_MEM_CHECK(TAG, dm, {return NULL;});
+
+    audio_element_cfg_t cfg = DEFAULT_AUDIO_ELEMENT_CONFIG();
+    cfg.destroy = _iq_demod_destroy;
+    cfg.process = _iq_demod_process;
+    cfg.open = _iq_demod_open;
+    cfg.close = _iq_demod_close;
+    cfg.buffer_len = IQ_DEMOD_BUFFER_LEN;
+    cfg.task_stack = config->task_stack ? config->task_stack : IQ_DEMOD_TASK_STACK;
+    cfg.stack_in_ext = config->stack_in_ext;
+    cfg.task_prio = config->task_prio;
+    cfg.task_core = config->task_core;
+    cfg.out_rb_size = config->out_rb_size;
+    cfg.tag = "iq";
+
+    dm->lock = xSemaphoreCreateMutex();
+    AUDIO_MEM_CHECK(TAG, dm->lock, {audio_free(dm); return NULL;});
+
+    iq_init(&dm->iq, config->sample_rate, &config->params);
+    dm->bits = config->bits;
+    dm->channels = config->channels;
+    dm->pending = config->params;
+
+    ESP_LOGI(TAG, "I/Q Config: Sample Rate: %d Bits: %d Channels: %d Mode: %s Offset: %d Hz",
+            config->sample_rate, config->bits, config->channels,
+            iq_mode_name(config->params.mode), config->params.offset_hz);
+
+    audio_element_handle_t el = audio_element_init(&cfg);
+    AUDIO_MEM_CHECK(TAG, el, {vSemaphoreDelete(dm->lock); audio_free(dm); return NULL;});
+    audio_element_setdata(el, dm);
+
+    return el;
+}
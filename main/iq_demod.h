@@ -0,0 +1,113 @@
+/*
+ * iq_demod.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: xenir
+ */
+
+#ifndef MAIN_IQ_DEMOD_H_
+#define MAIN_IQ_DEMOD_H_
+
+#include <stdint.h>
+
+#include "esp_err.h"
+#include "audio_element.h"
+#include "iq.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief      I/Q demodulator configurations
+ */
+typedef struct {
+    int                     out_rb_size;    /*!< Size of output ringbuffer */
+    int                     task_stack;     /*!< Task stack size */
+    int                     task_core;      /*!< Task running in core (0 or 1) */
+    int                     task_prio;      /*!< Task priority (based on freeRTOS priority) */
+    bool                    stack_in_ext;   /*!< Try to allocate stack in external memory */
+
+    int                     sample_rate;
+    int                     bits;           /*!< Sample size, 16 or 32, the same in and out */
+    int                     channels;       /*!< 2 for I/Q, 1 passes through whatever the mode */
+    iq_params_t             params;         /*!< Initial mode and corrections */
+} iq_demod_cfg_t;
+
+/**
+ * @brief      Processing cost since the element was created, per mode so
+ *             each can be compared, and the front end's imbalance as
+ *             estimated
+ */
+typedef struct {
+    uint32_t                blocks[IQ_MODES];
+    uint64_t                frames[IQ_MODES];
+    uint64_t                cycles[IQ_MODES];
+    float                   dc_i, dc_q;     /*!< Offsets removed, in 16 bit units */
+    float                   gain_db;        /*!< Q against I */
+    float                   phase_deg;      /*!< Away from quadrature */
+} iq_demod_stats_t;
+
+typedef void (*iq_demod_tap_t)(const char *buf, int len, void *ctx);
+
+#define IQ_DEMOD_TASK_STACK          (3 * 1024)
+#define IQ_DEMOD_TASK_CORE           (1)
+#define IQ_DEMOD_TASK_PRIO           (22)
+#define IQ_DEMOD_RINGBUFFER_SIZE     (8 * 1024)
+#define IQ_DEMOD_BUFFER_LEN          (1024)
+
+#define DEFAULT_IQ_DEMOD_CONFIG() {\
+    .out_rb_size        = IQ_DEMOD_RINGBUFFER_SIZE,\
+    .task_stack         = IQ_DEMOD_TASK_STACK,\
+    .task_core          = IQ_DEMOD_TASK_CORE,\
+    .task_prio          = IQ_DEMOD_TASK_PRIO,\
+    .stack_in_ext       = true,\
+    .sample_rate        = 16000,\
+    .bits               = 16,\
+    .channels           = 2,\
+    .params             = DEFAULT_IQ_PARAMS(),\
+}
+
+/**
+ * @brief      Create an Audio Element that takes stereo PCM as the I and Q
+ *             of a quadrature front end and demodulates it in place, USB,
+ *             LSB or AM, writing the audio to both channels so everything
+ *             after it sees the format it had. Off by default, and then
+ *             the input passes through untouched
+ *
+ * @param      config  The configuration
+ *
+ * @return     The audio element handle
+ */
+audio_element_handle_t iq_demod_init(iq_demod_cfg_t *config);
+
+/**
+ * @brief      Change the mode, offset and corrections. Safe to call from
+ *             any task while the pipeline runs; they are picked up at the
+ *             next block
+ */
+esp_err_t iq_demod_set_params(audio_element_handle_t self, const iq_params_t *params);
+
+esp_err_t iq_demod_get_params(audio_element_handle_t self, iq_params_t *params);
+
+/**
+ * @brief      Change the input format, picked up at the next block with the
+ *             same care needed as voice_dsp_set_format
+ */
+esp_err_t iq_demod_set_format(audio_element_handle_t self, int sample_rate, int bits, int channels);
+
+esp_err_t iq_demod_get_stats(audio_element_handle_t self, iq_demod_stats_t *stats);
+
+/**
+ * @brief      Attach a tap, called in the element task with every block as
+ *             read, before anything is done to it. Being the first element
+ *             after the I2S reader, that is the raw capture. Call before the
+ *             pipeline runs
+ */
+esp_err_t iq_demod_set_input_tap(audio_element_handle_t self, iq_demod_tap_t tap, void *ctx);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* MAIN_IQ_DEMOD_H_ */
@@ -0,0 +1,134 @@
+/*
+ * latency.c
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: xenir
+ */
+
+#include <string.h>
+
+#include "latency.h"
+
+static void _set_level( latency_t* l, int level )
+{
+    l->level = level;
+    l->block_ms = l->params.min_block_ms << level;
+    if ( l->block_ms > l->params.max_block_ms )
+        l->block_ms = l->params.max_block_ms;
+    l->queue_ms = l->block_ms * l->params.queue_blocks;
+}
+
+static void _record( latency_t* l, int64_t now_us, latency_reason_t reason )
+{
+    latency_change_t* c = &l->history[l->changes % LATENCY_HISTORY];
+
+    c->time_ms = ( now_us - l->start_us ) / 1000;
+    c->block_ms = l->block_ms;
+    c->queue_ms = l->queue_ms;
+    c->max_send_ms = l->max_send_us / 1000;
+    c->reason = reason;
+    l->changes++;
+}
+
+void latency_init( latency_t* l, const latency_params_t* params )
+{
+    memset( l, 0, sizeof(latency_t) );
+    l->params = *params;
+
+    if ( l->params.min_block_ms < 1 )
+        l->params.min_block_ms = 1;
+    if ( l->params.max_block_ms < l->params.min_block_ms )
+        l->params.max_block_ms = l->params.min_block_ms;
+    if ( l->params.queue_blocks < 1 )
+        l->params.queue_blocks = 1;
+
+    l->levels = 1;
+    while ( ( l->params.min_block_ms << ( l->levels - 1 ) ) < l->params.max_block_ms )
+        l->levels++;
+
+    _set_level( l, l->levels - 1 );
+}
+
+void latency_reset( latency_t* l, int64_t now_us )
+{
+    _set_level( l, l->levels - 1 );
+
+    l->start_us = now_us;
+    l->window_us = now_us;
+    l->max_send_us = 0;
+    l->max_queue_ms = 0;
+    l->drops = 0;
+    l->calm = 0;
+    l->changes = 0;
+    _record( l, now_us, LATENCY_START );
+}
+
+bool latency_update( latency_t* l, int64_t now_us, uint32_t send_us, int queue_ms, bool dropped )
+{
+    if ( send_us > l->max_send_us )
+        l->max_send_us = send_us;
+    if ( queue_ms > l->max_queue_ms )
+        l->max_queue_ms = queue_ms;
+    if ( dropped )
+        l->drops++;
+
+    if ( !l->params.enable || now_us - l->window_us < (int64_t) l->params.window_ms * 1000 )
+        return false;
+
+    // Percentages of the block in microseconds: ms * 1000 * pct / 100
+
+    uint32_t grow_us = l->block_ms * 10 * l->params.grow_pct;
+    uint32_t shrink_us = l->block_ms * 10 * l->params.shrink_pct;
+    int level = l->level;
+    latency_reason_t reason = LATENCY_SHRINK;
+
+    if ( l->drops || l->max_send_us > grow_us ) {
+
+        l->calm = 0;
+        reason = l->drops ? LATENCY_GROW_DROP : LATENCY_GROW_SEND;
+        if ( level < l->levels - 1 )
+            level++;
+
+    } else if ( l->max_send_us < shrink_us && l->max_queue_ms < l->queue_ms / 2 ) {
+
+        if ( ++l->calm >= l->params.calm_windows && level > 0 &&
+             l->block_ms + l->queue_ms > l->params.target_ms ) {
+            l->calm = 0;
+            level--;
+        }
+
+    } else {
+        l->calm = 0;
+    }
+
+    bool changed = level != l->level;
+    if ( changed ) {
+        _set_level( l, level );
+        _record( l, now_us, reason );
+    }
+
+    l->window_us = now_us;
+    l->max_send_us = 0;
+    l->max_queue_ms = 0;
+    l->drops = 0;
+
+    return changed;
+}
+
+const latency_change_t* latency_history( const latency_t* l, int n )
+{
+    if ( n < 0 || n >= LATENCY_HISTORY || (uint32_t) n >= l->changes )
+        return NULL;
+    return &l->history[( l->changes - 1 - n ) % LATENCY_HISTORY];
+}
+
+const char* latency_reason_name( int reason )
+{
+    switch ( reason ) {
+        case LATENCY_START:		return "start";
+        case LATENCY_GROW_SEND:	return "slow_send";
+        case LATENCY_GROW_DROP:	return "drop";
+        case LATENCY_SHRINK:	return "calm";
+        default:				return "?";
+    }
+}
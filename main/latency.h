@@ -0,0 +1,109 @@
+/*
+ * latency.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: xenir
+ */
+
+#ifndef MAIN_LATENCY_H_
+#define MAIN_LATENCY_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Picks the streamer's block length and the most audio it lets queue in
+// front of it. Operating points double the block from min_block_ms up to
+// max_block_ms, the queue limit being queue_blocks blocks. Every window the
+// slowest send and the deepest queue are checked: a send taking more than
+// grow_pct of a block, or audio dropped at the queue limit, moves one point
+// up at once. A point is only left downwards after calm_windows windows in
+// a row with every send under shrink_pct of a block and the queue under half
+// its limit, and only while block plus queue is above target_ms.
+
+typedef struct {
+    bool	enable;				// Off holds the largest point
+    int		target_ms;			// Block plus queue to shrink towards
+    int		min_block_ms;
+    int		max_block_ms;
+    int		queue_blocks;		// Queue limit in blocks
+    int		window_ms;
+    int		grow_pct;
+    int		shrink_pct;
+    int		calm_windows;
+} latency_params_t;
+
+#define DEFAULT_LATENCY_PARAMS() {\
+    .enable             = true,\
+    .target_ms          = 64,\
+    .min_block_ms       = 16,\
+    .max_block_ms       = 64,\
+    .queue_blocks       = 3,\
+    .window_ms          = 1000,\
+    .grow_pct           = 50,\
+    .shrink_pct         = 10,\
+    .calm_windows       = 5,\
+}
+
+#define LATENCY_HISTORY		16
+
+typedef enum {
+    LATENCY_START = 0,
+    LATENCY_GROW_SEND,			// A send took too long
+    LATENCY_GROW_DROP,			// Audio was dropped at the queue limit
+    LATENCY_SHRINK,
+} latency_reason_t;
+
+typedef struct {
+    uint32_t			time_ms;	// Since the controller was reset
+    uint16_t			block_ms;
+    uint16_t			queue_ms;
+    uint16_t			max_send_ms;	// Slowest send in the window that caused the move
+    uint8_t				reason;			// latency_reason_t
+} latency_change_t;
+
+typedef struct {
+
+    latency_params_t	params;
+
+    int					level;			// Index of the operating point
+    int					levels;
+    int					block_ms;
+    int					queue_ms;
+
+    int64_t				start_us;
+    int64_t				window_us;		// Start of the current window
+    uint32_t			max_send_us;
+    int					max_queue_ms;
+    uint32_t			drops;
+    int					calm;
+
+    uint32_t			changes;		// Total, the history keeps the last LATENCY_HISTORY
+    latency_change_t	history[LATENCY_HISTORY];
+
+} latency_t;
+
+void latency_init( latency_t* l, const latency_params_t* params );
+
+// Starts over for a new listener at the largest point, so the link has to
+// prove itself before the latency comes down
+void latency_reset( latency_t* l, int64_t now_us );
+
+// Feeds one block: the time its send took, the queue depth in front of the
+// streamer when it was read and whether audio was dropped to hold the queue
+// limit. Returns true when the operating point changed
+bool latency_update( latency_t* l, int64_t now_us, uint32_t send_us, int queue_ms, bool dropped );
+
+// Change "n" back from the newest, 0 being the newest. NULL past the history
+const latency_change_t* latency_history( const latency_t* l, int n );
+
+const char* latency_reason_name( int reason );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* MAIN_LATENCY_H_ */
@@ -5,6 +5,7 @@
 #include "freertos/task.h"
 #include "sdkconfig.h"
 #include "esp_log.h"
+#include "esp_timer.h"
 #include "wifi.h"
 
 #include "webserver.h"
@@ -13,6 +14,21 @@
 #include "i2s_stream.h"
 #include "board.h"
 #include "streaming_http_audio.h"
+#include "hls_segmenter.h"
+#include "iq_demod.h"
+#include "voice_dsp.h"
+#include "mixer.h"
+#include "tee.h"
+#include "probe.h"
+#include "streaming_wav.h"
+#include "spectrum_tap.h"
+#include "tone_tap.h"
+#include "i2s_capture.h"
+#include "i2s_replay.h"
+#include "sysmon.h"
+#include "block_pool.h"
+#include "boot.h"
+#include "trace.h"
 
 
 #define BASE_PATH "/spiffs"
@@ -20,9 +36,829 @@ static const char *TAG = "esp32-streaming-audio";
 
 #define STATUS_LED	2
 
+#define FORMAT_SWITCH_TIMEOUT_MS	500
+#define AUDIO_POOL_BLOCKS			3		// HTTP streamer output, DTX hold and resampler
+#define TONE_POOL_BLOCK				512		// Generator buffer for the mixer tone
+#define STREAM_ALIAS_PORT			8080	// Where the stream used to have its own server
+
+static audio_pipeline_handle_t pipeline = NULL;
+static audio_event_iface_handle_t evt = NULL;
+static audio_element_handle_t i2s_stream_reader = NULL;		// Or the trace replay, see replaying
+static audio_element_handle_t i2s_stream_writer = NULL;
+static audio_element_handle_t iq_demod = NULL;
+static audio_element_handle_t voice_dsp = NULL;
+static audio_element_handle_t mixer = NULL;
+static audio_element_handle_t tee = NULL;
+static audio_element_handle_t http_audio = NULL;
+static hls_segmenter_handle_t hls = NULL;
+static spectrum_tap_handle_t spectrum = NULL;
+static tone_tap_handle_t tone_detect = NULL;
+static i2s_capture_handle_t capture = NULL;
+
+// Set when the pipeline is fed from CONFIG_STREAMING_REPLAY_FILE
+static bool replaying = false;
+static bool replay_fast = false;
+
+// Capture format in force, changed at run time with cmd=format
+static int capture_rate = 16000;
+static int capture_bits = 16;
+static int capture_channels = 2;
+
+// Reference tone overlaid by the mixer, set with cmd=mix. The frequency is
+// read by the mixer task on every block
+static struct {
+	streaming_wav_t		wav;
+	bool				ready;
+	volatile float		frequency;
+	int					id;				// Mixer input, -1 when detached
+	int					gain_db;
+	int					live_db;
+} tone = { .id = -1, .gain_db = -20, .live_db = 0 };
+
+static int _tone_read( int16_t* buf, int frames, void* ctx )
+{
+	return streaming_wav_read( &tone.wav, tone.frequency, buf, frames );
+}
+
+// Latency probe markers, also a mixer input, attached by the first cmd=probe
+static probe_t probe;
+static int probe_id = -1;
+
+static int _probe_read( int16_t* buf, int frames, void* ctx )
+{
+	return probe_read( &probe, buf, frames );
+}
+
+static bool query_int( const char* query, const char* key, int* value )
+{
+	char buf[16];
+
+	if ( httpd_query_key_value( query, key, buf, sizeof(buf) ) != ESP_OK )
+		return false;
+
+	*value = atoi( buf );
+	return true;
+}
+
+// /command?cmd=dsp[&hpf=<hz>|0][&agc=0|1][&target=<dbfs>][&maxgain=<db>][&attack=<ms>][&release=<ms>]
+//                 [&gate=<dbfs>|0][&floor=<db>][&hold=<ms>][&gate_release=<ms>]
+//                 [&nr=<db>|0][&nr_rise=<db/s>][&nr_smooth=<pct>]
+// Any parameter left out keeps its current value. The response reports the
+// settings in force and the measured cost in cycles per frame, the noise
+// reduction's share of it, its mean gain and the delay it adds.
+
+static void command_dsp( const char* command, char* response )
+{
+	if ( !voice_dsp ) {
+		snprintf( response, WEBSERVER_COMMAND_RESPONSE_SIZE, "DSP not running" );
+		return;
+	}
+
+	voice_proc_params_t p;
+	voice_dsp_get_params( voice_dsp, &p );
+
+	int v;
+	if ( query_int( command, "hpf", &v ) ) {
+		p.hpf_enable = v > 0;
+		if ( v > 0 )
+			p.hpf_cutoff_hz = v;
+	}
+	if ( query_int( command, "agc", &v ) )
+		p.agc_enable = v != 0;
+	query_int( command, "target", &p.agc_target_dbfs );
+	query_int( command, "maxgain", &p.agc_max_gain_db );
+	query_int( command, "attack", &p.agc_attack_ms );
+	query_int( command, "release", &p.agc_release_ms );
+	if ( query_int( command, "gate", &v ) ) {
+		p.gate_enable = v != 0;
+		if ( v != 0 )
+			p.gate_threshold_dbfs = v;
+	}
+	query_int( command, "floor", &p.gate_floor_db );
+	query_int( command, "hold", &p.gate_hold_ms );
+	query_int( command, "gate_release", &p.gate_release_ms );
+
+	denoise_params_t nr;
+	voice_dsp_get_denoise( voice_dsp, &nr );
+
+	if ( query_int( command, "nr", &v ) ) {
+		nr.enable = v > 0;
+		if ( v > 0 )
+			nr.attenuation_db = v;
+	}
+	query_int( command, "nr_rise", &nr.noise_rise_db );
+	query_int( command, "nr_smooth", &nr.smoothing_pct );
+
+	voice_dsp_set_params( voice_dsp, &p );
+	voice_dsp_set_denoise( voice_dsp, &nr );
+
+	voice_dsp_stats_t stats;
+	voice_dsp_get_stats( voice_dsp, &stats );
+
+	snprintf( response, WEBSERVER_COMMAND_RESPONSE_SIZE,
+			"hpf=%d agc=%d target=%d maxgain=%d attack=%d release=%d gate=%d floor=%d hold=%d gate_release=%d "
+			"nr=%d nr_rise=%d nr_smooth=%d cycles_per_frame=%u max_block_cycles=%u/%u "
+			"nr_cycles_per_frame=%u nr_gain=%d%% nr_delay_ms=%d",
+			p.hpf_enable ? p.hpf_cutoff_hz : 0, p.agc_enable, p.agc_target_dbfs, p.agc_max_gain_db,
+			p.agc_attack_ms, p.agc_release_ms, p.gate_enable ? p.gate_threshold_dbfs : 0,
+			p.gate_floor_db, p.gate_hold_ms, p.gate_release_ms,
+			nr.enable ? nr.attenuation_db : 0, nr.noise_rise_db, nr.smoothing_pct,
+			stats.frames ? (unsigned) ( stats.cycles / stats.frames ) : 0,
+			stats.max_block_cycles, stats.max_block_frames,
+			stats.frames ? (unsigned) ( stats.denoise_cycles / stats.frames ) : 0,
+			(int) ( stats.denoise_gain * 100 ),
+			stats.denoise_latency * 1000 / capture_rate );
+}
+
+// /command?cmd=iq[&mode=off|usb|lsb|am][&offset=<hz>][&dc=0|1][&balance=0|1][&swap=0|1]
+// Treats the stereo input as I and Q from a quadrature front end and
+// demodulates it ahead of the voice DSP. offset is the baseband frequency
+// tuned to, the suppressed carrier for SSB or the carrier for AM. The
+// response reports the front end's DC and imbalance as estimated and the
+// measured cycles per frame of each mode that has run.
+
+static void command_iq( const char* command, char* response )
+{
+	if ( !iq_demod ) {
+		snprintf( response, WEBSERVER_COMMAND_RESPONSE_SIZE, "I/Q demodulator not running" );
+		return;
+	}
+
+	iq_params_t p;
+	iq_demod_get_params( iq_demod, &p );
+
+	char mode[8];
+	int v;
+	bool changed = false;
+	if ( httpd_query_key_value( command, "mode", mode, sizeof(mode) ) == ESP_OK ) {
+		if ( ( p.mode = iq_mode_parse( mode ) ) < 0 ) {
+			snprintf( response, WEBSERVER_COMMAND_RESPONSE_SIZE, "Unknown mode: %s, need off, usb, lsb or am", mode );
+			return;
+		}
+		changed = true;
+	}
+	changed |= query_int( command, "offset", &p.offset_hz );
+	if ( query_int( command, "dc", &v ) ) {
+		p.dc = v != 0;
+		changed = true;
+	}
+	if ( query_int( command, "balance", &v ) ) {
+		p.balance = v != 0;
+		changed = true;
+	}
+	if ( query_int( command, "swap", &v ) ) {
+		p.swap = v != 0;
+		changed = true;
+	}
+
+	if ( changed ) {
+		if ( p.offset_hz <= -capture_rate / 2 || p.offset_hz >= capture_rate / 2 ) {
+			snprintf( response, WEBSERVER_COMMAND_RESPONSE_SIZE, "Need -%d < offset < %d", capture_rate / 2, capture_rate / 2 );
+			return;
+		}
+		iq_demod_set_params( iq_demod, &p );
+	}
+
+	iq_demod_stats_t stats;
+	iq_demod_get_stats( iq_demod, &stats );
+
+	int n = snprintf( response, WEBSERVER_COMMAND_RESPONSE_SIZE,
+			"mode=%s offset=%d dc=%d balance=%d swap=%d%s dc_i=%d dc_q=%d gain_db=%.1f phase_deg=%.1f cycles_per_frame=",
+			iq_mode_name( p.mode ), p.offset_hz, p.dc, p.balance, p.swap,
+			capture_channels == 2 ? "" : " (needs stereo)",
+			(int) stats.dc_i, (int) stats.dc_q, stats.gain_db, stats.phase_deg );
+
+	for ( int m = IQ_MODE_OFF + 1 ; m < IQ_MODES && n < WEBSERVER_COMMAND_RESPONSE_SIZE ; m++ )
+		n += snprintf( response + n, WEBSERVER_COMMAND_RESPONSE_SIZE - n, "%s%s:%u", m > 1 ? "," : "", iq_mode_name( m ),
+				stats.frames[m] ? (unsigned) ( stats.cycles[m] / stats.frames[m] ) : 0 );
+}
+
+// /command?cmd=dtx[&enable=0|1][&keepalive=<ms>][&threshold=<db>][&hangover=<ms>]
+// Reports how much of the stream was suppressed and the VAD cost per block
+
+static void command_dtx( const char* command, char* response )
+{
+	if ( !http_audio ) {
+		snprintf( response, WEBSERVER_COMMAND_RESPONSE_SIZE, "Streamer not running" );
+		return;
+	}
+
+	streaming_http_audio_dtx_t dtx;
+	streaming_http_audio_get_dtx( http_audio, &dtx );
+
+	int v;
+	if ( query_int( command, "enable", &v ) )
+		dtx.enable = v != 0;
+	query_int( command, "keepalive", &dtx.keepalive_ms );
+	query_int( command, "threshold", &dtx.vad.threshold_db );
+	query_int( command, "hangover", &dtx.vad.hangover_ms );
+
+	streaming_http_audio_set_dtx( http_audio, &dtx );
+
+	streaming_http_audio_stats_t stats;
+	streaming_http_audio_get_stats( http_audio, &stats );
+
+	uint64_t total = stats.bytes_sent + stats.bytes_suppressed;
+
+	snprintf( response, WEBSERVER_COMMAND_RESPONSE_SIZE,
+			"enable=%d keepalive=%d threshold=%d hangover=%d "
+			"blocks=%u speech=%u sent=%llu suppressed=%llu saved=%u%% vad_cycles_per_block=%u",
+			dtx.enable, dtx.keepalive_ms, dtx.vad.threshold_db, dtx.vad.hangover_ms,
+			stats.blocks, stats.speech_blocks, stats.bytes_sent, stats.bytes_suppressed,
+			total ? (unsigned) ( stats.bytes_suppressed * 100 / total ) : 0,
+			stats.vad_blocks ? (unsigned) ( stats.vad_cycles / stats.vad_blocks ) : 0 );
+}
+
+// /command?cmd=clock[&played_us=<n>]
+// Sent every few seconds by the player page with its playback position so
+// the streamer can measure how much audio the listener has buffered and
+// correct for the difference between the two clocks. Without played_us it
+// just reports the state
+
+static void command_clock( const char* command, char* response )
+{
+	if ( !http_audio ) {
+		snprintf( response, WEBSERVER_COMMAND_RESPONSE_SIZE, "Streamer not running" );
+		return;
+	}
+
+	char buf[24];
+	int64_t played_us = -1;
+	if ( httpd_query_key_value( command, "played_us", buf, sizeof(buf) ) == ESP_OK )
+		played_us = strtoll( buf, NULL, 10 );
+
+	streaming_http_audio_clock_t clock;
+	streaming_http_audio_clock_report( http_audio, played_us, &clock );
+
+	snprintf( response, WEBSERVER_COMMAND_RESPONSE_SIZE,
+			"ppm=%d drift_ppm=%d depth_ms=%d target_ms=%d reports=%u",
+			clock.ppm, clock.drift_ppm, clock.depth_ms, clock.target_ms, clock.reports );
+}
+
+// /command?cmd=latency[&enable=0|1][&target=<ms>][&min=<ms>][&max=<ms>][&queue=<blocks>]
+// Reports the block length and queue limit in force, the audio dropped to
+// hold the limit and the last few moves (seconds into the stream, block/queue
+// ms and why)
+
+static void command_latency( const char* command, char* response )
+{
+	if ( !http_audio ) {
+		snprintf( response, WEBSERVER_COMMAND_RESPONSE_SIZE, "Streamer not running" );
+		return;
+	}
+
+	latency_t l;
+	streaming_http_audio_get_latency( http_audio, &l );
+
+	latency_params_t p = l.params;
+	int v;
+	bool changed = false;
+	if ( query_int( command, "enable", &v ) ) {
+		p.enable = v != 0;
+		changed = true;
+	}
+	changed |= query_int( command, "target", &p.target_ms );
+	changed |= query_int( command, "min", &p.min_block_ms );
+	changed |= query_int( command, "max", &p.max_block_ms );
+	changed |= query_int( command, "queue", &p.queue_blocks );
+
+	if ( changed )
+		streaming_http_audio_set_latency( http_audio, &p );
+
+	streaming_http_audio_stats_t stats;
+	streaming_http_audio_get_stats( http_audio, &stats );
+
+	int n = snprintf( response, WEBSERVER_COMMAND_RESPONSE_SIZE,
+			"enable=%d target=%d min=%d max=%d queue=%d block_ms=%d queue_ms=%d dropped=%llu changes=%u history=",
+			p.enable, p.target_ms, p.min_block_ms, p.max_block_ms, p.queue_blocks,
+			l.block_ms, l.queue_ms, stats.bytes_dropped, l.changes );
+
+	const latency_change_t* c;
+	for ( int i = 0 ; i < 4 && ( c = latency_history( &l, i ) ) && n < WEBSERVER_COMMAND_RESPONSE_SIZE ; i++ )
+		n += snprintf( response + n, WEBSERVER_COMMAND_RESPONSE_SIZE - n, "%s%u.%us:%u/%u:%s",
+				i ? "," : "", c->time_ms / 1000, c->time_ms % 1000 / 100, c->block_ms, c->queue_ms,
+				latency_reason_name( c->reason ) );
+}
+
+// /command?cmd=stretch[&enable=0|1][&start=<ms>][&stop=<ms>][&catchup=<ms>][&min=<pct>][&max=<pct>][&limit=<ms>]
+// Catch-up for a listener that fell behind: once the backlog in front of the
+// streamer reaches start ms it is played out at min to max percent of real
+// time, faster the larger it is, until it is down to stop ms. Reports the
+// rate in force, the latency removed and the cost in cycles per ms of audio
+// compressed
+
+static void command_stretch( const char* command, char* response )
+{
+	if ( !http_audio ) {
+		snprintf( response, WEBSERVER_COMMAND_RESPONSE_SIZE, "Streamer not running" );
+		return;
+	}
+
+	streaming_http_audio_stretch_t st;
+	streaming_http_audio_get_stretch( http_audio, &st );
+
+	stretch_params_t p = st.params;
+	int v;
+	bool changed = false;
+	if ( query_int( command, "enable", &v ) ) {
+		p.enable = v != 0;
+		changed = true;
+	}
+	changed |= query_int( command, "start", &p.start_ms );
+	changed |= query_int( command, "stop", &p.stop_ms );
+	changed |= query_int( command, "catchup", &p.catchup_ms );
+	changed |= query_int( command, "min", &p.min_pct );
+	changed |= query_int( command, "max", &p.max_pct );
+	changed |= query_int( command, "limit", &p.max_ms );
+
+	if ( changed ) {
+		if ( p.stop_ms < 0 || p.start_ms <= p.stop_ms || p.catchup_ms <= 0 || p.min_pct <= 100 ||
+			 p.max_pct < p.min_pct || p.max_pct > STRETCH_MAX_PCT ) {
+			snprintf( response, WEBSERVER_COMMAND_RESPONSE_SIZE,
+					"Need 0 <= stop < start, catchup > 0 and 100 < min <= max <= %d", STRETCH_MAX_PCT );
+			return;
+		}
+		streaming_http_audio_set_stretch( http_audio, &p );
+	}
+
+	streaming_http_audio_stats_t stats;
+	streaming_http_audio_get_stats( http_audio, &stats );
+
+	uint64_t stretched_ms = stats.stretch_samples * 1000 / capture_rate;
+
+	snprintf( response, WEBSERVER_COMMAND_RESPONSE_SIZE,
+			"enable=%d start=%d stop=%d catchup=%d min=%d max=%d limit=%d pct=%d catchups=%u removed_ms=%llu "
+			"blocks=%u cycles_per_ms=%u",
+			p.enable, p.start_ms, p.stop_ms, p.catchup_ms, p.min_pct, p.max_pct, p.max_ms, st.pct, st.catchups,
+			st.in_samples > st.out_samples ? ( st.in_samples - st.out_samples ) * 1000 / capture_rate : 0,
+			stats.stretch_blocks, stretched_ms ? (unsigned) ( stats.stretch_cycles / stretched_ms ) : 0 );
+}
+
+// /command?cmd=notch[&enable=0|1][&tones=<n>][&width=<hz>][&depth=<db>][&converge=<ms>][&lock=<db>]
+// Adaptive notch for steady carriers and whine on the stream. enable is the
+// default, a listener can choose with /stream?notch=0|1. Reports whether it
+// runs for the current listener, each section's frequency with an L when
+// locked on a tone, and the cost in cycles per sample
+
+static void command_notch( const char* command, char* response )
+{
+	if ( !http_audio ) {
+		snprintf( response, WEBSERVER_COMMAND_RESPONSE_SIZE, "Streamer not running" );
+		return;
+	}
+
+	notch_t nt;
+	bool running;
+	streaming_http_audio_get_notch( http_audio, &nt, &running );
+
+	notch_params_t p = nt.params;
+	int v;
+	bool changed = false;
+	if ( query_int( command, "enable", &v ) ) {
+		p.enable = v != 0;
+		changed = true;
+	}
+	changed |= query_int( command, "tones", &p.tones );
+	changed |= query_int( command, "width", &p.width_hz );
+	changed |= query_int( command, "depth", &p.depth_db );
+	changed |= query_int( command, "converge", &p.converge_ms );
+	changed |= query_int( command, "lock", &p.lock_db );
+
+	if ( changed ) {
+		if ( p.tones < 1 || p.tones > NOTCH_MAX_TONES || p.width_hz < 1 || p.depth_db < 0 || p.converge_ms < 1 ) {
+			snprintf( response, WEBSERVER_COMMAND_RESPONSE_SIZE,
+					"Need 1 <= tones <= %d, width >= 1, depth >= 0 and converge >= 1", NOTCH_MAX_TONES );
+			return;
+		}
+		streaming_http_audio_set_notch( http_audio, &p );
+	}
+
+	streaming_http_audio_stats_t stats;
+	streaming_http_audio_get_stats( http_audio, &stats );
+
+	int n = snprintf( response, WEBSERVER_COMMAND_RESPONSE_SIZE,
+			"enable=%d tones=%d width=%d depth=%d converge=%d lock=%d running=%d cycles_per_sample=%u tones_hz=",
+			p.enable, p.tones, p.width_hz, p.depth_db, p.converge_ms, p.lock_db, running,
+			stats.notch_samples ? (unsigned) ( stats.notch_cycles / stats.notch_samples ) : 0 );
+
+	for ( int i = 0 ; i < nt.tones && n < WEBSERVER_COMMAND_RESPONSE_SIZE ; i++ )
+		n += snprintf( response + n, WEBSERVER_COMMAND_RESPONSE_SIZE - n, "%s%d%s",
+				i ? "," : "", notch_frequency( &nt, i ), nt.sec[i].locked ? "L" : "" );
+}
+
+// /command?cmd=narrowband[&preset=off|voice|narrow|cw]
+// Sets the channel filter preset for listeners that do not pick one with
+// /stream?bw=<preset>. The presets are 3 kHz, 1.5 kHz and 500 Hz of audio
+// streamed at the lowest rate that carries them, a half, a quarter and an
+// eighth of 16 kHz. The response reports the filter of the current or last
+// listener: its rate, delay, cost per input sample and the share of the
+// samples it passed on.
+
+static void command_narrowband( const char* command, char* response )
+{
+	if ( !http_audio ) {
+		snprintf( response, WEBSERVER_COMMAND_RESPONSE_SIZE, "Streamer not running" );
+		return;
+	}
+
+	char name[8];
+	if ( httpd_query_key_value( command, "preset", name, sizeof(name) ) == ESP_OK ) {
+		int preset = narrowband_parse( name );
+		if ( preset < 0 ) {
+			snprintf( response, WEBSERVER_COMMAND_RESPONSE_SIZE, "Unknown preset: %s, need off, voice, narrow or cw", name );
+			return;
+		}
+		streaming_http_audio_set_narrowband( http_audio, preset );
+	}
+
+	int preset;
+	narrowband_t nb;
+	bool running;
+	streaming_http_audio_get_narrowband( http_audio, &preset, &nb, &running );
+
+	streaming_http_audio_stats_t stats;
+	streaming_http_audio_get_stats( http_audio, &stats );
+
+	snprintf( response, WEBSERVER_COMMAND_RESPONSE_SIZE,
+			"preset=%s listener=%s running=%d bandwidth=%d rate=%d stages=%d delay_ms=%u cycles_per_sample=%u out_pct=%u",
+			narrowband_name( preset ), narrowband_name( nb.preset ), running, nb.bandwidth_hz, nb.out_rate, nb.stages,
+			nb.delay_us / 1000,
+			stats.narrowband_samples ? (unsigned) ( stats.narrowband_cycles / stats.narrowband_samples ) : 0,
+			stats.narrowband_samples ? (unsigned) ( stats.narrowband_out_samples * 100 / stats.narrowband_samples ) : 100 );
+}
+
+// /command?cmd=tee reports how the captured blocks are shared between the
+// streamer (out0) and the local monitor (out1): copies per block, the pool
+// they share against the ringbuffer each output would otherwise need, and
+// per output the blocks dropped because it fell behind and its peak queue
+
+static void command_tee( const char* command, char* response )
+{
+	if ( !tee ) {
+		snprintf( response, WEBSERVER_COMMAND_RESPONSE_SIZE, "Tee not running" );
+		return;
+	}
+
+	tee_stats_t stats;
+	tee_get_stats( tee, &stats );
+
+	int n = snprintf( response, WEBSERVER_COMMAND_RESPONSE_SIZE,
+			"blocks=%u copies_per_block=%u.%02u pool_fails=%u taps=%d pool_bytes=%d bytes_per_output=%d ringbuffer_bytes=%d",
+			stats.blocks, (unsigned) ( stats.blocks ? stats.copies / stats.blocks : 0 ),
+			(unsigned) ( stats.blocks ? stats.copies * 100 / stats.blocks % 100 : 0 ),
+			stats.pool_fails, stats.taps, stats.pool_bytes, stats.output_bytes, MIXER_RINGBUFFER_SIZE );
+
+	for ( int i = 0 ; i < stats.outputs && n < WEBSERVER_COMMAND_RESPONSE_SIZE ; i++ )
+		n += snprintf( response + n, WEBSERVER_COMMAND_RESPONSE_SIZE - n, " out%d=dropped:%u,peak:%d",
+				i, stats.output[i].dropped, stats.output[i].peak );
+}
+
+// /command?cmd=probe[&fire=1][&period=<ms>|0][&enable=0]
+// Latency probe for host/probe. fire=1 adds one marker at the next mixer
+// block, period adds one every period ms, enable=0 detaches the probe from
+// the mixer. The response carries the time the request was handled so a
+// client can tell how long its request took to get here
+
+static void command_probe( const char* command, char* response )
+{
+	if ( !mixer ) {
+		snprintf( response, WEBSERVER_COMMAND_RESPONSE_SIZE, "Mixer not running" );
+		return;
+	}
+
+	int64_t now = esp_timer_get_time();
+	int v, period = -1, fire = 0;
+
+	query_int( command, "fire", &fire );
+	query_int( command, "period", &period );
+
+	if ( query_int( command, "enable", &v ) && v == 0 ) {
+		probe_set_period( &probe, 0 );
+		if ( probe_id >= 0 && mixer_detach( mixer, probe_id ) == ESP_OK )
+			probe_id = -1;
+	} else if ( fire || period >= 0 ) {
+		if ( probe_id < 0 )
+			probe_id = mixer_attach( mixer, _probe_read, NULL, MIX_UNITY_Q15 );
+		if ( period >= 0 )
+			probe_set_period( &probe, period );
+		if ( fire && probe_id >= 0 )
+			probe_fire( &probe );
+	}
+
+	snprintf( response, WEBSERVER_COMMAND_RESPONSE_SIZE,
+			"attached=%d period=%d requested=%u markers=%u rate=%d chirp=%d-%dHz/%dms time_us=%lld",
+			probe_id >= 0, probe.period_ms, probe.requested, probe.markers, probe.sample_rate,
+			PROBE_F0_HZ, PROBE_F1_HZ, PROBE_MS, (long long) now );
+}
+
+// /command?cmd=spectrum reports the cost of the shared spectrum frames
+
+static void command_spectrum( const char* command, char* response )
+{
+	if ( !spectrum ) {
+		snprintf( response, WEBSERVER_COMMAND_RESPONSE_SIZE, "Spectrum not running" );
+		return;
+	}
+
+	spectrum_tap_stats_t stats;
+	spectrum_tap_get_stats( spectrum, &stats );
+
+	snprintf( response, WEBSERVER_COMMAND_RESPONSE_SIZE,
+			"frames=%u cycles_per_frame=%u skipped=%u dropped=%u",
+			stats.frames, stats.frames ? (unsigned) ( stats.cycles / stats.frames ) : 0,
+			stats.skipped, stats.dropped );
+}
+
+// /command?cmd=tones[&hz=<hz>[,<hz>...]][&frame=<ms>][&on=<db>][&off=<db>][&min=<dbfs>]
+// Goertzel tone detectors on the stream, publishing on and off changes to
+// /tones subscribers. on and off are each tone's share of the frame's power,
+// min its least level. Reports the cost in cycles per sample and each
+// tone's state as hz:on:dbfs from the last frame
+
+static void command_tones( const char* command, char* response )
+{
+	if ( !tone_detect ) {
+		snprintf( response, WEBSERVER_COMMAND_RESPONSE_SIZE, "Tone detector not running" );
+		return;
+	}
+
+	goertzel_params_t p;
+	tone_tap_get_params( tone_detect, &p );
+
+	bool changed = false;
+	char list[64];
+	if ( httpd_query_key_value( command, "hz", list, sizeof(list) ) == ESP_OK ) {
+		p.tones = 0;
+		for ( char* s = list ; *s && p.tones < GOERTZEL_MAX_TONES ; ) {
+			char* end;
+			long hz = strtol( s, &end, 10 );
+			if ( end == s ) {
+				s++;
+				continue;
+			}
+			p.hz[p.tones++] = hz;
+			s = end;
+		}
+		changed = true;
+	}
+	changed |= query_int( command, "frame", &p.frame_ms );
+	changed |= query_int( command, "on", &p.on_db );
+	changed |= query_int( command, "off", &p.off_db );
+	changed |= query_int( command, "min", &p.min_dbfs );
+
+	if ( changed && tone_tap_set_params( tone_detect, &p ) != ESP_OK ) {
+		snprintf( response, WEBSERVER_COMMAND_RESPONSE_SIZE,
+				"Need 1 to %d tones under 24000 Hz, %d <= frame <= %d, off <= on <= 0 and min <= 0",
+				GOERTZEL_MAX_TONES, GOERTZEL_MIN_FRAME_MS, GOERTZEL_MAX_FRAME_MS );
+		return;
+	}
+
+	tone_tap_stats_t stats;
+	tone_tap_get_stats( tone_detect, &stats );
+
+	int n = snprintf( response, WEBSERVER_COMMAND_RESPONSE_SIZE,
+			"frame=%d on=%d off=%d min=%d cycles_per_sample=%u skipped=%u events=%u lost=%u dropped=%u tones=",
+			p.frame_ms, p.on_db, p.off_db, p.min_dbfs,
+			stats.samples ? (unsigned) ( stats.cycles / stats.samples ) : 0,
+			stats.skipped, stats.events, stats.lost, stats.dropped );
+
+	for ( int t = 0 ; t < p.tones && n < WEBSERVER_COMMAND_RESPONSE_SIZE ; t++ )
+		n += snprintf( response + n, WEBSERVER_COMMAND_RESPONSE_SIZE - n, "%s%d:%d:%d",
+				t ? "," : "", p.hz[t], stats.on[t], stats.dbfs[t] );
+}
+
+// /command?cmd=capture
+// Reports the I2S traces taken with /capture?seconds=<n>: downloads
+// started, the blocks recorded and those lost behind a slow client, and
+// the format they are recorded in.
+
+static void command_capture( const char* command, char* response )
+{
+	if ( !capture ) {
+		snprintf( response, WEBSERVER_COMMAND_RESPONSE_SIZE, "Capture not running" );
+		return;
+	}
+
+	i2s_capture_stats_t stats;
+	i2s_capture_get_stats( capture, &stats );
+
+	snprintf( response, WEBSERVER_COMMAND_RESPONSE_SIZE,
+			"active=%d captures=%u blocks=%u bytes=%llu dropped=%u rate=%d bits=%d channels=%d",
+			stats.active, stats.captures, stats.blocks, (unsigned long long) stats.bytes, stats.dropped,
+			capture_rate, capture_bits, capture_channels );
+}
+
+// /command?cmd=replay[&fast=0|1]
+// The trace fed in place of the codec when built with
+// CONFIG_STREAMING_REPLAY. fast=1 feeds it as fast as the pipeline takes
+// it, fast=0 at the pace it was captured. late counts blocks fed more than
+// a tick after they were due, gaps the places the capture lost blocks.
+
+static void command_replay( const char* command, char* response )
+{
+	if ( !replaying || !i2s_stream_reader ) {
+		snprintf( response, WEBSERVER_COMMAND_RESPONSE_SIZE, "Not replaying, enable STREAMING_REPLAY" );
+		return;
+	}
+
+	int fast;
+	if ( query_int( command, "fast", &fast ) ) {
+		replay_fast = fast != 0;
+		i2s_replay_set_fast( i2s_stream_reader, replay_fast );
+	}
+
+	i2s_replay_stats_t stats;
+	i2s_replay_get_stats( i2s_stream_reader, &stats );
+
+	snprintf( response, WEBSERVER_COMMAND_RESPONSE_SIZE,
+			"fast=%d blocks=%u bytes=%llu loops=%u gaps=%u late=%u max_late_ms=%u rate=%d bits=%d channels=%d",
+			replay_fast, stats.blocks, (unsigned long long) stats.bytes, stats.loops, stats.gaps,
+			stats.late, stats.max_late_us / 1000, capture_rate, capture_bits, capture_channels );
+}
+
+// /command?cmd=format[&rate=<hz>][&bits=16|32][&channels=1|2]
+// Changes the capture format on the running pipeline. The elements are
+// paused rather than stopped, the ringbuffers holding audio in the old
+// format are emptied and every element has the new format staged before
+// they resume. A streaming client has its response ended and reconnects to
+// get the new WAV header. switch_ms is the time spent paused, gap_ms the
+// hole the streamer measured in its output.
+
+static void command_format( const char* command, char* response )
+{
+	if ( !pipeline ) {
+		snprintf( response, WEBSERVER_COMMAND_RESPONSE_SIZE, "Pipeline not running" );
+		return;
+	}
+
+	if ( replaying ) {
+		snprintf( response, WEBSERVER_COMMAND_RESPONSE_SIZE, "Replaying a trace, format fixed at rate=%d bits=%d channels=%d",
+				capture_rate, capture_bits, capture_channels );
+		return;
+	}
+
+	int rate = capture_rate, bits = capture_bits, channels = capture_channels;
+	query_int( command, "rate", &rate );
+	query_int( command, "bits", &bits );
+	query_int( command, "channels", &channels );
+
+	if ( rate < 8000 || rate > 48000 || ( bits != 16 && bits != 32 ) || channels < 1 || channels > 2 ) {
+		snprintf( response, WEBSERVER_COMMAND_RESPONSE_SIZE, "Unsupported format: rate=%d bits=%d channels=%d",
+				rate, bits, channels );
+		return;
+	}
+
+	streaming_http_audio_stats_t stats;
+	streaming_http_audio_get_stats( http_audio, &stats );
+	uint32_t changes = stats.format_changes;
+	uint32_t switch_us = 0;
+
+	if ( rate != capture_rate || bits != capture_bits || channels != capture_channels ) {
+
+		int64_t start = esp_timer_get_time();
+
+		// The tee's outputs are not in the pipeline, so they are paused
+		// and emptied apart from it
+
+		if ( audio_pipeline_pause( pipeline ) != ESP_OK || tee_pause( tee ) != ESP_OK ) {
+			tee_resume( tee );
+			audio_pipeline_resume( pipeline );
+			snprintf( response, WEBSERVER_COMMAND_RESPONSE_SIZE, "Pipeline did not pause, format unchanged" );
+			return;
+		}
+
+		audio_pipeline_reset_ringbuffer( pipeline );
+
+		i2s_stream_set_clk( i2s_stream_reader, rate, bits, channels );
+		i2s_stream_set_clk( i2s_stream_writer, rate, 16, channels );
+		iq_demod_set_format( iq_demod, rate, bits, channels );
+		voice_dsp_set_format( voice_dsp, rate, bits, channels );
+		if ( mixer )
+			mixer_set_channels( mixer, channels );
+		if ( tone.ready )
+			streaming_wav_set_rate( &tone.wav, rate );
+		probe_init( &probe, rate );
+		streaming_http_audio_set_format( http_audio, rate, channels );
+		if ( hls )
+			hls_segmenter_set_format( hls, rate, 16, 1 );
+		if ( spectrum )
+			spectrum_tap_set_rate( spectrum, rate );
+		if ( tone_detect )
+			tone_tap_set_rate( tone_detect, rate );
+		if ( capture )
+			i2s_capture_set_format( capture, rate, bits, channels );
+
+		tee_resume( tee );
+		audio_pipeline_resume( pipeline );
+		switch_us = esp_timer_get_time() - start;
+
+		capture_rate = rate;
+		capture_bits = bits;
+		capture_channels = channels;
+
+		// The gap is only known once the first block in the new format has
+		// reached the streamer
+
+		for ( int t = 0 ; t < FORMAT_SWITCH_TIMEOUT_MS / 10 && stats.format_changes == changes ; t++ ) {
+			vTaskDelay( 10 / portTICK_PERIOD_MS );
+			streaming_http_audio_get_stats( http_audio, &stats );
+		}
+
+		if ( stats.format_changes == changes )
+			ESP_LOGW( TAG, "No audio in the new format after %d ms", FORMAT_SWITCH_TIMEOUT_MS );
+	}
+
+	snprintf( response, WEBSERVER_COMMAND_RESPONSE_SIZE,
+			"rate=%d bits=%d channels=%d switch_ms=%u gap_ms=%u max_gap_ms=%u changes=%u",
+			capture_rate, capture_bits, capture_channels, switch_us / 1000,
+			stats.format_gap_us / 1000, stats.format_max_gap_us / 1000, stats.format_changes );
+}
+
+// /command?cmd=mix[&tone=<hz>|0][&tone_gain=<db>][&live=<db>]
+// Overlays the streaming_wav reference tone on the live feed after the
+// voice DSP. tone=0 detaches it; gains are in dB, -100 or below is silence
+// and +6 the most. The response reports the mixing cost per block.
+
+static void command_mix( const char* command, char* response )
+{
+	if ( !mixer || !tone.ready ) {
+		snprintf( response, WEBSERVER_COMMAND_RESPONSE_SIZE, "Mixer not running" );
+		return;
+	}
+
+	int hz = tone.id >= 0 ? (int) tone.frequency : 0;
+	bool gain_given = query_int( command, "tone_gain", &tone.gain_db );
+	query_int( command, "tone", &hz );
+
+	if ( query_int( command, "live", &tone.live_db ) )
+		mixer_set_gain( mixer, MIXER_MAIN, mix_gain_q15( tone.live_db ) );
+
+	if ( hz > 0 && hz < capture_rate / 2 ) {
+		tone.frequency = hz;
+		if ( tone.id < 0 )
+			tone.id = mixer_attach( mixer, _tone_read, NULL, mix_gain_q15( tone.gain_db ) );
+		else if ( gain_given )
+			mixer_set_gain( mixer, tone.id, mix_gain_q15( tone.gain_db ) );
+	} else if ( hz == 0 && tone.id >= 0 ) {
+		if ( mixer_detach( mixer, tone.id ) == ESP_OK )
+			tone.id = -1;
+	}
+
+	mixer_stats_t stats;
+	mixer_get_stats( mixer, &stats );
+
+	snprintf( response, WEBSERVER_COMMAND_RESPONSE_SIZE,
+			"tone=%d tone_gain=%d live=%d inputs=%d cycles_per_block=%u max_cycles=%u short_frames=%llu",
+			tone.id >= 0 ? (int) tone.frequency : 0, tone.gain_db, tone.live_db, stats.inputs,
+			stats.blocks ? (unsigned) ( stats.cycles / stats.blocks ) : 0, stats.max_block_cycles,
+			(unsigned long long) stats.short_frames );
+}
+
 void command_callback( const char* command, char* response )
 {
+	char cmd[16];
+
 	ESP_LOGI( TAG, "In command callback: %s\n", command );
+
+	if ( httpd_query_key_value( command, "cmd", cmd, sizeof(cmd) ) != ESP_OK ) {
+		snprintf( response, WEBSERVER_COMMAND_RESPONSE_SIZE, "Missing cmd" );
+		return;
+	}
+
+	if ( strcmp( cmd, "dsp" ) == 0 )
+		command_dsp( command, response );
+	else if ( strcmp( cmd, "iq" ) == 0 )
+		command_iq( command, response );
+	else if ( strcmp( cmd, "dtx" ) == 0 )
+		command_dtx( command, response );
+	else if ( strcmp( cmd, "spectrum" ) == 0 )
+		command_spectrum( command, response );
+	else if ( strcmp( cmd, "tones" ) == 0 )
+		command_tones( command, response );
+	else if ( strcmp( cmd, "clock" ) == 0 )
+		command_clock( command, response );
+	else if ( strcmp( cmd, "latency" ) == 0 )
+		command_latency( command, response );
+	else if ( strcmp( cmd, "stretch" ) == 0 )
+		command_stretch( command, response );
+	else if ( strcmp( cmd, "notch" ) == 0 )
+		command_notch( command, response );
+	else if ( strcmp( cmd, "narrowband" ) == 0 )
+		command_narrowband( command, response );
+	else if ( strcmp( cmd, "tee" ) == 0 )
+		command_tee( command, response );
+	else if ( strcmp( cmd, "probe" ) == 0 )
+		command_probe( command, response );
+	else if ( strcmp( cmd, "capture" ) == 0 )
+		command_capture( command, response );
+	else if ( strcmp( cmd, "replay" ) == 0 )
+		command_replay( command, response );
+	else if ( strcmp( cmd, "format" ) == 0 )
+		command_format( command, response );
+	else if ( strcmp( cmd, "mix" ) == 0 )
+		command_mix( command, response );
+	else
+		snprintf( response, WEBSERVER_COMMAND_RESPONSE_SIZE, "Unknown cmd: %s", cmd );
 }
 
 
@@ -73,27 +909,30 @@ void blink( int cnt, gpio_num_t gpio )
     }
 }
 
-void init_webserver(void)
+// Marks the first block to reach the tee in front of the streamer, the end
+// of boot as far as a listener is concerned
+
+static void _first_audio_tap( const char* buf, int len, void* ctx )
 {
-    ESP_ERROR_CHECK(nvs_flash_init());
+	static bool seen = false;
 
-    ESP_LOGI(TAG, "Initializing SPIFFS");
-    init_spiffs( BASE_PATH );
+	if ( !seen ) {
+		seen = true;
+		boot_mark( "first_audio" );
+	}
+}
 
-    ESP_LOGI(TAG, "Initializing WiFi");
-    wifi_connect_with_hostname( CONFIG_ESP_WIFI_SSID, CONFIG_ESP_WIFI_PASSWORD, CONFIG_ESP_HOSTNAME );
+// The streamer's backlog behind the tee, for its latency controller and
+// catch-up. Run in the streamer's task, which is the tee output asking
 
-    blink(3, STATUS_LED);
-
-    ESP_LOGI(TAG, "Starting Web Server");
-    start_webserver( BASE_PATH, command_callback );
+static int _http_audio_backlog( void* ctx, uint32_t* dropped )
+{
+	*dropped = tee_output_dropped( tee, http_audio );
+	return tee_output_backlog( tee, http_audio );
 }
 
-void audio_process(void)
+esp_err_t audio_start(void)
 {
-    audio_pipeline_handle_t pipeline;
-    audio_element_handle_t i2s_stream_reader, i2s_stream_writer, http_audio;
-
     esp_log_level_set("*", ESP_LOG_INFO);
     esp_log_level_set(TAG, ESP_LOG_DEBUG);
 
@@ -105,57 +944,165 @@ void audio_process(void)
     audio_pipeline_cfg_t pipeline_cfg = DEFAULT_AUDIO_PIPELINE_CONFIG();
     pipeline = audio_pipeline_init(&pipeline_cfg);
 
+#ifdef CONFIG_STREAMING_REPLAY
+    ESP_LOGI(TAG, "[3.1a] Create trace replay in place of the codec chip, in the trace's format");
+
+    i2s_replay_cfg_t replay_cfg = DEFAULT_I2S_REPLAY_CONFIG();
+    replay_cfg.path = CONFIG_STREAMING_REPLAY_FILE;
+#ifdef CONFIG_STREAMING_REPLAY_FAST
+    replay_cfg.fast = true;
+#endif
+#ifndef CONFIG_STREAMING_REPLAY_LOOP
+    replay_cfg.loop = false;
+#endif
+    i2s_stream_reader = i2s_replay_init(&replay_cfg);
+    if (!i2s_stream_reader) {
+        return ESP_FAIL;
+    }
+    i2s_replay_get_format(i2s_stream_reader, &capture_rate, &capture_bits, &capture_channels);
+    replaying = true;
+    replay_fast = replay_cfg.fast;
+#else
     ESP_LOGI(TAG, "[3.1a] Create i2s stream to read data from codec chip");
 
     i2s_stream_cfg_t i2s_cfg_read = I2S_STREAM_CFG_DEFAULT();
     i2s_cfg_read.type = AUDIO_STREAM_READER;
-    i2s_cfg_read.i2s_config.sample_rate = 16000;
+    i2s_cfg_read.i2s_config.sample_rate = capture_rate;
     i2s_stream_reader = i2s_stream_init(&i2s_cfg_read);
+#endif
 
     ESP_LOGI(TAG, "[3.1b] Create i2s stream to write data to codec chip");
 
     i2s_stream_cfg_t i2s_cfg = I2S_STREAM_CFG_DEFAULT();
-    i2s_cfg.i2s_config.sample_rate = 16000;
+    i2s_cfg.i2s_config.sample_rate = capture_rate;
     i2s_cfg.type = AUDIO_STREAM_WRITER;
     i2s_stream_writer = i2s_stream_init(&i2s_cfg);
 
+    ESP_LOGI(TAG, "[3.1c] Create I/Q demodulator, off until a mode is chosen, and the trace capture on its input");
+
+    iq_demod_cfg_t iq_cfg = DEFAULT_IQ_DEMOD_CONFIG();
+    iq_cfg.sample_rate = capture_rate;
+    iq_cfg.bits = capture_bits;
+    iq_cfg.channels = capture_channels;
+    iq_demod = iq_demod_init(&iq_cfg);
+
+    capture = i2s_capture_init(capture_rate, capture_bits, capture_channels);
+    if (capture) {
+        iq_demod_set_input_tap(iq_demod, i2s_capture_write, capture);
+    }
+
+    ESP_LOGI(TAG, "[3.1d] Create voice DSP (high-pass, AGC, noise gate)");
+
+    voice_dsp_cfg_t dsp_cfg = DEFAULT_VOICE_DSP_CONFIG();
+    dsp_cfg.sample_rate = capture_rate;
+    dsp_cfg.bits = capture_bits;
+    dsp_cfg.channels = capture_channels;
+    voice_dsp = voice_dsp_init(&dsp_cfg);
+
+    ESP_LOGI(TAG, "[3.1e] Create mixer for the reference tone");
+
+    mixer_cfg_t mixer_cfg = DEFAULT_MIXER_CONFIG();
+    mixer_cfg.channels = capture_channels;
+    mixer = mixer_init(&mixer_cfg);
+
+    probe_init(&probe, capture_rate);
+
+    if (streaming_wav_init(&tone.wav, block_pool_create("tone", TONE_POOL_BLOCK, 1)) == 0) {
+        streaming_wav_set_rate(&tone.wav, capture_rate);
+        tone.ready = true;
+    }
+
+    ESP_LOGI(TAG, "[3.1f] Create tee feeding the monitor and the HTTP Streamer");
+
+    tee_cfg_t tee_cfg = DEFAULT_TEE_CONFIG();
+    tee = tee_init(&tee_cfg);
+
     ESP_LOGI(TAG, "[3.2] Create HTTP Streamer");
 
     streaming_http_audio_cfg_t sha_cfg = DEFAULT_STREAMING_HTTP_AUDIO_CONFIG();
-    httpd_config_t config = HTTPD_DEFAULT_CONFIG();
-    memcpy( &(sha_cfg.http_cfg), &config, sizeof(httpd_config_t) );
-    sha_cfg.http_cfg.server_port = 8080;
-    sha_cfg.http_cfg.ctrl_port = 8081;
-    sha_cfg.sample_rate = 16000;
+    sha_cfg.pool = block_pool_create("audio", STREAMING_HTTP_AUDIO_POOL_BLOCK, AUDIO_POOL_BLOCKS);
+    sha_cfg.sample_rate = capture_rate;
+    sha_cfg.in_channels = capture_channels;
     http_audio = streaming_http_audio_init(&sha_cfg);
 
-    ESP_LOGI(TAG, "[3.3] Register all elements to audio pipeline");
+    ESP_LOGI(TAG, "[3.2a] Create HLS segmenter on the HTTP Streamer output");
 
-    audio_pipeline_register(pipeline, i2s_stream_reader, "i2s_read");
-    audio_pipeline_register(pipeline, i2s_stream_writer, "i2s_write");
-    audio_pipeline_register(pipeline, http_audio, "http_audio");
+    hls_segmenter_cfg_t hls_cfg = DEFAULT_HLS_SEGMENTER_CONFIG();
+    hls_cfg.sample_rate = sha_cfg.sample_rate;
+    hls_cfg.bits = sha_cfg.bits;
+    hls_cfg.channels = sha_cfg.channels;
+    hls = hls_segmenter_init(&hls_cfg);
+    if (hls) {
+        streaming_http_audio_add_tap(http_audio, hls_segmenter_write, hls);
+    }
 
-    ESP_LOGI(TAG, "[3.4] Link it together [codec_chip]-->i2s_stream_reader-->http_audio");
+    ESP_LOGI(TAG, "[3.2b] Create spectrum tap on the HTTP Streamer output");
 
+    spectrum = spectrum_tap_init(sha_cfg.sample_rate);
+    if (spectrum) {
+        streaming_http_audio_add_tap(http_audio, spectrum_tap_write, spectrum);
+    }
+
+    ESP_LOGI(TAG, "[3.2c] Create tone detector tap on the HTTP Streamer output");
+
+    goertzel_params_t tone_params = DEFAULT_GOERTZEL_PARAMS();
+    tone_detect = tone_tap_init(sha_cfg.sample_rate, &tone_params);
+    if (tone_detect) {
+        streaming_http_audio_add_tap(http_audio, tone_tap_write, tone_detect);
+    }
+    tee_add_tap(tee, _first_audio_tap, NULL);
 
-    const char *link_tag[3] = {"i2s_read", "http_audio"};
-    audio_pipeline_link(pipeline, &link_tag[0], 2);
+    ESP_LOGI(TAG, "[3.3] Register all elements to audio pipeline");
+
+    // The streamer and the monitor are fed by the tee, which runs them
+
+    audio_pipeline_register(pipeline, i2s_stream_reader, "i2s_read");
+    audio_pipeline_register(pipeline, iq_demod, "iq");
+    audio_pipeline_register(pipeline, voice_dsp, "dsp");
+    audio_pipeline_register(pipeline, mixer, "mix");
+    audio_pipeline_register(pipeline, tee, "tee");
+    tee_add_output(tee, http_audio);
+    streaming_http_audio_set_backlog(http_audio, _http_audio_backlog, NULL);
+    tee_add_output(tee, i2s_stream_writer);
 
-/*
-    const char *link_tag[3] = {"i2s_read", "i2s_write"};
-    audio_pipeline_link(pipeline, &link_tag[0], 2);
-*/
+    ESP_LOGI(TAG, "[3.4] Link it together [codec_chip]-->i2s_stream_reader-->iq-->dsp-->mix-->tee-->http_audio,i2s_stream_writer");
+
+    const char *link_tag[5] = {"i2s_read", "iq", "dsp", "mix", "tee"};
+    audio_pipeline_link(pipeline, &link_tag[0], 5);
 
     ESP_LOGI(TAG, "[ 4 ] Set up  event listener");
     audio_event_iface_cfg_t evt_cfg = AUDIO_EVENT_IFACE_DEFAULT_CFG();
-    audio_event_iface_handle_t evt = audio_event_iface_init(&evt_cfg);
+    evt = audio_event_iface_init(&evt_cfg);
 
     ESP_LOGI(TAG, "[4.1] Listening event from all elements of pipeline");
     audio_pipeline_set_listener(pipeline, evt);
 
     ESP_LOGI(TAG, "[ 5 ] Start audio_pipeline");
-    audio_pipeline_run(pipeline);
+    return audio_pipeline_run(pipeline);
+}
 
+// The HTTP side of the streamer, HLS segmenter, spectrum and tone taps and
+// the trace capture, which need the port 80 server. Until this has run they see every block
+// but serve nothing
+
+static esp_err_t audio_register(void)
+{
+    esp_err_t ret = streaming_http_audio_register(http_audio);
+
+    if (hls && hls_segmenter_register(hls) != ESP_OK)
+        ret = ESP_FAIL;
+    if (spectrum && spectrum_tap_register(spectrum) != ESP_OK)
+        ret = ESP_FAIL;
+    if (tone_detect && tone_tap_register(tone_detect) != ESP_OK)
+        ret = ESP_FAIL;
+    if (capture && i2s_capture_register(capture) != ESP_OK)
+        ret = ESP_FAIL;
+
+    return ret;
+}
+
+void audio_loop(void)
+{
     ESP_LOGI(TAG, "[ 6 ] Listen for all pipeline events");
 
     while (1) {
@@ -166,8 +1113,8 @@ void audio_process(void)
             continue;
         }
 
-        /* Stop when the last pipeline element (i2s_stream_writer in this case) receives stop event */
-        if (msg.source_type == AUDIO_ELEMENT_TYPE_ELEMENT && msg.source == (void *) http_audio
+        /* Stop when the last pipeline element (the tee in this case) receives stop event */
+        if (msg.source_type == AUDIO_ELEMENT_TYPE_ELEMENT && msg.source == (void *) tee
             && msg.cmd == AEL_MSG_CMD_REPORT_STATUS
             && (((int)msg.data == AEL_STATUS_STATE_STOPPED) || ((int)msg.data == AEL_STATUS_STATE_FINISHED))) {
             ESP_LOGW(TAG, "[ * ] Stop event received");
@@ -180,9 +1127,19 @@ void audio_process(void)
     audio_pipeline_wait_for_stop(pipeline);
     audio_pipeline_terminate(pipeline);
 
+    /* The web server keeps running, so every handler given one of the
+     * handles below is taken off before the handle goes */
+    streaming_http_audio_unregister(http_audio);
+    if (hls)
+        hls_segmenter_unregister(hls);
+    if (capture)
+        i2s_capture_unregister(capture);
+
     audio_pipeline_unregister(pipeline, i2s_stream_reader);
-    audio_pipeline_unregister(pipeline, i2s_stream_writer);
-    audio_pipeline_unregister(pipeline, http_audio);
+    audio_pipeline_unregister(pipeline, iq_demod);
+    audio_pipeline_unregister(pipeline, voice_dsp);
+    audio_pipeline_unregister(pipeline, mixer);
+    audio_pipeline_unregister(pipeline, tee);
 
     /* Terminate the pipeline before removing the listener */
     audio_pipeline_remove_listener(pipeline);
@@ -192,13 +1149,100 @@ void audio_process(void)
 
     /* Release all resources */
     audio_pipeline_deinit(pipeline);
+    pipeline = NULL;
     audio_element_deinit(i2s_stream_reader);
+    i2s_stream_reader = NULL;
     audio_element_deinit(i2s_stream_writer);
+    audio_element_deinit(iq_demod);
+    iq_demod = NULL;
+    audio_element_deinit(voice_dsp);
+    voice_dsp = NULL;
+    tone.id = -1;
+    audio_element_deinit(mixer);
+    mixer = NULL;
+    audio_element_deinit(tee);
+    tee = NULL;
     audio_element_deinit(http_audio);
+    http_audio = NULL;
+    hls_segmenter_destroy(hls);
+    hls = NULL;
+    spectrum_tap_destroy(spectrum);
+    spectrum = NULL;
+    tone_tap_destroy(tone_detect);
+    tone_detect = NULL;
+    i2s_capture_destroy(capture);
+    capture = NULL;
+}
+
+// Boot steps. Capture only needs the TCP/IP stack, so the pipeline is
+// running while SPIFFS mounts and the station associates, and its output is
+// served as soon as the web server is up. A replayed trace has to wait for
+// SPIFFS
+
+static esp_err_t boot_nvs(void)
+{
+    return nvs_flash_init();
 }
 
+static esp_err_t boot_spiffs(void)
+{
+    return init_spiffs( BASE_PATH );
+}
+
+static esp_err_t boot_net(void)
+{
+    return wifi_netif_init( CONFIG_ESP_HOSTNAME );
+}
+
+static esp_err_t boot_wifi(void)
+{
+    return wifi_init_station( CONFIG_ESP_WIFI_SSID, CONFIG_ESP_WIFI_PASSWORD );
+}
+
+static esp_err_t boot_led(void)
+{
+    blink(3, STATUS_LED);
+    return ESP_OK;
+}
+
+static esp_err_t boot_web(void)
+{
+    esp_err_t ret = start_webserver( BASE_PATH, command_callback );
+    if ( ret == ESP_OK )
+        ret = boot_register();
+    if ( ret == ESP_OK )
+        ret = webserver_start_alias( STREAM_ALIAS_PORT );
+    if ( ret == ESP_OK )
+        trace_register();		// Optional, says so when it is not built in
+    return ret;
+}
+
+static esp_err_t boot_sysmon(void)
+{
+    esp_err_t ret = sysmon_start( SYSMON_PERIOD_MS );
+    return ret == ESP_ERR_NOT_SUPPORTED ? ESP_OK : ret;
+}
+
+static const boot_step_t boot_steps[] = {
+    { .name = "nvs",        .fn = boot_nvs },
+    { .name = "spiffs",     .fn = boot_spiffs },
+    { .name = "net",        .fn = boot_net },
+    { .name = "wifi",       .fn = boot_wifi,        .after = { "nvs", "net" } },
+    { .name = "led",        .fn = boot_led,         .after = { "wifi" } },
+    { .name = "web",        .fn = boot_web,         .after = { "spiffs", "net" } },
+    { .name = "sysmon",     .fn = boot_sysmon,      .after = { "web" } },
+#ifdef CONFIG_STREAMING_REPLAY
+    { .name = "audio",      .fn = audio_start,      .after = { "net", "spiffs" } },	// The trace is read from SPIFFS
+#else
+    { .name = "audio",      .fn = audio_start,      .after = { "net" } },
+#endif
+    { .name = "audio_web",  .fn = audio_register,   .after = { "audio", "web" } },
+};
+
 void app_main()
 {
-	init_webserver();
-	audio_process();
+	boot_run( boot_steps, sizeof(boot_steps) / sizeof(boot_steps[0]) );
+
+	if ( pipeline && evt )
+		audio_loop();
 }
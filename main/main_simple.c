@@ -73,4 +73,5 @@ void app_main2()
 
     ESP_LOGI(TAG, "Starting Streaming Server");
     start_streaming_server();
+    webserver_start_alias( 8080 );
 }
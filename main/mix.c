@@ -0,0 +1,73 @@
+/*
+ * mix.c
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: xenir
+ */
+
+#include <math.h>
+
+#include "mix.h"
+
+static inline int32_t _sat16( int32_t v )
+{
+    v = v < -32768 ? -32768 : v;
+    return v > 32767 ? 32767 : v;
+}
+
+static inline int32_t _mul_q15( int32_t s, int32_t gain )
+{
+    return ( s * gain + ( 1 << 14 ) ) >> 15;
+}
+
+int32_t mix_gain_q15( float db )
+{
+    if ( db <= -100 )
+        return 0;
+
+    float g = MIX_UNITY_Q15 * powf( 10.0f, db / 20.0f ) + 0.5f;
+    return g > MIX_MAX_GAIN_Q15 ? MIX_MAX_GAIN_Q15 : (int32_t) g;
+}
+
+void mix_scale_q15( int16_t* buf, int count, int32_t gain )
+{
+    if ( gain == MIX_UNITY_Q15 )
+        return;
+
+    for ( int i = 0 ; i < count ; i++ )
+        buf[i] = _sat16( _mul_q15( buf[i], gain ) );
+}
+
+void mix_add_q15( int16_t* dst, const int16_t* src, int frames, int channels, int32_t gain )
+{
+    if ( gain == 0 )
+        return;
+
+    // Unity gain and the mono and stereo layouts get their own loops so
+    // each inner loop has a fixed stride and no multiply it does not need
+
+    if ( channels == 1 ) {
+        if ( gain == MIX_UNITY_Q15 )
+            for ( int i = 0 ; i < frames ; i++ )
+                dst[i] = _sat16( dst[i] + src[i] );
+        else
+            for ( int i = 0 ; i < frames ; i++ )
+                dst[i] = _sat16( dst[i] + _mul_q15( src[i], gain ) );
+        return;
+    }
+
+    if ( channels == 2 ) {
+        for ( int i = 0 ; i < frames ; i++ ) {
+            int32_t s = gain == MIX_UNITY_Q15 ? src[i] : _mul_q15( src[i], gain );
+            dst[2*i] = _sat16( dst[2*i] + s );
+            dst[2*i+1] = _sat16( dst[2*i+1] + s );
+        }
+        return;
+    }
+
+    for ( int i = 0 ; i < frames ; i++ ) {
+        int32_t s = _mul_q15( src[i], gain );
+        for ( int c = 0 ; c < channels ; c++ )
+            dst[i*channels+c] = _sat16( dst[i*channels+c] + s );
+    }
+}
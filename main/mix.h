@@ -0,0 +1,40 @@
+/*
+ * mix.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: xenir
+ */
+
+#ifndef MAIN_MIX_H_
+#define MAIN_MIX_H_
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Saturating Q15 mixing kernels for 16 bit PCM. Gains are Q15 held in an
+// int32 so unity (32768) is exact and up to +6 dB is possible while a
+// sample times the gain still fits 32 bits. Every loop is a straight run
+// over the block with the clamp written as min/max, so compilers can
+// vectorise it on hosts that have SIMD.
+
+#define MIX_UNITY_Q15		32768
+#define MIX_MAX_GAIN_Q15	65536
+
+// Gain in dB to Q15, clamped to [0, MIX_MAX_GAIN_Q15]. -100 dB or below is 0
+int32_t mix_gain_q15( float db );
+
+// buf[i] = sat( buf[i] * gain ) over "count" samples
+void mix_scale_q15( int16_t* buf, int count, int32_t gain );
+
+// Adds a mono source to every channel of an interleaved block:
+// dst[f*channels+c] = sat( dst[f*channels+c] + src[f] * gain )
+void mix_add_q15( int16_t* dst, const int16_t* src, int frames, int channels, int32_t gain );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* MAIN_MIX_H_ */
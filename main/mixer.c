@@ -0,0 +1,293 @@
+/*
+ * mixer.c
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: xenir
+ */
+
+#include <string.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "esp_log.h"
+#include "audio_mem.h"
+#include "audio_element.h"
+#include "audio_error.h"
+
+#include "cycle_count.h"
+#include "mixer.h"
+
+static const char *TAG = "mixer";
+
+#define DETACH_TIMEOUT_MS		500
+
+typedef struct {
+    mixer_read_t	read;				// NULL when the slot is free
+    void*			ctx;
+    int32_t			gain;
+} mixer_input_t;
+
+typedef struct mixer {
+
+    int					channels;
+    int32_t				main_gain;
+    mixer_input_t		inputs[MIXER_MAX_INPUTS];
+    int16_t*			scratch;			// One block of mono source samples
+
+    // Changes are staged here and copied over by the element task between
+    // blocks. "applied" catches up with "generation" at each copy, which is
+    // how a detach knows the task has let go of the old source
+    SemaphoreHandle_t	lock;
+    mixer_input_t		pending[MIXER_MAX_INPUTS];
+    int32_t				pending_main_gain;
+    int					pending_channels;
+    volatile uint32_t	generation;
+    volatile uint32_t	applied;
+
+    mixer_stats_t		stats;
+
+} mixer_t;
+
+static esp_err_t _mixer_destroy(audio_element_handle_t self)
+{
+    mixer_t *mix = (mixer_t *)audio_element_getdata(self);
+    vSemaphoreDelete(mix->lock);
+    audio_free(mix->scratch);
+    audio_free(mix);
+    return ESP_OK;
+}
+
+static esp_err_t _mixer_open(audio_element_handle_t self)
+{
+    ESP_LOGD(TAG, "_mixer_open");
+    return ESP_OK;
+}
+
+static esp_err_t _mixer_close(audio_element_handle_t self)
+{
+    ESP_LOGD(TAG, "_mixer_close");
+    if (AEL_STATE_PAUSED != audio_element_get_state(self)) {
+        audio_element_set_byte_pos(self, 0);
+        audio_element_set_total_bytes(self, 0);
+    }
+    return ESP_OK;
+}
+
+static int _mixer_process(audio_element_handle_t self, char *in_buffer, int in_len)
+{
+    mixer_t *mix = (mixer_t *)audio_element_getdata(self);
+
+    int r_size = audio_element_input(self, in_buffer, in_len);
+    if (r_size <= 0)
+        return r_size;
+
+    if (mix->applied != mix->generation) {
+        xSemaphoreTake(mix->lock, portMAX_DELAY);
+        memcpy(mix->inputs, mix->pending, sizeof(mix->inputs));
+        mix->main_gain = mix->pending_main_gain;
+        mix->channels = mix->pending_channels;
+        mix->applied = mix->generation;
+        xSemaphoreGive(mix->lock);
+    }
+
+    int16_t *block = (int16_t *)in_buffer;
+    int frames = r_size / (sizeof(int16_t) * mix->channels);
+    int inputs = 0;
+
+    uint32_t start = cycle_count_get();
+
+    mix_scale_q15(block, frames * mix->channels, mix->main_gain);
+
+    for (int i = 0; i < MIXER_MAX_INPUTS; i++) {
+
+        mixer_input_t *in = &mix->inputs[i];
+        if (!in->read)
+            continue;
+
+        int got = in->read(mix->scratch, frames, in->ctx);
+        if (got < 0)
+            got = 0;
+        if (got < frames) {
+            memset(mix->scratch + got, 0, (frames - got) * sizeof(int16_t));
+            mix->stats.short_frames += frames - got;
+        }
+
+        mix_add_q15(block, mix->scratch, frames, mix->channels, in->gain);
+        inputs++;
+    }
+
+    uint32_t cycles = cycle_count_get() - start;
+
+    mix->stats.blocks++;
+    mix->stats.frames += frames;
+    mix->stats.cycles += cycles;
+    mix->stats.inputs = inputs;
+    if (cycles > mix->stats.max_block_cycles)
+        mix->stats.max_block_cycles = cycles;
+
+    int out_len = audio_element_output(self, in_buffer, r_size);
+    if (out_len > 0) {
+        audio_element_update_byte_pos(self, out_len);
+    }
+
+    return out_len;
+}
+
+int mixer_attach(audio_element_handle_t self, mixer_read_t read, void *ctx, int32_t gain)
+{
+    mixer_t *mix = (mixer_t *)audio_element_getdata(self);
+    int id = -1;
+
+    if (!read || gain < 0 || gain > MIX_MAX_GAIN_Q15)
+        return -1;
+
+    xSemaphoreTake(mix->lock, portMAX_DELAY);
+    for (int i = 0; i < MIXER_MAX_INPUTS && id < 0; i++) {
+        if (!mix->pending[i].read) {
+            mix->pending[i].read = read;
+            mix->pending[i].ctx = ctx;
+            mix->pending[i].gain = gain;
+            mix->generation++;
+            id = i;
+        }
+    }
+    xSemaphoreGive(mix->lock);
+
+    if (id >= 0)
+        ESP_LOGI(TAG, "Input %d attached", id);
+    return id;
+}
+
+esp_err_t mixer_detach(audio_element_handle_t self, int id)
+{
+    mixer_t *mix = (mixer_t *)audio_element_getdata(self);
+
+    if (id < 0 || id >= MIXER_MAX_INPUTS)
+        return ESP_ERR_NOT_FOUND;
+
+    xSemaphoreTake(mix->lock, portMAX_DELAY);
+    bool attached = mix->pending[id].read != NULL;
+    memset(&mix->pending[id], 0, sizeof(mixer_input_t));
+    uint32_t generation = ++mix->generation;
+    xSemaphoreGive(mix->lock);
+
+    if (!attached)
+        return ESP_ERR_NOT_FOUND;
+
+    // A task that is not running is not inside a block, and it copies the
+    // table before it mixes the next one
+
+    TickType_t start = xTaskGetTickCount();
+    while ((int32_t)(mix->applied - generation) < 0 && audio_element_get_state(self) == AEL_STATE_RUNNING) {
+        if (xTaskGetTickCount() - start > pdMS_TO_TICKS(DETACH_TIMEOUT_MS))
+            return ESP_ERR_TIMEOUT;
+        vTaskDelay(1);
+    }
+
+    ESP_LOGI(TAG, "Input %d detached", id);
+    return ESP_OK;
+}
+
+esp_err_t mixer_set_gain(audio_element_handle_t self, int id, int32_t gain)
+{
+    mixer_t *mix = (mixer_t *)audio_element_getdata(self);
+    esp_err_t ret = ESP_OK;
+
+    if (id < MIXER_MAIN || id >= MIXER_MAX_INPUTS)
+        return ESP_ERR_NOT_FOUND;
+    if (gain < 0 || gain > MIX_MAX_GAIN_Q15)
+        return ESP_ERR_INVALID_ARG;
+
+    xSemaphoreTake(mix->lock, portMAX_DELAY);
+    if (id == MIXER_MAIN)
+        mix->pending_main_gain = gain;
+    else if (mix->pending[id].read)
+        mix->pending[id].gain = gain;
+    else
+        ret = ESP_ERR_NOT_FOUND;
+    mix->generation++;
+    xSemaphoreGive(mix->lock);
+
+    return ret;
+}
+
+esp_err_t mixer_get_gain(audio_element_handle_t self, int id, int32_t *gain)
+{
+    mixer_t *mix = (mixer_t *)audio_element_getdata(self);
+    esp_err_t ret = ESP_OK;
+
+    if (id < MIXER_MAIN || id >= MIXER_MAX_INPUTS)
+        return ESP_ERR_NOT_FOUND;
+
+    xSemaphoreTake(mix->lock, portMAX_DELAY);
+    if (id == MIXER_MAIN)
+        *gain = mix->pending_main_gain;
+    else if (mix->pending[id].read)
+        *gain = mix->pending[id].gain;
+    else
+        ret = ESP_ERR_NOT_FOUND;
+    xSemaphoreGive(mix->lock);
+
+    return ret;
+}
+
+esp_err_t mixer_set_channels(audio_element_handle_t self, int channels)
+{
+    mixer_t *mix = (mixer_t *)audio_element_getdata(self);
+
+    if (channels < 1 || channels > 2)
+        return ESP_ERR_INVALID_ARG;
+
+    xSemaphoreTake(mix->lock, portMAX_DELAY);
+    mix->pending_channels = channels;
+    mix->generation++;
+    xSemaphoreGive(mix->lock);
+
+    return ESP_OK;
+}
+
+esp_err_t mixer_get_stats(audio_element_handle_t self, mixer_stats_t *stats)
+{
+    mixer_t *mix = (mixer_t *)audio_element_getdata(self);
+    *stats = mix->stats;
+    return ESP_OK;
+}
+
+audio_element_handle_t mixer_init(mixer_cfg_t *config)
+{
+    if (config->channels < 1 || config->channels > 2)
+        return NULL;
+
+    mixer_t *mix = audio_calloc(1, sizeof(mixer_t));
+    AUDIO_MEM_CHECK(TAG, mix, {return NULL;});
+
+    audio_element_cfg_t cfg = DEFAULT_AUDIO_ELEMENT_CONFIG();
+    cfg.destroy = _mixer_destroy;
+    cfg.process = _mixer_process;
+    cfg.open = _mixer_open;
+    cfg.close = _mixer_close;
+    cfg.buffer_len = MIXER_BUFFER_LEN;
+    cfg.task_stack = config->task_stack ? config->task_stack : MIXER_TASK_STACK;
+    cfg.stack_in_ext = config->stack_in_ext;
+    cfg.task_prio = config->task_prio;
+    cfg.task_core = config->task_core;
+    cfg.out_rb_size = config->out_rb_size;
+    cfg.tag = "mix";
+
+    // Mono needs the most frames per block
+    mix->scratch = audio_malloc(MIXER_BUFFER_LEN);
+    AUDIO_MEM_CHECK(TAG, mix->scratch, {audio_free(mix); return NULL;});
+
+    mix->lock = xSemaphoreCreateMutex();
+    AUDIO_MEM_CHECK(TAG, mix->lock, {audio_free(mix->scratch); audio_free(mix); return NULL;});
+
+    mix->channels = mix->pending_channels = config->channels;
+    mix->main_gain = mix->pending_main_gain = config->main_gain;
+
+    audio_element_handle_t el = audio_element_init(&cfg);
+    AUDIO_MEM_CHECK(TAG, el, {vSemaphoreDelete(mix->lock); audio_free(mix->scratch); audio_free(mix); return NULL;});
+    audio_element_setdata(el, mix);
+
+    return el;
+}
@@ -0,0 +1,113 @@
+/*
+ * mixer.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: xenir
+ */
+
+#ifndef MAIN_MIXER_H_
+#define MAIN_MIXER_H_
+
+#include <stdint.h>
+
+#include "esp_err.h"
+#include "audio_element.h"
+#include "mix.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Pipeline element that overlays any number of extra sources on the block
+// passing through it. The block from the upstream element is mixed into in
+// place: it is scaled by the main gain, then each attached source fills a
+// scratch block of mono samples which is added, at its own gain, to every
+// channel. A source that comes up short is padded with silence and the
+// shortfall counted, so a stalled source never holds up the live feed.
+
+#define MIXER_MAX_INPUTS		4
+#define MIXER_MAIN				(-1)		// Input id of the upstream block
+
+/**
+ * @brief      Source callback, run in the mixer task. Fill "buf" with up to
+ *             "frames" mono 16 bit samples at the pipeline rate
+ *
+ * @return     The number of samples written
+ */
+typedef int (*mixer_read_t)(int16_t *buf, int frames, void *ctx);
+
+typedef struct {
+    int                     out_rb_size;    /*!< Size of output ringbuffer */
+    int                     task_stack;     /*!< Task stack size */
+    int                     task_core;      /*!< Task running in core (0 or 1) */
+    int                     task_prio;      /*!< Task priority (based on freeRTOS priority) */
+    bool                    stack_in_ext;   /*!< Try to allocate stack in external memory */
+
+    int                     channels;       /*!< Interleaved 16 bit channels, 1 or 2 */
+    int32_t                 main_gain;      /*!< Q15 gain of the upstream block */
+} mixer_cfg_t;
+
+typedef struct {
+    uint32_t                blocks;
+    uint64_t                frames;
+    uint64_t                cycles;
+    uint32_t                max_block_cycles;
+    int                     inputs;         /*!< Sources attached when the last block was mixed */
+    uint64_t                short_frames;   /*!< Silence padded in for sources that came up short */
+} mixer_stats_t;
+
+#define MIXER_TASK_STACK          (3 * 1024)
+#define MIXER_TASK_CORE           (1)
+#define MIXER_TASK_PRIO           (22)
+#define MIXER_RINGBUFFER_SIZE     (8 * 1024)
+#define MIXER_BUFFER_LEN          (1024)
+
+#define DEFAULT_MIXER_CONFIG() {\
+    .out_rb_size        = MIXER_RINGBUFFER_SIZE,\
+    .task_stack         = MIXER_TASK_STACK,\
+    .task_core          = MIXER_TASK_CORE,\
+    .task_prio          = MIXER_TASK_PRIO,\
+    .stack_in_ext       = true,\
+    .channels           = 2,\
+    .main_gain          = MIX_UNITY_Q15,\
+}
+
+audio_element_handle_t mixer_init(mixer_cfg_t *config);
+
+/**
+ * @brief      Attach a source. It is first read at the next block
+ *
+ * @return     The input id, or -1 if all MIXER_MAX_INPUTS are in use
+ */
+int mixer_attach(audio_element_handle_t self, mixer_read_t read, void *ctx, int32_t gain);
+
+/**
+ * @brief      Detach a source. Returns once the mixer task has stopped
+ *             calling it, after which its context may be freed
+ *
+ * @return     ESP_OK, ESP_ERR_NOT_FOUND for an unknown id or ESP_ERR_TIMEOUT
+ *             if the running mixer did not reach a new block in time
+ */
+esp_err_t mixer_detach(audio_element_handle_t self, int id);
+
+/**
+ * @brief      Change the Q15 gain of an input, or of the upstream block when
+ *             id is MIXER_MAIN. Applied at the next block
+ */
+esp_err_t mixer_set_gain(audio_element_handle_t self, int id, int32_t gain);
+
+esp_err_t mixer_get_gain(audio_element_handle_t self, int id, int32_t *gain);
+
+/**
+ * @brief      Change the channel count. Like the other elements, the caller
+ *             must make sure no data in the old format is still queued
+ */
+esp_err_t mixer_set_channels(audio_element_handle_t self, int channels);
+
+esp_err_t mixer_get_stats(audio_element_handle_t self, mixer_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* MAIN_MIXER_H_ */
@@ -0,0 +1,189 @@
+/*
+ * narrowband.c
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: xenir
+ */
+
+#include <string.h>
+#include <strings.h>
+#include <math.h>
+
+#include "narrowband.h"
+
+#define KAISER_BETA			6.0f		// About 65 dB of stopband
+#define MIN_RATE_FACTOR		2.5f		// Output rate against bandwidth
+#define CHANNEL_EDGE		0.04f		// Channel cutoff above the bandwidth, of the output rate
+
+static const struct {
+    const char*	name;
+    int			bandwidth_hz;
+} presets[NARROWBAND_PRESETS] = {
+    { "off",	0 },
+    { "voice",	3000 },
+    { "narrow",	1500 },
+    { "cw",		500 },
+};
+
+int narrowband_bandwidth( int preset )
+{
+    return preset >= 0 && preset < NARROWBAND_PRESETS ? presets[preset].bandwidth_hz : 0;
+}
+
+const char* narrowband_name( int preset )
+{
+    return preset >= 0 && preset < NARROWBAND_PRESETS ? presets[preset].name : "?";
+}
+
+int narrowband_parse( const char* name )
+{
+    for ( int p = 0 ; p < NARROWBAND_PRESETS ; p++ )
+        if ( strcasecmp( name, presets[p].name ) == 0 )
+            return p;
+    return -1;
+}
+
+// Zeroth order modified Bessel function, for the Kaiser window
+
+static float _i0( float x )
+{
+    float sum = 1, term = 1;
+    for ( int k = 1 ; k < 20 ; k++ ) {
+        term *= ( x / ( 2 * k ) ) * ( x / ( 2 * k ) );
+        sum += term;
+    }
+    return sum;
+}
+
+static float _kaiser( int n, int half )
+{
+    float r = (float) n / ( half + 1 );
+    return _i0( KAISER_BETA * sqrtf( 1 - r * r ) ) / _i0( KAISER_BETA );
+}
+
+static float _sinc( float x )
+{
+    return x == 0 ? 1 : sinf( M_PI * x ) / ( M_PI * x );
+}
+
+// Windowed sinc designs, both scaled to unity gain at DC
+
+static void _design( narrowband_t* nb )
+{
+    // The centre tap stays at a half, the odd taps make up the other half
+    float sum = 0;
+    for ( int j = 0 ; j < ( NARROWBAND_HALFBAND_HALF + 1 ) / 2 ; j++ ) {
+        int n = 2 * j + 1;
+        nb->halfband[j] = 0.5f * _sinc( n / 2.0f ) * _kaiser( n, NARROWBAND_HALFBAND_HALF );
+        sum += 2 * nb->halfband[j];
+    }
+    for ( int j = 0 ; j < ( NARROWBAND_HALFBAND_HALF + 1 ) / 2 ; j++ )
+        nb->halfband[j] *= 0.5f / sum;
+
+    // Kept below the output's Nyquist, where the halfband leaves aliases
+    float fc = nb->bandwidth_hz + CHANNEL_EDGE * nb->out_rate;
+    fc = fc > 0.45f * nb->out_rate ? 0.45f * nb->out_rate : fc;
+    fc /= nb->out_rate;
+
+    sum = 0;
+    for ( int k = 0 ; k <= NARROWBAND_CHANNEL_HALF ; k++ ) {
+        nb->channel[k] = 2 * fc * _sinc( 2 * fc * k ) * _kaiser( k, NARROWBAND_CHANNEL_HALF );
+        sum += k ? 2 * nb->channel[k] : nb->channel[k];
+    }
+    for ( int k = 0 ; k <= NARROWBAND_CHANNEL_HALF ; k++ )
+        nb->channel[k] /= sum;
+}
+
+int narrowband_init( narrowband_t* nb, int sample_rate, int preset )
+{
+    memset( nb, 0, sizeof(narrowband_t) );
+    nb->preset = preset > 0 && preset < NARROWBAND_PRESETS ? preset : NARROWBAND_OFF;
+    nb->bandwidth_hz = narrowband_bandwidth( nb->preset );
+    nb->sample_rate = sample_rate;
+    nb->out_rate = sample_rate;
+
+    if ( nb->preset == NARROWBAND_OFF )
+        return sample_rate;
+
+    // Halving while the bandwidth still fits, so the rate only divides by a
+    // power of two and the output rate is a whole number for any capture
+    // rate the board takes
+
+    while ( nb->stages < NARROWBAND_MAX_STAGES && ( sample_rate >> ( nb->stages + 1 ) ) >= MIN_RATE_FACTOR * nb->bandwidth_hz &&
+            ( sample_rate >> ( nb->stages + 1 ) ) << ( nb->stages + 1 ) == sample_rate ) {
+        nb->delay_us += (uint64_t) NARROWBAND_HALFBAND_HALF * 1000000 / ( sample_rate >> nb->stages );
+        nb->stages++;
+    }
+
+    nb->out_rate = sample_rate >> nb->stages;
+    nb->delay_us += (uint64_t) NARROWBAND_CHANNEL_HALF * 1000000 / nb->out_rate;
+    _design( nb );
+
+    return nb->out_rate;
+}
+
+// Pushes x into a halfband stage; on the second of each pair the output is
+// worked out at the window's centre and returned through y
+
+static inline bool _halfband( const narrowband_t* nb, narrowband_stage_t* st, float x, float* y )
+{
+    int p = st->pos;
+    st->hist[p] = st->hist[p + NARROWBAND_HALFBAND_TAPS] = x;
+    st->pos = p + 1 == NARROWBAND_HALFBAND_TAPS ? 0 : p + 1;
+
+    st->odd = !st->odd;
+    if ( st->odd )
+        return false;
+
+    const float* c = &st->hist[st->pos + NARROWBAND_HALFBAND_HALF];
+    float sum = 0.5f * c[0];
+    for ( int j = 0 ; j < ( NARROWBAND_HALFBAND_HALF + 1 ) / 2 ; j++ )
+        sum += nb->halfband[j] * ( c[-2 * j - 1] + c[2 * j + 1] );
+
+    *y = sum;
+    return true;
+}
+
+static inline float _channel( narrowband_t* nb, float x )
+{
+    int p = nb->cpos;
+    nb->chist[p] = nb->chist[p + NARROWBAND_CHANNEL_TAPS] = x;
+    nb->cpos = p + 1 == NARROWBAND_CHANNEL_TAPS ? 0 : p + 1;
+
+    // Two sums, so each add need not wait for the one before
+    const float* c = &nb->chist[nb->cpos + NARROWBAND_CHANNEL_HALF];
+    float s0 = nb->channel[0] * c[0], s1 = 0;
+    int k = 1;
+    for ( ; k + 1 <= NARROWBAND_CHANNEL_HALF ; k += 2 ) {
+        s0 += nb->channel[k] * ( c[-k] + c[k] );
+        s1 += nb->channel[k + 1] * ( c[-k - 1] + c[k + 1] );
+    }
+    for ( ; k <= NARROWBAND_CHANNEL_HALF ; k++ )
+        s0 += nb->channel[k] * ( c[-k] + c[k] );
+
+    return s0 + s1;
+}
+
+int narrowband_process( narrowband_t* nb, int16_t* buf, int count )
+{
+    if ( nb->preset == NARROWBAND_OFF )
+        return count;
+
+    // In place: output sample n never lies past input sample i
+
+    int n = 0;
+    for ( int i = 0 ; i < count ; i++ ) {
+
+        float v = buf[i];
+        int s = 0;
+        while ( s < nb->stages && _halfband( nb, &nb->stage[s], v, &v ) )
+            s++;
+        if ( s < nb->stages )
+            continue;
+
+        float y = _channel( nb, v );
+        buf[n++] = y > 32767 ? 32767 : ( y < -32768 ? -32768 : lrintf( y ) );
+    }
+
+    return n;
+}
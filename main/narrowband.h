@@ -0,0 +1,92 @@
+/*
+ * narrowband.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: xenir
+ */
+
+#ifndef MAIN_NARROWBAND_H_
+#define MAIN_NARROWBAND_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Decimating channel filter for 16 bit mono, for streams whose content is
+// all well below the capture rate's Nyquist: speech under 3 kHz, CW under
+// 500 Hz. A cascade of halfband FIR stages each halves the rate, as many as
+// leave the output rate at least 2.5 times the preset's bandwidth, and a
+// final lowpass FIR at the output rate sets the bandwidth itself. At 16 kHz
+// the presets stream at 8, 4 and 2 kHz, a half, a quarter and an eighth of
+// the bytes.
+//
+// Each halfband stage has NARROWBAND_HALFBAND_TAPS Kaiser windowed taps, of
+// which every other one is zero and the rest symmetric, so it costs about
+// NARROWBAND_HALFBAND_TAPS / 8 multiplies per input sample; it is flat to
+// 0.4 of its output rate and what it lets alias lands above the channel
+// filter's stopband. The channel filter has NARROWBAND_CHANNEL_TAPS taps,
+// symmetric, run once per output sample. Both in single precision float
+// like the notch. The delay is half of each filter's length at its rate,
+// about 20 ms for the CW preset (see narrowband_t.delay_us).
+
+#define NARROWBAND_MAX_STAGES		4
+#define NARROWBAND_HALFBAND_TAPS	39
+#define NARROWBAND_HALFBAND_HALF	( NARROWBAND_HALFBAND_TAPS / 2 )
+#define NARROWBAND_CHANNEL_TAPS		47
+#define NARROWBAND_CHANNEL_HALF		( NARROWBAND_CHANNEL_TAPS / 2 )
+
+typedef enum {
+    NARROWBAND_OFF = 0,							// Full rate, nothing filtered
+    NARROWBAND_VOICE,							// 3 kHz
+    NARROWBAND_NARROW,							// 1.5 kHz
+    NARROWBAND_CW,								// 500 Hz
+    NARROWBAND_PRESETS
+} narrowband_preset_t;
+
+typedef struct {
+    float		hist[2 * NARROWBAND_HALFBAND_TAPS];		// Written twice so the taps never wrap
+    int			pos;
+    bool		odd;									// Holding the first of a pair
+} narrowband_stage_t;
+
+typedef struct {
+
+    int					preset;
+    int					bandwidth_hz;
+    int					sample_rate;
+    int					out_rate;
+    int					stages;
+    uint32_t			delay_us;
+
+    float				halfband[( NARROWBAND_HALFBAND_HALF + 1 ) / 2];	// Taps 1, 3, 5 ... from the centre
+    float				channel[NARROWBAND_CHANNEL_HALF + 1];			// Centre tap first
+    narrowband_stage_t	stage[NARROWBAND_MAX_STAGES];
+    float				chist[2 * NARROWBAND_CHANNEL_TAPS];
+    int					cpos;
+
+} narrowband_t;
+
+// Sets up "preset" for input at sample_rate and returns the output rate,
+// sample_rate itself for NARROWBAND_OFF
+int narrowband_init( narrowband_t* nb, int sample_rate, int preset );
+
+// Filters "count" samples in place and returns how many come out, about
+// count / ( sample_rate / out_rate ); a stage part way through a pair
+// carries it to the next call. NARROWBAND_OFF returns count untouched
+int narrowband_process( narrowband_t* nb, int16_t* buf, int count );
+
+int narrowband_bandwidth( int preset );
+
+const char* narrowband_name( int preset );
+
+// Preset from its name, -1 for none
+int narrowband_parse( const char* name );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* MAIN_NARROWBAND_H_ */
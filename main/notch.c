@@ -0,0 +1,200 @@
+/*
+ * notch.c
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: xenir
+ */
+
+#include <string.h>
+#include <math.h>
+
+#include "notch.h"
+
+#define SEARCH_WIDTH_HZ		200			// Notch width while a section searches
+#define STILL_MS			200			// A locked tone moves less than its width in this long
+#define MIN_DBFS			-60			// Quieter than this nothing locks
+#define EDGE_HZ				40			// Sections stay this far from DC and Nyquist
+
+static float _radius( int sample_rate, int width_hz )
+{
+    float r = 1 - M_PI * width_hz / sample_rate;
+    return r < 0.5f ? 0.5f : ( r > 0.9999f ? 0.9999f : r );
+}
+
+static void _derive( notch_t* nt )
+{
+    const notch_params_t* p = &nt->params;
+    int width = p->width_hz > 1 ? p->width_hz : 1;
+    int converge = p->converge_ms > 1 ? p->converge_ms : 1;
+    float level = 32768.0f * powf( 10.0f, MIN_DBFS / 20.0f );
+
+    nt->r_lock = _radius( nt->sample_rate, width );
+    nt->r_search = _radius( nt->sample_rate, width > SEARCH_WIDTH_HZ ? width : SEARCH_WIDTH_HZ );
+    nt->mix = 1 - powf( 10.0f, -( p->depth_db > 0 ? p->depth_db : 0 ) / 20.0f );
+    nt->step = 4.0f * 1000 / ( (float) converge * nt->sample_rate );
+    nt->slew = 2 * nt->step;
+    nt->min_power = level * level;
+    nt->a_min = -2 * cosf( 2 * M_PI * EDGE_HZ / nt->sample_rate );
+    nt->a_max = -2 * cosf( 2 * M_PI * ( nt->sample_rate / 2 - EDGE_HZ ) / nt->sample_rate );
+}
+
+// Sections start spread evenly over the band
+
+static void _start( notch_t* nt, int k )
+{
+    notch_section_t* sec = &nt->sec[k];
+    memset( sec, 0, sizeof(notch_section_t) );
+    sec->a = -2 * cosf( M_PI * ( k + 1 ) / ( NOTCH_MAX_TONES + 1 ) );
+    sec->a_last = sec->a;
+}
+
+void notch_init( notch_t* nt, int sample_rate, const notch_params_t* params )
+{
+    memset( nt, 0, sizeof(notch_t) );
+    nt->sample_rate = sample_rate;
+    nt->params = *params;
+    for ( int k = 0 ; k < NOTCH_MAX_TONES ; k++ )
+        _start( nt, k );
+    notch_set_params( nt, params );
+}
+
+void notch_set_params( notch_t* nt, const notch_params_t* params )
+{
+    int tones = params->tones < 1 ? 1 : ( params->tones > NOTCH_MAX_TONES ? NOTCH_MAX_TONES : params->tones );
+
+    // Sections taken out of use start over if they come back
+
+    for ( int k = tones ; k < nt->tones ; k++ )
+        _start( nt, k );
+
+    nt->params = *params;
+    nt->tones = tones;
+    _derive( nt );
+}
+
+int notch_frequency( const notch_t* nt, int section )
+{
+    return lrintf( acosf( -nt->sec[section].a / 2 ) * nt->sample_rate / ( 2 * M_PI ) );
+}
+
+// Lock decisions from the block's powers, with 3 dB of hysteresis, and the
+// step for the next block normalised by the power the section works on. A
+// tone is what the section removes standing out from the rest of the
+// spectrum: the removed power against the output power that would fall in
+// the search width if it were spread evenly. It must also hold still: the
+// section's frequency may move by no more than the locked width in STILL_MS,
+// which keeps it off voiced speech, whose pitch moves faster than that
+
+static void _update( notch_t* nt, int count, const float* removed, const float* out, const float* state )
+{
+    int converge = nt->params.converge_ms > 1 ? nt->params.converge_ms : 1;
+    float k = (float) count * 1000 / ( converge * nt->sample_rate );
+    float on = powf( 10.0f, nt->params.lock_db / 10.0f );
+    float share = (float) SEARCH_WIDTH_HZ * 2 / nt->sample_rate;
+    bool any = false;
+
+    k = k > 1 ? 1 : k;
+
+    for ( int i = 0 ; i < nt->tones ; i++ ) {
+
+        notch_section_t* sec = &nt->sec[i];
+
+        // Should the filter ever run away, that section starts over
+        if ( !isfinite( sec->s1 ) || !isfinite( sec->s2 ) || !isfinite( out[i] ) ) {
+            _start( nt, i );
+            continue;
+        }
+
+        sec->removed_power += k * ( removed[i] / count - sec->removed_power );
+        sec->out_power += k * ( out[i] / count - sec->out_power );
+        sec->mu = nt->step / ( state[i] / count + 1.0f );
+
+        // How fast the frequency moves, in steps of a ( -2 cos w ) per
+        // second, against the locked width per STILL_MS
+
+        float move = sec->a - sec->a_last;
+        sec->a_last = sec->a;
+        sec->a_rate += k * ( ( move < 0 ? -move : move ) * nt->sample_rate / count - sec->a_rate );
+
+        float sin_w = sqrtf( 1 - sec->a * sec->a / 4 );
+        float still = 2 * sin_w * 2 * M_PI * nt->params.width_hz / nt->sample_rate * 1000 / STILL_MS;
+
+        float ratio = sec->removed_power / ( sec->out_power * share + 1.0f );
+        bool loud = sec->removed_power > nt->min_power;
+
+        if ( !sec->locked && loud && ratio > on && sec->a_rate < still ) {
+            sec->locked = true;
+            sec->locks++;
+        } else if ( sec->locked && ( !loud || ratio < on / 2 || sec->a_rate > 2 * still ) ) {
+            sec->locked = false;
+        }
+
+        if ( sec->locked ) {
+            sec->locked_blocks++;
+            any = true;
+        }
+    }
+
+    nt->blocks++;
+    if ( any )
+        nt->locked_blocks++;
+}
+
+void notch_process( notch_t* nt, int16_t* buf, int count )
+{
+    if ( count <= 0 )
+        return;
+
+    float removed[NOTCH_MAX_TONES] = { 0 }, out[NOTCH_MAX_TONES] = { 0 }, state[NOTCH_MAX_TONES] = { 0 };
+    float r[NOTCH_MAX_TONES], r2[NOTCH_MAX_TONES];
+    bool locked[NOTCH_MAX_TONES];
+    int tones = nt->tones;
+
+    for ( int k = 0 ; k < tones ; k++ ) {
+        locked[k] = nt->sec[k].locked;
+        r[k] = locked[k] ? nt->r_lock : nt->r_search;
+        r2[k] = r[k] * r[k];
+    }
+
+    for ( int i = 0 ; i < count ; i++ ) {
+
+        float x = buf[i];
+        float z = x;
+
+        // Through the cascade: each section adapts on what reaches it, and
+        // passes on its output only while locked
+
+        for ( int k = 0 ; k < tones ; k++ ) {
+
+            notch_section_t* sec = &nt->sec[k];
+            float a = sec->a, s1 = sec->s1, s2 = sec->s2;
+
+            float s = z - r[k] * a * s1 - r2[k] * s2;
+            float e = s + a * s1 + s2;
+
+            // The step is normalised by the last block's power, so at an
+            // onset out of quiet it is far too large; the slew limit keeps
+            // the coefficient from jumping about, which a time varying IIR
+            // does not survive
+
+            float da = sec->mu * e * s1;
+            da = da > nt->slew ? nt->slew : ( da < -nt->slew ? -nt->slew : da );
+            a -= da;
+            sec->a = a < nt->a_min ? nt->a_min : ( a > nt->a_max ? nt->a_max : a );
+            sec->s2 = s1;
+            sec->s1 = s;
+
+            removed[k] += ( z - e ) * ( z - e );
+            out[k] += e * e;
+            state[k] += s * s;
+
+            if ( locked[k] )
+                z = e;
+        }
+
+        float y = x - nt->mix * ( x - z );
+        buf[i] = y > 32767 ? 32767 : ( y < -32768 ? -32768 : lrintf( y ) );
+    }
+
+    _update( nt, count, removed, out, state );
+}
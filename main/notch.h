@@ -0,0 +1,102 @@
+/*
+ * notch.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: xenir
+ */
+
+#ifndef MAIN_NOTCH_H_
+#define MAIN_NOTCH_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Adaptive notch for steady carriers and whine on 16 bit mono. A cascade of
+// constrained second order IIR notches,
+//
+//   H(z) = ( 1 + a z^-1 + z^-2 ) / ( 1 + r a z^-1 + r^2 z^-2 ),  a = -2 cos w
+//
+// each adapting its frequency by the simplified gradient of its output
+// power, normalised by the power it works on. While a section is searching
+// its notch is wide so the gradient reaches tones far from it; once what it
+// removes stands lock_db above the average level of the rest of the
+// spectrum, for a while, and its frequency holds still, it counts as
+// locked, narrows to width_hz and is applied. Each section adapts on what the sections before it let
+// through, so they settle on different tones, strongest first. The pitch of
+// speech moves too much for a section to lock on it, so it goes through.
+//
+// The filter runs in single precision float, which the ESP32's FPU does as
+// fast as the fixed point equivalent and the adaptation needs the range.
+
+#define NOTCH_MAX_TONES		4
+
+typedef struct {
+    bool	enable;				// Default for a stream, the caller decides
+    int		tones;				// Sections, each can hold one tone
+    int		width_hz;			// Notch width at -3 dB once locked
+    int		depth_db;			// How far a locked tone is brought down
+    int		converge_ms;		// About how long finding a tone takes
+    int		lock_db;			// How far a tone must stand above the spectrum around it
+} notch_params_t;
+
+#define DEFAULT_NOTCH_PARAMS() {\
+    .enable             = false,\
+    .tones              = 2,\
+    .width_hz           = 30,\
+    .depth_db           = 40,\
+    .converge_ms        = 100,\
+    .lock_db            = 12,\
+}
+
+typedef struct {
+    float		a;				// -2 cos w
+    float		s1, s2;			// All pole state
+    float		mu;				// Step for this block, normalised
+    float		removed_power;	// Smoothed over blocks
+    float		out_power;
+    float		a_last;			// At the end of the last block
+    float		a_rate;			// How fast it moves, per second
+    bool		locked;
+    uint32_t	locks;			// Times it locked on
+    uint32_t	locked_blocks;
+} notch_section_t;
+
+typedef struct {
+
+    notch_params_t		params;
+    int					sample_rate;
+    int					tones;
+    float				r_lock, r_search;	// Pole radii locked and searching
+    float				mix;				// Share of the notched signal in the output
+    float				step;
+    float				slew;				// Most a may move per sample
+    float				min_power;			// Below this nothing locks
+    float				a_min, a_max;
+    notch_section_t		sec[NOTCH_MAX_TONES];
+
+    uint32_t			blocks;
+    uint32_t			locked_blocks;		// Blocks with at least one tone removed
+
+} notch_t;
+
+void notch_init( notch_t* nt, int sample_rate, const notch_params_t* params );
+
+// Changes parameters keeping what the sections found
+void notch_set_params( notch_t* nt, const notch_params_t* params );
+
+// Filters "count" samples in place. The sections only adapt while this
+// runs, so a stream that turns it on may take converge_ms to lock again
+void notch_process( notch_t* nt, int16_t* buf, int count );
+
+// Frequency a section sits at in Hz, locked or not
+int notch_frequency( const notch_t* nt, int section );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* MAIN_NOTCH_H_ */
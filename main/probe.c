@@ -0,0 +1,96 @@
+/*
+ * probe.c
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: xenir
+ */
+
+#include <string.h>
+#include <math.h>
+
+#include "probe.h"
+
+int probe_samples( int sample_rate )
+{
+    return sample_rate * PROBE_MS / 1000;
+}
+
+// Phase of a linear sweep is 2 pi ( f0 t + ( f1 - f0 ) t^2 / 2T )
+
+static float _chirp( int sample_rate, int len, int i )
+{
+    float t = (float) i / sample_rate;
+    float T = (float) len / sample_rate;
+    float phase = 2 * M_PI * ( PROBE_F0_HZ * t + ( PROBE_F1_HZ - PROBE_F0_HZ ) * t * t / ( 2 * T ) );
+
+    int edge = sample_rate * PROBE_EDGE_MS / 1000;
+    int from_end = len - 1 - i;
+    int k = i < from_end ? i : from_end;
+    float w = k < edge ? 0.5f * ( 1 - cosf( M_PI * k / edge ) ) : 1.0f;
+
+    return w * sinf( phase );
+}
+
+void probe_chirp( int sample_rate, float* out )
+{
+    int len = probe_samples( sample_rate );
+    for ( int i = 0 ; i < len ; i++ )
+        out[i] = _chirp( sample_rate, len, i );
+}
+
+void probe_init( probe_t* p, int sample_rate )
+{
+    int period_ms = p->period_ms;
+
+    memset( p, 0, sizeof(probe_t) );
+    p->sample_rate = sample_rate;
+    p->len = probe_samples( sample_rate );
+    p->pos = -1;
+    p->period_ms = period_ms;
+}
+
+void probe_fire( probe_t* p )
+{
+    p->requested++;
+}
+
+void probe_set_period( probe_t* p, int period_ms )
+{
+    p->period_ms = period_ms > 0 ? period_ms : 0;
+}
+
+int probe_read( probe_t* p, int16_t* buf, int frames )
+{
+    int period = p->period_ms * ( p->sample_rate / 1000 );
+
+    for ( int i = 0 ; i < frames ; i++ ) {
+
+        if ( p->pos < 0 ) {
+            bool due = p->requested != p->started;
+            if ( period > 0 && p->until_next == 0 ) {
+                p->until_next = period;
+                due = true;
+            }
+            if ( due ) {
+                p->started = p->requested;
+                p->pos = 0;
+            }
+        }
+
+        if ( period > 0 && p->until_next > 0 )
+            p->until_next--;
+
+        if ( p->pos >= 0 ) {
+            buf[i] = PROBE_LEVEL * 32767 * _chirp( p->sample_rate, p->len, p->pos );
+            if ( ++p->pos >= p->len ) {
+                p->pos = -1;
+                p->markers++;
+            }
+        } else {
+            buf[i] = 0;
+        }
+    }
+
+    p->samples += frames;
+    return frames;
+}
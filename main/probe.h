@@ -0,0 +1,73 @@
+/*
+ * probe.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: xenir
+ */
+
+#ifndef MAIN_PROBE_H_
+#define MAIN_PROBE_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Latency probe marker: a short linear chirp from PROBE_F0_HZ to PROBE_F1_HZ
+// with raised cosine edges, added to the capture side on request or every
+// period. A listener finds it in the stream by cross-correlating with the
+// same chirp (probe_chirp), which host/probe does to turn the time between
+// asking for a marker and hearing it into a glass to ear latency. A chirp
+// has a single sharp correlation peak, unlike a tone, so it is found to
+// within a sample under speech or noise.
+//
+// probe_read is a mixer source. fire and the period may be set from any
+// task, the reading task picks them up at its next block.
+
+#define PROBE_F0_HZ			500
+#define PROBE_F1_HZ			3500
+#define PROBE_MS			50
+#define PROBE_EDGE_MS		5
+#define PROBE_LEVEL			0.25f			// -12 dBFS peak
+
+typedef struct {
+
+    int					sample_rate;
+    int					len;				// Chirp samples
+    int					pos;				// Next sample of a marker being played, -1 when idle
+
+    volatile uint32_t	requested;			// Markers asked for with probe_fire
+    uint32_t			started;
+    volatile int		period_ms;			// 0 for none
+    uint32_t			until_next;			// Samples to the next periodic marker
+
+    uint32_t			markers;			// Markers played in full
+    uint64_t			samples;			// Read since init
+
+} probe_t;
+
+// Also used for a rate change, the period is kept
+void probe_init( probe_t* p, int sample_rate );
+
+// Length of the chirp at "sample_rate"
+int probe_samples( int sample_rate );
+
+// The chirp at "sample_rate" as floats at full scale, "out" holding
+// probe_samples() values. Used by listeners as the correlation template
+void probe_chirp( int sample_rate, float* out );
+
+// Asks for one marker, started at the next read
+void probe_fire( probe_t* p );
+
+void probe_set_period( probe_t* p, int period_ms );
+
+// Mixer source: fills "frames" mono samples with the marker or silence
+int probe_read( probe_t* p, int16_t* buf, int frames );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* MAIN_PROBE_H_ */
@@ -0,0 +1,82 @@
+/*
+ * resampler.c
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: xenir
+ */
+
+#include <string.h>
+
+#include "resampler.h"
+
+#define Q32_ONE		( (uint64_t) 1 << 32 )
+
+static inline int16_t _sat16( int32_t v )
+{
+    return v > 32767 ? 32767 : ( v < -32768 ? -32768 : v );
+}
+
+void resampler_init( resampler_t* rs )
+{
+    memset( rs, 0, sizeof(resampler_t) );
+    rs->phase = Q32_ONE;
+    rs->step = Q32_ONE;
+}
+
+void resampler_set_ppm( resampler_t* rs, int32_t ppm )
+{
+    if ( ppm > RESAMPLER_MAX_PPM )
+        ppm = RESAMPLER_MAX_PPM;
+    if ( ppm < -RESAMPLER_MAX_PPM )
+        ppm = -RESAMPLER_MAX_PPM;
+
+    // step = 1 / ( 1 + ppm / 1e6 )
+    rs->ppm = ppm;
+    rs->step = Q32_ONE * 1000000 / ( 1000000 + ppm );
+}
+
+int resampler_process( resampler_t* rs, const int16_t* in, int count, int16_t* out )
+{
+    int n = 0;
+
+    // Positions index the three history samples followed by the block, so
+    // output is possible while two samples past the integer position exist
+
+    uint64_t end = (uint64_t) ( count + 1 ) << 32;
+
+#define SAMPLE(k)	( (k) < 3 ? rs->hist[k] : in[(k) - 3] )
+
+    for ( ; rs->phase < end ; rs->phase += rs->step ) {
+
+        int i = rs->phase >> 32;
+        int32_t f = ( rs->phase & 0xFFFFFFFF ) >> 17;		// Q15
+
+        int32_t xm1 = SAMPLE( i - 1 ), x0 = SAMPLE( i ), x1 = SAMPLE( i + 1 ), x2 = SAMPLE( i + 2 );
+
+        // Catmull-Rom coefficients, doubled to stay integer
+        int32_t c1 = x1 - xm1;
+        int32_t c2 = 2 * xm1 - 5 * x0 + 4 * x1 - x2;
+        int32_t c3 = ( x2 - xm1 ) + 3 * ( x0 - x1 );
+
+        int64_t y = ( (int64_t) c3 * f ) >> 15;
+        y = ( ( y + c2 ) * f ) >> 15;
+        y = ( ( y + c1 ) * f ) >> 15;
+
+        out[n++] = _sat16( x0 + (int32_t) ( y >> 1 ) );
+    }
+
+#undef SAMPLE
+
+    if ( count >= 3 ) {
+        memcpy( rs->hist, in + count - 3, 3 * sizeof(int16_t) );
+    } else {
+        for ( int k = 0 ; k < count ; k++ ) {
+            rs->hist[0] = rs->hist[1];
+            rs->hist[1] = rs->hist[2];
+            rs->hist[2] = in[k];
+        }
+    }
+
+    rs->phase -= (uint64_t) count << 32;
+    return n;
+}
@@ -0,0 +1,51 @@
+/*
+ * resampler.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: xenir
+ */
+
+#ifndef MAIN_RESAMPLER_H_
+#define MAIN_RESAMPLER_H_
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Fractional resampler for 16 bit mono PCM, meant for ratios within a few
+// hundred ppm of 1 to absorb clock drift. The read position is a Q32 phase,
+// so the ratio resolves to well below 0.001 ppm and can be changed between
+// blocks without a discontinuity. Samples are interpolated with a 4 point
+// cubic Hermite in integer arithmetic, at a fixed delay of two input samples.
+
+#define RESAMPLER_MAX_PPM		10000
+
+typedef struct {
+    uint64_t	phase;			// Q32 position, integer part indexes hist followed by the block
+    uint64_t	step;			// Q32 input samples per output sample
+    int32_t		ppm;
+    int16_t		hist[3];		// Last three samples of the previous block
+} resampler_t;
+
+void resampler_init( resampler_t* rs );
+
+// Positive ppm produces more output samples than input, negative fewer
+void resampler_set_ppm( resampler_t* rs, int32_t ppm );
+
+// Output samples that "in_count" input samples can produce at most
+static inline int resampler_max_out( int in_count )
+{
+    return in_count + in_count / ( 1000000 / RESAMPLER_MAX_PPM ) + 2;
+}
+
+// Resamples "count" samples into "out", which must hold resampler_max_out
+// samples. "in" and "out" must not overlap. Returns the samples written
+int resampler_process( resampler_t* rs, const int16_t* in, int count, int16_t* out );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* MAIN_RESAMPLER_H_ */
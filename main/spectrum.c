@@ -0,0 +1,205 @@
+/*
+ * spectrum.c
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: xenir
+ */
+
+#include <string.h>
+#include <math.h>
+
+#include "spectrum.h"
+
+#ifdef ESP_PLATFORM
+#include "esp_dsp.h"
+#endif
+
+#define HALF		( SPECTRUM_FFT_SIZE / 2 )
+
+#ifdef ESP_PLATFORM
+
+static int _fft_init( spectrum_t* sp )
+{
+    // The esp-dsp twiddle table is global and sized for the largest FFT,
+    // a second init from another module just reports it is already there
+
+    esp_err_t ret = dsps_fft2r_init_fc32( NULL, CONFIG_DSP_MAX_FFT_SIZE );
+    return ( ret == ESP_OK || ret == ESP_ERR_DSP_REINITIALIZED ) ? 0 : -1;
+}
+
+static void _fft( spectrum_t* sp )
+{
+    dsps_fft2r_fc32( sp->data, HALF );
+    dsps_bit_rev_fc32( sp->data, HALF );
+}
+
+#else
+
+static int _fft_init( spectrum_t* sp )
+{
+    for ( int k = 0 ; k < HALF / 2 ; k++ ) {
+        sp->twiddle[2*k] = cosf( 2 * M_PI * k / HALF );
+        sp->twiddle[2*k+1] = -sinf( 2 * M_PI * k / HALF );
+    }
+    return 0;
+}
+
+// Iterative radix-2 decimation in time, in place on HALF complex values
+
+static void _fft( spectrum_t* sp )
+{
+    float* d = sp->data;
+
+    for ( int i = 1, j = 0 ; i < HALF ; i++ ) {
+        int bit = HALF >> 1;
+        for ( ; j & bit ; bit >>= 1 )
+            j ^= bit;
+        j ^= bit;
+        if ( i < j ) {
+            float t;
+            t = d[2*i]; d[2*i] = d[2*j]; d[2*j] = t;
+            t = d[2*i+1]; d[2*i+1] = d[2*j+1]; d[2*j+1] = t;
+        }
+    }
+
+    for ( int len = 2 ; len <= HALF ; len <<= 1 ) {
+        int step = HALF / len;
+        for ( int i = 0 ; i < HALF ; i += len ) {
+            for ( int k = 0 ; k < len / 2 ; k++ ) {
+                float wr = sp->twiddle[2*k*step], wi = sp->twiddle[2*k*step+1];
+                float* a = &d[2*(i+k)];
+                float* b = &d[2*(i+k+len/2)];
+                float tr = b[0] * wr - b[1] * wi;
+                float ti = b[0] * wi + b[1] * wr;
+                b[0] = a[0] - tr; b[1] = a[1] - ti;
+                a[0] += tr; a[1] += ti;
+            }
+        }
+    }
+}
+
+#endif
+
+int spectrum_init( spectrum_t* sp, int sample_rate )
+{
+    memset( sp, 0, sizeof(spectrum_t) );
+    sp->sample_rate = sample_rate;
+
+    for ( int i = 0 ; i < SPECTRUM_FFT_SIZE ; i++ )
+        sp->window[i] = 0.5f * ( 1.0f - cosf( 2 * M_PI * i / ( SPECTRUM_FFT_SIZE - 1 ) ) );
+
+    for ( int k = 0 ; k < HALF ; k++ ) {
+        sp->split[2*k] = cosf( 2 * M_PI * k / SPECTRUM_FFT_SIZE );
+        sp->split[2*k+1] = -sinf( 2 * M_PI * k / SPECTRUM_FFT_SIZE );
+    }
+
+    // Log spaced edges from SPECTRUM_MIN_HZ to Nyquist. At the bottom the
+    // log spacing is finer than the FFT resolution, so edges are pushed up
+    // to keep every output bin at least one FFT bin wide
+
+    float lo = (float) SPECTRUM_MIN_HZ * SPECTRUM_FFT_SIZE / sample_rate;
+    if ( lo < 1 )
+        lo = 1;
+    float ratio = powf( HALF / lo, 1.0f / SPECTRUM_BINS );
+
+    int prev = 0;
+    for ( int b = 0 ; b <= SPECTRUM_BINS ; b++ ) {
+        int edge = lo * powf( ratio, b ) + 0.5f;
+        if ( edge <= prev )
+            edge = prev + 1;
+        if ( edge > HALF )
+            edge = HALF;
+        sp->edges[b] = edge;
+        prev = edge;
+    }
+
+    return _fft_init( sp );
+}
+
+static int8_t _dbfs( float ratio )
+{
+    float db = ratio > 0 ? 20.0f * log10f( ratio ) : SPECTRUM_FLOOR_DB;
+    return db < SPECTRUM_FLOOR_DB ? SPECTRUM_FLOOR_DB : ( db > 0 ? 0 : db );
+}
+
+void spectrum_compute( spectrum_t* sp, const int16_t* samples, int count, spectrum_frame_t* frame )
+{
+    int32_t peak = 0;
+    int64_t sum = 0;
+
+    for ( int i = 0 ; i < count ; i++ ) {
+        int32_t s = samples[i];
+        sum += s * s;
+        if ( s < 0 )
+            s = -s;
+        if ( s > peak )
+            peak = s;
+    }
+
+    frame->peak_dbfs = _dbfs( peak / 32768.0f );
+    frame->rms_dbfs = count ? _dbfs( sqrtf( (float) sum / count ) / 32768.0f ) : SPECTRUM_FLOOR_DB;
+
+    // Pack even samples into the real and odd samples into the imaginary
+    // parts, windowed and scaled to +/-1
+
+    // A short block goes at the end of the transform, zeros before it
+    int pad = count < SPECTRUM_FFT_SIZE ? SPECTRUM_FFT_SIZE - count : 0;
+    const int16_t* x = samples + count - ( SPECTRUM_FFT_SIZE - pad );
+    const float scale = 1.0f / 32768.0f;
+
+    for ( int i = 0 ; i < SPECTRUM_FFT_SIZE ; i++ )
+        sp->data[i] = i < pad ? 0 : x[i - pad] * scale * sp->window[i];
+
+    _fft( sp );
+
+    // Split the half size transform into the real spectrum. Each pair k and
+    // HALF-k is done together so the result can overwrite the input; the
+    // power ends up in the real slot. Powers are normalised so a full scale
+    // sine (peak N/4 after the Hann window) reads 1.0
+
+    const float norm = 1.0f / ( ( SPECTRUM_FFT_SIZE / 4.0f ) * ( SPECTRUM_FFT_SIZE / 4.0f ) );
+    float* d = sp->data;
+
+    float dc = d[0] + d[1];
+    d[0] = dc * dc * norm;
+
+    for ( int k = 1 ; k <= HALF / 2 ; k++ ) {
+
+        int n = HALF - k;
+        float zr = d[2*k], zi = d[2*k+1];
+        float nr = d[2*n], ni = d[2*n+1];
+
+        for ( int pass = 0 ; pass < 2 ; pass++ ) {
+
+            int m = pass ? n : k;
+            float ar = pass ? nr : zr, ai = pass ? ni : zi;
+            float br = pass ? zr : nr, bi = pass ? zi : ni;
+
+            float er = ( ar + br ) * 0.5f, ei = ( ai - bi ) * 0.5f;
+            float orr = ( ai + bi ) * 0.5f, oi = ( br - ar ) * 0.5f;
+            float wr = sp->split[2*m], wi = sp->split[2*m+1];
+
+            float xr = er + wr * orr - wi * oi;
+            float xi = ei + wr * oi + wi * orr;
+            d[2*m] = ( xr * xr + xi * xi ) * norm;
+
+            if ( k == n )
+                break;
+        }
+    }
+
+    for ( int b = 0 ; b < SPECTRUM_BINS ; b++ ) {
+
+        int end = sp->edges[b+1] > sp->edges[b] ? sp->edges[b+1] : sp->edges[b] + 1;
+        float max = 0;
+
+        for ( int k = sp->edges[b] ; k < end && k < HALF ; k++ ) {
+            if ( d[2*k] > max )
+                max = d[2*k];
+        }
+
+        float db = max > 0 ? 10.0f * log10f( max ) : SPECTRUM_FLOOR_DB;
+        int v = ( db - SPECTRUM_FLOOR_DB ) * 2;
+        frame->bins[b] = v < 0 ? 0 : ( v > 255 ? 255 : v );
+    }
+}
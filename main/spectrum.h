@@ -0,0 +1,60 @@
+/*
+ * spectrum.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: xenir
+ */
+
+#ifndef MAIN_SPECTRUM_H_
+#define MAIN_SPECTRUM_H_
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Hann windowed real FFT of the most recent SPECTRUM_FFT_SIZE samples of a
+// block, reduced to SPECTRUM_BINS log spaced bins. The real transform is
+// done as a half size complex FFT followed by a split step. On the ESP32 the
+// complex FFT is the esp-dsp one, elsewhere a portable radix-2 fallback is
+// used so the same code can be benchmarked on a host.
+
+#define SPECTRUM_FFT_SIZE		512
+#define SPECTRUM_BINS			64
+#define SPECTRUM_MIN_HZ			50
+#define SPECTRUM_FLOOR_DB		(-120)
+
+// Bins are 0.5 dB steps above SPECTRUM_FLOOR_DB, 0 dB being a full scale sine
+
+typedef struct {
+    uint8_t		bins[SPECTRUM_BINS];
+    int8_t		peak_dbfs;
+    int8_t		rms_dbfs;
+} spectrum_frame_t;
+
+typedef struct {
+
+    int			sample_rate;
+    float		window[SPECTRUM_FFT_SIZE];
+    float		data[SPECTRUM_FFT_SIZE];				// N/2 interleaved complex values
+    float		split[SPECTRUM_FFT_SIZE];				// Real FFT split twiddles, N/2 complex
+#ifndef ESP_PLATFORM
+    float		twiddle[SPECTRUM_FFT_SIZE / 2];			// Fallback FFT twiddles, N/4 complex
+#endif
+    uint16_t	edges[SPECTRUM_BINS + 1];				// First FFT bin of each output bin
+
+} spectrum_t;
+
+int spectrum_init( spectrum_t* sp, int sample_rate );
+
+// Computes a frame from "count" mono samples. Peak and RMS cover the whole
+// block, the spectrum its last SPECTRUM_FFT_SIZE samples (zero padded if
+// the block is shorter).
+void spectrum_compute( spectrum_t* sp, const int16_t* samples, int count, spectrum_frame_t* frame );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* MAIN_SPECTRUM_H_ */
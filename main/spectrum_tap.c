@@ -0,0 +1,132 @@
+/*
+ * spectrum_tap.c
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: xenir
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "esp_log.h"
+#include "audio_mem.h"
+#include "audio_error.h"
+
+#include "cycle_count.h"
+#include "event_stream.h"
+#include "spectrum.h"
+#include "spectrum_tap.h"
+
+static const char *TAG = "spectrum_tap";
+
+// Frames go out as one line of JSON with the bins hex encoded, two
+// characters per bin. The first event a viewer gets describes the bins:
+//   {"rate":16000,"floor":-120,"step":0.5,"edges":[hz,...]}
+// followed by frames of
+//   {"seq":n,"peak":dbfs,"rms":dbfs,"bins":"..."}
+
+#define HELLO_SIZE		( 64 + ( SPECTRUM_BINS + 1 ) * 7 )
+
+struct spectrum_tap {
+
+    spectrum_t				sp;
+    event_stream_handle_t	es;				// NULL until registered with the web server
+    char					hello[HELLO_SIZE];
+    char					event[64 + SPECTRUM_BINS * 2];
+    uint32_t				seq;
+    spectrum_tap_stats_t	stats;
+};
+
+void spectrum_tap_write(const char *buf, int len, void *ctx)
+{
+    struct spectrum_tap* tap = (struct spectrum_tap*) ctx;
+
+    if ( !tap->es || event_stream_subscribers( tap->es ) == 0 ) {
+        tap->stats.skipped++;
+        return;
+    }
+
+    spectrum_frame_t frame;
+
+    uint32_t start = cycle_count_get();
+    spectrum_compute( &tap->sp, (const int16_t*) buf, len / 2, &frame );
+    tap->stats.cycles += cycle_count_get() - start;
+    tap->stats.frames++;
+
+    static const char hex[] = "0123456789abcdef";
+
+    int pos = snprintf( tap->event, sizeof(tap->event), "{\"seq\":%u,\"peak\":%d,\"rms\":%d,\"bins\":\"",
+            tap->seq++, frame.peak_dbfs, frame.rms_dbfs );
+
+    for ( int b = 0 ; b < SPECTRUM_BINS ; b++ ) {
+        tap->event[pos++] = hex[frame.bins[b] >> 4];
+        tap->event[pos++] = hex[frame.bins[b] & 0xF];
+    }
+    pos += snprintf( tap->event + pos, sizeof(tap->event) - pos, "\"}" );
+
+    event_stream_publish( tap->es, tap->event, pos );
+}
+
+void spectrum_tap_get_stats(spectrum_tap_handle_t tap, spectrum_tap_stats_t *stats)
+{
+    *stats = tap->stats;
+    stats->dropped = tap->es ? event_stream_dropped( tap->es ) : 0;
+}
+
+static int _hello( struct spectrum_tap* tap, int sample_rate )
+{
+    int pos = snprintf( tap->hello, HELLO_SIZE, "{\"rate\":%d,\"floor\":%d,\"step\":0.5,\"edges\":[",
+            sample_rate, SPECTRUM_FLOOR_DB );
+    for ( int b = 0 ; b <= SPECTRUM_BINS ; b++ )
+        pos += snprintf( tap->hello + pos, HELLO_SIZE - pos, "%s%d", b ? "," : "",
+                tap->sp.edges[b] * sample_rate / SPECTRUM_FFT_SIZE );
+    pos += snprintf( tap->hello + pos, HELLO_SIZE - pos, "]}" );
+
+    return pos;
+}
+
+// Viewers already subscribed get the new description as an ordinary event
+
+void spectrum_tap_set_rate(spectrum_tap_handle_t tap, int sample_rate)
+{
+    spectrum_init( &tap->sp, sample_rate );
+    int len = _hello( tap, sample_rate );
+    if ( tap->es )
+        event_stream_publish( tap->es, tap->hello, len );
+}
+
+spectrum_tap_handle_t spectrum_tap_init(int sample_rate)
+{
+    struct spectrum_tap* tap = audio_calloc( 1, sizeof(struct spectrum_tap) );
+    AUDIO_MEM_CHECK(TAG, tap, {return NULL;});
+
+    if ( spectrum_init( &tap->sp, sample_rate ) != 0 ) {
+        ESP_LOGE(TAG, "FFT init failed");
+        audio_free( tap );
+        return NULL;
+    }
+
+    _hello( tap, sample_rate );
+
+    ESP_LOGI(TAG, "Spectrum Config: FFT: %d Bins: %d Sample Rate: %d", SPECTRUM_FFT_SIZE, SPECTRUM_BINS, sample_rate);
+    return tap;
+}
+
+esp_err_t spectrum_tap_register(spectrum_tap_handle_t tap)
+{
+    event_stream_handle_t es = event_stream_create( "/spectrum", tap->hello );
+    if ( !es )
+        return ESP_FAIL;
+
+    tap->es = es;
+    return ESP_OK;
+}
+
+void spectrum_tap_destroy(spectrum_tap_handle_t tap)
+{
+    if ( !tap )
+        return;
+
+    event_stream_destroy( tap->es );
+    audio_free( tap );
+}
@@ -0,0 +1,68 @@
+/*
+ * spectrum_tap.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: xenir
+ */
+
+#ifndef MAIN_SPECTRUM_TAP_H_
+#define MAIN_SPECTRUM_TAP_H_
+
+#include <stdint.h>
+
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct spectrum_tap *spectrum_tap_handle_t;
+
+/**
+ * @brief      Processing cost of the frames computed so far
+ */
+typedef struct {
+    uint32_t                frames;
+    uint64_t                cycles;
+    uint32_t                skipped;        /*!< Blocks seen with nobody subscribed */
+    uint32_t                dropped;        /*!< Frames dropped behind a slow viewer */
+} spectrum_tap_stats_t;
+
+/**
+ * @brief      Create the spectrum tap. Attach with streaming_http_audio_add_tap
+ *             before the pipeline runs; until spectrum_tap_register is called
+ *             every block is skipped
+ */
+spectrum_tap_handle_t spectrum_tap_init(int sample_rate);
+
+/**
+ * @brief      Create the /spectrum event stream on the port 80 server, which
+ *             must be running. Can be called while the pipeline runs
+ */
+esp_err_t spectrum_tap_register(spectrum_tap_handle_t tap);
+
+/**
+ * @brief      streaming_http_audio tap: one frame per block, shared by all
+ *             viewers, and nothing computed while nobody is subscribed
+ */
+void spectrum_tap_write(const char *buf, int len, void *ctx);
+
+/**
+ * @brief      Follow a sample rate change. Call while the element feeding the
+ *             tap is paused
+ */
+void spectrum_tap_set_rate(spectrum_tap_handle_t tap, int sample_rate);
+
+void spectrum_tap_get_stats(spectrum_tap_handle_t tap, spectrum_tap_stats_t *stats);
+
+/**
+ * @brief      Remove /spectrum and free the tap. The element feeding it must
+ *             have stopped
+ */
+void spectrum_tap_destroy(spectrum_tap_handle_t tap);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* MAIN_SPECTRUM_TAP_H_ */
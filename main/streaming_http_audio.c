@@ -1,6 +1,9 @@
 // Copyright 2018 Espressif Systems (Shanghai) PTE LTD
 // All rights reserved.
 
+#include <sys/param.h>
+#include <stdlib.h>
+
 #include "streaming_http_audio.h"
 
 #include "esp_log.h"
@@ -8,6 +11,13 @@
 #include "audio_element.h"
 #include "wav_header.h"
 #include "audio_error.h"
+#include "freertos/semphr.h"
+#include "esp_timer.h"
+#include "cycle_count.h"
+#include "resampler.h"
+#include "webserver.h"
+#include "trace.h"
+#include "ringbuf.h"
 
 static const char *TAG = "streaming_http_audio";
 
@@ -15,19 +25,119 @@ static const char *TAG = "streaming_http_audio";
 typedef struct streaming_http_audio {
 
     bool			active;
-    httpd_req_t*	req;
+    int				fd;				// The listener's socket, detached from the server
     int				buf_size;
     char*			buf;
+    char*			rs_buf;			// Resampler output, swapped with buf
+    block_pool_handle_t	pool;
 
     int				sample_rate;
     int				bits;
     int				channels;
+    int				in_channels;
+
+    // A format change is staged the same way as DTX settings
+    int				pending_rate;
+    int				pending_in_channels;
+    volatile bool	format_dirty;
+    int64_t			last_block_us;
+
+    int							num_taps;
+    streaming_http_audio_tap_t	taps[STREAMING_HTTP_AUDIO_MAX_TAPS];
+    void*						tap_ctx[STREAMING_HTTP_AUDIO_MAX_TAPS];
+
+    // DTX settings are staged under the lock and applied by the element
+    // task at the start of the next block
+    SemaphoreHandle_t				lock;
+    streaming_http_audio_dtx_t		dtx;
+    streaming_http_audio_dtx_t		dtx_pending;
+    volatile bool					dtx_dirty;
+    vad_t							vad;
+
+    char*			hold;			// Block held back so an onset can release its predecessor
+    int				hold_len;
+    bool			hold_speech;
+    TickType_t		last_send;
+
+    // Drift correction. The listener reports under the lock, the element
+    // task picks up the new ratio at the next block
+    drift_t							drift;
+    resampler_t						rs;
+    volatile uint32_t				sent_samples;	// Since the listener connected
+    volatile int32_t				ppm_pending;
+    volatile bool					ppm_dirty;
+
+    // Latency control. The element task owns the controller, new settings
+    // and a new listener are flagged to it like the DTX settings
+    latency_t						latency;
+    latency_params_t				latency_pending;
+    volatile bool					latency_dirty;
+    volatile bool					latency_restart;
+    int								block_len;		// Bytes read per block while a listener is connected
+    int								queue_ms;		// Depth in front of the element at the last read
+    bool							queue_dropped;
+    uint32_t						send_us;		// Time spent sending the current block
+    streaming_http_audio_backlog_t	backlog;		// Queue depth when the input is not a ringbuffer
+    void*							backlog_ctx;
+    uint32_t						backlog_dropped;	// Its drop count at the last read
+
+    // Catch-up by time compression, owned by the element task like the
+    // latency controller, with settings staged the same way
+    stretch_t						stretch;
+    stretch_params_t				stretch_pending;
+    volatile bool					stretch_dirty;
+
+    // Carrier removal on the listener's copy. Settings are staged the same
+    // way, the listener can override the enable flag when it connects
+    notch_t							notch;
+    notch_params_t					notch_pending;
+    volatile bool					notch_dirty;
+    int								notch_listener;	// 0 or 1 from ?notch=, -1 to follow the settings
+
+    // Decimating channel filter on the listener's copy. The WAV header
+    // carries the rate, so the preset is fixed when the listener connects:
+    // its own from ?bw= or the default
+    narrowband_t					nb;
+    int								nb_default;
+    int								nb_factor;		// Input samples per output sample
+
+    streaming_http_audio_stats_t	stats;
 
 } streaming_http_audio_t;
 
+static void _streaming_http_audio_free_buffers(streaming_http_audio_t *sha)
+{
+    if (sha->pool) {
+        block_pool_put(sha->pool, sha->buf);
+        block_pool_put(sha->pool, sha->hold);
+        block_pool_put(sha->pool, sha->rs_buf);
+    } else {
+        audio_free(sha->buf);
+        audio_free(sha->hold);
+        audio_free(sha->rs_buf);
+    }
+}
+
+// Ends the listener's session. The server dropped it when the handler
+// detached the socket, so normally the close is ours; if that has not
+// happened yet the server closes it instead
+
+static void _streaming_http_audio_end_session( streaming_http_audio_t* sha )
+{
+    TRACE_INSTANT("stream_close", sha->fd);
+    if ( webserver_release_socket( sha->fd ) )
+        close( sha->fd );
+    sha->fd = -1;
+    sha->active = false;
+}
+
 static esp_err_t _streaming_http_audio_destroy(audio_element_handle_t self)
 {
     streaming_http_audio_t *sha = (streaming_http_audio_t *)audio_element_getdata(self);
+    if (sha->active)
+        _streaming_http_audio_end_session(sha);
+    vSemaphoreDelete(sha->lock);
+    _streaming_http_audio_free_buffers(sha);
     audio_free(sha);
     return ESP_OK;
 }
@@ -47,9 +157,174 @@ static esp_err_t _streaming_http_audio_close(audio_element_handle_t self)
     return ESP_OK;
 }
 
+static int _streaming_http_audio_bytes_per_ms( streaming_http_audio_t* sha )
+{
+    return sha->sample_rate * sha->in_channels * 2 / 1000;
+}
+
+// Block length for the operating point, in whole input frames and never more
+// than the element buffer
+
+static void _streaming_http_audio_set_block( streaming_http_audio_t* sha )
+{
+    int frame = sha->in_channels * 2;
+    int len = _streaming_http_audio_bytes_per_ms( sha ) * sha->latency.block_ms;
+
+    len -= len % frame;
+    sha->block_len = len < frame ? frame : MIN( len, STREAMING_HTTP_AUDIO_BUFFER_LEN - STREAMING_HTTP_AUDIO_BUFFER_LEN % frame );
+}
+
+// Measures the queue in front of the element and sets the catch-up rate
+// from it: a listener that fell behind is played the backlog a little
+// faster than real time until it is back near live. Beyond the queue limit,
+// the operating point's or with catch-up enabled the larger stretch max_ms,
+// the oldest audio is read and thrown away. It is lost to the taps as well,
+// but a listener that fell that far behind hears the present rather than a
+// backlog it can never catch up on. Fed by a tee there is no ringbuffer:
+// the backlog callback reports the tee's queue for this output and the
+// excess is read out of it the same way. The tee also bounds the queue at
+// its own depth, dropping its oldest blocks; those drops are reported by the
+// callback and count as drops here, so the latency controller sees them
+// whichever limit is the lower.
+
+static int _streaming_http_audio_backlog( streaming_http_audio_t* sha, ringbuf_handle_t rb, uint32_t* dropped )
+{
+    *dropped = sha->backlog_dropped;
+    if ( rb )
+        return rb_bytes_filled(rb);
+    return sha->backlog ? sha->backlog( sha->backlog_ctx, dropped ) : -1;
+}
+
+static void _streaming_http_audio_trim( audio_element_handle_t self, streaming_http_audio_t* sha, char* buf, int buf_len )
+{
+    ringbuf_handle_t rb = audio_element_get_input_ringbuf(self);
+    int per_ms = _streaming_http_audio_bytes_per_ms( sha );
+
+    if ( per_ms <= 0 )
+        return;
+
+    uint32_t dropped;
+    int filled = _streaming_http_audio_backlog( sha, rb, &dropped );
+    if ( filled < 0 ) {
+        stretch_update( &sha->stretch, 0 );
+        return;
+    }
+
+    if ( dropped != sha->backlog_dropped ) {
+        sha->stats.bytes_dropped += (uint32_t) ( dropped - sha->backlog_dropped );
+        sha->backlog_dropped = dropped;
+        sha->queue_dropped = true;
+    }
+
+    sha->queue_ms = filled / per_ms;
+    stretch_update( &sha->stretch, sha->queue_ms );
+
+    int limit_ms = sha->latency.queue_ms;
+    if ( sha->stretch.params.enable )
+        limit_ms = MAX( limit_ms, sha->stretch.params.max_ms );
+
+    int excess = filled - limit_ms * per_ms;
+    excess -= excess % ( sha->in_channels * 2 );
+    if ( excess > 0 )
+        sha->queue_dropped = true;
+
+    while ( excess > 0 ) {
+        int n = audio_element_input(self, buf, MIN( excess, buf_len ));
+        if ( n <= 0 )
+            break;
+        excess -= n;
+        sha->stats.bytes_dropped += n;
+    }
+}
+
+// Runs after every block sent to a listener. A changed point takes effect
+// at the next read
+
+static void _streaming_http_audio_adapt( streaming_http_audio_t* sha )
+{
+    if ( latency_update( &sha->latency, esp_timer_get_time(), sha->send_us, sha->queue_ms, sha->queue_dropped ) ) {
+        _streaming_http_audio_set_block( sha );
+        ESP_LOGI(TAG, "Latency point %d ms blocks, %d ms queue (%s)", sha->latency.block_ms, sha->latency.queue_ms,
+                latency_reason_name( latency_history( &sha->latency, 0 )->reason ));
+    }
+    sha->send_us = 0;
+    sha->queue_dropped = false;
+}
+
+static void _streaming_http_audio_apply_latency( streaming_http_audio_t* sha )
+{
+    if ( sha->latency_dirty ) {
+        xSemaphoreTake( sha->lock, portMAX_DELAY );
+        latency_init( &sha->latency, &sha->latency_pending );
+        sha->latency_dirty = false;
+        xSemaphoreGive( sha->lock );
+    }
+
+    // Drops from before this listener are not its latency's doing
+    if ( sha->latency_restart && sha->backlog )
+        sha->backlog( sha->backlog_ctx, &sha->backlog_dropped );
+
+    latency_reset( &sha->latency, esp_timer_get_time() );
+    _streaming_http_audio_set_block( sha );
+    sha->send_us = 0;
+    sha->latency_restart = false;
+}
+
+// Catch-up settings only change the rates, a catch-up under way carries on
+
+static void _streaming_http_audio_apply_stretch( streaming_http_audio_t* sha )
+{
+    xSemaphoreTake( sha->lock, portMAX_DELAY );
+    sha->stretch.params = sha->stretch_pending;
+    sha->stretch_dirty = false;
+    xSemaphoreGive( sha->lock );
+}
+
+static void _streaming_http_audio_apply_notch( streaming_http_audio_t* sha )
+{
+    xSemaphoreTake( sha->lock, portMAX_DELAY );
+    notch_set_params( &sha->notch, &sha->notch_pending );
+    sha->notch_dirty = false;
+    xSemaphoreGive( sha->lock );
+}
+
+static bool _streaming_http_audio_notch_on( streaming_http_audio_t* sha )
+{
+    return sha->notch_listener < 0 ? sha->notch.params.enable : sha->notch_listener != 0;
+}
+
+// Longest read while the catch-up stage runs, so that its output plus the
+// drift resampler's stretch still fits an output buffer
+
+static int _streaming_http_audio_stretch_len( streaming_http_audio_t* sha )
+{
+    int frame = sha->in_channels * 2;
+    int samples = MIN( STREAMING_HTTP_AUDIO_BUFFER_LEN / 2, STRETCH_MAX_IN ) - ( sha->stretch.seq - sha->stretch.overlap );
+
+    return MAX( samples * frame, frame );
+}
+
 static int _streaming_http_audio_process(audio_element_handle_t self, char *in_buffer, int in_len)
 {
-    int r_size = audio_element_input(self, in_buffer, in_len);
+    TRACE_BEGIN("sha_process");
+    streaming_http_audio_t *sha = (streaming_http_audio_t *)audio_element_getdata(self);
+
+    // Without a listener the whole buffer is read, latency only matters to
+    // the socket
+
+    int wanted = in_len;
+    if ( sha->active ) {
+        if ( sha->latency_restart || sha->latency_dirty )
+            _streaming_http_audio_apply_latency( sha );
+        if ( sha->stretch_dirty )
+            _streaming_http_audio_apply_stretch( sha );
+        _streaming_http_audio_trim( self, sha, in_buffer, in_len );
+        wanted = MIN( sha->block_len, in_len );
+        if ( stretch_busy( &sha->stretch ) )
+            wanted = MIN( wanted, _streaming_http_audio_stretch_len( sha ) );
+    }
+
+    int r_size = audio_element_input(self, in_buffer, wanted);
 
     int out_len = r_size;
     if (r_size > 0) {
@@ -60,11 +335,135 @@ static int _streaming_http_audio_process(audio_element_handle_t self, char *in_b
         }
     }
 
+    TRACE_END("sha_process");
     return out_len;
 }
 
 int cnt = 0;
 
+static bool _streaming_http_audio_send( streaming_http_audio_t* sha, const char* buf, int len )
+{
+    TRACE_BEGIN("send");
+    int64_t start = esp_timer_get_time();
+    esp_err_t ret = webserver_send_all(sha->fd, buf, len);
+    sha->send_us += esp_timer_get_time() - start;
+    TRACE_END("send");
+
+    if (ret != ESP_OK) {
+         ESP_LOGE(TAG, "Streaming send failed");
+         _streaming_http_audio_end_session(sha);
+         return false;
+    }
+
+    sha->stats.bytes_sent += len;
+    sha->sent_samples += len / 2 * sha->nb_factor;	// At the input rate, which the drift correction works in
+    sha->last_send = xTaskGetTickCount();
+    return true;
+}
+
+// Sends a held block if it or its successor was speech. Otherwise the block
+// is dropped, apart from a short run of digital silence every keepalive_ms
+// so the player and any proxies in between see the stream is still alive.
+
+static void _streaming_http_audio_emit( streaming_http_audio_t* sha, char* buf, int len, bool speech )
+{
+    if ( speech ) {
+        _streaming_http_audio_send( sha, buf, len );
+        return;
+    }
+
+    sha->stats.bytes_suppressed += len;
+
+    if ( sha->dtx.keepalive_ms <= 0 ||
+         xTaskGetTickCount() - sha->last_send < pdMS_TO_TICKS( sha->dtx.keepalive_ms ) )
+        return;
+
+    int n = sha->nb.out_rate * sha->dtx.keepalive_len / 1000 * sha->channels * sha->bits / 8;
+    n = MIN( n, len ) & ~1;
+
+    memset( buf, 0, n );
+    if ( _streaming_http_audio_send( sha, buf, n ) )
+        sha->stats.bytes_suppressed -= n;
+}
+
+static void _streaming_http_audio_apply_dtx( streaming_http_audio_t* sha )
+{
+    // Anything still held back goes out before the settings change. The
+    // held block belongs to the element task, so it is sent before taking
+    // the lock and a slow socket does not hold up the command handlers
+
+    if ( sha->active && sha->hold_len > 0 )
+        _streaming_http_audio_emit( sha, sha->hold, sha->hold_len, true );
+    sha->hold_len = 0;
+
+    xSemaphoreTake( sha->lock, portMAX_DELAY );
+    sha->dtx = sha->dtx_pending;
+    vad_init( &sha->vad, sha->sample_rate, &sha->dtx.vad );
+    sha->dtx_dirty = false;
+
+    xSemaphoreGive( sha->lock );
+}
+
+// Runs in the element task at the first block in the new format. The client
+// was sent a WAV header for the old format, so its connection is closed,
+// which ends the response cleanly, and the player has to reconnect; the gap is measured from the last block
+// seen in the old format.
+
+static void _streaming_http_audio_apply_format( streaming_http_audio_t* sha )
+{
+    // The held block is sent outside the lock, as in apply_dtx. The session
+    // ends under it, so a new listener cannot get in with the old rate
+
+    if ( sha->active && sha->hold_len > 0 )
+        _streaming_http_audio_emit( sha, sha->hold, sha->hold_len, true );
+    sha->hold_len = 0;
+
+    xSemaphoreTake( sha->lock, portMAX_DELAY );
+    if ( sha->active )
+        _streaming_http_audio_end_session( sha );
+
+    sha->sample_rate = sha->pending_rate;
+    sha->in_channels = sha->pending_in_channels;
+    vad_init( &sha->vad, sha->sample_rate, &sha->dtx.vad );
+    drift_params_t drift = sha->drift.params;
+    drift_init( &sha->drift, sha->sample_rate, &drift );
+    stretch_params_t stretch = sha->stretch.params;
+    stretch_init( &sha->stretch, sha->sample_rate, &stretch );
+    notch_params_t notch = sha->notch.params;
+    notch_init( &sha->notch, sha->sample_rate, &notch );
+    sha->format_dirty = false;
+
+    xSemaphoreGive( sha->lock );
+
+    int64_t now = esp_timer_get_time();
+    uint32_t gap = sha->last_block_us ? now - sha->last_block_us : 0;
+
+    sha->stats.format_changes++;
+    sha->stats.format_gap_us = gap;
+    if ( gap > sha->stats.format_max_gap_us )
+        sha->stats.format_max_gap_us = gap;
+
+    ESP_LOGI(TAG, "Format now %d Hz, %d input channels, gap %u us", sha->sample_rate, sha->in_channels, gap);
+}
+
+// Channel filter and decimation, the last stage before the socket so
+// everything ahead of it runs at the input rate. Returns the new length
+
+static int _streaming_http_audio_narrow( streaming_http_audio_t* sha, int len )
+{
+    if ( sha->nb.preset == NARROWBAND_OFF )
+        return len;
+
+    uint32_t start = cycle_count_get();
+    int n = narrowband_process( &sha->nb, (int16_t*)sha->buf, len / 2 );
+    sha->stats.narrowband_cycles += cycle_count_get() - start;
+    sha->stats.narrowband_blocks++;
+    sha->stats.narrowband_samples += len / 2;
+    sha->stats.narrowband_out_samples += n;
+
+    return 2 * n;
+}
+
 // This function is invoked every time the incoming audio buffer is full
 // The function then checks to see if there is an active audio stream and
 // if so writes the incoming buffer out to the web client. A http_resp_send_chunk
@@ -78,15 +477,18 @@ int cnt = 0;
 //			dest[i/2] = src[i];
 
 
-static int _streaming_http_audio_write(audio_element_handle_t self, char *buffer, int len, TickType_t ticks_to_wait, void *context)
+static int _streaming_http_audio_block(audio_element_handle_t self, char *buffer, int len)
 {
-
     streaming_http_audio_t *sha = (streaming_http_audio_t *)audio_element_getdata(self);
 
-    // If there is no active stream then just simply return len
-    // This effectively ignores the audio block
+    if ( sha->format_dirty )
+    	_streaming_http_audio_apply_format( sha );
+    sha->last_block_us = esp_timer_get_time();
+
+    // If there is no active stream and nothing tapping the output then just
+    // simply return len. This effectively ignores the audio block
 
-    if ( !sha->active )
+    if ( !sha->active && sha->num_taps == 0 )
     	return len;
 
     /*
@@ -94,28 +496,127 @@ static int _streaming_http_audio_write(audio_element_handle_t self, char *buffer
     	ESP_LOGI(TAG, "In Audio Write Length: %d", len );
 	*/
 
-    // Transform incoming buffer of size "len" from stereo 16 bit
+    // Transform incoming buffer of size "len" from stereo (or mono) 16 bit
     // to mono 16 bit WAV format
 
     int16_t* src = (int16_t*)buffer;
     int16_t* dest = (int16_t*)sha->buf;
+    int out_len = len / sha->in_channels;
 
-    for ( int i = 0 ; i < len/2 ; i += 2 )
-     	dest[i/2] = src[i];
+    if ( sha->in_channels == 1 )
+    	memcpy( dest, src, out_len );
+    else
+    	for ( int i = 0 ; i < len/2 ; i += 2 )
+    		dest[i/2] = src[i];
 
-    httpd_req_t *req = sha->req;
+    for ( int i = 0 ; i < sha->num_taps ; i++ )
+    	sha->taps[i]( sha->buf, out_len, sha->tap_ctx[i] );
 
-    if (httpd_resp_send_chunk(req, (const char*)sha->buf, len/2 ) != ESP_OK) {
-         ESP_LOGE(TAG, "Streaming send failed");
-         httpd_resp_sendstr_chunk(req, NULL);
-         sha->active = false;
-         return len;
+    if ( sha->dtx_dirty )
+    	_streaming_http_audio_apply_dtx( sha );
+
+    if ( !sha->active ) {
+    	sha->hold_len = 0;
+    	return len;
+    }
+
+    sha->stats.blocks++;
+
+    // Carrier removal is chosen per stream, so it runs on the listener's
+    // copy only; the taps and the local monitor keep the original
+
+    if ( sha->notch_dirty )
+    	_streaming_http_audio_apply_notch( sha );
+
+    if ( _streaming_http_audio_notch_on( sha ) ) {
+    	uint32_t start = cycle_count_get();
+    	notch_process( &sha->notch, (int16_t*)sha->buf, out_len / 2 );
+    	sha->stats.notch_cycles += cycle_count_get() - start;
+    	sha->stats.notch_blocks++;
+    	sha->stats.notch_samples += out_len / 2;
+    }
+
+    // Catch-up runs on the listener's copy only, and before the drift
+    // correction so that sees the rate the listener is actually sent
+
+    if ( stretch_busy( &sha->stretch ) ) {
+    	uint32_t start = cycle_count_get();
+    	int in_samples = out_len / 2;
+    	out_len = 2 * stretch_process( &sha->stretch, (int16_t*)sha->buf, in_samples, (int16_t*)sha->rs_buf );
+    	sha->stats.stretch_cycles += cycle_count_get() - start;
+    	sha->stats.stretch_blocks++;
+    	sha->stats.stretch_samples += in_samples;
+
+    	char* stretched = sha->rs_buf;
+    	sha->rs_buf = sha->buf;
+    	sha->buf = stretched;
+
+    	// Still collecting the input for a round
+    	if ( out_len == 0 )
+    		return len;
+    }
+
+    // Drift correction runs on the listener's copy only, the taps above get
+    // the audio at the I2S rate
+
+    if ( sha->drift.params.enable ) {
+    	if ( sha->ppm_dirty ) {
+    		resampler_set_ppm( &sha->rs, sha->ppm_pending );
+    		sha->ppm_dirty = false;
+    	}
+    	out_len = 2 * resampler_process( &sha->rs, (int16_t*)sha->buf, out_len/2, (int16_t*)sha->rs_buf );
+    	char* resampled = sha->rs_buf;
+    	sha->rs_buf = sha->buf;
+    	sha->buf = resampled;
+    }
+
+    if ( !sha->dtx.enable ) {
+    	sha->stats.speech_blocks++;
+    	out_len = _streaming_http_audio_narrow( sha, out_len );
+    	if ( out_len > 0 && _streaming_http_audio_send( sha, sha->buf, out_len ) )
+    		_streaming_http_audio_adapt( sha );
+    	return len;
     }
 
-     return len;
+    // DTX: classify this block, then decide on the one held from last time.
+    // Swapping the buffers keeps the current block without a copy. The VAD
+    // is set up for the input rate, so it sees the block before the channel
+    // filter
+
+    uint32_t start = cycle_count_get();
+    bool speech = vad_process( &sha->vad, (int16_t*)sha->buf, out_len/2 );
+    sha->stats.vad_cycles += cycle_count_get() - start;
+    sha->stats.vad_blocks++;
+
+    if ( speech )
+    	sha->stats.speech_blocks++;
+
+    out_len = _streaming_http_audio_narrow( sha, out_len );
+
+    if ( sha->hold_len > 0 )
+    	_streaming_http_audio_emit( sha, sha->hold, sha->hold_len, sha->hold_speech || speech );
+
+    char* held = sha->hold;
+    sha->hold = sha->buf;
+    sha->buf = held;
+    sha->hold_len = out_len;
+    sha->hold_speech = speech;
+
+    if ( sha->active )
+    	_streaming_http_audio_adapt( sha );
+
+    return len;
+}
+
+static int _streaming_http_audio_write(audio_element_handle_t self, char *buffer, int len, TickType_t ticks_to_wait, void *context)
+{
+    TRACE_BEGIN("sha_write");
+    int ret = _streaming_http_audio_block(self, buffer, len);
+    TRACE_END("sha_write");
+    return ret;
 }
 
-void _streaming_wav_header( wav_header_t* w, streaming_http_audio_t* sha )
+void _streaming_wav_header( wav_header_t* w, streaming_http_audio_t* sha, int sample_rate )
 {
 	// Simple hack here for an endless stream is to set the len to maximum value.
 	// Both Chrome and Brave seem to have no problems with this.
@@ -130,83 +631,325 @@ void _streaming_wav_header( wav_header_t* w, streaming_http_audio_t* sha )
 	w->fmt.audio_format = 1;
 	w->fmt.bits_per_sample = sha->bits;
 	w->fmt.block_align = sha->channels * sha->bits/8;
-	w->fmt.byterate = sha->sample_rate * sha->channels * sha->bits/8;
+	w->fmt.byterate = sample_rate * sha->channels * sha->bits/8;
 	w->fmt.chunk_size = 16;
 	w->fmt.num_of_channels = sha->channels;
-	w->fmt.samplerate = sha->sample_rate;
+	w->fmt.samplerate = sample_rate;
 
 	w->data.chunk_id = 0X61746164;
 	w->data.chunk_size = len;
 }
 
 // This function will be invoked when the "play" button is pressed in the
-// browser audio control. This function emits the wav header (with the endless length)
-// sets the "active" flag to true and puts the http request pointer into sha->req
-// The write function will then use this to write the incoming audio back to
-// the web client.
+// browser audio control. The socket is detached from the server, the
+// response head and the WAV header (with the endless length) are written to
+// it and the session is handed to the element: the write function sends
+// every later block straight to the socket from the element task. Nothing
+// waits in the server task, so the port 80 server carries the stream next to
+// the files and commands. There is one listener at a time, a second gets a
+// 503 until the first has gone.
 
 static esp_err_t _stream_handler(httpd_req_t *req)
 {
-    ESP_LOGE(TAG, "In Stream Handler" );
-	httpd_resp_set_type(req, "audio/x-wav");
+    static const char head[] = "HTTP/1.1 200 OK\r\nContent-Type: audio/x-wav\r\n"
+                               "Cache-Control: no-cache\r\nConnection: close\r\n\r\n";
 
-	wav_header_t wav;
     streaming_http_audio_t *sha = (streaming_http_audio_t *)audio_element_getdata( (audio_element_handle_t) req->user_ctx);
 
-    ESP_LOGE(TAG, "Sending Header" );
-	_streaming_wav_header( &wav, sha );
-    httpd_resp_send_chunk(req, (const char*)&(wav), sizeof(wav));
+    if ( sha->active || webserver_detach_socket( req ) != ESP_OK ) {
+        httpd_resp_set_status( req, "503 Service Unavailable" );
+        httpd_resp_send( req, "Stream busy", HTTPD_RESP_USE_STRLEN );
+        return ESP_OK;
+    }
 
-    ESP_LOGE(TAG, "Header Sent" );
+    // ?notch=0|1 picks the carrier notch for this listener, ?bw=<preset>
+    // the channel filter
+    char query[64], value[8];
+    int notch = -1, preset = sha->nb_default;
+    if ( httpd_req_get_url_query_str( req, query, sizeof(query) ) == ESP_OK ) {
+        if ( httpd_query_key_value( query, "notch", value, sizeof(value) ) == ESP_OK )
+            notch = atoi( value ) != 0;
+        if ( httpd_query_key_value( query, "bw", value, sizeof(value) ) == ESP_OK && narrowband_parse( value ) >= 0 )
+            preset = narrowband_parse( value );
+    }
 
-    sha->req = req;
-    sha->active = true;
+    // Not active, so the element task leaves the filter alone
+    xSemaphoreTake( sha->lock, portMAX_DELAY );
+    int rate = narrowband_init( &sha->nb, sha->sample_rate, preset );
+    sha->nb_factor = sha->sample_rate / rate;
+    xSemaphoreGive( sha->lock );
 
-    // This seems hokey. This function can't return while the stream is active
-    // because the socket will be closed (Assumption) so need to keep looping
-    // here until _streaming_http_audio_write closes and sets active to false
-    // Events with attached data might be a solution
+    int fd = httpd_req_to_sockfd( req );
+    wav_header_t wav;
+	_streaming_wav_header( &wav, sha, rate );
 
-    while ( sha->active )
-        vTaskDelay(100 / portTICK_PERIOD_MS);
+    if ( webserver_send_all( fd, head, sizeof(head) - 1 ) != ESP_OK ||
+         webserver_send_all( fd, (const char*) &wav, sizeof(wav) ) != ESP_OK ) {
+        webserver_release_socket( fd );
+        return ESP_FAIL;
+    }
 
-    return ESP_OK;
-}
+    // A new listener starts with no correction and an empty buffer
 
-// The ESP-IDF web server is single threaded so we need to create
-// a dedicated separate web server that just serves up the streaming audio
-// The port is configurable. This single-threadedness means only one streaming
-// connection is available at any point in time.
+    xSemaphoreTake( sha->lock, portMAX_DELAY );
+    resampler_init( &sha->rs );
+    drift_reset( &sha->drift, esp_timer_get_time() );
+    sha->sent_samples = 0;
+    sha->ppm_dirty = false;
+    sha->latency_restart = true;
+    stretch_reset( &sha->stretch );
+    sha->notch_listener = notch;
+    sha->fd = fd;
+    sha->active = true;
+    xSemaphoreGive( sha->lock );
 
-esp_err_t _start_streaming_server( audio_element_handle_t el, streaming_http_audio_cfg_t *config )
-{
-    httpd_handle_t server = NULL;
+    TRACE_INSTANT("stream_open", fd);
+    ESP_LOGI(TAG, "Listener on socket %d at %d Hz", fd, rate);
+
+    // Failing the request is what detaches the socket from the server
+    return ESP_FAIL;
+}
 
+esp_err_t streaming_http_audio_register(audio_element_handle_t self)
+{
     httpd_uri_t stream = {
         .uri       = "/stream",
         .method    = HTTP_GET,
         .handler   = _stream_handler,
-        .user_ctx  = el
+        .user_ctx  = self
     };
 
-    /* Use the URI wildcard matching function in order to
-     * allow the same handler to respond to multiple different
-     * target URIs which match the wildcard scheme */
-    config->http_cfg.uri_match_fn = httpd_uri_match_wildcard;
-    config->http_cfg.lru_purge_enable = true;
-
-    // Start the httpd server
-    ESP_LOGI(TAG, "Starting server on port: '%d'", config->http_cfg.server_port);
-    if (httpd_start(&server, &(config->http_cfg)) == ESP_OK) {
-        // Set URI handlers
-        ESP_LOGI(TAG, "Registering URI handlers");
-        httpd_register_uri_handler(server, &stream);
-        ESP_LOGI(TAG, "Completed Registering URI handlers");
-        return ESP_OK;
+    return webserver_register_uri_handler( &stream );
+}
+
+esp_err_t streaming_http_audio_unregister(audio_element_handle_t self)
+{
+    return webserver_unregister_uri_handler( "/stream", HTTP_GET );
+}
+
+
+// Taps are expected to be attached before the pipeline runs, so the tap
+// table is not locked against the write callback
+
+esp_err_t streaming_http_audio_add_tap(audio_element_handle_t self, streaming_http_audio_tap_t tap, void *ctx)
+{
+    streaming_http_audio_t *sha = (streaming_http_audio_t *)audio_element_getdata(self);
+
+    if ( sha->num_taps >= STREAMING_HTTP_AUDIO_MAX_TAPS ) {
+        ESP_LOGE(TAG, "No free tap slots");
+        return ESP_ERR_NO_MEM;
     }
 
-    ESP_LOGI(TAG, "Error starting server!");
-    return ESP_FAIL;
+    sha->taps[sha->num_taps] = tap;
+    sha->tap_ctx[sha->num_taps] = ctx;
+    sha->num_taps++;
+
+    return ESP_OK;
+}
+
+
+esp_err_t streaming_http_audio_set_dtx(audio_element_handle_t self, const streaming_http_audio_dtx_t *dtx)
+{
+    streaming_http_audio_t *sha = (streaming_http_audio_t *)audio_element_getdata(self);
+
+    xSemaphoreTake( sha->lock, portMAX_DELAY );
+    sha->dtx_pending = *dtx;
+    sha->dtx_dirty = true;
+    xSemaphoreGive( sha->lock );
+
+    return ESP_OK;
+}
+
+esp_err_t streaming_http_audio_get_dtx(audio_element_handle_t self, streaming_http_audio_dtx_t *dtx)
+{
+    streaming_http_audio_t *sha = (streaming_http_audio_t *)audio_element_getdata(self);
+
+    xSemaphoreTake( sha->lock, portMAX_DELAY );
+    *dtx = sha->dtx_pending;
+    xSemaphoreGive( sha->lock );
+
+    return ESP_OK;
+}
+
+esp_err_t streaming_http_audio_set_format(audio_element_handle_t self, int sample_rate, int in_channels)
+{
+    streaming_http_audio_t *sha = (streaming_http_audio_t *)audio_element_getdata(self);
+
+    if ( in_channels < 1 || in_channels > 2 )
+        return ESP_ERR_INVALID_ARG;
+
+    xSemaphoreTake( sha->lock, portMAX_DELAY );
+    sha->pending_rate = sample_rate;
+    sha->pending_in_channels = in_channels;
+    sha->format_dirty = true;
+    xSemaphoreGive( sha->lock );
+
+    return ESP_OK;
+}
+
+esp_err_t streaming_http_audio_clock_report(audio_element_handle_t self, int64_t played_us, streaming_http_audio_clock_t *clock)
+{
+    streaming_http_audio_t *sha = (streaming_http_audio_t *)audio_element_getdata(self);
+
+    xSemaphoreTake( sha->lock, portMAX_DELAY );
+
+    if ( played_us >= 0 && sha->active ) {
+
+        // Both counts are modulo 2^32 samples so the difference survives the
+        // wrap on streams that run for days
+
+        uint32_t played = played_us * sha->sample_rate / 1000000;
+        int32_t depth = (int32_t) ( sha->sent_samples - played );
+
+        if ( sha->dtx.enable ) {
+            sha->drift.reports++;
+            sha->drift.depth_ms = (int64_t) depth * 1000 / sha->sample_rate;
+        } else {
+            sha->ppm_pending = drift_update( &sha->drift, esp_timer_get_time(), depth );
+            sha->ppm_dirty = true;
+        }
+    }
+
+    if ( clock ) {
+        clock->ppm = sha->drift.ppm;
+        clock->drift_ppm = -sha->drift.integral_ppm;
+        clock->depth_ms = sha->drift.depth_ms;
+        clock->target_ms = sha->drift.target_ms;
+        clock->reports = sha->drift.reports;
+    }
+
+    xSemaphoreGive( sha->lock );
+
+    return ESP_OK;
+}
+
+esp_err_t streaming_http_audio_set_latency(audio_element_handle_t self, const latency_params_t *params)
+{
+    streaming_http_audio_t *sha = (streaming_http_audio_t *)audio_element_getdata(self);
+
+    xSemaphoreTake( sha->lock, portMAX_DELAY );
+    sha->latency_pending = *params;
+    sha->latency_dirty = true;
+    xSemaphoreGive( sha->lock );
+
+    return ESP_OK;
+}
+
+// Read without the lock like the stats, the element task does not take it
+// per block. A change landing mid copy only tears a diagnostic read
+
+esp_err_t streaming_http_audio_get_latency(audio_element_handle_t self, latency_t *latency)
+{
+    streaming_http_audio_t *sha = (streaming_http_audio_t *)audio_element_getdata(self);
+
+    *latency = sha->latency;
+    if ( sha->latency_dirty )
+        latency->params = sha->latency_pending;
+
+    return ESP_OK;
+}
+
+esp_err_t streaming_http_audio_set_stretch(audio_element_handle_t self, const stretch_params_t *params)
+{
+    streaming_http_audio_t *sha = (streaming_http_audio_t *)audio_element_getdata(self);
+
+    xSemaphoreTake( sha->lock, portMAX_DELAY );
+    sha->stretch_pending = *params;
+    sha->stretch_dirty = true;
+    xSemaphoreGive( sha->lock );
+
+    return ESP_OK;
+}
+
+// Read without the lock like the latency controller
+
+esp_err_t streaming_http_audio_get_stretch(audio_element_handle_t self, streaming_http_audio_stretch_t *stretch)
+{
+    streaming_http_audio_t *sha = (streaming_http_audio_t *)audio_element_getdata(self);
+    const stretch_t* st = &sha->stretch;
+
+    stretch->params = sha->stretch_dirty ? sha->stretch_pending : st->params;
+    stretch->pct = st->pct;
+    stretch->catchups = st->catchups;
+    stretch->rounds = st->rounds;
+    stretch->in_samples = st->in_samples;
+    stretch->out_samples = st->out_samples;
+
+    return ESP_OK;
+}
+
+esp_err_t streaming_http_audio_set_notch(audio_element_handle_t self, const notch_params_t *params)
+{
+    streaming_http_audio_t *sha = (streaming_http_audio_t *)audio_element_getdata(self);
+
+    xSemaphoreTake( sha->lock, portMAX_DELAY );
+    sha->notch_pending = *params;
+    sha->notch_dirty = true;
+    xSemaphoreGive( sha->lock );
+
+    return ESP_OK;
+}
+
+// Read without the lock like the catch-up state
+
+esp_err_t streaming_http_audio_get_notch(audio_element_handle_t self, notch_t *notch, bool *running)
+{
+    streaming_http_audio_t *sha = (streaming_http_audio_t *)audio_element_getdata(self);
+
+    *notch = sha->notch;
+    if ( sha->notch_dirty )
+        notch->params = sha->notch_pending;
+    if ( running )
+        *running = sha->active && _streaming_http_audio_notch_on( sha );
+
+    return ESP_OK;
+}
+
+esp_err_t streaming_http_audio_set_narrowband(audio_element_handle_t self, int preset)
+{
+    streaming_http_audio_t *sha = (streaming_http_audio_t *)audio_element_getdata(self);
+
+    if ( preset < NARROWBAND_OFF || preset >= NARROWBAND_PRESETS )
+        return ESP_ERR_INVALID_ARG;
+
+    xSemaphoreTake( sha->lock, portMAX_DELAY );
+    sha->nb_default = preset;
+    xSemaphoreGive( sha->lock );
+
+    return ESP_OK;
+}
+
+// Read without the lock like the notch
+
+esp_err_t streaming_http_audio_get_narrowband(audio_element_handle_t self, int *preset, narrowband_t *nb, bool *running)
+{
+    streaming_http_audio_t *sha = (streaming_http_audio_t *)audio_element_getdata(self);
+
+    if ( preset )
+        *preset = sha->nb_default;
+    if ( nb )
+        *nb = sha->nb;
+    if ( running )
+        *running = sha->active && sha->nb.preset != NARROWBAND_OFF;
+
+    return ESP_OK;
+}
+
+esp_err_t streaming_http_audio_set_backlog(audio_element_handle_t self, streaming_http_audio_backlog_t backlog, void *ctx)
+{
+    streaming_http_audio_t *sha = (streaming_http_audio_t *)audio_element_getdata(self);
+
+    sha->backlog = backlog;
+    sha->backlog_ctx = ctx;
+
+    return ESP_OK;
+}
+
+esp_err_t streaming_http_audio_get_stats(audio_element_handle_t self, streaming_http_audio_stats_t *stats)
+{
+    streaming_http_audio_t *sha = (streaming_http_audio_t *)audio_element_getdata(self);
+    *stats = sha->stats;
+    return ESP_OK;
 }
 
 
@@ -222,7 +965,7 @@ audio_element_handle_t streaming_http_audio_init(streaming_http_audio_cfg_t *con
     cfg.close = _streaming_http_audio_close;
     cfg.task_stack = STREAMING_HTTP_AUDIO_TASK_STACK;
 
-    cfg.buffer_len = 4096;
+    cfg.buffer_len = STREAMING_HTTP_AUDIO_BUFFER_LEN;
 
     if (config) {
         if (config->task_stack) {
@@ -237,14 +980,50 @@ audio_element_handle_t streaming_http_audio_init(streaming_http_audio_cfg_t *con
     cfg.tag = "sha";
     cfg.write = _streaming_http_audio_write;
 
-    // Only need half the buffer size on output as it is mono. If a stereo output is
-    // required then remove the "/2" (and see the write function above
-    sha->buf_size = cfg.buffer_len/2;
-    sha->buf = audio_malloc( sha->buf_size );
+    // Stereo input only needs half the buffer size on output as it is mono, but
+    // the input can be switched to mono at run time so size for that
+    // The resampler can stretch a block slightly, so the buffers are
+    // STREAMING_HTTP_AUDIO_POOL_BLOCK rather than the element buffer length
+    sha->buf_size = STREAMING_HTTP_AUDIO_POOL_BLOCK;
+    if (config->pool && block_pool_block_size(config->pool) >= sha->buf_size) {
+        sha->pool = config->pool;
+        sha->buf = block_pool_get( sha->pool );
+        sha->hold = block_pool_get( sha->pool );
+        sha->rs_buf = block_pool_get( sha->pool );
+    } else {
+        if (config->pool)
+            ESP_LOGW(TAG, "Pool blocks smaller than %d bytes, using the heap", sha->buf_size);
+        sha->buf = audio_malloc( sha->buf_size );
+        sha->hold = audio_malloc( sha->buf_size );
+        sha->rs_buf = audio_malloc( sha->buf_size );
+    }
+    sha->lock = xSemaphoreCreateMutex();
+    AUDIO_MEM_CHECK(TAG, sha->buf && sha->hold && sha->rs_buf && sha->lock, {
+        if (sha->lock) vSemaphoreDelete(sha->lock);
+        _streaming_http_audio_free_buffers(sha); audio_free(sha); return NULL;});
     sha->active = false;
+    sha->fd = -1;
     sha->sample_rate = config->sample_rate;
 	sha->bits = config->bits;
 	sha->channels = config->channels;
+	sha->in_channels = config->in_channels ? config->in_channels : 2;
+
+	sha->dtx = config->dtx;
+	sha->dtx_pending = config->dtx;
+	vad_init( &sha->vad, sha->sample_rate, &sha->dtx.vad );
+	drift_init( &sha->drift, sha->sample_rate, &config->drift );
+	resampler_init( &sha->rs );
+	sha->latency_pending = config->latency;
+	latency_init( &sha->latency, &config->latency );
+	_streaming_http_audio_set_block( sha );
+	sha->stretch_pending = config->stretch;
+	stretch_init( &sha->stretch, sha->sample_rate, &config->stretch );
+	sha->notch_pending = config->notch;
+	notch_init( &sha->notch, sha->sample_rate, &config->notch );
+	sha->notch_listener = -1;
+	sha->nb_default = config->narrowband;
+	narrowband_init( &sha->nb, sha->sample_rate, NARROWBAND_OFF );
+	sha->nb_factor = 1;
 
     ESP_LOGE(TAG, "Streaming Audio Config: Size: %d Sample Rate: %d Bits: %d Channels: %d",
     	    sha->buf_size,
@@ -254,11 +1033,9 @@ audio_element_handle_t streaming_http_audio_init(streaming_http_audio_cfg_t *con
     		);
 
     audio_element_handle_t el = audio_element_init(&cfg);
-    AUDIO_MEM_CHECK(TAG, el, {audio_free(sha); return NULL;});
+    AUDIO_MEM_CHECK(TAG, el, {vSemaphoreDelete(sha->lock); _streaming_http_audio_free_buffers(sha); audio_free(sha); return NULL;});
     audio_element_setdata(el, sha);
 
-    _start_streaming_server( el, config );
-
     ESP_LOGD(TAG, "streaming_http_audio_init");
     return el;
 }
@@ -13,11 +13,89 @@
 #include "freertos/event_groups.h"
 #include "esp_system.h"
 #include "esp_http_server.h"
+#include "vad.h"
+#include "drift.h"
+#include "latency.h"
+#include "stretch.h"
+#include "notch.h"
+#include "narrowband.h"
+#include "block_pool.h"
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
+/**
+ * @brief      Discontinuous transmission settings. While the VAD reports
+ *             silence nothing is sent to the client except a short block of
+ *             silence every keepalive_ms (0 sends nothing at all). Blocks are
+ *             held back by one block so a speech onset also releases the
+ *             block before it
+ */
+typedef struct {
+    bool                    enable;
+    int                     keepalive_ms;   /*!< Interval between silence frames */
+    int                     keepalive_len;  /*!< Length of each silence frame in ms */
+    vad_params_t            vad;
+} streaming_http_audio_dtx_t;
+
+#define DEFAULT_STREAMING_HTTP_AUDIO_DTX() {\
+    .enable             = false,\
+    .keepalive_ms       = 1000,\
+    .keepalive_len      = 20,\
+    .vad                = DEFAULT_VAD_PARAMS(),\
+}
+
+/**
+ * @brief      Clock drift correction state for the connected listener
+ */
+typedef struct {
+    int32_t                 ppm;            /*!< Resampling correction in force */
+    int32_t                 drift_ppm;      /*!< Estimated listener clock error, negative when it runs slow */
+    int32_t                 depth_ms;       /*!< Audio sent but not yet played */
+    int32_t                 target_ms;
+    uint32_t                reports;
+} streaming_http_audio_clock_t;
+
+/**
+ * @brief      Catch-up state: the rate in force and what the time
+ *             compression stage has done since the element was created
+ */
+typedef struct {
+    stretch_params_t        params;
+    int                     pct;            /*!< Rate in force, 100 when not catching up */
+    uint32_t                catchups;
+    uint32_t                rounds;         /*!< WSOLA sequences output */
+    uint64_t                in_samples;     /*!< Consumed while catching up */
+    uint64_t                out_samples;    /*!< Produced from them */
+} streaming_http_audio_stretch_t;
+
+/**
+ * @brief      Transmit statistics since the element was created
+ */
+typedef struct {
+    uint32_t                blocks;         /*!< Blocks presented to a connected client */
+    uint32_t                speech_blocks;
+    uint64_t                bytes_sent;
+    uint64_t                bytes_suppressed;
+    uint64_t                bytes_dropped;  /*!< Discarded to hold the latency controller's queue limit */
+    uint32_t                stretch_blocks; /*!< Blocks through the time compression stage */
+    uint64_t                stretch_cycles;
+    uint64_t                stretch_samples;    /*!< Input samples those blocks carried */
+    uint32_t                notch_blocks;   /*!< Blocks through the carrier notch */
+    uint64_t                notch_cycles;
+    uint64_t                notch_samples;
+    uint32_t                narrowband_blocks;  /*!< Blocks through the channel filter */
+    uint64_t                narrowband_cycles;
+    uint64_t                narrowband_samples; /*!< Input samples those blocks carried */
+    uint64_t                narrowband_out_samples;
+    uint32_t                vad_blocks;     /*!< Blocks classified by the VAD */
+    uint64_t                vad_cycles;
+    uint32_t                format_changes;
+    uint32_t                format_gap_us;  /*!< Gap in the output around the last format change */
+    uint32_t                format_max_gap_us;
+} streaming_http_audio_stats_t;
+
 /**
  * @brief      WAV Encoder configurations
  */
@@ -29,10 +107,17 @@ typedef struct {
     int                     task_prio;      /*!< Task priority (based on freeRTOS priority) */
     bool                    stack_in_ext;   /*!< Try to allocate stack in external memory */
 
-    httpd_config_t			http_cfg;
     int						sample_rate;
     int						bits;
     int						channels;
+    int						in_channels;	/*!< Interleaved 16 bit input channels, only the first is streamed */
+    streaming_http_audio_dtx_t	dtx;
+    drift_params_t			drift;
+    latency_params_t		latency;
+    stretch_params_t		stretch;
+    notch_params_t			notch;			/*!< Carrier removal, the default for each listener */
+    int						narrowband;		/*!< Channel filter preset (narrowband_preset_t), the default for each listener */
+    block_pool_handle_t		pool;			/*!< Output, DTX hold and resampler buffers, three blocks of STREAMING_HTTP_AUDIO_POOL_BLOCK. Heap if NULL */
 } streaming_http_audio_cfg_t;
 
 
@@ -41,6 +126,9 @@ typedef struct {
 #define STREAMING_HTTP_AUDIO_TASK_CORE           (1)
 #define STREAMING_HTTP_AUDIO_TASK_PRIO           (23)
 #define STREAMING_HTTP_AUDIO_RINGBUFFER_SIZE     (8 * 1024)
+#define STREAMING_HTTP_AUDIO_MAX_TAPS            (4)
+#define STREAMING_HTTP_AUDIO_BUFFER_LEN          (4096)
+#define STREAMING_HTTP_AUDIO_POOL_BLOCK          (STREAMING_HTTP_AUDIO_BUFFER_LEN + STREAMING_HTTP_AUDIO_BUFFER_LEN / 64)
 
 #define DEFAULT_STREAMING_HTTP_AUDIO_CONFIG() {\
     .out_rb_size        = STREAMING_HTTP_AUDIO_RINGBUFFER_SIZE,\
@@ -51,6 +139,13 @@ typedef struct {
 	.sample_rate		= 8000, \
 	.bits				= 16, \
 	.channels			= 1, \
+	.in_channels		= 2, \
+	.dtx				= DEFAULT_STREAMING_HTTP_AUDIO_DTX(), \
+	.drift				= DEFAULT_DRIFT_PARAMS(), \
+	.latency			= DEFAULT_LATENCY_PARAMS(), \
+	.stretch			= DEFAULT_STRETCH_PARAMS(), \
+	.notch				= DEFAULT_NOTCH_PARAMS(), \
+	.narrowband			= NARROWBAND_OFF, \
 }
 
 /**
@@ -62,6 +157,128 @@ typedef struct {
  */
 audio_element_handle_t streaming_http_audio_init(streaming_http_audio_cfg_t *config);
 
+/**
+ * @brief      Callback receiving every block in the output (WAV) format,
+ *             whether or not a client is connected
+ */
+typedef void (*streaming_http_audio_tap_t)(const char *buf, int len, void *ctx);
+
+/**
+ * @brief      Attach a tap to the element output
+ *
+ * @param      self  The audio element handle
+ * @param      tap   The tap callback, run in the element task
+ * @param      ctx   Context passed to the callback
+ *
+ * @return     ESP_OK or ESP_ERR_NO_MEM when all tap slots are used
+ */
+esp_err_t streaming_http_audio_add_tap(audio_element_handle_t self, streaming_http_audio_tap_t tap, void *ctx);
+
+/**
+ * @brief      Change the DTX settings. Applied at the next block
+ */
+esp_err_t streaming_http_audio_set_dtx(audio_element_handle_t self, const streaming_http_audio_dtx_t *dtx);
+
+esp_err_t streaming_http_audio_get_dtx(audio_element_handle_t self, streaming_http_audio_dtx_t *dtx);
+
+/**
+ * @brief      Change the sample rate and input channel count. Applied at the
+ *             next block: anything held back by DTX goes out in the old
+ *             format, then a connected client has its response ended so it
+ *             reconnects and gets a WAV header for the new format. The
+ *             caller must make sure no data in the old format is still
+ *             queued (pause the pipeline and reset the ringbuffers around
+ *             the change, or behind the tee, pause it with tee_pause)
+ */
+esp_err_t streaming_http_audio_set_format(audio_element_handle_t self, int sample_rate, int in_channels);
+
+/**
+ * @brief      Feed the listener's playback position, in microseconds of
+ *             stream time since it connected, to the drift correction. The
+ *             new correction is applied at the next block. The correction is
+ *             held while DTX is enabled, as the listener stalls whenever
+ *             silence is suppressed
+ *
+ * @param      played_us  Position reported by the listener, or -1 to only
+ *                        read the state
+ */
+esp_err_t streaming_http_audio_clock_report(audio_element_handle_t self, int64_t played_us, streaming_http_audio_clock_t *clock);
+
+/**
+ * @brief      Change the latency controller settings. Applied at the next
+ *             block, a connected listener starts over at the largest point
+ */
+esp_err_t streaming_http_audio_set_latency(audio_element_handle_t self, const latency_params_t *params);
+
+/**
+ * @brief      Read the latency controller: the operating point in force and
+ *             the last LATENCY_HISTORY changes (see latency_history()). The
+ *             block length and queue limit only apply while a listener is
+ *             connected, otherwise whole element buffers are read
+ */
+esp_err_t streaming_http_audio_get_latency(audio_element_handle_t self, latency_t *latency);
+
+/**
+ * @brief      Change the catch-up settings. Applied at the next block, a
+ *             catch-up under way finishes at the new rates
+ */
+esp_err_t streaming_http_audio_set_stretch(audio_element_handle_t self, const stretch_params_t *params);
+
+esp_err_t streaming_http_audio_get_stretch(audio_element_handle_t self, streaming_http_audio_stretch_t *stretch);
+
+/**
+ * @brief      Change the carrier notch settings, applied at the next block.
+ *             The enable flag is the default: a listener that connects to
+ *             /stream?notch=0 or ?notch=1 chooses for its own stream
+ */
+esp_err_t streaming_http_audio_set_notch(audio_element_handle_t self, const notch_params_t *params);
+
+/**
+ * @brief      Read the notch: its settings, what each section has found and
+ *             whether it runs for the current listener
+ */
+esp_err_t streaming_http_audio_get_notch(audio_element_handle_t self, notch_t *notch, bool *running);
+
+/**
+ * @brief      Change the default channel filter preset. The WAV header
+ *             carries the rate, so it applies from the next listener on;
+ *             one that connects to /stream?bw=<preset> chooses for itself
+ */
+esp_err_t streaming_http_audio_set_narrowband(audio_element_handle_t self, int preset);
+
+/**
+ * @brief      Read the default preset and the filter of the current or last
+ *             listener, with whether it runs for a listener now
+ */
+esp_err_t streaming_http_audio_get_narrowband(audio_element_handle_t self, int *preset, narrowband_t *nb, bool *running);
+
+/**
+ * @brief      Callback returning the bytes queued in front of the element,
+ *             or -1 if not known, and in "dropped" the bytes the queue has
+ *             thrown away so far (a wrapping count). Run in the element task
+ */
+typedef int (*streaming_http_audio_backlog_t)(void *ctx, uint32_t *dropped);
+
+/**
+ * @brief      Tell the element how to measure its backlog when its input is
+ *             not a ringbuffer, for the latency controller and the catch-up
+ *             stage. Set before the pipeline runs
+ */
+esp_err_t streaming_http_audio_set_backlog(audio_element_handle_t self, streaming_http_audio_backlog_t backlog, void *ctx);
+
+esp_err_t streaming_http_audio_get_stats(audio_element_handle_t self, streaming_http_audio_stats_t *stats);
+
+/**
+ * @brief      Serve the stream at /stream on the port 80 server. The server
+ *             must be running
+ */
+esp_err_t streaming_http_audio_register(audio_element_handle_t self);
+
+/**
+ * @brief      Take /stream off the server before the element is deinitialized
+ */
+esp_err_t streaming_http_audio_unregister(audio_element_handle_t self);
+
 
 #ifdef __cplusplus
 }
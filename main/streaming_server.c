@@ -8,6 +8,7 @@
 */
 
 #include "streaming_server.h"
+#include "webserver.h"
 #include "wav_create.h"
 #include "streaming_wav.h"
 
@@ -42,6 +43,9 @@ struct httpd_req_aux {
  */
 
 #define SCRATCH_BUFSIZE  8192
+#define STREAM_SESSIONS  1              // One tone task, for the life of the stream
+#define STREAM_TASK_STACK  (3 * 1024)
+#define STREAM_TASK_PRIO   4
 
 static const char *TAG = "streaming-server";
 
@@ -49,6 +53,12 @@ struct streaming_server_data {
 
     char scratch[SCRATCH_BUFSIZE];
     void (*command_callback)( const char*, char* );
+    block_pool_handle_t session_pool;
+
+    /* The session, owned by the stream task while active */
+    volatile bool active;
+    int fd;
+    streaming_wav_t wav;
 };
 
 struct streaming_server_data *streaming_server_data = NULL;
@@ -88,43 +98,68 @@ static esp_err_t stream_handler_old(httpd_req_t *req)
 }
 
 
-static esp_err_t stream_handler(httpd_req_t *req)
+/* Generates the tone into the detached socket until the client goes */
+static void stream_task(void *arg)
 {
-    ESP_LOGE(TAG, "In Stream Handler" );
-	httpd_resp_set_type(req, "audio/x-wav");
+    struct streaming_server_data *sd = streaming_server_data;
+    float frequency = 600;
 
-    //struct httpd_req_aux *ra = req->aux;
-    //const char   *hdr_ptr = ra->scratch;
+    for ( ;; ) {
 
-    streaming_wav_t	wav;
+    	streaming_wav_play( &sd->wav, frequency );
 
-    ESP_LOGE(TAG, "Sending Header" );
-	streaming_wav_init( &wav, SCRATCH_BUFSIZE );
-    httpd_resp_send_chunk(req, (const char*)&(wav.hdr), sizeof(wav.hdr));
+        if (webserver_send_all(sd->fd, (const char*)sd->wav.buf, SCRATCH_BUFSIZE) != ESP_OK) {
+            ESP_LOGI(TAG, "Stream on socket %d ended", sd->fd);
+            break;
+        }
+	}
 
-    size_t chunksize = SCRATCH_BUFSIZE;
-    float frequency = 600;
+    streaming_wav_destroy( &sd->wav );
+    if (webserver_release_socket(sd->fd)) {
+        close(sd->fd);
+    }
+    sd->active = false;
+    vTaskDelete(NULL);
+}
 
-    int cnt = 0;
+/* Writes the response head and hands the socket to the stream task, the
+ * server goes straight back to its other sessions */
+static esp_err_t stream_handler(httpd_req_t *req)
+{
+    static const char head[] = "HTTP/1.1 200 OK\r\nContent-Type: audio/x-wav\r\n"
+                               "Cache-Control: no-cache\r\nConnection: close\r\n\r\n";
 
-    for ( ;; ) {
+    struct streaming_server_data *sd = streaming_server_data;
 
-    	streaming_wav_play( &wav, frequency );
+    if ( sd->active || streaming_wav_init( &sd->wav, sd->session_pool ) != 0 ) {
+        httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "No free stream sessions");
+        return ESP_OK;
+    }
 
-        if (httpd_resp_send_chunk(req, (const char*)wav.buf, chunksize) != ESP_OK) {
-            ESP_LOGE(TAG, "File sending failed!");
-            httpd_resp_sendstr_chunk(req, NULL);
-            httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Failed to send file");
-            streaming_wav_destroy( &wav );
-            return ESP_FAIL;
-        }
+    if ( webserver_detach_socket( req ) != ESP_OK ) {
+        streaming_wav_destroy( &sd->wav );
+        httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "No free stream sessions");
+        return ESP_OK;
+    }
 
-	}
+    sd->fd = httpd_req_to_sockfd( req );
 
-    streaming_wav_destroy( &wav );
-    httpd_resp_send_chunk(req, NULL, 0);
+    if ( webserver_send_all( sd->fd, head, sizeof(head) - 1 ) != ESP_OK ||
+         webserver_send_all( sd->fd, (const char*)&(sd->wav.hdr), sizeof(sd->wav.hdr) ) != ESP_OK ) {
+        streaming_wav_destroy( &sd->wav );
+        webserver_release_socket( sd->fd );
+        return ESP_FAIL;
+    }
 
-    return ESP_OK;
+    sd->active = true;
+    if ( xTaskCreate( stream_task, "tone_stream", STREAM_TASK_STACK, NULL, STREAM_TASK_PRIO, NULL ) != pdPASS ) {
+        streaming_wav_destroy( &sd->wav );
+        webserver_release_socket( sd->fd );
+        sd->active = false;
+    }
+
+    // Failing the request is what detaches the socket from the server
+    return ESP_FAIL;
 }
 
 
@@ -142,11 +177,12 @@ esp_err_t start_streaming_server()
         return ESP_ERR_NO_MEM;
     }
 
-    httpd_handle_t server = NULL;
-    httpd_config_t config = HTTPD_DEFAULT_CONFIG();
-
-    config.server_port = 8080;
-    config.ctrl_port = 8081;
+    streaming_server_data->session_pool = block_pool_create("stream", SCRATCH_BUFSIZE, STREAM_SESSIONS);
+    if (!streaming_server_data->session_pool) {
+        free(streaming_server_data);
+        streaming_server_data = NULL;
+        return ESP_ERR_NO_MEM;
+    }
 
     httpd_uri_t stream = {
         .uri       = "/stream",
@@ -157,28 +193,6 @@ esp_err_t start_streaming_server()
         .user_ctx  = "Stream Handler"
     };
 
-    /* Use the URI wildcard matching function in order to
-     * allow the same handler to respond to multiple different
-     * target URIs which match the wildcard scheme */
-    config.uri_match_fn = httpd_uri_match_wildcard;
-    config.lru_purge_enable = true;
-
-    // Start the httpd server
-    ESP_LOGI(TAG, "Starting server on port: '%d'", config.server_port);
-    if (httpd_start(&server, &config) == ESP_OK) {
-        // Set URI handlers
-        ESP_LOGI(TAG, "Registering URI handlers");
-        httpd_register_uri_handler(server, &stream);
-        ESP_LOGI(TAG, "Completed Registering URI handlers");
-        return ESP_OK;
-    }
-
-    ESP_LOGI(TAG, "Error starting server!");
-    return ESP_FAIL;
+    /* Served by the port 80 server, which must already be running */
+    return webserver_register_uri_handler(&stream);
 }
-
-
-
-
-
-
@@ -8,6 +8,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdint.h>
+#include <string.h>
 
 #include <sys/stat.h>
 #include <fcntl.h>
@@ -109,11 +110,44 @@ int streaming_wav_factor( streaming_wav_t* wav ) {
 
 void streaming_wav_destroy( streaming_wav_t* wav ) {
 
-	free(wav->buf);
+	block_pool_put( wav->pool, wav->buf );
+	wav->buf = NULL;
 }
 
 
-void streaming_wav_init( streaming_wav_t* wav, int buffer_size ) {
+void streaming_wav_set_rate( streaming_wav_t* wav, int sample_rate ) {
+
+	streaming_wav_header( wav, wav->hdr.fmt.num_of_channels, wav->hdr.fmt.bits_per_sample, sample_rate );
+	wav->cnt = 0;
+	wav->pos = wav->buf_size;
+}
+
+
+int streaming_wav_read( streaming_wav_t* wav, float frequency, int16_t* dest, int samples ) {
+
+	int done = 0;
+
+	while ( done < samples ) {
+
+		if ( wav->pos == wav->buf_size ) {
+			streaming_wav_play( wav, frequency );
+			wav->pos = 0;
+		}
+
+		int n = wav->buf_size - wav->pos;
+		if ( n > samples - done )
+			n = samples - done;
+
+		memcpy( dest + done, wav->buf + wav->pos, n * sizeof(int16_t) );
+		wav->pos += n;
+		done += n;
+	}
+
+	return done;
+}
+
+
+int streaming_wav_init( streaming_wav_t* wav, block_pool_handle_t pool ) {
 
 	int num_channels = 1;
 	int bits_per_sample = 16;
@@ -123,9 +157,14 @@ void streaming_wav_init( streaming_wav_t* wav, int buffer_size ) {
 
 	streaming_wav_header( wav, num_channels, bits_per_sample, sample_rate );
 
-	wav->buf = (int16_t*)malloc( buffer_size );
-	wav->buf_size = buffer_size / streaming_wav_factor( wav );
+	wav->pool = pool;
+	wav->buf = (int16_t*)block_pool_get( pool );
+	if ( !wav->buf )
+		return -1;
 
+	wav->buf_size = block_pool_block_size( pool ) / streaming_wav_factor( wav );
+	wav->pos = wav->buf_size;
+	return 0;
 }
 
 
@@ -10,6 +10,7 @@
 
 #include <stdint.h>
 #include "wav_header.h"
+#include "block_pool.h"
 
 
 typedef struct {
@@ -18,11 +19,21 @@ typedef struct {
 	int16_t			*buf;
 	int				buf_size;
 	int				cnt;
+	int				pos;			// Samples of buf already handed out by streaming_wav_read
+	block_pool_handle_t	pool;
 
 } streaming_wav_t;
 
-void streaming_wav_init( streaming_wav_t* wav, int buffer_size );
+// The sample buffer is one block of "pool", so a session costs no heap.
+// Returns -1 if the pool is empty
+int streaming_wav_init( streaming_wav_t* wav, block_pool_handle_t pool );
 void streaming_wav_play( streaming_wav_t* wav, float frequency );
 void streaming_wav_destroy( streaming_wav_t* wav );
 
+// For using the generator as a mixer source rather than a stream: set the
+// rate to the pipeline's, then read any number of mono samples. The buffer
+// is refilled with streaming_wav_play as it runs out
+void streaming_wav_set_rate( streaming_wav_t* wav, int sample_rate );
+int streaming_wav_read( streaming_wav_t* wav, float frequency, int16_t* dest, int samples );
+
 #endif /* MAIN_STREAMING_WAV_H_ */
@@ -0,0 +1,198 @@
+/*
+ * stretch.c
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: xenir
+ */
+
+#include <string.h>
+
+#include "stretch.h"
+
+void stretch_init( stretch_t* st, int sample_rate, const stretch_params_t* params )
+{
+    memset( st, 0, sizeof(stretch_t) );
+    st->params = *params;
+    st->sample_rate = sample_rate > STRETCH_MAX_RATE ? STRETCH_MAX_RATE : sample_rate;
+    st->seq = st->sample_rate * STRETCH_SEQUENCE_MS / 1000;
+    st->seek = st->sample_rate * STRETCH_SEEK_MS / 1000;
+    st->overlap = st->sample_rate * STRETCH_OVERLAP_MS / 1000;
+    st->pct = 100;
+}
+
+void stretch_reset( stretch_t* st )
+{
+    st->pct = 100;
+    st->primed = false;
+    st->skip_frac = 0;
+    st->head = 0;
+    st->fill = 0;
+}
+
+int stretch_update( stretch_t* st, int backlog_ms )
+{
+    const stretch_params_t* p = &st->params;
+    int pct = 100;
+
+    // Hysteresis between start_ms and stop_ms, then a rate that works off
+    // the excess in about catchup_ms
+
+    if ( p->enable && backlog_ms > p->stop_ms && ( st->pct > 100 || backlog_ms >= p->start_ms ) ) {
+
+        int max = p->max_pct < STRETCH_MAX_PCT ? p->max_pct : STRETCH_MAX_PCT;
+        int min = p->min_pct > 100 ? p->min_pct : 101;
+
+        pct = 100 + ( backlog_ms - p->stop_ms ) * 100 / ( p->catchup_ms > 0 ? p->catchup_ms : 1 );
+        pct = pct < min ? min : ( pct > max ? max : pct );
+
+        if ( st->pct == 100 )
+            st->catchups++;
+    }
+
+    st->pct = pct;
+    return pct;
+}
+
+// Input is consumed by moving the head, the FIFO is compacted once per call
+
+static void _shift( stretch_t* st, int n )
+{
+    st->head += n;
+    st->fill -= n;
+}
+
+// Offset into the FIFO, within the seek window, whose first overlap
+// samples best match the tail: highest normalised correlation on every
+// other sample and offset, then refined to the neighbouring offsets
+
+static int64_t _dot( const int16_t* a, const int16_t* b, int len, int step, int64_t* energy )
+{
+    int64_t dot = 0, e = 0;
+    for ( int j = 0 ; j < len ; j += step ) {
+        dot += (int32_t) a[j] * b[j];
+        e += (int32_t) b[j] * b[j];
+    }
+    *energy = e;
+    return dot;
+}
+
+static float _score( int64_t dot, int64_t energy )
+{
+    // Squared normalised correlation keeping the sign, no square root
+    float d = (float) dot;
+    return energy > 0 ? d * ( d < 0 ? -d : d ) / (float) energy : 0;
+}
+
+static int _best_offset( stretch_t* st )
+{
+    int best = 0;
+    float best_score = -1e30f;
+    int64_t e;
+
+    for ( int k = 0 ; k < st->seek ; k += 2 ) {
+        int64_t dot = _dot( st->tail, st->fifo + st->head + k, st->overlap, 2, &e );
+        float s = _score( dot, e );
+        if ( s > best_score ) {
+            best_score = s;
+            best = k;
+        }
+    }
+
+    int centre = best;
+    best_score = -1e30f;
+    for ( int k = centre - 1 ; k <= centre + 1 ; k++ ) {
+        if ( k < 0 || k >= st->seek )
+            continue;
+        int64_t dot = _dot( st->tail, st->fifo + st->head + k, st->overlap, 1, &e );
+        float s = _score( dot, e );
+        if ( s > best_score ) {
+            best_score = s;
+            best = k;
+        }
+    }
+
+    return best;
+}
+
+static int _round( stretch_t* st, int16_t* out )
+{
+    int o = st->overlap;
+    int k = _best_offset( st );
+    const int16_t* x = st->fifo + st->head + k;
+
+    // Linear cross fade from the tail into the new sequence, then the body
+    // of the sequence; its end is the next tail
+
+    for ( int j = 0 ; j < o ; j++ )
+        out[j] = ( (int32_t) st->tail[j] * ( o - j ) + (int32_t) x[j] * j ) / o;
+    memcpy( out + o, x + o, ( st->seq - 2 * o ) * sizeof(int16_t) );
+    memcpy( st->tail, x + st->seq - o, o * sizeof(int16_t) );
+
+    uint64_t skip = (uint64_t) ( st->seq - o ) * st->pct * 65536 / 100 + st->skip_frac;
+    st->skip_frac = skip & 0xFFFF;
+    skip >>= 16;
+
+    st->tail_end = k + st->seq - skip;
+    _shift( st, skip );
+
+    st->rounds++;
+    st->in_samples += skip;
+    st->out_samples += st->seq - o;
+    return st->seq - o;
+}
+
+int stretch_process( stretch_t* st, const int16_t* in, int count, int16_t* out )
+{
+    int n = 0;
+
+    memmove( st->fifo, st->fifo + st->head, st->fill * sizeof(int16_t) );
+    st->head = 0;
+
+    if ( count > STRETCH_FIFO - st->fill ) {
+        st->overflows++;
+        count = STRETCH_FIFO - st->fill;
+    }
+    memcpy( st->fifo + st->fill, in, count * sizeof(int16_t) );
+    st->fill += count;
+
+    if ( st->pct > 100 ) {
+
+        // Entering: the first overlap becomes the tail, to be faded out
+        // into the best match a sequence later
+
+        if ( !st->primed && st->fill >= st->overlap ) {
+            memcpy( st->tail, st->fifo + st->head, st->overlap * sizeof(int16_t) );
+            _shift( st, st->overlap );
+            st->tail_end = 0;
+            st->primed = true;
+            st->in_samples += st->overlap;
+        }
+
+        while ( st->primed && st->fill >= st->seek + st->seq && n <= count )
+            n += _round( st, out + n );
+
+        return n;
+    }
+
+    // Leaving: the tail goes back in front of the input that continues it,
+    // then everything held plays out at real time, at most a sequence more
+    // than the input per call
+
+    if ( st->primed ) {
+        int rest = st->fill - st->tail_end;
+        memmove( st->fifo + st->overlap, st->fifo + st->head + st->tail_end, rest * sizeof(int16_t) );
+        memcpy( st->fifo, st->tail, st->overlap * sizeof(int16_t) );
+        st->head = 0;
+        st->fill = st->overlap + rest;
+        st->primed = false;
+        st->skip_frac = 0;
+    }
+
+    n = stretch_max_out( st, count );
+    if ( n > st->fill )
+        n = st->fill;
+    memcpy( out, st->fifo + st->head, n * sizeof(int16_t) );
+    _shift( st, n );
+
+    return n;
+}
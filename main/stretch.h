@@ -0,0 +1,117 @@
+/*
+ * stretch.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: xenir
+ */
+
+#ifndef MAIN_STRETCH_H_
+#define MAIN_STRETCH_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Time compression for a listener that has fallen behind: the backlog in
+// front of the streamer is played out a little faster than real time until
+// it is back near live, instead of being dropped. WSOLA on 16 bit mono:
+// each round outputs one sequence of STRETCH_SEQUENCE_MS, the first
+// STRETCH_OVERLAP_MS of it cross faded from the end of the previous one,
+// then skips ( sequence - overlap ) * rate of input. Where the next sequence
+// starts is searched over STRETCH_SEEK_MS for the best correlation with the
+// previous one's end, so pitch periods line up and the splice is not heard
+// as a click or a warble at these rates.
+//
+// At 100% the stage holds nothing and the streamer leaves it out. Leaving a
+// catch-up, what is held (the pending overlap and the input after it) plays
+// out unchanged over the next few blocks, so entering and leaving are both
+// seamless.
+
+#define STRETCH_SEQUENCE_MS		30
+#define STRETCH_SEEK_MS			12
+#define STRETCH_OVERLAP_MS		8
+#define STRETCH_MAX_PCT			125		// Skip must stay inside one sequence
+#define STRETCH_MAX_RATE		48000
+#define STRETCH_MAX_IN			2048	// Samples per call
+
+typedef struct {
+    bool	enable;
+    int		start_ms;			// Backlog that starts a catch-up
+    int		stop_ms;			// Backlog that ends it
+    int		catchup_ms;			// The backlog over stop_ms is worked off in about this long
+    int		min_pct;			// Rate limits while catching up, 100 is real time
+    int		max_pct;
+    int		max_ms;				// Backlog still dropped beyond this, where the streamer can drop
+} stretch_params_t;
+
+#define DEFAULT_STRETCH_PARAMS() {\
+    .enable             = true,\
+    .start_ms           = 80,\
+    .stop_ms            = 30,\
+    .catchup_ms         = 2000,\
+    .min_pct            = 105,\
+    .max_pct            = 120,\
+    .max_ms             = 1000,\
+}
+
+#define STRETCH_FIFO	( STRETCH_MAX_IN + ( STRETCH_SEQUENCE_MS + STRETCH_SEEK_MS + STRETCH_OVERLAP_MS ) * STRETCH_MAX_RATE / 1000 )
+
+typedef struct {
+
+    stretch_params_t	params;
+    int					sample_rate;
+    int					seq;				// Window lengths in samples
+    int					seek;
+    int					overlap;
+
+    int					pct;				// Rate in force, 100 when not catching up
+    bool				primed;				// Rounds running, tail holds the pending overlap
+    uint32_t			skip_frac;			// Q16 remainder of the skips so far
+    int					tail_end;			// Input continuing the tail, from the head
+    int					head;				// First unconsumed sample in the FIFO
+    int					fill;				// Unconsumed samples
+    int16_t				fifo[STRETCH_FIFO];
+    int16_t				tail[STRETCH_OVERLAP_MS * STRETCH_MAX_RATE / 1000];
+
+    uint32_t			catchups;
+    uint32_t			rounds;
+    uint64_t			in_samples;			// Consumed while catching up
+    uint64_t			out_samples;		// Produced from them
+    uint32_t			overflows;			// Input refused, only if a caller breaks STRETCH_MAX_IN
+
+} stretch_t;
+
+void stretch_init( stretch_t* st, int sample_rate, const stretch_params_t* params );
+
+// Drops anything held, for a new listener
+void stretch_reset( stretch_t* st );
+
+// Picks the rate from the backlog in front of the streamer. Returns the
+// rate in percent
+int stretch_update( stretch_t* st, int backlog_ms );
+
+// True while the stage has to run: catching up or playing out what it holds
+static inline bool stretch_busy( const stretch_t* st )
+{
+    return st->pct > 100 || st->primed || st->fill > 0;
+}
+
+// Output samples that "in_count" input samples can produce at most
+static inline int stretch_max_out( const stretch_t* st, int in_count )
+{
+    return in_count + st->seq - st->overlap;
+}
+
+// Compresses "count" samples into "out", which must hold stretch_max_out
+// samples. Returns the samples written, which may be 0 while it collects
+// the input for a round
+int stretch_process( stretch_t* st, const int16_t* in, int count, int16_t* out );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* MAIN_STRETCH_H_ */
@@ -0,0 +1,289 @@
+/*
+ * sysmon.c
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: xenir
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_heap_caps.h"
+#include "esp_http_server.h"
+#include "audio_mem.h"
+#include "audio_error.h"
+#include "sdkconfig.h"
+
+#include "webserver.h"
+#include "block_pool.h"
+#include "sysmon.h"
+
+static const char *TAG = "sysmon";
+
+#if CONFIG_FREERTOS_USE_TRACE_FACILITY && CONFIG_FREERTOS_GENERATE_RUN_TIME_STATS && CONFIG_FREERTOS_VTASKLIST_INCLUDE_COREID
+
+// The sampler owns the TaskStatus_t array and the scratch table. What
+// the handler reads (the task table and the history ring) is swapped in
+// under the lock, so a request never waits for uxTaskGetSystemState.
+
+typedef struct {
+    char			name[configMAX_TASK_NAME_LEN];
+    UBaseType_t		number;
+    int				core;			// -1 when not pinned
+    UBaseType_t		prio;
+    eTaskState		state;
+    uint32_t		runtime;		// Counter at the last sample
+    uint32_t		load_permille;	// Of one core over the last period
+    uint32_t		stack_free;
+} sysmon_task_t;
+
+typedef struct {
+    int64_t			time_us;
+    uint32_t		idle[portNUM_PROCESSORS];
+} sysmon_sample_t;
+
+struct sysmon {
+
+    int					period_ms;
+    TaskStatus_t*		status;
+    sysmon_task_t		scratch[SYSMON_MAX_TASKS];
+    sysmon_task_t		snapshot[SYSMON_MAX_TASKS];		// Handler's copy, requests are serialised by the server
+
+    SemaphoreHandle_t	lock;
+    sysmon_task_t		tasks[SYSMON_MAX_TASKS];
+    int					num_tasks;
+    sysmon_sample_t		history[SYSMON_HISTORY + 1];
+    int					head;			// Next slot to write
+    int					samples;
+};
+
+static struct sysmon* sysmon = NULL;
+
+static const sysmon_task_t* _find_task( const sysmon_task_t* tasks, int count, UBaseType_t number )
+{
+    for ( int i = 0 ; i < count ; i++ ) {
+        if ( tasks[i].number == number )
+            return &tasks[i];
+    }
+    return NULL;
+}
+
+static bool _sample( struct sysmon* sm )
+{
+    uint32_t total;
+    int count = uxTaskGetSystemState( sm->status, SYSMON_MAX_TASKS, &total );
+    int64_t now = esp_timer_get_time();
+
+    if ( count == 0 )
+        return false;
+
+    sysmon_task_t* tasks = sm->scratch;
+
+    // Counters are esp_timer microseconds truncated to 32 bits, so deltas
+    // stay valid across the wrap as long as the period is under an hour
+
+    const sysmon_sample_t* last = sm->samples ? &sm->history[( sm->head + SYSMON_HISTORY ) % ( SYSMON_HISTORY + 1 )] : NULL;
+    uint32_t period_us = last ? now - last->time_us : 0;
+
+    sysmon_sample_t sample = { .time_us = now };
+
+    for ( int i = 0 ; i < count ; i++ ) {
+
+        TaskStatus_t* st = &sm->status[i];
+        sysmon_task_t* t = &tasks[i];
+
+        strlcpy( t->name, st->pcTaskName, sizeof(t->name) );
+        t->number = st->xTaskNumber;
+        t->core = st->xCoreID == tskNO_AFFINITY ? -1 : st->xCoreID;
+        t->prio = st->uxCurrentPriority;
+        t->state = st->eCurrentState;
+        t->runtime = st->ulRunTimeCounter;
+        t->stack_free = st->usStackHighWaterMark;
+
+        const sysmon_task_t* prev = _find_task( sm->tasks, sm->num_tasks, t->number );
+        t->load_permille = prev && period_us ? (uint64_t) ( t->runtime - prev->runtime ) * 1000 / period_us : 0;
+
+        for ( int core = 0 ; core < portNUM_PROCESSORS ; core++ ) {
+            if ( st->xHandle == xTaskGetIdleTaskHandleForCPU( core ) )
+                sample.idle[core] = t->runtime;
+        }
+    }
+
+    xSemaphoreTake( sm->lock, portMAX_DELAY );
+    memcpy( sm->tasks, tasks, count * sizeof(sysmon_task_t) );
+    sm->num_tasks = count;
+    sm->history[sm->head] = sample;
+    sm->head = ( sm->head + 1 ) % ( SYSMON_HISTORY + 1 );
+    if ( sm->samples < SYSMON_HISTORY + 1 )
+        sm->samples++;
+    xSemaphoreGive( sm->lock );
+
+    return true;
+}
+
+static void _sysmon_task( void* arg )
+{
+    struct sysmon* sm = (struct sysmon*) arg;
+    TickType_t wake = xTaskGetTickCount();
+
+    while ( 1 ) {
+        if ( !_sample( sm ) )
+            ESP_LOGW(TAG, "More than %d tasks, nothing sampled", SYSMON_MAX_TASKS);
+        vTaskDelayUntil( &wake, pdMS_TO_TICKS( sm->period_ms ) );
+    }
+}
+
+// Load over the last "periods" samples, in tenths of a percent. Called with
+// the lock held
+
+static int _core_load( struct sysmon* sm, int core, int periods )
+{
+    if ( periods >= sm->samples )
+        periods = sm->samples - 1;
+    if ( periods <= 0 )
+        return 0;
+
+    const sysmon_sample_t* now = &sm->history[( sm->head + SYSMON_HISTORY ) % ( SYSMON_HISTORY + 1 )];
+    const sysmon_sample_t* then = &sm->history[( sm->head + SYSMON_HISTORY - periods ) % ( SYSMON_HISTORY + 1 )];
+
+    uint32_t elapsed = now->time_us - then->time_us;
+    uint32_t idle = now->idle[core] - then->idle[core];
+
+    return elapsed && idle < elapsed ? (uint64_t) ( elapsed - idle ) * 1000 / elapsed : 0;
+}
+
+static char _state( eTaskState state )
+{
+    switch ( state ) {
+    case eRunning:		return 'X';
+    case eReady:		return 'R';
+    case eBlocked:		return 'B';
+    case eSuspended:	return 'S';
+    case eDeleted:		return 'D';
+    default:			return '?';
+    }
+}
+
+static esp_err_t _stats_handler(httpd_req_t *req)
+{
+    struct sysmon* sm = (struct sysmon*) req->user_ctx;
+
+    static const int windows[] = { 1, 10, SYSMON_HISTORY };
+    int load[portNUM_PROCESSORS][3];
+    char buf[192];
+
+    // The task table is copied out so the lock is not held across sends
+
+    sysmon_task_t* tasks = sm->snapshot;
+
+    xSemaphoreTake( sm->lock, portMAX_DELAY );
+    int num_tasks = sm->num_tasks;
+    memcpy( tasks, sm->tasks, num_tasks * sizeof(sysmon_task_t) );
+    for ( int core = 0 ; core < portNUM_PROCESSORS ; core++ )
+        for ( int w = 0 ; w < 3 ; w++ )
+            load[core][w] = _core_load( sm, core, windows[w] );
+    xSemaphoreGive( sm->lock );
+
+    httpd_resp_set_type(req, "application/json");
+    httpd_resp_set_hdr(req, "Cache-Control", "no-cache");
+
+    // Fragmentation is how far the largest free block falls short of the
+    // total free, in tenths of a percent
+
+    size_t heap_free = heap_caps_get_free_size( MALLOC_CAP_8BIT );
+    size_t heap_largest = heap_caps_get_largest_free_block( MALLOC_CAP_8BIT );
+    int frag = heap_free ? 1000 - (uint64_t) heap_largest * 1000 / heap_free : 0;
+
+    snprintf( buf, sizeof(buf), "{\"uptime_ms\":%lld,\"period_ms\":%d,\"heap_free\":%u,\"heap_min\":%u,"
+            "\"heap_largest\":%u,\"heap_frag\":%d.%d,\"cores\":[",
+            esp_timer_get_time() / 1000, sm->period_ms, heap_free,
+            heap_caps_get_minimum_free_size( MALLOC_CAP_8BIT ), heap_largest, frag / 10, frag % 10 );
+    httpd_resp_sendstr_chunk(req, buf);
+
+    for ( int core = 0 ; core < portNUM_PROCESSORS ; core++ ) {
+        snprintf( buf, sizeof(buf), "%s{\"load\":[%d.%d,%d.%d,%d.%d]}", core ? "," : "",
+                load[core][0] / 10, load[core][0] % 10, load[core][1] / 10, load[core][1] % 10,
+                load[core][2] / 10, load[core][2] % 10 );
+        httpd_resp_sendstr_chunk(req, buf);
+    }
+
+    httpd_resp_sendstr_chunk(req, "],\"tasks\":[");
+
+    for ( int i = 0 ; i < num_tasks ; i++ ) {
+        sysmon_task_t* t = &tasks[i];
+        snprintf( buf, sizeof(buf), "%s{\"name\":\"%s\",\"core\":%d,\"prio\":%u,\"state\":\"%c\",\"load\":%u.%u,\"stack_free\":%u}",
+                i ? "," : "", t->name, t->core, (unsigned) t->prio, _state( t->state ),
+                t->load_permille / 10, t->load_permille % 10, t->stack_free );
+        httpd_resp_sendstr_chunk(req, buf);
+    }
+
+    httpd_resp_sendstr_chunk(req, "],\"pools\":[");
+
+    block_pool_handle_t pools[BLOCK_POOL_MAX_POOLS];
+    int num_pools = block_pool_list( pools, BLOCK_POOL_MAX_POOLS );
+
+    for ( int i = 0 ; i < num_pools ; i++ ) {
+        block_pool_stats_t ps;
+        block_pool_get_stats( pools[i], &ps );
+        snprintf( buf, sizeof(buf), "%s{\"name\":\"%s\",\"size\":%d,\"count\":%d,\"in_use\":%d,\"peak\":%d,\"fails\":%u}",
+                i ? "," : "", ps.name, ps.block_size, ps.count, ps.in_use, ps.peak, ps.fails );
+        httpd_resp_sendstr_chunk(req, buf);
+    }
+
+    httpd_resp_sendstr_chunk(req, "]}");
+    return httpd_resp_sendstr_chunk(req, NULL);
+}
+
+esp_err_t sysmon_start(int period_ms)
+{
+    if ( sysmon )
+        return ESP_ERR_INVALID_STATE;
+
+    struct sysmon* sm = audio_calloc( 1, sizeof(struct sysmon) );
+    AUDIO_MEM_CHECK(TAG, sm, {return ESP_ERR_NO_MEM;});
+
+    sm->period_ms = period_ms > 0 ? period_ms : SYSMON_PERIOD_MS;
+    sm->status = audio_malloc( SYSMON_MAX_TASKS * sizeof(TaskStatus_t) );
+    sm->lock = xSemaphoreCreateMutex();
+    AUDIO_MEM_CHECK(TAG, sm->status && sm->lock, {
+        if (sm->lock) vSemaphoreDelete(sm->lock);
+        audio_free(sm->status); audio_free(sm); return ESP_ERR_NO_MEM;});
+
+    httpd_uri_t stats = {
+        .uri       = "/stats",
+        .method    = HTTP_GET,
+        .handler   = _stats_handler,
+        .user_ctx  = sm
+    };
+
+    esp_err_t ret = webserver_register_uri_handler( &stats );
+    if ( ret != ESP_OK )
+        return ret;
+
+    // Not pinned: the sampler is light and should not perturb either core's
+    // audio tasks more than it has to
+
+    if ( xTaskCreate( _sysmon_task, "sysmon", SYSMON_TASK_STACK, sm, SYSMON_TASK_PRIO, NULL ) != pdPASS ) {
+        ESP_LOGE(TAG, "Failed to create sampler task");
+        return ESP_FAIL;
+    }
+
+    sysmon = sm;
+    ESP_LOGI(TAG, "Sampling %d tasks every %d ms", uxTaskGetNumberOfTasks(), sm->period_ms);
+    return ESP_OK;
+}
+
+#else
+
+esp_err_t sysmon_start(int period_ms)
+{
+    ESP_LOGW(TAG, "FreeRTOS trace facility, run time stats and core ids are not enabled in sdkconfig");
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+#endif
@@ -0,0 +1,55 @@
+/*
+ * sysmon.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: xenir
+ */
+
+#ifndef MAIN_SYSMON_H_
+#define MAIN_SYSMON_H_
+
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Samples the FreeRTOS run time counters and stack high water marks of every
+// task once a period and serves them from /stats on the port 80 server:
+//
+//   {"uptime_ms":..,"period_ms":1000,"heap_free":..,"heap_min":..,"heap_largest":..,"heap_frag":..,
+//    "cores":[{"load":[1s,10s,60s]},...],
+//    "tasks":[{"name":"sha","core":1,"prio":23,"state":"B","load":3.2,"stack_free":812},...],
+//    "pools":[{"name":"audio","size":4096,"count":2,"in_use":2,"peak":2,"fails":0},...]}
+//
+// Core loads are percentages over the last 1, 10 and SYSMON_HISTORY periods,
+// taken from the time the idle task of each core did not get. A task load is
+// its share of one core over the last period. stack_free is the high water
+// mark: the least stack, in bytes, the task has ever had left. heap_frag is
+// the percentage of free heap not in the largest free block, and heap_min
+// the lowest free heap since boot, which after a long run shows whether
+// anything is still allocating.
+//
+// Needs CONFIG_FREERTOS_USE_TRACE_FACILITY, CONFIG_FREERTOS_GENERATE_RUN_TIME_STATS
+// and CONFIG_FREERTOS_VTASKLIST_INCLUDE_COREID.
+
+#define SYSMON_PERIOD_MS		1000
+#define SYSMON_HISTORY			60
+#define SYSMON_MAX_TASKS		32
+#define SYSMON_TASK_STACK		(3 * 1024)
+#define SYSMON_TASK_PRIO		(2)
+
+/**
+ * @brief      Start the sampler task and register /stats
+ *
+ * @param      period_ms  Sampling period, SYSMON_PERIOD_MS if 0
+ *
+ * @return     ESP_ERR_NOT_SUPPORTED when the run time stats are not built in
+ */
+esp_err_t sysmon_start(int period_ms);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* MAIN_SYSMON_H_ */
@@ -0,0 +1,426 @@
+/*
+ * tee.c
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: xenir
+ */
+
+#include <string.h>
+#include <sys/param.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "esp_log.h"
+#include "audio_mem.h"
+#include "audio_element.h"
+#include "audio_error.h"
+
+#include "block_pool.h"
+#include "tee.h"
+
+static const char *TAG = "tee";
+
+#define POLL_MS		100		// How often a waiting output checks the tee is still running
+
+typedef struct {
+    volatile int	refs;
+    int				len;
+    char			data[];
+} tee_block_t;
+
+typedef struct tee tee_t;
+
+// Each counter is only written by one task: the queue side by the tee, the
+// read side by the output's own task
+
+typedef struct {
+    tee_t*					tee;
+    audio_element_handle_t	el;
+    QueueHandle_t			queue;
+    tee_block_t*			cur;			// Block being read, owned by the output task
+    int						offset;
+    uint32_t				dropped;
+    uint32_t				dropped_bytes;	// Wraps, read as a difference
+    int						peak;
+    uint64_t				bytes;
+    uint64_t				copies;
+} tee_output_t;
+
+struct tee {
+
+    int						block_len;
+    int						depth;
+    block_pool_handle_t		pool;
+    volatile bool			running;
+    volatile bool			pausing;		// Outputs stop waiting for blocks so they can take a pause
+
+    int						num_outputs;
+    tee_output_t			outputs[TEE_MAX_OUTPUTS];
+
+    int						num_taps;
+    tee_tap_t				taps[TEE_MAX_TAPS];
+    void*					tap_ctx[TEE_MAX_TAPS];
+
+    uint32_t				blocks;
+    uint32_t				pool_fails;
+};
+
+static void _release( tee_t* tee, tee_block_t* b )
+{
+    if ( __atomic_sub_fetch( &b->refs, 1, __ATOMIC_ACQ_REL ) == 0 )
+        block_pool_put( tee->pool, b );
+}
+
+static void _drain( tee_output_t* out )
+{
+    tee_block_t* b;
+    while ( xQueueReceive( out->queue, &b, 0 ) == pdTRUE )
+        _release( out->tee, b );
+}
+
+// Read callback of every output. Fills the whole request like a ringbuffer
+// read would, a block at a time
+
+static int _tee_read(audio_element_handle_t el, char *buf, int len, TickType_t ticks_to_wait, void *context)
+{
+    tee_output_t* out = (tee_output_t*) context;
+    TickType_t waited = 0;
+    int n = 0;
+
+    while ( n < len ) {
+
+        if ( !out->cur ) {
+
+            TickType_t wait = pdMS_TO_TICKS( POLL_MS );
+            if ( ticks_to_wait != portMAX_DELAY && ticks_to_wait - waited < wait )
+                wait = ticks_to_wait - waited;
+
+            if ( out->tee->pausing )
+                wait = 0;
+
+            if ( xQueueReceive( out->queue, &out->cur, wait ) != pdTRUE ) {
+                out->cur = NULL;
+                waited += wait;
+                if ( !out->tee->running )
+                    return n ? n : AEL_IO_ABORT;
+                if ( out->tee->pausing )
+                    return n ? n : AEL_IO_TIMEOUT;
+                if ( ticks_to_wait != portMAX_DELAY && waited >= ticks_to_wait )
+                    return n ? n : AEL_IO_TIMEOUT;
+                continue;
+            }
+            out->offset = 0;
+        }
+
+        int chunk = MIN( len - n, out->cur->len - out->offset );
+        memcpy( buf + n, out->cur->data + out->offset, chunk );
+        out->copies++;
+        out->offset += chunk;
+        n += chunk;
+
+        if ( out->offset >= out->cur->len ) {
+            _release( out->tee, out->cur );
+            out->cur = NULL;
+        }
+    }
+
+    out->bytes += n;
+    return n;
+}
+
+// Queues a reference for the output, making room by dropping its oldest
+// block if the output has fallen behind
+
+static void _queue( tee_output_t* out, tee_block_t* b )
+{
+    __atomic_add_fetch( &b->refs, 1, __ATOMIC_RELAXED );
+
+    while ( xQueueSend( out->queue, &b, 0 ) != pdTRUE ) {
+        tee_block_t* old;
+        if ( xQueueReceive( out->queue, &old, 0 ) == pdTRUE ) {
+            out->dropped_bytes += old->len;
+            _release( out->tee, old );
+            out->dropped++;
+        }
+    }
+
+    int queued = uxQueueMessagesWaiting( out->queue );
+    if ( queued > out->peak )
+        out->peak = queued;
+}
+
+static int _tee_process(audio_element_handle_t self, char *in_buffer, int in_len)
+{
+    tee_t *tee = (tee_t *)audio_element_getdata(self);
+
+    // The upstream ringbuffer is read straight into the shared block, which
+    // is the only copy the tee makes
+
+    tee_block_t* b = block_pool_get( tee->pool );
+    if ( !b ) {
+        tee->pool_fails++;
+        return audio_element_input(self, in_buffer, in_len);
+    }
+
+    int r_size = audio_element_input(self, b->data, MIN( in_len, tee->block_len ));
+    if (r_size <= 0) {
+        block_pool_put( tee->pool, b );
+        return r_size;
+    }
+
+    b->len = r_size;
+    b->refs = 1;
+    tee->blocks++;
+
+    for ( int i = 0 ; i < tee->num_taps ; i++ )
+        tee->taps[i]( b->data, r_size, tee->tap_ctx[i] );
+
+    for ( int i = 0 ; i < tee->num_outputs ; i++ )
+        _queue( &tee->outputs[i], b );
+
+    _release( tee, b );
+
+    audio_element_update_byte_pos(self, r_size);
+    return r_size;
+}
+
+// Outputs start and stop with the tee. A pause leaves them waiting on
+// their queues
+
+static esp_err_t _tee_open(audio_element_handle_t self)
+{
+    tee_t *tee = (tee_t *)audio_element_getdata(self);
+
+    tee->running = true;
+
+    for ( int i = 0 ; i < tee->num_outputs ; i++ ) {
+        audio_element_handle_t el = tee->outputs[i].el;
+        if ( audio_element_get_state(el) != AEL_STATE_RUNNING ) {
+            audio_element_run(el);
+            audio_element_resume(el, 0, 0);
+        }
+    }
+
+    ESP_LOGD(TAG, "_tee_open");
+    return ESP_OK;
+}
+
+static esp_err_t _tee_close(audio_element_handle_t self)
+{
+    tee_t *tee = (tee_t *)audio_element_getdata(self);
+
+    ESP_LOGD(TAG, "_tee_close");
+    if (AEL_STATE_PAUSED == audio_element_get_state(self))
+        return ESP_OK;
+
+    audio_element_set_byte_pos(self, 0);
+    audio_element_set_total_bytes(self, 0);
+
+    // Outputs waiting for a block see the flag within POLL_MS and abort
+
+    tee->running = false;
+    for ( int i = 0 ; i < tee->num_outputs ; i++ ) {
+        audio_element_stop(tee->outputs[i].el);
+        audio_element_wait_for_stop(tee->outputs[i].el);
+    }
+    tee_flush(self);
+
+    return ESP_OK;
+}
+
+static esp_err_t _tee_destroy(audio_element_handle_t self)
+{
+    tee_t *tee = (tee_t *)audio_element_getdata(self);
+
+    // The pool is never freed, like every other block pool
+
+    for ( int i = 0 ; i < tee->num_outputs ; i++ ) {
+        _drain( &tee->outputs[i] );
+        vQueueDelete( tee->outputs[i].queue );
+    }
+    audio_free(tee);
+    return ESP_OK;
+}
+
+esp_err_t tee_add_output(audio_element_handle_t self, audio_element_handle_t el)
+{
+    tee_t *tee = (tee_t *)audio_element_getdata(self);
+
+    if ( tee->num_outputs >= TEE_MAX_OUTPUTS ) {
+        ESP_LOGE(TAG, "No free output slots");
+        return ESP_ERR_NO_MEM;
+    }
+
+    tee_output_t* out = &tee->outputs[tee->num_outputs];
+    out->queue = xQueueCreate( tee->depth, sizeof(tee_block_t*) );
+    AUDIO_MEM_CHECK(TAG, out->queue, {return ESP_ERR_NO_MEM;});
+
+    out->tee = tee;
+    out->el = el;
+    audio_element_set_read_cb(el, _tee_read, out);
+    tee->num_outputs++;
+
+    return ESP_OK;
+}
+
+esp_err_t tee_add_tap(audio_element_handle_t self, tee_tap_t tap, void *ctx)
+{
+    tee_t *tee = (tee_t *)audio_element_getdata(self);
+
+    if ( tee->num_taps >= TEE_MAX_TAPS ) {
+        ESP_LOGE(TAG, "No free tap slots");
+        return ESP_ERR_NO_MEM;
+    }
+
+    tee->taps[tee->num_taps] = tap;
+    tee->tap_ctx[tee->num_taps] = ctx;
+    tee->num_taps++;
+
+    return ESP_OK;
+}
+
+esp_err_t tee_flush(audio_element_handle_t self)
+{
+    tee_t *tee = (tee_t *)audio_element_getdata(self);
+
+    for ( int i = 0 ; i < tee->num_outputs ; i++ )
+        _drain( &tee->outputs[i] );
+
+    return ESP_OK;
+}
+
+// An output blocked in its read callback only sees the pause command once
+// the read returns, so the reads stop waiting while the tee is pausing.
+// Each output is paused before its blocks are taken from it, the one it was
+// reading included, as its task no longer touches them
+
+esp_err_t tee_pause(audio_element_handle_t self)
+{
+    tee_t *tee = (tee_t *)audio_element_getdata(self);
+    esp_err_t ret = ESP_OK;
+
+    tee->pausing = true;
+
+    for ( int i = 0 ; i < tee->num_outputs ; i++ ) {
+        tee_output_t* out = &tee->outputs[i];
+
+        if ( audio_element_pause(out->el) != ESP_OK ) {
+            ESP_LOGE(TAG, "Output %d did not pause", i);
+            ret = ESP_FAIL;
+            continue;
+        }
+
+        _drain( out );
+        if ( out->cur ) {
+            _release( tee, out->cur );
+            out->cur = NULL;
+        }
+    }
+
+    return ret;
+}
+
+esp_err_t tee_resume(audio_element_handle_t self)
+{
+    tee_t *tee = (tee_t *)audio_element_getdata(self);
+
+    tee->pausing = false;
+
+    for ( int i = 0 ; i < tee->num_outputs ; i++ ) {
+        if ( audio_element_get_state(tee->outputs[i].el) == AEL_STATE_PAUSED )
+            audio_element_resume(tee->outputs[i].el, 0, 0);
+    }
+
+    return ESP_OK;
+}
+
+int tee_output_backlog(audio_element_handle_t self, audio_element_handle_t el)
+{
+    tee_t *tee = (tee_t *)audio_element_getdata(self);
+
+    // Queued blocks are counted as full, only the last read of a run can be
+    // short
+
+    for ( int i = 0 ; i < tee->num_outputs ; i++ ) {
+        tee_output_t* out = &tee->outputs[i];
+        if ( out->el == el )
+            return uxQueueMessagesWaiting( out->queue ) * tee->block_len + ( out->cur ? out->cur->len - out->offset : 0 );
+    }
+
+    return -1;
+}
+
+uint32_t tee_output_dropped(audio_element_handle_t self, audio_element_handle_t el)
+{
+    tee_t *tee = (tee_t *)audio_element_getdata(self);
+
+    for ( int i = 0 ; i < tee->num_outputs ; i++ ) {
+        if ( tee->outputs[i].el == el )
+            return tee->outputs[i].dropped_bytes;
+    }
+
+    return 0;
+}
+
+esp_err_t tee_get_stats(audio_element_handle_t self, tee_stats_t *stats)
+{
+    tee_t *tee = (tee_t *)audio_element_getdata(self);
+
+    memset( stats, 0, sizeof(tee_stats_t) );
+    stats->blocks = tee->blocks;
+    stats->copies = tee->blocks;
+    stats->pool_fails = tee->pool_fails;
+    stats->outputs = tee->num_outputs;
+    stats->taps = tee->num_taps;
+    stats->pool_bytes = block_pool_block_size( tee->pool ) * ( tee->depth + TEE_MAX_OUTPUTS + 1 );
+    stats->output_bytes = sizeof(tee_output_t) + tee->depth * sizeof(tee_block_t*);
+
+    for ( int i = 0 ; i < tee->num_outputs ; i++ ) {
+        tee_output_t* out = &tee->outputs[i];
+        stats->copies += out->copies;
+        stats->output[i].dropped = out->dropped;
+        stats->output[i].queued = uxQueueMessagesWaiting( out->queue );
+        stats->output[i].peak = out->peak;
+        stats->output[i].bytes = out->bytes;
+    }
+
+    return ESP_OK;
+}
+
+audio_element_handle_t tee_init(tee_cfg_t *config)
+{
+    if (config->block_len <= 0 || config->depth <= 0)
+        return NULL;
+
+    tee_t *tee = audio_calloc(1, sizeof(tee_t));
+    AUDIO_MEM_CHECK(TAG, tee, {return NULL;});
+
+    audio_element_cfg_t cfg = DEFAULT_AUDIO_ELEMENT_CONFIG();
+    cfg.destroy = _tee_destroy;
+    cfg.process = _tee_process;
+    cfg.open = _tee_open;
+    cfg.close = _tee_close;
+    cfg.buffer_len = config->block_len;
+    cfg.task_stack = config->task_stack ? config->task_stack : TEE_TASK_STACK;
+    cfg.stack_in_ext = config->stack_in_ext;
+    cfg.task_prio = config->task_prio;
+    cfg.task_core = config->task_core;
+    cfg.tag = "tee";
+
+    tee->block_len = config->block_len;
+    tee->depth = config->depth;
+
+    // The slowest output holds at most "depth" blocks and the others hold
+    // newer ones from the same run, on top of that each output can be part
+    // way through one block and the tee is filling one
+
+    tee->pool = block_pool_create("tee", sizeof(tee_block_t) + tee->block_len, tee->depth + TEE_MAX_OUTPUTS + 1);
+    AUDIO_MEM_CHECK(TAG, tee->pool, {audio_free(tee); return NULL;});
+
+    audio_element_handle_t el = audio_element_init(&cfg);
+    AUDIO_MEM_CHECK(TAG, el, {audio_free(tee); return NULL;});
+    audio_element_setdata(el, tee);
+
+    return el;
+}
@@ -0,0 +1,147 @@
+/*
+ * tee.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: xenir
+ */
+
+#ifndef MAIN_TEE_H_
+#define MAIN_TEE_H_
+
+#include <stdint.h>
+
+#include "esp_err.h"
+#include "audio_element.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Pipeline element that feeds several consumers from one copy of each
+// block. An ADF link has one reader per ringbuffer, so a second consumer
+// would need its own ringbuffer and a copy of every block into it. The tee
+// is the last linked element instead: it reads each block once into a
+// reference counted block from its pool and queues a reference to it for
+// every output. Outputs are ADF elements whose input is a read callback
+// that copies out of the queued blocks, taps are called in the tee task
+// with a pointer into the block. The block goes back to the pool when the
+// last output has read it.
+//
+// An output whose queue is full loses its oldest block, so a stalled
+// consumer never holds up the capture or the other outputs. Every queue
+// holds a run of the most recent blocks, so the pool only needs one queue
+// worth plus the block each output is reading and the one being filled.
+//
+// The tee runs its outputs when it starts and stops them when it stops;
+// they are not registered with the pipeline, so a pipeline pause does not
+// pause them: tee_pause does.
+
+#define TEE_MAX_OUTPUTS		2
+#define TEE_MAX_TAPS		2
+
+typedef void (*tee_tap_t)(const char *buf, int len, void *ctx);
+
+typedef struct {
+    int                     task_stack;     /*!< Task stack size */
+    int                     task_core;      /*!< Task running in core (0 or 1) */
+    int                     task_prio;      /*!< Task priority (based on freeRTOS priority) */
+    bool                    stack_in_ext;   /*!< Try to allocate stack in external memory */
+
+    int                     block_len;      /*!< Bytes read from upstream per block */
+    int                     depth;          /*!< Blocks queued per output before the oldest is dropped */
+} tee_cfg_t;
+
+typedef struct {
+    uint32_t                dropped;        /*!< Blocks lost because the queue was full */
+    int                     queued;
+    int                     peak;
+    uint64_t                bytes;
+} tee_output_stats_t;
+
+typedef struct {
+    uint32_t                blocks;
+    uint64_t                copies;         /*!< Block copies: one in per block plus the reads out */
+    uint32_t                pool_fails;     /*!< Blocks read with no free pool block, lost to every output */
+    int                     outputs;
+    int                     taps;
+    int                     pool_bytes;     /*!< Shared by all outputs */
+    int                     output_bytes;   /*!< Queue of references, per output */
+    tee_output_stats_t      output[TEE_MAX_OUTPUTS];
+} tee_stats_t;
+
+#define TEE_TASK_STACK          (3 * 1024)
+#define TEE_TASK_CORE           (1)
+#define TEE_TASK_PRIO           (22)
+#define TEE_BLOCK_LEN           (1024)
+#define TEE_DEPTH               (8)
+
+#define DEFAULT_TEE_CONFIG() {\
+    .task_stack         = TEE_TASK_STACK,\
+    .task_core          = TEE_TASK_CORE,\
+    .task_prio          = TEE_TASK_PRIO,\
+    .stack_in_ext       = true,\
+    .block_len          = TEE_BLOCK_LEN,\
+    .depth              = TEE_DEPTH,\
+}
+
+audio_element_handle_t tee_init(tee_cfg_t *config);
+
+/**
+ * @brief      Feed "el" from the tee. Its read callback is replaced, so it
+ *             must not be linked. Call before the pipeline runs
+ *
+ * @return     ESP_OK, or ESP_ERR_NO_MEM when all TEE_MAX_OUTPUTS are used
+ */
+esp_err_t tee_add_output(audio_element_handle_t self, audio_element_handle_t el);
+
+/**
+ * @brief      Attach a tap, called in the tee task with every block in the
+ *             upstream format. Call before the pipeline runs
+ */
+esp_err_t tee_add_tap(audio_element_handle_t self, tee_tap_t tap, void *ctx);
+
+/**
+ * @brief      Throw away the blocks queued for every output. A block an
+ *             output has started reading is finished; tee_pause drops that
+ *             too
+ */
+esp_err_t tee_flush(audio_element_handle_t self);
+
+/**
+ * @brief      Pause every output and throw away all its blocks, the one it
+ *             was part way through included, for a format change with the
+ *             pipeline paused. Once it returns no output holds a block in
+ *             the old format
+ *
+ * @return     ESP_OK, or ESP_FAIL if an output did not pause; call tee_resume
+ *             either way
+ */
+esp_err_t tee_pause(audio_element_handle_t self);
+
+/**
+ * @brief      Resume the outputs after tee_pause
+ */
+esp_err_t tee_resume(audio_element_handle_t self);
+
+/**
+ * @brief      Bytes queued for output "el", including what is left of the
+ *             block it is reading. Only exact from the output's own task,
+ *             which is where the output asks how far behind it is
+ *
+ * @return     The bytes queued, or -1 if "el" is not an output of the tee
+ */
+int tee_output_backlog(audio_element_handle_t self, audio_element_handle_t el);
+
+/**
+ * @brief      Bytes output "el" has lost to a full queue so far. The count
+ *             wraps, so take the difference between two readings
+ */
+uint32_t tee_output_dropped(audio_element_handle_t self, audio_element_handle_t el);
+
+esp_err_t tee_get_stats(audio_element_handle_t self, tee_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* MAIN_TEE_H_ */
@@ -0,0 +1,259 @@
+/*
+ * tone_tap.c
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: xenir
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "esp_log.h"
+#include "audio_mem.h"
+#include "audio_error.h"
+
+#include "cycle_count.h"
+#include "event_stream.h"
+#include "tone_tap.h"
+
+static const char *TAG = "tone_tap";
+
+// Changes go out as one line of JSON per block that has any, each with its
+// time in ms on the stream's sample clock, counted from when the tap was
+// created and carried across rate and parameter changes. The first event a
+// subscriber gets describes the bank:
+//   {"rate":16000,"frame_ms":10,"on_db":-10,"off_db":-14,"min_dbfs":-50,"hz":[600,...]}
+// followed by
+//   {"seq":n,"changes":[{"hz":600,"on":1,"t":ms,"dbfs":-20},...]}
+// An event dropped behind a slow subscriber stays queued and goes with the
+// next block's, so changes arrive late rather than not at all.
+
+#define QUEUE_SIZE		16					// One change is at most 60 characters
+#define HELLO_SIZE		( 96 + GOERTZEL_MAX_TONES * 7 )
+
+typedef struct {
+    int			hz;
+    bool		on;
+    int8_t		dbfs;
+    uint64_t	ms;
+} tone_change_t;
+
+struct tone_tap {
+
+    goertzel_t				g;
+    goertzel_params_t		params;			// What g was started with
+
+    // Staged like iq_demod's, applied by the streamer task between blocks
+    SemaphoreHandle_t		lock;
+    goertzel_params_t		pending;
+    volatile bool			dirty;
+
+    uint64_t				base_us;		// Stream time at g's sample 0
+    uint64_t				idle;			// Samples since, with nobody subscribed
+
+    goertzel_event_t		found[QUEUE_SIZE];
+    tone_change_t			queue[QUEUE_SIZE];
+    int						queued;
+    uint32_t				lost;			// Before g was last restarted
+
+    event_stream_handle_t	es;				// NULL until registered with the web server
+    char					hello[HELLO_SIZE];
+    char					event[EVENT_STREAM_MAX_EVENT];
+    uint32_t				seq;
+    tone_tap_stats_t		stats;
+};
+
+static uint64_t _time_us( struct tone_tap* tap, uint64_t sample )
+{
+    return tap->base_us + sample * 1000000 / tap->g.sample_rate;
+}
+
+static void _queue( struct tone_tap* tap, int tone, bool on, int dbfs, uint64_t us )
+{
+    if ( tap->queued == QUEUE_SIZE ) {
+        tap->lost++;
+        return;
+    }
+
+    tone_change_t* c = &tap->queue[tap->queued++];
+    c->hz = tap->g.params.hz[tone];
+    c->on = on;
+    c->dbfs = dbfs;
+    c->ms = us / 1000;
+}
+
+// Starts the detector over, at the rate and parameters now in force,
+// keeping the clock running. Tones it had on are reported off there if
+// anybody has been listening throughout
+
+static void _restart( struct tone_tap* tap, int sample_rate, bool report )
+{
+    uint64_t now_us = _time_us( tap, tap->g.samples + tap->idle );
+
+    for ( int t = 0 ; report && t < tap->g.params.tones ; t++ )
+        if ( tap->g.on[t] )
+            _queue( tap, t, false, tap->g.level_dbfs[t] < -127 ? -127 : (int) tap->g.level_dbfs[t], now_us );
+
+    tap->lost += tap->g.lost;
+    tap->base_us = now_us;
+    tap->idle = 0;
+    goertzel_init( &tap->g, sample_rate, &tap->params );
+}
+
+static int _hello( struct tone_tap* tap )
+{
+    const goertzel_params_t* p = &tap->g.params;
+
+    int pos = snprintf( tap->hello, HELLO_SIZE, "{\"rate\":%d,\"frame_ms\":%d,\"on_db\":%d,\"off_db\":%d,\"min_dbfs\":%d,\"hz\":[",
+            tap->g.sample_rate, p->frame_ms, p->on_db, p->off_db, p->min_dbfs );
+    for ( int t = 0 ; t < p->tones ; t++ )
+        pos += snprintf( tap->hello + pos, HELLO_SIZE - pos, "%s%d", t ? "," : "", p->hz[t] );
+    pos += snprintf( tap->hello + pos, HELLO_SIZE - pos, "]}" );
+
+    return pos;
+}
+
+static void _publish( struct tone_tap* tap )
+{
+    int pos = snprintf( tap->event, sizeof(tap->event), "{\"seq\":%u,\"changes\":[", tap->seq );
+
+    for ( int i = 0 ; i < tap->queued ; i++ ) {
+        const tone_change_t* c = &tap->queue[i];
+        pos += snprintf( tap->event + pos, sizeof(tap->event) - pos, "%s{\"hz\":%d,\"on\":%d,\"t\":%llu,\"dbfs\":%d}",
+                i ? "," : "", c->hz, c->on, (unsigned long long) c->ms, c->dbfs );
+    }
+    pos += snprintf( tap->event + pos, sizeof(tap->event) - pos, "]}" );
+
+    if ( !event_stream_publish( tap->es, tap->event, pos ) )
+        return;
+
+    tap->seq++;
+    tap->stats.events += tap->queued;
+    tap->queued = 0;
+}
+
+void tone_tap_write(const char *buf, int len, void *ctx)
+{
+    struct tone_tap* tap = (struct tone_tap*) ctx;
+    int count = len / 2;
+
+    // Nothing queued is of use to whoever subscribes next, and the
+    // detector starts afresh for them
+
+    if ( !tap->es || event_stream_subscribers( tap->es ) == 0 ) {
+        tap->idle += count;
+        tap->queued = 0;
+        tap->stats.skipped++;
+        return;
+    }
+
+    if ( tap->dirty ) {
+        xSemaphoreTake( tap->lock, portMAX_DELAY );
+        tap->params = tap->pending;
+        tap->dirty = false;
+        xSemaphoreGive( tap->lock );
+
+        _restart( tap, tap->g.sample_rate, tap->idle == 0 );
+        event_stream_publish( tap->es, tap->hello, _hello( tap ) );
+    }
+    else if ( tap->idle )
+        _restart( tap, tap->g.sample_rate, false );
+
+    uint32_t start = cycle_count_get();
+    int n = goertzel_process( &tap->g, (const int16_t*) buf, count, tap->found, QUEUE_SIZE );
+    tap->stats.cycles += cycle_count_get() - start;
+    tap->stats.blocks++;
+    tap->stats.samples += count;
+
+    for ( int i = 0 ; i < n ; i++ )
+        _queue( tap, tap->found[i].tone, tap->found[i].on, tap->found[i].dbfs, _time_us( tap, tap->found[i].sample ) );
+
+    if ( tap->queued )
+        _publish( tap );
+}
+
+esp_err_t tone_tap_set_params(tone_tap_handle_t tap, const goertzel_params_t *params)
+{
+    if ( params->tones < 1 || params->tones > GOERTZEL_MAX_TONES ||
+            params->frame_ms < GOERTZEL_MIN_FRAME_MS || params->frame_ms > GOERTZEL_MAX_FRAME_MS ||
+            params->on_db > 0 || params->off_db > params->on_db || params->min_dbfs > 0 )
+        return ESP_ERR_INVALID_ARG;
+
+    for ( int t = 0 ; t < params->tones ; t++ )
+        if ( params->hz[t] <= 0 || params->hz[t] >= 24000 )
+            return ESP_ERR_INVALID_ARG;
+
+    xSemaphoreTake( tap->lock, portMAX_DELAY );
+    tap->pending = *params;
+    tap->dirty = true;
+    xSemaphoreGive( tap->lock );
+
+    return ESP_OK;
+}
+
+void tone_tap_get_params(tone_tap_handle_t tap, goertzel_params_t *params)
+{
+    xSemaphoreTake( tap->lock, portMAX_DELAY );
+    *params = tap->pending;
+    xSemaphoreGive( tap->lock );
+}
+
+void tone_tap_get_stats(tone_tap_handle_t tap, tone_tap_stats_t *stats)
+{
+    *stats = tap->stats;
+    stats->lost = tap->lost + tap->g.lost;
+    stats->dropped = tap->es ? event_stream_dropped( tap->es ) : 0;
+    for ( int t = 0 ; t < GOERTZEL_MAX_TONES ; t++ ) {
+        stats->on[t] = tap->g.on[t];
+        stats->dbfs[t] = tap->g.level_dbfs[t] < -127 ? -127 : (int) tap->g.level_dbfs[t];
+    }
+}
+
+// Subscribers already listening get the new description as an ordinary event
+
+void tone_tap_set_rate(tone_tap_handle_t tap, int sample_rate)
+{
+    _restart( tap, sample_rate, tap->idle == 0 );
+    int len = _hello( tap );
+    if ( tap->es )
+        event_stream_publish( tap->es, tap->hello, len );
+}
+
+tone_tap_handle_t tone_tap_init(int sample_rate, const goertzel_params_t *params)
+{
+    struct tone_tap* tap = audio_calloc( 1, sizeof(struct tone_tap) );
+    AUDIO_MEM_CHECK(TAG, tap, {return NULL;});
+
+    tap->lock = xSemaphoreCreateMutex();
+    AUDIO_MEM_CHECK(TAG, tap->lock, {audio_free(tap); return NULL;});
+
+    tap->params = tap->pending = *params;
+    goertzel_init( &tap->g, sample_rate, &tap->params );
+    _hello( tap );
+
+    ESP_LOGI(TAG, "Tone Config: Tones: %d First: %d Hz Frame: %d ms Sample Rate: %d",
+            params->tones, params->hz[0], params->frame_ms, sample_rate);
+    return tap;
+}
+
+esp_err_t tone_tap_register(tone_tap_handle_t tap)
+{
+    event_stream_handle_t es = event_stream_create( "/tones", tap->hello );
+    if ( !es )
+        return ESP_FAIL;
+
+    tap->es = es;
+    return ESP_OK;
+}
+
+void tone_tap_destroy(tone_tap_handle_t tap)
+{
+    if ( !tap )
+        return;
+
+    event_stream_destroy( tap->es );
+    vSemaphoreDelete( tap->lock );
+    audio_free( tap );
+}
@@ -0,0 +1,85 @@
+/*
+ * tone_tap.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: xenir
+ */
+
+#ifndef MAIN_TONE_TAP_H_
+#define MAIN_TONE_TAP_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "esp_err.h"
+#include "goertzel.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct tone_tap *tone_tap_handle_t;
+
+/**
+ * @brief      Detector cost and what it has reported so far
+ */
+typedef struct {
+    uint32_t                blocks;
+    uint64_t                samples;
+    uint64_t                cycles;
+    uint32_t                skipped;        /*!< Blocks seen with nobody subscribed */
+    uint32_t                events;         /*!< On and off changes published */
+    uint32_t                lost;           /*!< Changes that found the queue full */
+    uint32_t                dropped;        /*!< Events dropped behind a slow subscriber, then retried */
+    bool                    on[GOERTZEL_MAX_TONES];
+    int8_t                  dbfs[GOERTZEL_MAX_TONES];   /*!< Each tone's level in the last frame */
+} tone_tap_stats_t;
+
+/**
+ * @brief      Create the tone detector tap. Attach with
+ *             streaming_http_audio_add_tap before the pipeline runs; until
+ *             tone_tap_register is called every block is skipped
+ */
+tone_tap_handle_t tone_tap_init(int sample_rate, const goertzel_params_t *params);
+
+/**
+ * @brief      Create the /tones event stream on the port 80 server, which
+ *             must be running. Can be called while the pipeline runs
+ */
+esp_err_t tone_tap_register(tone_tap_handle_t tap);
+
+/**
+ * @brief      streaming_http_audio tap: runs the detector bank over every
+ *             block while anybody is subscribed and publishes its on and
+ *             off changes
+ */
+void tone_tap_write(const char *buf, int len, void *ctx);
+
+/**
+ * @brief      Change the tones and thresholds. Safe to call from any task
+ *             while the pipeline runs; they are picked up at the next block,
+ *             with every tone that was on reported off
+ */
+esp_err_t tone_tap_set_params(tone_tap_handle_t tap, const goertzel_params_t *params);
+
+void tone_tap_get_params(tone_tap_handle_t tap, goertzel_params_t *params);
+
+/**
+ * @brief      Follow a sample rate change. Call while the element feeding the
+ *             tap is paused
+ */
+void tone_tap_set_rate(tone_tap_handle_t tap, int sample_rate);
+
+void tone_tap_get_stats(tone_tap_handle_t tap, tone_tap_stats_t *stats);
+
+/**
+ * @brief      Remove /tones and free the tap. The element feeding it must
+ *             have stopped
+ */
+void tone_tap_destroy(tone_tap_handle_t tap);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* MAIN_TONE_TAP_H_ */
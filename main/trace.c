@@ -0,0 +1,213 @@
+/*
+ * trace.c
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: xenir
+ */
+
+#include <stdio.h>
+#include <stdarg.h>
+#include <string.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_http_server.h"
+#include "audio_mem.h"
+
+#include "webserver.h"
+#include "trace.h"
+
+static const char *TAG = "trace";
+
+#if CONFIG_STREAMING_TRACE
+
+#define EVENTS		CONFIG_STREAMING_TRACE_EVENTS
+
+_Static_assert( ( EVENTS & ( EVENTS - 1 ) ) == 0, "CONFIG_STREAMING_TRACE_EVENTS must be a power of two" );
+
+typedef struct {
+    int64_t			ts;				// esp_timer microseconds
+    const char*		name;
+    TaskHandle_t	task;
+    int32_t			arg;
+    char			phase;
+} trace_event_t;
+
+// A writer preempted between claiming a slot and filling it leaves that
+// one event stale, which only matters if a dump is taken at that moment.
+// Tasks that are not pinned can land on either ring, the claim is atomic
+// either way.
+
+typedef struct {
+    uint32_t		head;			// Total events claimed, the slot is head % EVENTS
+    trace_event_t	events[EVENTS];
+} trace_ring_t;
+
+static trace_ring_t rings[portNUM_PROCESSORS];
+static volatile bool paused;
+
+void trace_record(const char *name, char phase, int32_t arg)
+{
+    if ( paused )
+        return;
+
+    trace_ring_t* ring = &rings[xPortGetCoreID()];
+    uint32_t slot = __atomic_fetch_add( &ring->head, 1, __ATOMIC_RELAXED ) & ( EVENTS - 1 );
+    trace_event_t* e = &ring->events[slot];
+
+    e->ts = esp_timer_get_time();
+    e->name = name;
+    e->task = xTaskGetCurrentTaskHandle();
+    e->arg = arg;
+    e->phase = phase;
+}
+
+// The export is built in a small buffer sent as one chunk whenever it
+// fills, so a full dump needs no large allocation
+
+typedef struct {
+    httpd_req_t*	req;
+    char			buf[1024];
+    int				len;
+    bool			first;
+    esp_err_t		ret;
+} trace_out_t;
+
+static void _out( trace_out_t* out, const char* fmt, ... ) __attribute__((format(printf, 2, 3)));
+
+static void _out( trace_out_t* out, const char* fmt, ... )
+{
+    if ( out->ret != ESP_OK )
+        return;
+
+    if ( out->len > (int) sizeof(out->buf) - 192 ) {
+        out->ret = httpd_resp_send_chunk( out->req, out->buf, out->len );
+        out->len = 0;
+    }
+
+    va_list ap;
+    va_start( ap, fmt );
+    int n = vsnprintf( out->buf + out->len, sizeof(out->buf) - out->len, fmt, ap );
+    va_end( ap );
+
+    if ( n > 0 )
+        out->len += n < (int) sizeof(out->buf) - out->len ? n : (int) sizeof(out->buf) - out->len - 1;
+}
+
+static void _event( trace_out_t* out, const trace_event_t* e, int core )
+{
+    _out( out, "%s{\"name\":\"%s\",\"ph\":\"%c\",\"ts\":%lld,\"pid\":%d,\"tid\":%u",
+            out->first ? "" : ",\n", e->name, e->phase, (long long) e->ts, core,
+            (unsigned) (uintptr_t) e->task );
+    out->first = false;
+
+    if ( e->phase == 'i' )
+        _out( out, ",\"s\":\"t\",\"args\":{\"v\":%d}}", (int) e->arg );
+    else
+        _out( out, "}" );
+}
+
+// Thread names for the tasks that are still alive, the rest show as numbers
+
+static void _task_names( trace_out_t* out )
+{
+#if CONFIG_FREERTOS_USE_TRACE_FACILITY
+    TaskStatus_t* status = audio_malloc( TRACE_MAX_TASKS * sizeof(TaskStatus_t) );
+    if ( !status )
+        return;
+
+    int count = uxTaskGetSystemState( status, TRACE_MAX_TASKS, NULL );
+    for ( int core = 0 ; core < portNUM_PROCESSORS ; core++ ) {
+        for ( int i = 0 ; i < count ; i++ ) {
+            _out( out, ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%d,\"tid\":%u,\"args\":{\"name\":\"%s\"}}",
+                    core, (unsigned) (uintptr_t) status[i].xHandle, status[i].pcTaskName );
+        }
+    }
+
+    audio_free( status );
+#endif
+}
+
+static esp_err_t _trace_handler(httpd_req_t *req)
+{
+    trace_out_t* out = audio_malloc( sizeof(trace_out_t) );
+    if ( !out ) {
+        httpd_resp_send_err( req, HTTPD_500_INTERNAL_SERVER_ERROR, "No memory" );
+        return ESP_OK;
+    }
+
+    out->req = req;
+    out->len = 0;
+    out->first = true;
+    out->ret = ESP_OK;
+
+    httpd_resp_set_type( req, "application/json" );
+
+    // Recording stops for the dump so the rings hold still. Whatever the
+    // hot path does meanwhile is lost, which the dump itself would have
+    // disturbed anyway
+
+    paused = true;
+    int total = 0;
+
+    _out( out, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n" );
+
+    for ( int core = 0 ; core < portNUM_PROCESSORS ; core++ ) {
+
+        uint32_t head = rings[core].head;
+        uint32_t count = head < EVENTS ? head : EVENTS;
+
+        _out( out, "%s{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%d,\"args\":{\"name\":\"core %d\"}}",
+                out->first ? "" : ",\n", core, core );
+        out->first = false;
+
+        for ( uint32_t i = head - count ; i != head ; i++ ) {
+            const trace_event_t* e = &rings[core].events[i & ( EVENTS - 1 )];
+            if ( e->name ) {
+                _event( out, e, core );
+                total++;
+            }
+        }
+    }
+
+    paused = false;
+
+    _task_names( out );
+    _out( out, "\n]}\n" );
+
+    if ( out->ret == ESP_OK && out->len > 0 )
+        out->ret = httpd_resp_send_chunk( req, out->buf, out->len );
+    if ( out->ret == ESP_OK )
+        out->ret = httpd_resp_send_chunk( req, NULL, 0 );
+
+    ESP_LOGI(TAG, "Dumped %d events", total);
+
+    esp_err_t ret = out->ret;
+    audio_free( out );
+    return ret;
+}
+
+esp_err_t trace_register(void)
+{
+    httpd_uri_t trace = {
+        .uri       = "/trace",
+        .method    = HTTP_GET,
+        .handler   = _trace_handler,
+        .user_ctx  = NULL
+    };
+
+    ESP_LOGI(TAG, "Tracing %d events per core", EVENTS);
+    return webserver_register_uri_handler( &trace );
+}
+
+#else
+
+esp_err_t trace_register(void)
+{
+    ESP_LOGW(TAG, "Tracing is not built in, enable CONFIG_STREAMING_TRACE");
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+#endif
@@ -0,0 +1,59 @@
+/*
+ * trace.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: xenir
+ */
+
+#ifndef MAIN_TRACE_H_
+#define MAIN_TRACE_H_
+
+#include <stdint.h>
+
+#include "esp_err.h"
+#include "sdkconfig.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Timestamped begin, end and instant events from the streaming hot path,
+// kept in one fixed ring per core and served from /trace as Chrome
+// trace_event JSON (load it in chrome://tracing or Perfetto). Recording
+// claims a slot with one atomic add, so it never blocks and can be called
+// from any task; the oldest events are overwritten. Built in with
+// CONFIG_STREAMING_TRACE, otherwise the macros compile to nothing.
+//
+// Event names must be string literals, only the pointer is recorded.
+
+#if CONFIG_STREAMING_TRACE
+
+#define TRACE_BEGIN(name)				trace_record( (name), 'B', 0 )
+#define TRACE_END(name)					trace_record( (name), 'E', 0 )
+#define TRACE_INSTANT(name, arg)		trace_record( (name), 'i', (arg) )
+
+void trace_record(const char *name, char phase, int32_t arg);
+
+#else
+
+#define TRACE_BEGIN(name)				do {} while (0)
+#define TRACE_END(name)					do {} while (0)
+#define TRACE_INSTANT(name, arg)		do { (void) (arg); } while (0)
+
+#endif
+
+#define TRACE_MAX_TASKS					32		// Named in the export
+
+/**
+ * @brief      Serve the rings from /trace on the port 80 server. Recording
+ *             is paused while a dump is written
+ *
+ * @return     ESP_ERR_NOT_SUPPORTED when tracing is not built in
+ */
+esp_err_t trace_register(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* MAIN_TRACE_H_ */
@@ -0,0 +1,86 @@
+/*
+ * vad.c
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: xenir
+ */
+
+#include <string.h>
+#include <math.h>
+
+#include "vad.h"
+
+#define NOISE_RISE_SHIFT	9		// Floor rises with a time constant of about 5 s
+#define NOISE_FALL_SHIFT	2
+
+void vad_init( vad_t* vad, int sample_rate, const vad_params_t* params )
+{
+    memset( vad, 0, sizeof(vad_t) );
+
+    vad->params = *params;
+    vad->frame_len = sample_rate / 100;
+
+    vad->voiced_q8 = 256 * powf( 10.0f, params->threshold_db / 10.0f );
+    vad->unvoiced_q8 = 256 * powf( 10.0f, params->unvoiced_db / 10.0f );
+    vad->zcr_min = vad->frame_len * params->zcr_percent / 100;
+
+    float level = 32768.0f * powf( 10.0f, params->min_level_dbfs / 20.0f );
+    vad->min_energy = level * level;
+
+    vad->hangover = params->hangover_ms / 10;
+    vad->noise = UINT32_MAX;
+}
+
+static bool _frame( vad_t* vad )
+{
+    uint32_t energy = vad->sum / vad->frame_len;
+
+    if ( vad->noise == UINT32_MAX )
+        vad->noise = energy;
+
+    uint64_t e = (uint64_t) energy << 8;
+    uint64_t n = vad->noise;
+
+    bool speech = energy >= vad->min_energy &&
+            ( e > n * vad->voiced_q8 ||
+            ( e > n * vad->unvoiced_q8 && vad->crossings >= vad->zcr_min ) );
+
+    if ( energy < vad->noise )
+        vad->noise -= ( vad->noise - energy ) >> NOISE_FALL_SHIFT;
+    else
+        vad->noise += ( ( energy - vad->noise ) >> NOISE_RISE_SHIFT ) + 1;
+
+    if ( speech )
+        vad->hang_count = vad->hangover + 1;
+
+    if ( vad->hang_count > 0 ) {
+        vad->hang_count--;
+        return true;
+    }
+
+    return false;
+}
+
+bool vad_process( vad_t* vad, const int16_t* samples, int count )
+{
+    bool active = false;
+    bool framed = false;
+
+    for ( int i = 0 ; i < count ; i++ ) {
+
+        int16_t s = samples[i];
+        vad->sum += (int32_t) s * s;
+        vad->crossings += ( s ^ vad->last ) < 0;
+        vad->last = s;
+
+        if ( ++vad->pos == vad->frame_len ) {
+            active |= _frame( vad );
+            framed = true;
+            vad->pos = 0;
+            vad->sum = 0;
+            vad->crossings = 0;
+        }
+    }
+
+    return framed ? active : vad->hang_count > 0;
+}
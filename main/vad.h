@@ -0,0 +1,70 @@
+/*
+ * vad.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: xenir
+ */
+
+#ifndef MAIN_VAD_H_
+#define MAIN_VAD_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Energy and zero-crossing voice activity detector for 16 bit mono PCM.
+// The input is analysed in 10 ms frames against a noise floor that drops
+// quickly and rises slowly. A frame is speech when its energy is well above
+// the floor, or moderately above it with a high crossing rate (unvoiced
+// consonants). Speech is extended by a hangover so word endings survive.
+
+typedef struct {
+    int		threshold_db;		// Energy above the noise floor for voiced speech
+    int		unvoiced_db;		// Lower margin accepted when the crossing rate is high
+    int		zcr_percent;		// Crossings per sample, in percent, counted as unvoiced
+    int		min_level_dbfs;		// Nothing quieter than this is speech
+    int		hangover_ms;
+} vad_params_t;
+
+#define DEFAULT_VAD_PARAMS() {\
+    .threshold_db       = 9,\
+    .unvoiced_db        = 4,\
+    .zcr_percent        = 30,\
+    .min_level_dbfs     = -60,\
+    .hangover_ms        = 300,\
+}
+
+typedef struct {
+
+    vad_params_t	params;
+    int				frame_len;
+
+    uint32_t		voiced_q8;		// Energy ratios in Q8
+    uint32_t		unvoiced_q8;
+    int				zcr_min;		// Crossings per frame
+    uint32_t		min_energy;
+    int				hangover;		// Frames
+
+    uint32_t		noise;			// Mean square noise floor
+    int				hang_count;
+    int				pos;			// Samples into the current frame
+    uint64_t		sum;
+    int				crossings;
+    int16_t			last;
+
+} vad_t;
+
+void vad_init( vad_t* vad, int sample_rate, const vad_params_t* params );
+
+// Returns true when any frame completed in the block was speech or still in
+// hangover. A partial frame at the end of the block carries over.
+bool vad_process( vad_t* vad, const int16_t* samples, int count );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* MAIN_VAD_H_ */
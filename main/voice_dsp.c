@@ -0,0 +1,255 @@
+/*
+ * voice_dsp.c
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: xenir
+ */
+
+#include <string.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "esp_log.h"
+#include "audio_mem.h"
+#include "audio_element.h"
+#include "audio_error.h"
+
+#include "cycle_count.h"
+#include "trace.h"
+#include "voice_dsp.h"
+
+static const char *TAG = "voice_dsp";
+
+typedef struct voice_dsp {
+
+    voice_proc_t		vp;
+    denoise_t			dn;
+    int					bits;
+
+    // Parameter changes are staged here and applied by the element task
+    // between blocks, so the processing loop itself takes no locks
+    SemaphoreHandle_t	lock;
+    voice_proc_params_t	pending;
+    volatile bool		dirty;
+    denoise_params_t	pending_denoise;
+    volatile bool		denoise_dirty;
+    int					pending_rate;
+    int					pending_bits;
+    int					pending_channels;
+    volatile bool		format_dirty;
+
+    voice_dsp_stats_t	stats;
+
+} voice_dsp_t;
+
+static esp_err_t _voice_dsp_destroy(audio_element_handle_t self)
+{
+    voice_dsp_t *dsp = (voice_dsp_t *)audio_element_getdata(self);
+    vSemaphoreDelete(dsp->lock);
+    audio_free(dsp);
+    return ESP_OK;
+}
+
+static esp_err_t _voice_dsp_open(audio_element_handle_t self)
+{
+    ESP_LOGD(TAG, "_voice_dsp_open");
+    return ESP_OK;
+}
+
+static esp_err_t _voice_dsp_close(audio_element_handle_t self)
+{
+    ESP_LOGD(TAG, "_voice_dsp_close");
+    if (AEL_STATE_PAUSED != audio_element_get_state(self)) {
+        audio_element_set_byte_pos(self, 0);
+        audio_element_set_total_bytes(self, 0);
+    }
+    return ESP_OK;
+}
+
+static int _voice_dsp_process(audio_element_handle_t self, char *in_buffer, int in_len)
+{
+    voice_dsp_t *dsp = (voice_dsp_t *)audio_element_getdata(self);
+
+    // The wait for the I2S reader's next block, the capture side of a stall
+    TRACE_BEGIN("i2s_read");
+    int r_size = audio_element_input(self, in_buffer, in_len);
+    TRACE_END("i2s_read");
+    if (r_size <= 0)
+        return r_size;
+
+    if (dsp->dirty) {
+        xSemaphoreTake(dsp->lock, portMAX_DELAY);
+        voice_proc_set_params(&dsp->vp, &dsp->pending);
+        dsp->dirty = false;
+        xSemaphoreGive(dsp->lock);
+    }
+
+    if (dsp->denoise_dirty) {
+        xSemaphoreTake(dsp->lock, portMAX_DELAY);
+        denoise_set_params(&dsp->dn, &dsp->pending_denoise);
+        dsp->denoise_dirty = false;
+        xSemaphoreGive(dsp->lock);
+    }
+
+    if (dsp->format_dirty) {
+        xSemaphoreTake(dsp->lock, portMAX_DELAY);
+        voice_proc_init(&dsp->vp, dsp->pending_rate, dsp->pending_channels, &dsp->pending);
+        denoise_init(&dsp->dn, dsp->pending_rate, dsp->pending_channels, &dsp->pending_denoise);
+        dsp->bits = dsp->pending_bits;
+        dsp->format_dirty = false;
+        xSemaphoreGive(dsp->lock);
+        ESP_LOGI(TAG, "Format now %d Hz %d bit %d channel", dsp->vp.sample_rate, dsp->bits, dsp->vp.channels);
+    }
+
+    // 32 bit slots carry the sample left justified, so the top half is the
+    // 16 bit sample. Narrowing in place halves the block
+
+    if (dsp->bits == 32) {
+        int32_t *wide = (int32_t *)in_buffer;
+        int16_t *narrow = (int16_t *)in_buffer;
+        r_size /= 2;
+        for (int i = 0; i < r_size / 2; i++)
+            narrow[i] = wide[i] >> 16;
+    }
+
+    int frames = r_size / (sizeof(int16_t) * dsp->vp.channels);
+
+    // Noise reduction first, so the AGC and the gate see the cleaned signal
+    // and the AGC does not bring the hiss back up
+
+    uint32_t start = cycle_count_get();
+    denoise_process(&dsp->dn, (int16_t *)in_buffer, frames);
+    uint32_t denoised = cycle_count_get();
+    voice_proc_process(&dsp->vp, (int16_t *)in_buffer, frames);
+    uint32_t cycles = cycle_count_get() - start;
+
+    dsp->stats.blocks++;
+    dsp->stats.frames += frames;
+    dsp->stats.cycles += cycles;
+    dsp->stats.denoise_cycles += denoised - start;
+    if (cycles > dsp->stats.max_block_cycles) {
+        dsp->stats.max_block_cycles = cycles;
+        dsp->stats.max_block_frames = frames;
+    }
+
+    int out_len = audio_element_output(self, in_buffer, r_size);
+    if (out_len > 0) {
+        audio_element_update_byte_pos(self, out_len);
+    }
+
+    return out_len;
+}
+
+esp_err_t voice_dsp_set_params(audio_element_handle_t self, const voice_proc_params_t *params)
+{
+    voice_dsp_t *dsp = (voice_dsp_t *)audio_element_getdata(self);
+
+    xSemaphoreTake(dsp->lock, portMAX_DELAY);
+    dsp->pending = *params;
+    dsp->dirty = true;
+    xSemaphoreGive(dsp->lock);
+
+    return ESP_OK;
+}
+
+esp_err_t voice_dsp_set_format(audio_element_handle_t self, int sample_rate, int bits, int channels)
+{
+    voice_dsp_t *dsp = (voice_dsp_t *)audio_element_getdata(self);
+
+    if ((bits != 16 && bits != 32) || channels < 1 || channels > 2)
+        return ESP_ERR_INVALID_ARG;
+
+    xSemaphoreTake(dsp->lock, portMAX_DELAY);
+    dsp->pending_rate = sample_rate;
+    dsp->pending_bits = bits;
+    dsp->pending_channels = channels;
+    dsp->format_dirty = true;
+    xSemaphoreGive(dsp->lock);
+
+    return ESP_OK;
+}
+
+esp_err_t voice_dsp_get_params(audio_element_handle_t self, voice_proc_params_t *params)
+{
+    voice_dsp_t *dsp = (voice_dsp_t *)audio_element_getdata(self);
+
+    xSemaphoreTake(dsp->lock, portMAX_DELAY);
+    *params = dsp->pending;
+    xSemaphoreGive(dsp->lock);
+
+    return ESP_OK;
+}
+
+esp_err_t voice_dsp_set_denoise(audio_element_handle_t self, const denoise_params_t *params)
+{
+    voice_dsp_t *dsp = (voice_dsp_t *)audio_element_getdata(self);
+
+    xSemaphoreTake(dsp->lock, portMAX_DELAY);
+    dsp->pending_denoise = *params;
+    dsp->denoise_dirty = true;
+    xSemaphoreGive(dsp->lock);
+
+    return ESP_OK;
+}
+
+esp_err_t voice_dsp_get_denoise(audio_element_handle_t self, denoise_params_t *params)
+{
+    voice_dsp_t *dsp = (voice_dsp_t *)audio_element_getdata(self);
+
+    xSemaphoreTake(dsp->lock, portMAX_DELAY);
+    *params = dsp->pending_denoise;
+    xSemaphoreGive(dsp->lock);
+
+    return ESP_OK;
+}
+
+esp_err_t voice_dsp_get_stats(audio_element_handle_t self, voice_dsp_stats_t *stats)
+{
+    voice_dsp_t *dsp = (voice_dsp_t *)audio_element_getdata(self);
+    *stats = dsp->stats;
+    stats->denoise_latency = dsp->dn.params.enable ? DENOISE_FFT_SIZE : 0;
+    stats->denoise_gain = dsp->dn.mean_gain;
+    return ESP_OK;
+}
+
+audio_element_handle_t voice_dsp_init(voice_dsp_cfg_t *config)
+{
+    voice_dsp_t *dsp = audio_calloc(1, sizeof(voice_dsp_t));
+    AUDIO_MEM_CHECK(TAG, dsp, {return NULL;});
+
+    audio_element_cfg_t cfg = DEFAULT_AUDIO_ELEMENT_CONFIG();
+    cfg.destroy = _voice_dsp_destroy;
+    cfg.process = _voice_dsp_process;
+    cfg.open = _voice_dsp_open;
+    cfg.close = _voice_dsp_close;
+    cfg.buffer_len = VOICE_DSP_BUFFER_LEN;
+    cfg.task_stack = config->task_stack ? config->task_stack : VOICE_DSP_TASK_STACK;
+    cfg.stack_in_ext = config->stack_in_ext;
+    cfg.task_prio = config->task_prio;
+    cfg.task_core = config->task_core;
+    cfg.out_rb_size = config->out_rb_size;
+    cfg.tag = "dsp";
+
+    dsp->lock = xSemaphoreCreateMutex();
+    AUDIO_MEM_CHECK(TAG, dsp->lock, {audio_free(dsp); return NULL;});
+
+    voice_proc_init(&dsp->vp, config->sample_rate, config->channels, &config->params);
+    dsp->bits = config->bits;
+    dsp->pending = config->params;
+    if (denoise_init(&dsp->dn, config->sample_rate, config->channels, &config->denoise) != 0)
+        ESP_LOGW(TAG, "Noise reduction unavailable");
+    dsp->pending_denoise = config->denoise;
+
+    ESP_LOGI(TAG, "Voice DSP Config: Sample Rate: %d Bits: %d Channels: %d NR: %d dB HPF: %d Hz AGC: %d dBFS Gate: %d dBFS",
+            config->sample_rate, config->bits, config->channels,
+            config->denoise.enable ? config->denoise.attenuation_db : 0,
+            config->params.hpf_enable ? config->params.hpf_cutoff_hz : 0,
+            config->params.agc_enable ? config->params.agc_target_dbfs : 0,
+            config->params.gate_enable ? config->params.gate_threshold_dbfs : 0);
+
+    audio_element_handle_t el = audio_element_init(&cfg);
+    AUDIO_MEM_CHECK(TAG, el, {vSemaphoreDelete(dsp->lock); audio_free(dsp); return NULL;});
+    audio_element_setdata(el, dsp);
+
+    return el;
+}
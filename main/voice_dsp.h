@@ -0,0 +1,116 @@
+/*
+ * voice_dsp.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: xenir
+ */
+
+#ifndef MAIN_VOICE_DSP_H_
+#define MAIN_VOICE_DSP_H_
+
+#include <stdint.h>
+
+#include "esp_err.h"
+#include "audio_element.h"
+#include "voice_proc.h"
+#include "denoise.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief      Voice DSP (noise reduction, high-pass, AGC, noise gate) configurations
+ */
+typedef struct {
+    int                     out_rb_size;    /*!< Size of output ringbuffer */
+    int                     task_stack;     /*!< Task stack size */
+    int                     task_core;      /*!< Task running in core (0 or 1) */
+    int                     task_prio;      /*!< Task priority (based on freeRTOS priority) */
+    bool                    stack_in_ext;   /*!< Try to allocate stack in external memory */
+
+    int                     sample_rate;
+    int                     bits;           /*!< Input sample size, 16 or 32 (output is always 16) */
+    int                     channels;       /*!< Interleaved channels, 1 or 2 */
+    voice_proc_params_t     params;         /*!< Initial processing parameters */
+    denoise_params_t        denoise;        /*!< Initial noise reduction parameters */
+} voice_dsp_cfg_t;
+
+/**
+ * @brief      Processing cost since the element was created
+ */
+typedef struct {
+    uint32_t                blocks;
+    uint64_t                frames;
+    uint64_t                cycles;
+    uint32_t                max_block_cycles;
+    uint32_t                max_block_frames;
+    uint64_t                denoise_cycles; /*!< Share of cycles spent in noise reduction */
+    int                     denoise_latency; /*!< Frames it delays the audio by, 0 when off */
+    float                   denoise_gain;   /*!< Mean gain over the bins of the last frame */
+} voice_dsp_stats_t;
+
+#define VOICE_DSP_TASK_STACK          (3 * 1024)
+#define VOICE_DSP_TASK_CORE           (1)
+#define VOICE_DSP_TASK_PRIO           (22)
+#define VOICE_DSP_RINGBUFFER_SIZE     (8 * 1024)
+#define VOICE_DSP_BUFFER_LEN          (1024)
+
+#define DEFAULT_VOICE_DSP_CONFIG() {\
+    .out_rb_size        = VOICE_DSP_RINGBUFFER_SIZE,\
+    .task_stack         = VOICE_DSP_TASK_STACK,\
+    .task_core          = VOICE_DSP_TASK_CORE,\
+    .task_prio          = VOICE_DSP_TASK_PRIO,\
+    .stack_in_ext       = true,\
+    .sample_rate        = 16000,\
+    .bits               = 16,\
+    .channels           = 2,\
+    .params             = DEFAULT_VOICE_PROC_PARAMS(),\
+    .denoise            = DEFAULT_DENOISE_PARAMS(),\
+}
+
+/**
+ * @brief      Create an Audio Element that runs a spectral noise reduction,
+ *             a DC blocking high-pass, an AGC and a noise gate over 16 bit
+ *             PCM in place. 32 bit input (24 bit microphones in 32 bit
+ *             slots) is narrowed to 16 bit first
+ *
+ * @param      config  The configuration
+ *
+ * @return     The audio element handle
+ */
+audio_element_handle_t voice_dsp_init(voice_dsp_cfg_t *config);
+
+/**
+ * @brief      Change the processing parameters. Safe to call from any task
+ *             while the pipeline runs; they are picked up at the next block
+ */
+esp_err_t voice_dsp_set_params(audio_element_handle_t self, const voice_proc_params_t *params);
+
+/**
+ * @brief      Change the input format. Like the parameters it is picked up
+ *             at the next block, so the caller must make sure no data in the
+ *             old format is still queued (pause the pipeline and reset the
+ *             ringbuffers around the change)
+ */
+esp_err_t voice_dsp_set_format(audio_element_handle_t self, int sample_rate, int bits, int channels);
+
+esp_err_t voice_dsp_get_params(audio_element_handle_t self, voice_proc_params_t *params);
+
+/**
+ * @brief      Change the noise reduction parameters, picked up at the next
+ *             block like the others. Turning it on delays the audio by
+ *             DENOISE_FFT_SIZE frames and starts them silent, turning it
+ *             off drops them
+ */
+esp_err_t voice_dsp_set_denoise(audio_element_handle_t self, const denoise_params_t *params);
+
+esp_err_t voice_dsp_get_denoise(audio_element_handle_t self, denoise_params_t *params);
+
+esp_err_t voice_dsp_get_stats(audio_element_handle_t self, voice_dsp_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* MAIN_VOICE_DSP_H_ */
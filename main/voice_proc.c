@@ -0,0 +1,225 @@
+/*
+ * voice_proc.c
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: xenir
+ */
+
+#include <string.h>
+#include <math.h>
+
+#include "voice_proc.h"
+
+#define Q15_ONE			32767
+#define Q11_ONE			2048
+#define AGC_MIN_GAIN	(Q11_ONE / 16)
+#define AGC_GAIN_LIMIT	(64000)			// Just under 30 dB in Q11, keeps sample * gain inside 32 bits
+#define HPF_MIN_CUTOFF	10
+
+static inline int16_t _sat16( int32_t v )
+{
+    if ( v > 32767 )
+        return 32767;
+    if ( v < -32768 )
+        return -32768;
+    return v;
+}
+
+static int32_t _db_to_level( int dbfs )
+{
+    return 32768.0f * powf( 10.0f, dbfs / 20.0f );
+}
+
+// One pole smoothing coefficient for a time constant, applied once per sub-block
+
+static int32_t _smoothing_q15( int sample_rate, int ms )
+{
+    if ( ms <= 0 )
+        return Q15_ONE;
+
+    float tau = sample_rate * ms / 1000.0f;
+    return Q15_ONE * ( 1.0f - expf( -VOICE_PROC_SUBBLOCK / tau ) );
+}
+
+void voice_proc_set_params( voice_proc_t* vp, const voice_proc_params_t* params )
+{
+    vp->params = *params;
+
+    // RBJ cookbook high-pass, Q = 1/sqrt(2)
+
+    int fc = params->hpf_cutoff_hz < HPF_MIN_CUTOFF ? HPF_MIN_CUTOFF : params->hpf_cutoff_hz;
+    float w0 = 2.0f * M_PI * fc / vp->sample_rate;
+    float cs = cosf( w0 );
+    float alpha = sinf( w0 ) / ( 2.0f * 0.70710678f );
+    float a0 = 1.0f + alpha;
+    float q30 = 1 << 30;
+
+    vp->b0 = q30 * ( 1.0f + cs ) / 2.0f / a0;
+    vp->b1 = q30 * -( 1.0f + cs ) / a0;
+    vp->b2 = vp->b0;
+    vp->a1 = q30 * -2.0f * cs / a0;
+    vp->a2 = q30 * ( 1.0f - alpha ) / a0;
+
+    vp->attack = _smoothing_q15( vp->sample_rate, params->agc_attack_ms );
+    vp->release = _smoothing_q15( vp->sample_rate, params->agc_release_ms );
+
+    vp->agc_target = _db_to_level( params->agc_target_dbfs );
+    float max_gain = Q11_ONE * powf( 10.0f, params->agc_max_gain_db / 20.0f );
+    vp->agc_max_gain = max_gain > AGC_GAIN_LIMIT ? AGC_GAIN_LIMIT : max_gain;
+
+    vp->gate_threshold = _db_to_level( params->gate_threshold_dbfs );
+    vp->gate_floor = Q15_ONE * powf( 10.0f, params->gate_floor_db / 20.0f );
+    vp->gate_release = _smoothing_q15( vp->sample_rate, params->gate_release_ms );
+    vp->gate_hold = params->gate_hold_ms * vp->sample_rate / 1000 / VOICE_PROC_SUBBLOCK;
+
+    if ( !params->agc_enable )
+        vp->agc_gain = Q11_ONE;
+    if ( !params->gate_enable )
+        vp->gate_gain = Q15_ONE;
+}
+
+void voice_proc_init( voice_proc_t* vp, int sample_rate, int channels, const voice_proc_params_t* params )
+{
+    memset( vp, 0, sizeof(voice_proc_t) );
+
+    vp->sample_rate = sample_rate;
+    vp->channels = channels > VOICE_PROC_MAX_CHANNELS ? VOICE_PROC_MAX_CHANNELS : channels;
+
+    vp->agc_gain = Q11_ONE;
+    vp->gate_gain = Q15_ONE;
+    vp->gain = Q11_ONE;
+
+    voice_proc_set_params( vp, params );
+}
+
+// DC blocker over one sub-block, returns the peak magnitude of the output
+
+static int32_t _hpf( voice_proc_t* vp, int16_t* buf, int frames )
+{
+    int32_t peak = 0;
+    int channels = vp->channels;
+
+    for ( int c = 0 ; c < channels ; c++ ) {
+
+        int32_t x1 = vp->x1[c], x2 = vp->x2[c];
+        int32_t y1 = vp->y1[c], y2 = vp->y2[c];
+
+        for ( int i = c ; i < frames * channels ; i += channels ) {
+
+            int32_t x = (int32_t) buf[i] << 8;
+            int64_t acc = (int64_t) vp->b0 * x + (int64_t) vp->b1 * x1 + (int64_t) vp->b2 * x2
+                        - (int64_t) vp->a1 * y1 - (int64_t) vp->a2 * y2;
+            int32_t y = acc >> 30;
+
+            x2 = x1; x1 = x;
+            y2 = y1; y1 = y;
+
+            int16_t out = _sat16( ( y + 128 ) >> 8 );
+            buf[i] = out;
+
+            int32_t mag = out < 0 ? -out : out;
+            if ( mag > peak )
+                peak = mag;
+        }
+
+        vp->x1[c] = x1; vp->x2[c] = x2;
+        vp->y1[c] = y1; vp->y2[c] = y2;
+    }
+
+    return peak;
+}
+
+static int32_t _peak( voice_proc_t* vp, const int16_t* buf, int frames )
+{
+    int32_t peak = 0;
+
+    for ( int i = 0 ; i < frames * vp->channels ; i++ ) {
+        int32_t mag = buf[i] < 0 ? -buf[i] : buf[i];
+        if ( mag > peak )
+            peak = mag;
+    }
+
+    return peak;
+}
+
+// Level detection and gain computation, once per sub-block. The AGC is
+// frozen while the input is below the gate threshold so it does not pump
+// the background noise up during pauses.
+
+static int32_t _update_gain( voice_proc_t* vp, int32_t peak )
+{
+    int32_t target = peak << 15;
+    int32_t coef = target > vp->env ? vp->attack : vp->release;
+    vp->env += ( (int64_t) ( target - vp->env ) * coef ) >> 15;
+
+    int32_t level = vp->env >> 15;
+    bool open = level >= vp->gate_threshold;
+
+    if ( vp->params.gate_enable ) {
+        if ( open ) {
+            vp->gate_count = 0;
+            vp->gate_gain = Q15_ONE;
+        } else if ( vp->gate_count < vp->gate_hold ) {
+            vp->gate_count++;
+        } else {
+            vp->gate_gain += ( ( vp->gate_floor - vp->gate_gain ) * vp->gate_release ) >> 15;
+        }
+    }
+
+    if ( vp->params.agc_enable && ( open || !vp->params.gate_enable ) ) {
+        int32_t gain = ( vp->agc_target << 11 ) / ( level > 0 ? level : 1 );
+        if ( gain > vp->agc_max_gain )
+            gain = vp->agc_max_gain;
+        if ( gain < AGC_MIN_GAIN )
+            gain = AGC_MIN_GAIN;
+        vp->agc_gain = gain;
+    }
+
+    if ( vp->gate_gain >= Q15_ONE )
+        return vp->agc_gain;
+
+    return ( vp->agc_gain * vp->gate_gain ) >> 15;
+}
+
+// Ramps from the previous gain to the new one across the sub-block. The
+// ramp is kept with 8 extra fraction bits so short tails still move smoothly
+
+static void _apply_gain( voice_proc_t* vp, int16_t* buf, int frames, int32_t gain )
+{
+    int channels = vp->channels;
+    int32_t cur = vp->gain << 8;
+    int32_t step = ( ( gain - vp->gain ) << 8 ) / frames;
+
+    for ( int i = 0 ; i < frames ; i++ ) {
+        cur += step;
+        int32_t g = cur >> 8;
+        for ( int c = 0 ; c < channels ; c++ ) {
+            int16_t* s = &buf[i * channels + c];
+            *s = _sat16( ( *s * g ) >> 11 );
+        }
+    }
+
+    vp->gain = gain;
+}
+
+void voice_proc_process( voice_proc_t* vp, int16_t* buf, int frames )
+{
+    bool gain_stage = vp->params.agc_enable || vp->params.gate_enable || vp->gain != Q11_ONE;
+
+    while ( frames > 0 ) {
+
+        int n = frames < VOICE_PROC_SUBBLOCK ? frames : VOICE_PROC_SUBBLOCK;
+        int32_t peak = 0;
+
+        if ( vp->params.hpf_enable )
+            peak = _hpf( vp, buf, n );
+        else if ( gain_stage )
+            peak = _peak( vp, buf, n );
+
+        if ( gain_stage )
+            _apply_gain( vp, buf, n, _update_gain( vp, peak ) );
+
+        buf += n * vp->channels;
+        frames -= n;
+    }
+}
@@ -0,0 +1,104 @@
+/*
+ * voice_proc.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: xenir
+ */
+
+#ifndef MAIN_VOICE_PROC_H_
+#define MAIN_VOICE_PROC_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// DC blocking high-pass, AGC and noise gate for 16 bit interleaved PCM.
+// Everything in the sample path is integer: the biquad runs with Q30
+// coefficients and 8 guard bits on its state, the level detector is a Q30
+// peak envelope and the gains are Q11 (AGC) and Q15 (gate). The AGC and
+// gate update once per VOICE_PROC_SUBBLOCK frames and the gain is ramped
+// linearly across the sub-block. Floating point is only used when the
+// parameters change.
+
+#define VOICE_PROC_SUBBLOCK			32
+#define VOICE_PROC_MAX_CHANNELS		2
+
+typedef struct {
+    bool	hpf_enable;
+    int		hpf_cutoff_hz;			// DC blocker corner frequency
+
+    bool	agc_enable;
+    int		agc_target_dbfs;		// Envelope level the AGC aims for
+    int		agc_max_gain_db;		// Gain limit, at most 30 dB
+    int		agc_attack_ms;
+    int		agc_release_ms;
+
+    bool	gate_enable;
+    int		gate_threshold_dbfs;	// Input envelope below which the gate closes
+    int		gate_floor_db;			// Attenuation when closed
+    int		gate_hold_ms;			// Time below threshold before closing
+    int		gate_release_ms;		// Time taken to close
+} voice_proc_params_t;
+
+#define DEFAULT_VOICE_PROC_PARAMS() {\
+    .hpf_enable             = true,\
+    .hpf_cutoff_hz          = 80,\
+    .agc_enable             = true,\
+    .agc_target_dbfs        = -18,\
+    .agc_max_gain_db        = 24,\
+    .agc_attack_ms          = 5,\
+    .agc_release_ms         = 500,\
+    .gate_enable            = true,\
+    .gate_threshold_dbfs    = -55,\
+    .gate_floor_db          = -40,\
+    .gate_hold_ms           = 200,\
+    .gate_release_ms        = 50,\
+}
+
+typedef struct {
+
+    voice_proc_params_t	params;
+    int					sample_rate;
+    int					channels;
+
+    // High-pass biquad, Q30 coefficients, state in Q23
+    int32_t				b0, b1, b2, a1, a2;
+    int32_t				x1[VOICE_PROC_MAX_CHANNELS], x2[VOICE_PROC_MAX_CHANNELS];
+    int32_t				y1[VOICE_PROC_MAX_CHANNELS], y2[VOICE_PROC_MAX_CHANNELS];
+
+    // Peak envelope in Q30 and its per sub-block coefficients in Q15
+    int32_t				env;
+    int32_t				attack;
+    int32_t				release;
+
+    int32_t				agc_target;		// In sample units
+    int32_t				agc_max_gain;	// Q11
+    int32_t				agc_gain;		// Q11
+
+    int32_t				gate_threshold;	// In sample units
+    int32_t				gate_floor;		// Q15
+    int32_t				gate_gain;		// Q15
+    int32_t				gate_release;	// Q15 per sub-block
+    int					gate_hold;		// Sub-blocks
+    int					gate_count;
+
+    int32_t				gain;			// Combined gain applied at the end of the last sub-block, Q11
+
+} voice_proc_t;
+
+void voice_proc_init( voice_proc_t* vp, int sample_rate, int channels, const voice_proc_params_t* params );
+
+// Changes parameters keeping the filter and gain state so there is no click
+void voice_proc_set_params( voice_proc_t* vp, const voice_proc_params_t* params );
+
+// Processes "frames" interleaved frames in place
+void voice_proc_process( voice_proc_t* vp, int16_t* buf, int frames );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* MAIN_VOICE_PROC_H_ */
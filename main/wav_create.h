@@ -9,5 +9,7 @@
 #define MAIN_WAV_CREATE_H_
 
 int create_wav( int seconds_of_recording, int frequency, int16_t** data );
+void create_wav_data( int16_t* buf, int seconds_of_recording, double frequency, int num_channels, int bits_per_sample, int sample_rate );
+void create_wav_header( int16_t* data_buf, int len, int num_channels, int bits_per_sample, int sample_rate );
 
 #endif /* MAIN_WAV_CREATE_H_ */
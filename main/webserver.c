@@ -7,9 +7,16 @@
    CONDITIONS OF ANY KIND, either express or implied.
 */
 
+#include <sys/socket.h>
+#include <netinet/in.h>
+
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+
 #include "webserver.h"
 #include "wav_create.h"
 #include "streaming_wav.h"
+#include "block_pool.h"
 
 #define HTTPD_SCRATCH_BUF  MAX(HTTPD_MAX_REQ_HDR_LEN, HTTPD_MAX_URI_LEN)
 
@@ -42,18 +49,66 @@ struct httpd_req_aux {
  */
 
 #define FILE_PATH_MAX (ESP_VFS_PATH_MAX + CONFIG_SPIFFS_OBJ_NAME_LEN)
-#define SCRATCH_BUFSIZE  8192
 
 static const char *TAG = "web-server";
 
+/* Everything a /command request needs, taken from a pool as one block so
+ * handling a command does not touch the heap */
+struct request_scratch {
+    char response[WEBSERVER_COMMAND_RESPONSE_SIZE];
+    char query[HTTPD_MAX_URI_LEN + 1];
+    char host[64];
+};
+
+/* A file download handed from the server task to a worker. The file is
+ * opened by the handler so missing files get their error from the server */
+struct file_job {
+    int fd;
+    FILE *file;
+    long size;
+    const char *type;
+};
+
+/* Sockets written by a task other than the server's. If the server closes
+ * one (client gone, LRU purge, or a handler detaching it) while it is held,
+ * the close is left to the holder so the descriptor cannot be reused under it */
+struct held_socket {
+    int fd;
+    bool closing;
+};
+
 struct file_server_data {
     /* Base path of file storage */
     char base_path[ESP_VFS_PATH_MAX + 1];
 
-    /* Scratch buffer for temporary storage during file transfer */
-    char scratch[SCRATCH_BUFSIZE];
+    /* Download workers, their queue and chunk buffers */
+    QueueHandle_t file_queue;
+    block_pool_handle_t file_pool;
+
+    /* Sockets held by the file workers and async sessions */
+    struct held_socket held[WEBSERVER_MAX_HELD_SOCKETS];
+    portMUX_TYPE held_lock;
 
     void (*command_callback)( const char*, char* );
+
+    /* Blocks of struct request_scratch */
+    block_pool_handle_t request_pool;
+
+    /* Handle of the port 80 server and its catch-all file handler. The
+     * handler list is changed from several boot tasks, so each change
+     * takes the lock; so does a call into the server task, which waits on
+     * call_done */
+    httpd_handle_t server;
+    httpd_uri_t file_download;
+    SemaphoreHandle_t uri_lock;
+    QueueHandle_t call_done;
+
+    /* Modules holding sockets open past their handler want to know when they close */
+    struct {
+        void (*fn)( int, void* );
+        void *ctx;
+    } close_callbacks[WEBSERVER_MAX_CLOSE_CALLBACKS];
+    int num_close_callbacks;
 };
 
 struct file_server_data *server_data = NULL;
@@ -61,28 +116,28 @@ struct file_server_data *server_data = NULL;
 #define IS_FILE_EXT(filename, ext) \
     (strcasecmp(&filename[strlen(filename) - sizeof(ext) + 1], ext) == 0)
 
-/* Set HTTP response content type according to file extension */
-static esp_err_t set_content_type_from_file(httpd_req_t *req, const char *filename)
+/* HTTP response content type according to file extension */
+static const char* content_type_from_file(const char *filename)
 {
     if (IS_FILE_EXT(filename, ".pdf")) {
-        return httpd_resp_set_type(req, "application/pdf");
+        return "application/pdf";
     } else if (IS_FILE_EXT(filename, ".html")) {
-            return httpd_resp_set_type(req, "text/html");
+            return "text/html";
     } else if (IS_FILE_EXT(filename, ".css")) {
-            return httpd_resp_set_type(req, "text/css");
+            return "text/css";
     } else if (IS_FILE_EXT(filename, ".svg")) {
-            return httpd_resp_set_type(req, "image/svg+xml");
+            return "image/svg+xml";
     } else if (IS_FILE_EXT(filename, ".jpeg")) {
-        return httpd_resp_set_type(req, "image/jpeg");
+        return "image/jpeg";
     } else if (IS_FILE_EXT(filename, ".wav")) {
-        return httpd_resp_set_type(req, "audio/x-wav");
+        return "audio/x-wav";
     } else if (IS_FILE_EXT(filename, ".ico")) {
-        return httpd_resp_set_type(req, "image/x-icon");
+        return "image/x-icon";
     }
 
     /* This is a limited set only */
     /* For any other type always set as plain text */
-    return httpd_resp_set_type(req, "text/plain");
+    return "text/plain";
 }
 
 
@@ -117,11 +172,136 @@ static const char* get_path_from_uri(char *dest, const char *base_path, const ch
 
 
 
-/* Handler to download a file kept on the server */
+esp_err_t webserver_hold_socket(int fd)
+{
+    esp_err_t ret = ESP_ERR_NO_MEM;
+
+    taskENTER_CRITICAL(&server_data->held_lock);
+    for (int i = 0; i < WEBSERVER_MAX_HELD_SOCKETS; i++) {
+        if (server_data->held[i].fd < 0) {
+            server_data->held[i].fd = fd;
+            server_data->held[i].closing = false;
+            ret = ESP_OK;
+            break;
+        }
+    }
+    taskEXIT_CRITICAL(&server_data->held_lock);
+
+    return ret;
+}
+
+bool webserver_release_socket(int fd)
+{
+    bool closing = false;
+
+    taskENTER_CRITICAL(&server_data->held_lock);
+    for (int i = 0; i < WEBSERVER_MAX_HELD_SOCKETS; i++) {
+        if (server_data->held[i].fd == fd) {
+            closing = server_data->held[i].closing;
+            server_data->held[i].fd = -1;
+            break;
+        }
+    }
+    taskEXIT_CRITICAL(&server_data->held_lock);
+
+    return closing;
+}
+
+/* Called with the server closing "fd". Returns true if the socket is held */
+static bool held_socket_defer_close(int fd)
+{
+    bool held = false;
+
+    taskENTER_CRITICAL(&server_data->held_lock);
+    for (int i = 0; i < WEBSERVER_MAX_HELD_SOCKETS; i++) {
+        if (server_data->held[i].fd == fd) {
+            server_data->held[i].closing = true;
+            held = true;
+            break;
+        }
+    }
+    taskEXIT_CRITICAL(&server_data->held_lock);
+
+    return held;
+}
+
+esp_err_t webserver_detach_socket(httpd_req_t *req)
+{
+    return webserver_hold_socket(httpd_req_to_sockfd(req));
+}
+
+esp_err_t webserver_send_all(int fd, const char *buf, int len)
+{
+    while (len > 0) {
+        int n = send(fd, buf, len, MSG_NOSIGNAL);
+        if (n <= 0) {
+            return ESP_FAIL;
+        }
+        buf += n;
+        len -= n;
+    }
+    return ESP_OK;
+}
+
+/* Writes the whole response straight to the socket. The session's send
+ * timeout still applies, so a stalled client costs a worker at most that
+ * long per chunk */
+static bool file_send(struct file_job *job, char *chunk)
+{
+    int len = snprintf(chunk, WEBSERVER_FILE_CHUNK,
+                       "HTTP/1.1 200 OK\r\nContent-Type: %s\r\nContent-Length: %ld\r\n\r\n",
+                       job->type, job->size);
+    if (webserver_send_all(job->fd, chunk, len) != ESP_OK) {
+        return false;
+    }
+
+    long remaining = job->size;
+    while (remaining > 0) {
+        size_t chunksize = fread(chunk, 1, WEBSERVER_FILE_CHUNK, job->file);
+        if (chunksize == 0) {
+            return false;
+        }
+        if (webserver_send_all(job->fd, chunk, chunksize) != ESP_OK) {
+            return false;
+        }
+        remaining -= chunksize;
+    }
+
+    return true;
+}
+
+static void file_worker_task(void *arg)
+{
+    struct file_job job;
+
+    while (true) {
+        xQueueReceive(server_data->file_queue, &job, portMAX_DELAY);
+
+        /* One block per worker, so the pool only runs dry if it is undersized */
+        char *chunk = block_pool_get(server_data->file_pool);
+        bool ok = chunk && file_send(&job, chunk);
+        if (chunk) {
+            block_pool_put(server_data->file_pool, chunk);
+        }
+        fclose(job.file);
+
+        if (webserver_release_socket(job.fd)) {
+            close(job.fd);
+        } else if (!ok) {
+            ESP_LOGE(TAG, "File sending failed on socket %d", job.fd);
+            httpd_sess_trigger_close(server_data->server, job.fd);
+        }
+    }
+}
+
+/* Handler to download a file kept on the server. It only checks the file
+ * and queues it: the transfer is done by a worker after the handler has
+ * returned, with the server going back to its other sessions. The client
+ * does not send its next request on the connection until the response is
+ * complete, so the server has nothing to read from the socket meanwhile */
 static esp_err_t download_get_handler(httpd_req_t *req)
 {
     char filepath[FILE_PATH_MAX];
-    FILE *fd = NULL;
     struct stat file_stat;
 
     const char *filename = get_path_from_uri(filepath, ((struct file_server_data *)req->user_ctx)->base_path,
@@ -133,90 +313,76 @@ static esp_err_t download_get_handler(httpd_req_t *req)
         return ESP_FAIL;
     }
 
-    fd = fopen(filepath, "r");
-    if (!fd) {
-        ESP_LOGE(TAG, "Failed to read existing file : %s", filepath);
-        /* Respond with 500 Internal Server Error */
-        httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Failed to read existing file");
-        return ESP_FAIL;
-    }
-
     if (stat(filepath, &file_stat) == -1) {
         ESP_LOGE(TAG, "Failed to stat file : %s", filepath);
         httpd_resp_send_err(req, HTTPD_404_NOT_FOUND, "File does not exist");
         return ESP_FAIL;
     }
 
-    ESP_LOGI(TAG, "Sending file : %s (%ld bytes)...", filename, file_stat.st_size);
-    set_content_type_from_file(req, filename);
-
-    /* Retrieve the pointer to scratch buffer for temporary storage */
-    char *chunk = ((struct file_server_data *)req->user_ctx)->scratch;
-    size_t chunksize;
-    do {
-        /* Read file in chunks into the scratch buffer */
-        chunksize = fread(chunk, 1, SCRATCH_BUFSIZE, fd);
-
-        if (chunksize > 0) {
-            /* Send the buffer contents as HTTP response chunk */
-            if (httpd_resp_send_chunk(req, chunk, chunksize) != ESP_OK) {
-                fclose(fd);
-                ESP_LOGE(TAG, "File sending failed!");
-                /* Abort sending file */
-                httpd_resp_sendstr_chunk(req, NULL);
-                /* Respond with 500 Internal Server Error */
-                httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Failed to send file");
-               return ESP_FAIL;
-           }
-        }
+    struct file_job job = {
+        .fd = httpd_req_to_sockfd(req),
+        .size = file_stat.st_size,
+        .type = content_type_from_file(filename),
+    };
 
-        /* Keep looping till the whole file is sent */
-    } while (chunksize != 0);
+    if (webserver_hold_socket(job.fd) != ESP_OK) {
+        httpd_resp_set_status(req, "503 Service Unavailable");
+        httpd_resp_send(req, "Busy", HTTPD_RESP_USE_STRLEN);
+        return ESP_OK;
+    }
 
-    /* Close file after sending complete */
-    fclose(fd);
-    ESP_LOGI(TAG, "File sending complete");
+    job.file = fopen(filepath, "r");
+    if (!job.file) {
+        webserver_release_socket(job.fd);
+        ESP_LOGE(TAG, "Failed to read existing file : %s", filepath);
+        /* Respond with 500 Internal Server Error */
+        httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Failed to read existing file");
+        return ESP_FAIL;
+    }
+
+    ESP_LOGI(TAG, "Queueing file : %s (%ld bytes)...", filename, file_stat.st_size);
 
-    /* Respond with an empty chunk to signal HTTP response completion */
-    httpd_resp_send_chunk(req, NULL, 0);
+    if (xQueueSend(server_data->file_queue, &job, 0) != pdTRUE) {
+        fclose(job.file);
+        webserver_release_socket(job.fd);
+        httpd_resp_set_status(req, "503 Service Unavailable");
+        httpd_resp_send(req, "Busy", HTTPD_RESP_USE_STRLEN);
+    }
     return ESP_OK;
 }
 
 
 static esp_err_t command_handler(httpd_req_t *req)
 {
-    char* buf;
-    char* response;
-    size_t buf_len;
+    struct request_scratch *scratch = block_pool_get(server_data->request_pool);
+    if (!scratch) {
+        httpd_resp_set_status(req, "503 Service Unavailable");
+        httpd_resp_send(req, "Busy", HTTPD_RESP_USE_STRLEN);
+        return ESP_OK;
+    }
 
-    response = malloc(256);
+    char *response = scratch->response;
+    response[0] = '\0';
 
-    /* Get header value string length and allocate memory for length + 1,
-     * extra byte for null termination */
-    buf_len = httpd_req_get_hdr_value_len(req, "Host") + 1;
-    if (buf_len > 1) {
-        buf = malloc(buf_len);
+    /* Headers or queries too long for the scratch block are ignored */
+    size_t buf_len = httpd_req_get_hdr_value_len(req, "Host") + 1;
+    if (buf_len > 1 && buf_len <= sizeof(scratch->host)) {
         /* Copy null terminated value string into buffer */
-        if (httpd_req_get_hdr_value_str(req, "Host", buf, buf_len) == ESP_OK) {
-            ESP_LOGI(TAG, "Found header => Host: %s", buf);
+        if (httpd_req_get_hdr_value_str(req, "Host", scratch->host, buf_len) == ESP_OK) {
+            ESP_LOGI(TAG, "Found header => Host: %s", scratch->host);
         }
-        free(buf);
     }
 
-    /* Read URL query string length and allocate memory for length + 1,
-     * extra byte for null termination */
     buf_len = httpd_req_get_url_query_len(req) + 1;
-    if (buf_len > 1) {
-        buf = malloc(buf_len);
-        if (httpd_req_get_url_query_str(req, buf, buf_len) == ESP_OK) {
-            ESP_LOGI(TAG, "Found URL query => %s", buf);
-            server_data->command_callback( buf, response );
+    if (buf_len > 1 && buf_len <= sizeof(scratch->query)) {
+        if (httpd_req_get_url_query_str(req, scratch->query, buf_len) == ESP_OK) {
+            ESP_LOGI(TAG, "Found URL query => %s", scratch->query);
+            server_data->command_callback( scratch->query, response );
         }
-        free(buf);
     }
 
     httpd_resp_send(req, response, strlen(response));
-    free( response );
+    block_pool_put(server_data->request_pool, scratch);
 
     return ESP_OK;
 }
@@ -235,6 +401,238 @@ esp_err_t http_404_error_handler(httpd_req_t *req, httpd_err_code_t err)
 }
 
 
+/* Runs in the server task whenever a session socket is closed, whether by
+ * the client, an error or the LRU purge. Setting close_fn means the server
+ * leaves closing the socket to us */
+static void webserver_close_fn(httpd_handle_t hd, int sockfd)
+{
+    for (int i = 0; i < server_data->num_close_callbacks; i++) {
+        server_data->close_callbacks[i].fn(sockfd, server_data->close_callbacks[i].ctx);
+    }
+    if (!held_socket_defer_close(sockfd)) {
+        close(sockfd);
+    }
+}
+
+esp_err_t webserver_add_close_callback(void (*fn)(int sockfd, void *ctx), void *ctx)
+{
+    if (!server_data || server_data->num_close_callbacks >= WEBSERVER_MAX_CLOSE_CALLBACKS) {
+        return ESP_ERR_NO_MEM;
+    }
+
+    server_data->close_callbacks[server_data->num_close_callbacks].fn = fn;
+    server_data->close_callbacks[server_data->num_close_callbacks].ctx = ctx;
+    server_data->num_close_callbacks++;
+    return ESP_OK;
+}
+
+/* Only from the server task, which is the one calling them */
+esp_err_t webserver_remove_close_callback(void (*fn)(int sockfd, void *ctx), void *ctx)
+{
+    for (int i = 0; server_data && i < server_data->num_close_callbacks; i++) {
+        if (server_data->close_callbacks[i].fn == fn && server_data->close_callbacks[i].ctx == ctx) {
+            server_data->num_close_callbacks--;
+            memmove(&server_data->close_callbacks[i], &server_data->close_callbacks[i + 1],
+                    (server_data->num_close_callbacks - i) * sizeof(server_data->close_callbacks[0]));
+            return ESP_OK;
+        }
+    }
+    return ESP_ERR_NOT_FOUND;
+}
+
+httpd_handle_t webserver_get_handle(void)
+{
+    return server_data ? server_data->server : NULL;
+}
+
+/* Handlers are matched in registration order and the file download
+ * handler matches everything, so it is taken off the end of the list,
+ * the new handler added and the file handler put back behind it */
+esp_err_t webserver_register_uri_handler(const httpd_uri_t *uri)
+{
+    if (!server_data || !server_data->server) {
+        ESP_LOGE(TAG, "Web server not started");
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    httpd_handle_t server = server_data->server;
+
+    xSemaphoreTake(server_data->uri_lock, portMAX_DELAY);
+    httpd_unregister_uri_handler(server, server_data->file_download.uri, server_data->file_download.method);
+    esp_err_t ret = httpd_register_uri_handler(server, uri);
+    httpd_register_uri_handler(server, &server_data->file_download);
+    xSemaphoreGive(server_data->uri_lock);
+
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to register URI handler %s (%s)", uri->uri, esp_err_to_name(ret));
+    }
+    return ret;
+}
+
+struct server_call {
+    void (*fn)(void *arg);
+    void *arg;
+};
+
+static void server_call_work(void *arg)
+{
+    struct server_call *call = (struct server_call *)arg;
+    if (call->fn) {
+        call->fn(call->arg);
+    }
+    xQueueSend(server_data->call_done, &call, portMAX_DELAY);
+}
+
+/* Runs "fn" in the server task and waits for it, with uri_lock held. The
+ * server task runs one request at a time, so once the work has run no
+ * handler that was in progress is still running */
+static esp_err_t server_call(void (*fn)(void *arg), void *arg)
+{
+    struct server_call call = { fn, arg }, *done;
+
+    esp_err_t ret = httpd_queue_work(server_data->server, server_call_work, &call);
+    if (ret == ESP_OK) {
+        xQueueReceive(server_data->call_done, &done, portMAX_DELAY);
+    }
+    return ret;
+}
+
+esp_err_t webserver_call(void (*fn)(void *arg), void *arg)
+{
+    if (!server_data || !server_data->server) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    xSemaphoreTake(server_data->uri_lock, portMAX_DELAY);
+    esp_err_t ret = server_call(fn, arg);
+    xSemaphoreGive(server_data->uri_lock);
+    return ret;
+}
+
+/* The handler is taken off the list, then the server task is waited on so
+ * a request still running in it is finished and the handler's context can
+ * be freed on return */
+esp_err_t webserver_unregister_uri_handler(const char *uri, httpd_method_t method)
+{
+    if (!server_data || !server_data->server) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    xSemaphoreTake(server_data->uri_lock, portMAX_DELAY);
+    esp_err_t ret = httpd_unregister_uri_handler(server_data->server, uri, method);
+    if (ret == ESP_OK) {
+        ret = server_call(NULL, NULL);
+    }
+    xSemaphoreGive(server_data->uri_lock);
+
+    return ret;
+}
+
+/* Port alias. Clients of the old dedicated streaming server still connect
+ * to its port: the alias reads the request line and Host header and
+ * redirects to the same path on port 80. One connection at a time, so the
+ * buffers are static and the task stack stays small */
+
+static char alias_req[512];
+static char alias_resp[WEBSERVER_ALIAS_RESPONSE_SIZE];
+
+static void alias_redirect(int fd)
+{
+    int len = 0;
+
+    while (len < (int) sizeof(alias_req) - 1) {
+        int n = recv(fd, alias_req + len, sizeof(alias_req) - 1 - len, 0);
+        if (n <= 0) {
+            return;
+        }
+        len += n;
+        alias_req[len] = '\0';
+        if (strstr(alias_req, "\r\n\r\n")) {
+            break;
+        }
+    }
+
+    /* "GET /path HTTP/1.1", the path is cut at the space after it */
+    char *path = strchr(alias_req, ' ');
+    char *end = path ? strchr(path + 1, ' ') : NULL;
+    if (!end) {
+        return;
+    }
+    *end = '\0';
+    path++;
+
+    /* Host without its port, falling back to a relative redirect */
+    const char *host = "";
+    for (char *h = strstr(end + 1, "\r\n"); h && h[2] != '\r'; h = strstr(h + 2, "\r\n")) {
+        if (strncasecmp(h + 2, "Host:", 5) == 0) {
+            h += 7;
+            while (*h == ' ') {
+                h++;
+            }
+            h[strcspn(h, ":\r")] = '\0';
+            host = h;
+            break;
+        }
+    }
+
+    len = snprintf(alias_resp, sizeof(alias_resp),
+                   "HTTP/1.1 307 Temporary Redirect\r\nLocation: %s%s%s\r\n"
+                   "Content-Length: 0\r\nConnection: close\r\n\r\n",
+                   *host ? "http://" : "", host, path);
+    if (len < (int) sizeof(alias_resp)) {
+        webserver_send_all(fd, alias_resp, len);
+    }
+}
+
+static void alias_task(void *arg)
+{
+    int listen_fd = (intptr_t) arg;
+    struct timeval timeout = { .tv_sec = WEBSERVER_ALIAS_TIMEOUT_S };
+
+    while (true) {
+        int fd = accept(listen_fd, NULL, NULL);
+        if (fd < 0) {
+            vTaskDelay(100 / portTICK_PERIOD_MS);
+            continue;
+        }
+
+        setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+        setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+        alias_redirect(fd);
+        close(fd);
+    }
+}
+
+esp_err_t webserver_start_alias(int port)
+{
+    struct sockaddr_in addr = {
+        .sin_family = AF_INET,
+        .sin_port = htons(port),
+        .sin_addr.s_addr = htonl(INADDR_ANY),
+    };
+
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0) {
+        ESP_LOGE(TAG, "No socket for the port %d alias", port);
+        return ESP_FAIL;
+    }
+
+    int one = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+
+    if (bind(fd, (struct sockaddr *) &addr, sizeof(addr)) != 0 || listen(fd, 2) != 0 ||
+        xTaskCreate(alias_task, "http_alias", WEBSERVER_ALIAS_TASK_STACK, (void *) (intptr_t) fd,
+                    WEBSERVER_ALIAS_TASK_PRIO, NULL) != pdPASS) {
+        ESP_LOGE(TAG, "Failed to start the port %d alias", port);
+        close(fd);
+        return ESP_FAIL;
+    }
+
+    ESP_LOGI(TAG, "Port %d redirects to port 80", port);
+    return ESP_OK;
+}
+
+
 esp_err_t start_webserver(const char *base_path, void (*cb)( const char *, char * ))
 {
     /* Validate file storage base path */
@@ -257,6 +655,31 @@ esp_err_t start_webserver(const char *base_path, void (*cb)( const char *, char
     strlcpy(server_data->base_path, base_path,sizeof(server_data->base_path));
     server_data->command_callback = cb;
 
+    server_data->request_pool = block_pool_create("request", sizeof(struct request_scratch), WEBSERVER_REQUEST_BLOCKS);
+    server_data->file_pool = block_pool_create("file", WEBSERVER_FILE_CHUNK, WEBSERVER_FILE_WORKERS);
+    server_data->file_queue = xQueueCreate(WEBSERVER_FILE_QUEUE, sizeof(struct file_job));
+    server_data->uri_lock = xSemaphoreCreateMutex();
+    server_data->call_done = xQueueCreate(1, sizeof(struct server_call *));
+    if (!server_data->request_pool || !server_data->file_pool || !server_data->file_queue ||
+        !server_data->uri_lock || !server_data->call_done) {
+        free(server_data);
+        server_data = NULL;
+        return ESP_ERR_NO_MEM;
+    }
+
+    server_data->held_lock = (portMUX_TYPE) portMUX_INITIALIZER_UNLOCKED;
+    for (int i = 0; i < WEBSERVER_MAX_HELD_SOCKETS; i++) {
+        server_data->held[i].fd = -1;
+    }
+
+    for (int i = 0; i < WEBSERVER_FILE_WORKERS; i++) {
+        if (xTaskCreate(file_worker_task, "file_worker", WEBSERVER_FILE_TASK_STACK, NULL,
+                        WEBSERVER_FILE_TASK_PRIO, NULL) != pdPASS) {
+            ESP_LOGE(TAG, "Failed to start file worker %d", i);
+            return ESP_ERR_NO_MEM;
+        }
+    }
+
     httpd_handle_t server = NULL;
     httpd_config_t config = HTTPD_DEFAULT_CONFIG();
 
@@ -276,12 +699,15 @@ esp_err_t start_webserver(const char *base_path, void (*cb)( const char *, char
         .handler   = download_get_handler,
         .user_ctx  = server_data    // Pass server data as context
     };
+    server_data->file_download = file_download;
 
     /* Use the URI wildcard matching function in order to
      * allow the same handler to respond to multiple different
      * target URIs which match the wildcard scheme */
     config.uri_match_fn = httpd_uri_match_wildcard;
     config.lru_purge_enable = true;
+    config.max_uri_handlers = WEBSERVER_MAX_URI_HANDLERS;
+    config.close_fn = webserver_close_fn;
 
     // Start the httpd server
     ESP_LOGI(TAG, "Starting server on port: '%d'", config.server_port);
@@ -289,8 +715,9 @@ esp_err_t start_webserver(const char *base_path, void (*cb)( const char *, char
         // Set URI handlers
         ESP_LOGI(TAG, "Registering URI handlers");
         httpd_register_uri_handler(server, &command);
-        httpd_register_uri_handler(server, &file_download);
+        httpd_register_uri_handler(server, &server_data->file_download);
         ESP_LOGI(TAG, "Completed Registering URI handlers");
+        server_data->server = server;
         return ESP_OK;
     }
 
@@ -39,8 +39,72 @@
 extern "C" {
 #endif
 
+#define WEBSERVER_MAX_URI_HANDLERS	16
+#define WEBSERVER_COMMAND_RESPONSE_SIZE	256
+#define WEBSERVER_MAX_CLOSE_CALLBACKS	4
+#define WEBSERVER_REQUEST_BLOCKS	2
+
+// Static files are sent by a small pool of workers, each with its own chunk
+// buffer from the "file" block pool, so a slow download holds up neither
+// other downloads nor the handlers (/command and friends) that run on the
+// server task. The workers run below the server task's priority
+#define WEBSERVER_FILE_WORKERS		2
+#define WEBSERVER_FILE_QUEUE		2
+#define WEBSERVER_FILE_CHUNK		4096
+#define WEBSERVER_FILE_TASK_STACK	(3 * 1024)
+#define WEBSERVER_FILE_TASK_PRIO	(4)
+
+// Sockets a task other than the server's may hold: the file workers and
+// their queue plus the async streaming sessions
+#define WEBSERVER_MAX_STREAMS		2
+#define WEBSERVER_MAX_HELD_SOCKETS	(WEBSERVER_FILE_WORKERS + WEBSERVER_FILE_QUEUE + WEBSERVER_MAX_STREAMS)
+
+// The port alias redirects clients of an old port to port 80
+#define WEBSERVER_ALIAS_TASK_STACK	(2 * 1024)
+#define WEBSERVER_ALIAS_TASK_PRIO	(2)
+#define WEBSERVER_ALIAS_TIMEOUT_S	2
+#define WEBSERVER_ALIAS_RESPONSE_SIZE	(512 + 128)
+
 esp_err_t start_webserver(const char *base_path, void (*cb)( const char *, char * ));
 
+// Adds a handler to the port 80 server ahead of the catch-all file handler
+esp_err_t webserver_register_uri_handler(const httpd_uri_t *uri);
+
+// Takes a handler off the port 80 server. Returns once no request for it
+// is running, so its user_ctx can be freed. Not from the server task
+esp_err_t webserver_unregister_uri_handler(const char *uri, httpd_method_t method);
+
+// Called from the server task when any port 80 session socket closes
+esp_err_t webserver_add_close_callback(void (*fn)(int sockfd, void *ctx), void *ctx);
+
+// Only from the server task, e.g. in webserver_call
+esp_err_t webserver_remove_close_callback(void (*fn)(int sockfd, void *ctx), void *ctx);
+
+// Runs "fn" in the server task, between requests, and waits for it. Not
+// from the server task
+esp_err_t webserver_call(void (*fn)(void *arg), void *arg);
+
+httpd_handle_t webserver_get_handle(void);
+
+// Socket ownership for responses written outside the server task. A held
+// socket is not closed by the server: if the server drops the session while
+// it is held, release returns true and the holder must close it.
+esp_err_t webserver_hold_socket(int fd);
+bool webserver_release_socket(int fd);
+
+// Takes a request's socket away from the server for an async session. The
+// handler writes its own response head and must return ESP_FAIL, which
+// makes the server drop the session without closing the socket. The socket
+// then no longer counts against the server's open sessions or its LRU
+// purge; the session ends with webserver_release_socket and close
+esp_err_t webserver_detach_socket(httpd_req_t *req);
+
+// Writes all of "buf" to a held socket, bound by the socket's send timeout
+esp_err_t webserver_send_all(int fd, const char *buf, int len);
+
+// Redirects requests on "port" to the same path on port 80
+esp_err_t webserver_start_alias(int port);
+
 
 #ifdef __cplusplus
 }
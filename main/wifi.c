@@ -137,12 +137,19 @@ esp_err_t setHostname( const char *hostname )
     return err;
 }
 
-esp_err_t wifi_connect_with_hostname( const char* ssid, const char* password, const char* hostname )
+esp_err_t wifi_netif_init( const char* hostname )
 {
     ESP_ERROR_CHECK(esp_event_loop_create_default());
     ESP_ERROR_CHECK(esp_netif_init());
     esp_netif_create_default_wifi_sta();
     setHostname( hostname );
+
+    return ESP_OK;
+}
+
+esp_err_t wifi_connect_with_hostname( const char* ssid, const char* password, const char* hostname )
+{
+    wifi_netif_init( hostname );
     esp_err_t ret = wifi_init_station( ssid, password );
 
     return ret;
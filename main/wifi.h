@@ -26,6 +26,13 @@ extern "C" {
 
 esp_err_t wifi_connect_with_hostname( const char* ssid, const char* password, const char* hostname );
 
+// The two halves of wifi_connect_with_hostname. Once wifi_netif_init has
+// returned the TCP/IP stack is up and servers can be started; the station
+// connect blocks until the AP is associated and an address obtained, or the
+// retries run out
+esp_err_t wifi_netif_init( const char* hostname );
+esp_err_t wifi_init_station( const char* ssid, const char* password );
+
 #ifdef __cplusplus
 }
 #endif